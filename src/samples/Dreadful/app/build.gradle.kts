@@ -31,6 +31,16 @@ android {
         sourceCompatibility = JavaVersion.VERSION_1_8
         targetCompatibility = JavaVersion.VERSION_1_8
     }
+    androidResources {
+        // KTX2 textures are already compressed, keep them uncompressed in the apk
+        noCompress += "ktx2"
+        // Asset packs compress their own entries, and stored ones are mapped straight from the apk
+        noCompress += "dpak"
+        // Meshes are mapped from the apk and uploaded straight from there
+        noCompress += "dmesh"
+        // glTF binaries are read in place too, the buffers straight into GL
+        noCompress += "glb"
+    }
     buildFeatures {
         prefab = true
     }
@@ -1,4 +1,13 @@
 #include "AndroidOut.h"
 
+#include <sys/resource.h>
+
 AndroidOut androidOut("AO");
-std::ostream aout(&androidOut);
\ No newline at end of file
+std::ostream aout(&androidOut);
+
+long getPeakRssKiB() {
+  rusage usage{};
+  getrusage(RUSAGE_SELF, &usage);
+  // Linux reports ru_maxrss in KiB
+  return usage.ru_maxrss;
+}
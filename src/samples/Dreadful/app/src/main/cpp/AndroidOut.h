@@ -1,8 +1,11 @@
 #ifndef ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 #define ANDROIDGLINVESTIGATIONS_ANDROIDOUT_H
 
+#if defined(ANDROID)
 #include <android/log.h>
+#endif
 
+#include <cstdio>
 #include <sstream>
 
 /*!
@@ -14,8 +17,13 @@
 extern std::ostream aout;
 
 /*!
- * Use this class to create an output stream that writes to logcat. By default, a global one is
- * defined as @a aout
+ * @return the peak resident set size of the process in KiB, to log next to load times
+ */
+long getPeakRssKiB();
+
+/*!
+ * Use this class to create an output stream that writes to logcat, or to stderr in host builds such
+ * as src/tools/vkhost. By default, a global one is defined as @a aout
  */
 class AndroidOut : public std::stringbuf {
  public:
@@ -27,7 +35,11 @@ class AndroidOut : public std::stringbuf {
 
  protected:
   virtual int sync() override {
+#if defined(ANDROID)
     __android_log_print(ANDROID_LOG_DEBUG, logTag_, "%s", str().c_str());
+#else
+    fprintf(stderr, "%s: %s", logTag_, str().c_str());
+#endif
     str("");
     return 0;
   }
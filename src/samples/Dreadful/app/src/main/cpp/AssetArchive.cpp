@@ -0,0 +1,172 @@
+#include "AssetArchive.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "AndroidOut.h"
+#include "Lz4.h"
+
+using namespace std;
+
+std::unique_ptr<AssetArchive> AssetArchive::open(AAssetManager* assetManager, const string& assetPath) {
+  auto asset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_RANDOM);
+  if (!asset) {
+    aout << "AssetArchive: can't open " << assetPath << endl;
+    return nullptr;
+  }
+  unique_ptr<AssetArchive> archive(new AssetArchive());
+
+  // Stored in the apk, the pack is a byte range of the apk file that can be mapped directly. mmap
+  // wants a page aligned offset, so the mapping starts a little early.
+  off64_t start = 0;
+  off64_t length = 0;
+  int fd = AAsset_openFileDescriptor64(asset, &start, &length);
+  if (fd >= 0) {
+    off64_t pageStart = start & ~off64_t(sysconf(_SC_PAGESIZE) - 1);
+    size_t mappingSize = size_t(length + (start - pageStart));
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, pageStart);
+    close(fd);
+    if (mapping != MAP_FAILED) {
+      archive->mapping_ = mapping;
+      archive->mappingSize_ = mappingSize;
+      archive->data_ = static_cast<const uint8_t*>(mapping) + (start - pageStart);
+      archive->size_ = size_t(length);
+    }
+  }
+  bool mapped = archive->data_ != nullptr;
+  if (mapped) {
+    AAsset_close(asset);
+  } else {
+    // compressed in the apk, so the asset manager inflates it into memory that's kept until close
+    archive->data_ = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+    archive->size_ = size_t(AAsset_getLength64(asset));
+    archive->asset_ = asset;
+    if (!archive->data_) {
+      aout << "AssetArchive: can't read " << assetPath << endl;
+      return nullptr;
+    }
+  }
+
+  if (!archive->parse(assetPath)) {
+    return nullptr;
+  }
+  aout << "AssetArchive: " << assetPath << ", " << archive->entries_.size() << " entries, " << archive->size_
+       << " bytes, " << (mapped ? "mapped from the apk" : "inflated by the asset manager") << endl;
+  return archive;
+}
+
+std::unique_ptr<AssetArchive> AssetArchive::openFile(const string& path) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    aout << "AssetArchive: can't open " << path << endl;
+    return nullptr;
+  }
+  struct stat info = {};
+  void* mapping = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    mapping = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    aout << "AssetArchive: can't map " << path << endl;
+    return nullptr;
+  }
+
+  unique_ptr<AssetArchive> archive(new AssetArchive());
+  archive->mapping_ = mapping;
+  archive->mappingSize_ = size_t(info.st_size);
+  archive->data_ = static_cast<const uint8_t*>(mapping);
+  archive->size_ = size_t(info.st_size);
+  if (!archive->parse(path)) {
+    return nullptr;
+  }
+  aout << "AssetArchive: " << path << ", " << archive->entries_.size() << " entries, " << archive->size_ << " bytes"
+       << endl;
+  return archive;
+}
+
+AssetArchive::~AssetArchive() {
+  if (mapping_) {
+    munmap(mapping_, mappingSize_);
+  }
+  if (asset_) {
+    AAsset_close(asset_);
+  }
+}
+
+bool AssetArchive::parse(const string& name) {
+  auto fail = [&name](const char* message) {
+    aout << "AssetArchive: " << name << ": " << message << endl;
+    return false;
+  };
+
+  AssetPackHeader header;
+  if (size_ < sizeof(header)) {
+    return fail("not an asset pack");
+  }
+  memcpy(&header, data_, sizeof(header));
+  if (memcmp(header.magic, kAssetPackMagic, sizeof(kAssetPackMagic)) != 0) {
+    return fail("not an asset pack");
+  }
+  if (header.version != kAssetPackVersion) {
+    return fail("unsupported version");
+  }
+  size_t indexSize = size_t(header.entryCount) * sizeof(Entry);
+  if (indexSize + header.namesSize > size_ - sizeof(header)) {
+    return fail("truncated index");
+  }
+  entries_.resize(header.entryCount);
+  memcpy(entries_.data(), data_ + sizeof(header), indexSize);
+  names_ = reinterpret_cast<const char*>(data_ + sizeof(header) + indexSize);
+
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const auto& entry = entries_[i];
+    bool nameInBounds = size_t(entry.nameOffset) + entry.nameLength <= header.namesSize;
+    bool dataInBounds = entry.offset <= size_ && entry.storedSize <= size_ - entry.offset;
+    bool sizeConsistent = entry.compression == kAssetPackLz4 ||
+                          (entry.compression == kAssetPackStored && entry.storedSize == entry.size);
+    if (!nameInBounds || !dataInBounds || !sizeConsistent) {
+      return fail("corrupt entry");
+    }
+    // find() relies on the order
+    if (i > 0 && getName(entries_[i - 1]) >= getName(entry)) {
+      return fail("index is not sorted");
+    }
+  }
+  return true;
+}
+
+const AssetArchive::Entry* AssetArchive::find(string_view path) const {
+  auto it = lower_bound(entries_.begin(), entries_.end(), path,
+                        [this](const Entry& entry, string_view p) { return getName(entry) < p; });
+  return it != entries_.end() && getName(*it) == path ? &*it : nullptr;
+}
+
+span<const uint8_t> AssetArchive::getMapped(const Entry& entry) const {
+  if (entry.compression != kAssetPackStored) {
+    return {};
+  }
+  return {data_ + entry.offset, size_t(entry.size)};
+}
+
+bool AssetArchive::read(const Entry& entry, uint8_t* out, size_t size) const {
+  if (size > entry.size) {
+    return false;
+  }
+  const uint8_t* stored = data_ + entry.offset;
+  if (entry.compression == kAssetPackStored) {
+    memcpy(out, stored, size);
+    return true;
+  }
+  return lz4Decompress(stored, size_t(entry.storedSize), out, size);
+}
+
+bool AssetArchive::read(const Entry& entry, vector<uint8_t>& out) const {
+  out.resize(size_t(entry.size));
+  return read(entry, out.data(), out.size());
+}
@@ -0,0 +1,102 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ASSETARCHIVE_H
+#define ANDROIDGLINVESTIGATIONS_ASSETARCHIVE_H
+
+#include <android/asset_manager.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "AssetPack.h"
+
+/*!
+ * A memory mapped .dpak asset pack (see AssetPack.h), built by src/tools/assetpack. Looking an
+ * entry up is a binary search of the index, stored entries are used in place without a
+ * copy, and LZ4 entries decompress straight into the caller's buffer.
+ *
+ * Everything is read only after opening, so entries can be read from any number of threads at
+ * once, e.g. decompressed in parallel on a WorkerPool.
+ */
+class AssetArchive {
+ public:
+  using Entry = AssetPackEntry;
+
+  /*!
+   * Maps a pack from the apk. Packs stored uncompressed in the apk (see noCompress in
+   * build.gradle.kts) are mapped from its file descriptor, others fall back to the asset's buffer.
+   * @return the archive, or null if the asset is missing or not a valid pack
+   */
+  static std::unique_ptr<AssetArchive> open(AAssetManager* assetManager, const std::string& assetPath);
+
+  /*!
+   * Maps a pack from a plain file, e.g. one downloaded to internal storage.
+   */
+  static std::unique_ptr<AssetArchive> openFile(const std::string& path);
+
+  AssetArchive(const AssetArchive&) = delete;
+  AssetArchive& operator=(const AssetArchive&) = delete;
+  ~AssetArchive();
+
+  /*!
+   * @return the entry for an asset path, or null if the pack doesn't have it
+   */
+  const Entry* find(std::string_view path) const;
+
+  std::string_view getName(const Entry& entry) const {
+    return {names_ + entry.nameOffset, entry.nameLength};
+  }
+
+  std::span<const Entry> getEntries() const {
+    return entries_;
+  }
+
+  /*!
+   * @return the bytes of a stored entry in the mapping, or an empty span for compressed entries
+   */
+  std::span<const uint8_t> getMapped(const Entry& entry) const;
+
+  /*!
+   * Reads the first size bytes of an entry into out, decompressing if needed. Reading less than
+   * the whole entry only decompresses what's needed, which makes header probes cheap.
+   * @param size at most entry.size
+   * @return false if the entry is corrupt
+   */
+  bool read(const Entry& entry, uint8_t* out, size_t size) const;
+
+  /*!
+   * Reads a whole entry into out, resizing it.
+   */
+  bool read(const Entry& entry, std::vector<uint8_t>& out) const;
+
+  /*!
+   * @return the bytes the pack takes, all of which are mapped
+   */
+  size_t getSize() const {
+    return size_;
+  }
+
+ private:
+  AssetArchive() = default;
+
+  /*!
+   * Validates the header and index of the mapped data and copies the index out.
+   */
+  bool parse(const std::string& name);
+
+  // Either an mmap of a file descriptor, or an asset whose buffer is used directly
+  void* mapping_ = nullptr;
+  size_t mappingSize_ = 0;
+  AAsset* asset_ = nullptr;
+
+  const uint8_t* data_ = nullptr;
+  size_t size_ = 0;
+  // Copied out of the mapping, which packs inside the apk leave only 4 byte aligned
+  std::vector<Entry> entries_;
+  const char* names_ = nullptr;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_ASSETARCHIVE_H
@@ -0,0 +1,47 @@
+#ifndef ANDROIDGLINVESTIGATIONS_ASSETPACK_H
+#define ANDROIDGLINVESTIGATIONS_ASSETPACK_H
+
+#include <cstdint>
+
+/*!
+ * The layout of .dpak asset packs, which AssetArchive reads and src/tools/assetpack writes. This
+ * header has no GL or Android dependencies so the host tool can share it.
+ *
+ * A pack is a header, the entry index sorted by name (bytewise), the names, then the payloads,
+ * each starting on a kAssetPackAlignment boundary so mapped entries can be used in place. All
+ * integers are little endian.
+ */
+
+static constexpr uint8_t kAssetPackMagic[4] = {'D', 'P', 'A', 'K'};
+static constexpr uint32_t kAssetPackVersion = 1;
+static constexpr uint32_t kAssetPackAlignment = 64;
+
+struct AssetPackHeader {
+  uint8_t magic[4];
+  uint32_t version;
+  uint32_t entryCount;
+  // bytes of names following the index
+  uint32_t namesSize;
+};
+static_assert(sizeof(AssetPackHeader) == 16, "asset pack header is 16 bytes");
+
+enum AssetPackCompression : uint32_t {
+  kAssetPackStored = 0,
+  // one LZ4 block, see Lz4.h
+  kAssetPackLz4 = 1,
+};
+
+struct AssetPackEntry {
+  // from the start of the pack
+  uint64_t offset;
+  uint64_t storedSize;
+  uint64_t size;
+  // into the names, which aren't null terminated
+  uint32_t nameOffset;
+  uint32_t nameLength;
+  uint32_t compression;
+  uint32_t reserved;
+};
+static_assert(sizeof(AssetPackEntry) == 40, "asset pack entries are 40 bytes");
+
+#endif  // ANDROIDGLINVESTIGATIONS_ASSETPACK_H
@@ -0,0 +1,130 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BOUNDS_H
+#define ANDROIDGLINVESTIGATIONS_BOUNDS_H
+
+#include <array>
+#include <cmath>
+#include <span>
+
+#include "linear.h"
+
+/*!
+ * A bounding sphere, used for visibility tests.
+ */
+struct BoundingSphere {
+  r3::Vec3f center;
+  float radius = 0.f;
+};
+
+/*!
+ * An axis aligned bounding box. The default one is empty: growing it by anything gives that thing.
+ */
+struct BoundingBox {
+  r3::Vec3f min = r3::Vec3f(HUGE_VALF, HUGE_VALF, HUGE_VALF);
+  r3::Vec3f max = r3::Vec3f(-HUGE_VALF, -HUGE_VALF, -HUGE_VALF);
+
+  static BoundingBox fromSphere(const BoundingSphere& sphere) {
+    r3::Vec3f extent(sphere.radius, sphere.radius, sphere.radius);
+    return {sphere.center - extent, sphere.center + extent};
+  }
+
+  bool isEmpty() const {
+    return min.x > max.x;
+  }
+
+  void grow(const r3::Vec3f& point) {
+    min = r3::Min(min, point);
+    max = r3::Max(max, point);
+  }
+
+  void grow(const BoundingBox& box) {
+    min = r3::Min(min, box.min);
+    max = r3::Max(max, box.max);
+  }
+
+  r3::Vec3f getCenter() const {
+    return (min + max) * 0.5f;
+  }
+
+  //! @return half the surface area, which is all the surface area heuristic needs; 0 if empty
+  float getHalfArea() const {
+    if (isEmpty()) {
+      return 0.f;
+    }
+    r3::Vec3f size = max - min;
+    return size.x * size.y + size.y * size.z + size.z * size.x;
+  }
+};
+
+/*!
+ * Computes a sphere enclosing all the points. It's centered on the middle of their box, which is
+ * not minimal but is cheap and stable.
+ */
+template <typename Point>
+inline BoundingSphere computeBoundingSphere(std::span<const Point> points) {
+  BoundingSphere s;
+  if (points.empty()) {
+    return s;
+  }
+  r3::Vec3f lo(points[0].x, points[0].y, points[0].z);
+  r3::Vec3f hi = lo;
+  for (const auto& p : points) {
+    lo = r3::Min(lo, r3::Vec3f(p.x, p.y, p.z));
+    hi = r3::Max(hi, r3::Vec3f(p.x, p.y, p.z));
+  }
+  s.center = (lo + hi) * 0.5f;
+  for (const auto& p : points) {
+    s.radius = std::max(s.radius, (r3::Vec3f(p.x, p.y, p.z) - s.center).Length());
+  }
+  return s;
+}
+
+/*!
+ * Extracts the six clip planes (left, right, bottom, top, near, far) of a view projection matrix.
+ * Plane normals point into the frustum, so a point p is inside when Distance(p) >= 0 for all six.
+ */
+inline std::array<r3::Planef, 6> extractFrustumPlanes(const r3::Matrix4f& viewProjection) {
+  const r3::Vec4f r0 = viewProjection.GetRow(0);
+  const r3::Vec4f r1 = viewProjection.GetRow(1);
+  const r3::Vec4f r2 = viewProjection.GetRow(2);
+  const r3::Vec4f r3 = viewProjection.GetRow(3);
+  const r3::Vec4f eq[6] = {r3 + r0, r3 - r0, r3 + r1, r3 - r1, r3 + r2, r3 - r2};
+
+  std::array<r3::Planef, 6> planes;
+  for (int i = 0; i < 6; i++) {
+    r3::Vec3f n(eq[i].x, eq[i].y, eq[i].z);
+    float len = n.Length();
+    planes[i].planenormal = n / len;
+    planes[i].planedistance = -eq[i].w / len;
+  }
+  return planes;
+}
+
+/*!
+ * @return true if the sphere is at least partially inside all the planes.
+ */
+inline bool intersects(std::span<const r3::Planef> planes, const BoundingSphere& sphere) {
+  for (const auto& plane : planes) {
+    if (plane.Distance(sphere.center) < -sphere.radius) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * @return true if the box is at least partially inside all the planes, as far as testing its corner
+ * furthest along each plane's normal tells. Boxes near a frustum's edges can pass without touching it.
+ */
+inline bool intersects(std::span<const r3::Planef> planes, const BoundingBox& box) {
+  for (const auto& plane : planes) {
+    const auto& n = plane.planenormal;
+    r3::Vec3f corner(n.x >= 0 ? box.max.x : box.min.x, n.y >= 0 ? box.max.y : box.min.y,
+                     n.z >= 0 ? box.max.z : box.min.z);
+    if (corner.Dot(n) < plane.planedistance) {
+      return false;
+    }
+  }
+  return true;
+}
+
+#endif  // ANDROIDGLINVESTIGATIONS_BOUNDS_H
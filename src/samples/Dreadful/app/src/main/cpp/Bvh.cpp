@@ -0,0 +1,425 @@
+#include "Bvh.h"
+
+#include <algorithm>
+
+using namespace std;
+
+Bvh::~Bvh() {
+  if (rebuild_.valid()) {
+    rebuild_.wait();
+  }
+}
+
+void Bvh::setBounds(uint32_t node, const BoundingBox& bounds) {
+  auto& n = nodes_[node];
+  double weight = max(n.count, 1u);
+  weightedArea_ += (bounds.getHalfArea() - n.bounds.getHalfArea()) * weight;
+  n.bounds = bounds;
+}
+
+BoundingBox Bvh::computeBounds(const Node& node) const {
+  BoundingBox bounds;
+  if (node.count == 0) {
+    bounds = nodes_[node.first].bounds;
+    bounds.grow(nodes_[node.first + 1].bounds);
+  } else {
+    for (uint32_t i = node.first; i < node.first + node.count; i++) {
+      bounds.grow(boxes_[i]);
+    }
+  }
+  return bounds;
+}
+
+pair<uint32_t, uint32_t> Bvh::getObjectRange(uint32_t node) const {
+  // Leaves were made left to right, so the leftmost and rightmost leaves bound the range
+  uint32_t left = node;
+  while (nodes_[left].count == 0) {
+    left = nodes_[left].first;
+  }
+  uint32_t right = node;
+  while (nodes_[right].count == 0) {
+    right = nodes_[right].first + 1;
+  }
+  return {nodes_[left].first, nodes_[right].first + nodes_[right].count};
+}
+
+void Bvh::build(span<const BoundingBox> boxes) {
+  auto count = static_cast<uint32_t>(boxes.size());
+  nodes_.clear();
+  parents_.clear();
+  objectLeaves_.assign(count, 0);
+  weightedArea_ = 0;
+  builtCost_ = 0;
+
+  // Objects are partitioned in place with everything the split search reads, so each node's
+  // objects are one run of memory
+  struct Item {
+    BoundingBox box;
+    r3::Vec3f center;
+    uint32_t object;
+  };
+  vector<Item> items(count);
+  for (uint32_t i = 0; i < count; i++) {
+    items[i] = {boxes[i], boxes[i].getCenter(), i};
+  }
+
+  // A node per object at most, and as many internal nodes less one
+  nodes_.reserve(size_t(count) * 2);
+  parents_.reserve(size_t(count) * 2);
+  struct Range {
+    uint32_t node;
+    uint32_t begin;
+    uint32_t end;
+    uint32_t depth;
+  };
+  vector<Range> stack;
+  if (count > 0) {
+    nodes_.emplace_back();
+    parents_.push_back(kNoNode);
+    stack.push_back({0, 0, count, 0});
+  }
+  while (!stack.empty()) {
+    auto range = stack.back();
+    stack.pop_back();
+    uint32_t objects = range.end - range.begin;
+    BoundingBox bounds;
+    BoundingBox centerBounds;
+    for (uint32_t i = range.begin; i < range.end; i++) {
+      bounds.grow(items[i].box);
+      centerBounds.grow(items[i].center);
+    }
+
+    // Find the cheapest split between bins, along any axis, by the sum of each side's area times
+    // its objects. All three axes are binned in one pass over the objects, and sweeping each from
+    // the right first leaves one pass from the left to try every split.
+    int bestAxis = -1;
+    uint32_t bestBin = 0;
+    float bestCost = HUGE_VALF;
+    float binScales[3];
+    for (int axis = 0; axis < 3; axis++) {
+      float extent = centerBounds.max[axis] - centerBounds.min[axis];
+      binScales[axis] = extent > 0 ? kBinCount / extent : 0.f;
+    }
+    auto getBin = [&centerBounds, &binScales](const r3::Vec3f& center, int axis) {
+      auto bin = static_cast<uint32_t>((center[axis] - centerBounds.min[axis]) * binScales[axis]);
+      return min(bin, kBinCount - 1);
+    };
+    if (objects > kMinLeafObjects && range.depth + 1 < kMaxDepth) {
+      BoundingBox binBounds[3][kBinCount];
+      uint32_t binObjects[3][kBinCount] = {};
+      for (uint32_t i = range.begin; i < range.end; i++) {
+        for (int axis = 0; axis < 3; axis++) {
+          uint32_t bin = getBin(items[i].center, axis);
+          binObjects[axis][bin]++;
+          binBounds[axis][bin].grow(items[i].box);
+        }
+      }
+      for (int axis = 0; axis < 3; axis++) {
+        if (binScales[axis] == 0) {
+          continue;
+        }
+        float rightCosts[kBinCount];
+        BoundingBox right;
+        uint32_t rightObjects = 0;
+        for (uint32_t bin = kBinCount - 1; bin > 0; bin--) {
+          right.grow(binBounds[axis][bin]);
+          rightObjects += binObjects[axis][bin];
+          rightCosts[bin] = right.getHalfArea() * float(rightObjects);
+        }
+        BoundingBox left;
+        uint32_t leftObjects = 0;
+        for (uint32_t bin = 0; bin + 1 < kBinCount; bin++) {
+          left.grow(binBounds[axis][bin]);
+          leftObjects += binObjects[axis][bin];
+          float cost = left.getHalfArea() * float(leftObjects) + rightCosts[bin + 1];
+          if (leftObjects > 0 && leftObjects < objects && cost < bestCost) {
+            bestAxis = axis;
+            bestBin = bin;
+            bestCost = cost;
+          }
+        }
+      }
+    }
+
+    // Splitting costs a visit to each child on top of what their objects cost, which is worth it
+    // if that's less than testing every object here
+    float area = bounds.getHalfArea();
+    bool split = bestAxis >= 0 && (objects > kMaxLeafObjects || (area > 0 && 1 + bestCost / area < float(objects)));
+    uint32_t middle = range.begin;
+    if (split) {
+      middle = static_cast<uint32_t>(
+          partition(items.begin() + range.begin, items.begin() + range.end,
+                    [&](const Item& item) { return getBin(item.center, bestAxis) <= bestBin; }) -
+          items.begin());
+    } else if (objects > kMaxLeafObjects && range.depth + 1 < kMaxDepth) {
+      // Every center is in the same place, so any split is as good as another
+      split = true;
+      middle = range.begin + objects / 2;
+    }
+
+    auto& node = nodes_[range.node];
+    if (split) {
+      auto left = static_cast<uint32_t>(nodes_.size());
+      node.first = left;
+      node.count = 0;
+      nodes_.emplace_back();
+      nodes_.emplace_back();
+      parents_.push_back(range.node);
+      parents_.push_back(range.node);
+      // left popped first, so leaves are made left to right
+      stack.push_back({left + 1, middle, range.end, range.depth + 1});
+      stack.push_back({left, range.begin, middle, range.depth + 1});
+    } else {
+      node.first = range.begin;
+      node.count = objects;
+      for (uint32_t i = range.begin; i < range.end; i++) {
+        objectLeaves_[items[i].object] = range.node;
+      }
+    }
+    setBounds(range.node, bounds);
+  }
+
+  order_.resize(count);
+  boxes_.resize(count);
+  objectSlots_.resize(count);
+  for (uint32_t i = 0; i < count; i++) {
+    order_[i] = items[i].object;
+    boxes_[i] = items[i].box;
+    objectSlots_[items[i].object] = i;
+  }
+  builtCost_ = getCost();
+}
+
+void Bvh::refit(span<const BoundingBox> boxes, span<const uint32_t> moved) {
+  // Mark the leaves of moved objects and their ancestors, stopping at ones marked already
+  refitting_.resize(nodes_.size(), 0);
+  refitNodes_.clear();
+  for (uint32_t object : moved) {
+    boxes_[objectSlots_[object]] = boxes[object];
+    for (uint32_t node = objectLeaves_[object]; node != kNoNode && !refitting_[node]; node = parents_[node]) {
+      refitting_[node] = 1;
+      refitNodes_.push_back(node);
+    }
+  }
+
+  // Children come after their parents, so going backwards refits them first
+  sort(refitNodes_.begin(), refitNodes_.end(), greater<uint32_t>());
+  for (uint32_t node : refitNodes_) {
+    setBounds(node, computeBounds(nodes_[node]));
+    refitting_[node] = 0;
+  }
+}
+
+void Bvh::refit(span<const BoundingBox> boxes) {
+  for (uint32_t i = 0; i < order_.size(); i++) {
+    boxes_[i] = boxes[order_[i]];
+  }
+  // Summed from scratch, which also drops what rounding incremental refits gathered
+  weightedArea_ = 0;
+  for (auto node = static_cast<uint32_t>(nodes_.size()); node-- > 0;) {
+    auto& n = nodes_[node];
+    n.bounds = computeBounds(n);
+    weightedArea_ += double(n.bounds.getHalfArea()) * max(n.count, 1u);
+  }
+}
+
+float Bvh::getCost() const {
+  float rootArea = nodes_.empty() ? 0.f : nodes_[0].bounds.getHalfArea();
+  return rootArea > 0 ? float(weightedArea_ / rootArea) : 0.f;
+}
+
+void Bvh::rebuildAsync(span<const BoundingBox> boxes, WorkerPool& workers) {
+  if (rebuild_.valid()) {
+    return;
+  }
+  auto task = make_shared<packaged_task<unique_ptr<Bvh>()>>([boxes = vector(boxes.begin(), boxes.end())] {
+    auto bvh = make_unique<Bvh>();
+    bvh->build(boxes);
+    return bvh;
+  });
+  rebuild_ = task->get_future();
+  workers.submit([task] { (*task)(); });
+}
+
+bool Bvh::finishRebuild(span<const BoundingBox> boxes) {
+  if (!rebuild_.valid() || rebuild_.wait_for(chrono::seconds(0)) != future_status::ready) {
+    return false;
+  }
+  auto bvh = rebuild_.get();
+  // Objects added or removed since it started make it useless
+  if (bvh->getObjectCount() != boxes.size()) {
+    return false;
+  }
+  bvh->refit(boxes);
+  // its own cost as built, not refitted, is what it will degrade from
+  float builtCost = bvh->builtCost_;
+  *this = std::move(*bvh);
+  builtCost_ = builtCost;
+  return true;
+}
+
+void Bvh::cullFrustum(span<const r3::Planef> planes, vector<uint32_t>& visible) const {
+  if (nodes_.empty()) {
+    return;
+  }
+
+  // Each entry carries the planes its node's box straddles. Once a box is inside a plane, so is
+  // everything in it, and once it's inside all of them the whole subtree is visible.
+  struct Entry {
+    uint32_t node;
+    uint32_t planes;
+  };
+  Entry stack[kMaxDepth + 1];
+  uint32_t depth = 0;
+  stack[depth++] = {0, (1u << min<size_t>(planes.size(), 31)) - 1};
+  while (depth > 0) {
+    auto [index, mask] = stack[--depth];
+    const auto& node = nodes_[index];
+    const auto& bounds = node.bounds;
+    bool outside = false;
+    for (uint32_t remaining = mask; remaining; remaining &= remaining - 1) {
+      uint32_t p = __builtin_ctz(remaining);
+      const auto& n = planes[p].planenormal;
+      float d = planes[p].planedistance;
+      // the corners furthest along and against the normal
+      r3::Vec3f far(n.x >= 0 ? bounds.max.x : bounds.min.x, n.y >= 0 ? bounds.max.y : bounds.min.y,
+                    n.z >= 0 ? bounds.max.z : bounds.min.z);
+      r3::Vec3f near(n.x >= 0 ? bounds.min.x : bounds.max.x, n.y >= 0 ? bounds.min.y : bounds.max.y,
+                     n.z >= 0 ? bounds.min.z : bounds.max.z);
+      if (far.Dot(n) < d) {
+        outside = true;
+        break;
+      }
+      if (near.Dot(n) >= d) {
+        mask &= ~(1u << p);
+      }
+    }
+    if (outside) {
+      continue;
+    }
+    if (mask == 0) {
+      auto [begin, end] = getObjectRange(index);
+      visible.insert(visible.end(), order_.begin() + begin, order_.begin() + end);
+    } else if (node.count == 0) {
+      stack[depth++] = {node.first + 1, mask};
+      stack[depth++] = {node.first, mask};
+    } else {
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        if (intersects(planes, boxes_[i])) {
+          visible.push_back(order_[i]);
+        }
+      }
+    }
+  }
+}
+
+/*!
+ * @return where the ray enters the box, 0 if it starts inside, or HUGE_VALF if it misses it or only
+ * reaches it after limit
+ */
+static float intersectRay(const r3::Vec3f& origin, const r3::Vec3f& inverseDirection, const BoundingBox& box,
+                          float limit) {
+  float enter = 0.f;
+  float exit = limit;
+  for (int axis = 0; axis < 3; axis++) {
+    float t0 = (box.min[axis] - origin[axis]) * inverseDirection[axis];
+    float t1 = (box.max[axis] - origin[axis]) * inverseDirection[axis];
+    // written so a NaN, from a ray in a slab's plane, leaves the range alone
+    enter = max(enter, min(t0, t1));
+    exit = min(exit, max(t0, t1));
+  }
+  return enter <= exit ? enter : HUGE_VALF;
+}
+
+void Bvh::castRays(span<const r3::Linef> rays, float maxDistance, span<RayHit> hits) const {
+  for (size_t r = 0; r < rays.size(); r++) {
+    auto& hit = hits[r];
+    hit = RayHit();
+    if (nodes_.empty()) {
+      continue;
+    }
+    const auto& origin = rays[r].GetPosition();
+    const auto& direction = rays[r].GetDirection();
+    r3::Vec3f inverse(1.f / direction.x, 1.f / direction.y, 1.f / direction.z);
+    float nearest = maxDistance;
+
+    // Nearer children are visited first, so farther ones are mostly skipped by then
+    struct Entry {
+      uint32_t node;
+      float distance;
+    };
+    Entry stack[kMaxDepth + 1];
+    uint32_t depth = 0;
+    float rootDistance = intersectRay(origin, inverse, nodes_[0].bounds, nearest);
+    if (rootDistance != HUGE_VALF) {
+      stack[depth++] = {0, rootDistance};
+    }
+    while (depth > 0) {
+      auto entry = stack[--depth];
+      if (entry.distance > nearest) {
+        continue;
+      }
+      const auto& node = nodes_[entry.node];
+      if (node.count > 0) {
+        for (uint32_t i = node.first; i < node.first + node.count; i++) {
+          float distance = intersectRay(origin, inverse, boxes_[i], nearest);
+          if (distance < nearest || (distance == nearest && hit.object == kNoObject)) {
+            nearest = distance;
+            hit = {order_[i], distance};
+          }
+        }
+        continue;
+      }
+      Entry left = {node.first, intersectRay(origin, inverse, nodes_[node.first].bounds, nearest)};
+      Entry right = {node.first + 1, intersectRay(origin, inverse, nodes_[node.first + 1].bounds, nearest)};
+      if (left.distance > right.distance) {
+        swap(left, right);
+      }
+      if (right.distance != HUGE_VALF) {
+        stack[depth++] = right;
+      }
+      if (left.distance != HUGE_VALF) {
+        stack[depth++] = left;
+      }
+    }
+  }
+}
+
+/*!
+ * @return true if the sphere and box overlap
+ */
+static bool overlaps(const BoundingSphere& sphere, const BoundingBox& box) {
+  r3::Vec3f closest = r3::Min(r3::Max(sphere.center, box.min), box.max);
+  r3::Vec3f offset = closest - sphere.center;
+  return offset.Dot(offset) <= sphere.radius * sphere.radius;
+}
+
+void Bvh::overlapSpheres(span<const BoundingSphere> spheres, vector<uint32_t>& objects,
+                         vector<uint32_t>& offsets) const {
+  for (const auto& sphere : spheres) {
+    offsets.push_back(static_cast<uint32_t>(objects.size()));
+    if (nodes_.empty()) {
+      continue;
+    }
+    uint32_t stack[kMaxDepth + 1];
+    uint32_t depth = 0;
+    stack[depth++] = 0;
+    while (depth > 0) {
+      const auto& node = nodes_[stack[--depth]];
+      if (!overlaps(sphere, node.bounds)) {
+        continue;
+      }
+      if (node.count == 0) {
+        stack[depth++] = node.first + 1;
+        stack[depth++] = node.first;
+        continue;
+      }
+      for (uint32_t i = node.first; i < node.first + node.count; i++) {
+        if (overlaps(sphere, boxes_[i])) {
+          objects.push_back(order_[i]);
+        }
+      }
+    }
+  }
+  offsets.push_back(static_cast<uint32_t>(objects.size()));
+}
@@ -0,0 +1,170 @@
+#ifndef ANDROIDGLINVESTIGATIONS_BVH_H
+#define ANDROIDGLINVESTIGATIONS_BVH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "Bounds.h"
+#include "WorkerPool.h"
+#include "linear.h"
+
+/*!
+ * A bounding volume hierarchy over the boxes of a set of objects, for culling, picking and
+ * proximity queries without testing every object. Objects are the indices of the boxes given to
+ * build().
+ *
+ * The tree is built top down, splitting each node where the surface area heuristic, estimated with
+ * kBinCount bins per axis, says queries are cheapest. When objects move, refit() grows and shrinks
+ * the boxes of their leaves and those leaves' ancestors, keeping the tree's shape. That's cheap,
+ * but the shape gets worse as objects wander from where it was built for; getCost() tracks the
+ * heuristic's estimate, and once needsRebuild() says it's grown too much, rebuildAsync() builds a
+ * new tree on a worker while this one keeps serving queries, to be swapped in by finishRebuild().
+ *
+ * Queries take batches and append to output vectors, which are best reused between frames.
+ * Not thread safe, except that a rebuild in progress only reads its own copy of the boxes.
+ */
+class Bvh {
+ public:
+  static constexpr uint32_t kNoObject = UINT32_MAX;
+
+  //! How much the cost may grow past the built tree's before needsRebuild() says so
+  static constexpr float kRebuildCostRatio = 1.5f;
+
+  struct RayHit {
+    uint32_t object = kNoObject;
+    // along the ray, to where it enters the object's box
+    float distance = 0.f;
+  };
+
+  Bvh() = default;
+  Bvh(Bvh&&) = default;
+  Bvh& operator=(Bvh&&) = default;
+
+  //! Waits for a rebuild in progress
+  ~Bvh();
+
+  /*!
+   * Builds the tree over boxes, replacing any there was.
+   */
+  void build(std::span<const BoundingBox> boxes);
+
+  /*!
+   * Updates the tree for objects that moved.
+   * @param boxes every object's box, as now
+   * @param moved the objects whose boxes changed since the last build or refit
+   */
+  void refit(std::span<const BoundingBox> boxes, std::span<const uint32_t> moved);
+
+  /*!
+   * Updates the tree for all objects, which is quicker than listing most of them as moved.
+   */
+  void refit(std::span<const BoundingBox> boxes);
+
+  /*!
+   * @return the surface area heuristic's estimate of a query's cost, in box tests; lower is better
+   */
+  float getCost() const;
+
+  bool needsRebuild() const {
+    return getCost() > builtCost_ * kRebuildCostRatio;
+  }
+
+  /*!
+   * Starts building a new tree from a copy of boxes on workers, unless one is being built already.
+   */
+  void rebuildAsync(std::span<const BoundingBox> boxes, WorkerPool& workers);
+
+  /*!
+   * Swaps in the tree rebuildAsync() started if it's done, refitting it to boxes.
+   * @param boxes every object's box, as now, since they may have moved during the rebuild
+   * @return true if it swapped
+   */
+  bool finishRebuild(std::span<const BoundingBox> boxes);
+
+  bool isRebuilding() const {
+    return rebuild_.valid();
+  }
+
+  /*!
+   * Appends the objects whose boxes are at least partly inside all the planes, such as those of
+   * extractFrustumPlanes, to visible. Whole subtrees inside the planes are appended untested.
+   */
+  void cullFrustum(std::span<const r3::Planef> planes, std::vector<uint32_t>& visible) const;
+
+  /*!
+   * Finds the nearest object box each ray hits, for picking. Rays start at their line's position.
+   * @param hits one per ray, with kNoObject for rays that miss everything within maxDistance
+   */
+  void castRays(std::span<const r3::Linef> rays, float maxDistance, std::span<RayHit> hits) const;
+
+  /*!
+   * Appends the objects whose boxes overlap each sphere to objects, sphere by sphere.
+   * @param offsets gets where each sphere's objects start in objects, and after them where they end
+   */
+  void overlapSpheres(std::span<const BoundingSphere> spheres, std::vector<uint32_t>& objects,
+                      std::vector<uint32_t>& offsets) const;
+
+  size_t getObjectCount() const {
+    return objectLeaves_.size();
+  }
+
+  size_t getNodeCount() const {
+    return nodes_.size();
+  }
+
+ private:
+  //! Bins per axis the split search sorts centroids into
+  static constexpr uint32_t kBinCount = 16;
+  //! Nodes with this many objects or fewer are always leaves
+  static constexpr uint32_t kMinLeafObjects = 2;
+  //! Nodes with more objects are always split
+  static constexpr uint32_t kMaxLeafObjects = 16;
+  //! Deeper nodes become leaves whatever their size, so queries can use fixed stacks
+  static constexpr uint32_t kMaxDepth = 64;
+
+  //! 32 bytes, two to a cache line
+  struct Node {
+    BoundingBox bounds;
+    // the first of the two children of an internal node, or a leaf's first object in order_
+    uint32_t first = 0;
+    // objects of a leaf, 0 for internal nodes
+    uint32_t count = 0;
+  };
+
+  static constexpr uint32_t kNoNode = UINT32_MAX;
+
+  //! Sets a node's box, keeping weightedArea_ up to date
+  void setBounds(uint32_t node, const BoundingBox& bounds);
+
+  //! @return the box around a node's children or objects
+  BoundingBox computeBounds(const Node& node) const;
+
+  //! @return the range of order_ holding the objects under a node
+  std::pair<uint32_t, uint32_t> getObjectRange(uint32_t node) const;
+
+  // Children are stored after their parents, the root first
+  std::vector<Node> nodes_;
+  std::vector<uint32_t> parents_;
+  // Objects grouped by leaf, with their boxes next to them so leaves read one run of memory. A
+  // subtree's objects are one run too.
+  std::vector<uint32_t> order_;
+  std::vector<BoundingBox> boxes_;
+  // by object, where it is in order_ and which leaf has it
+  std::vector<uint32_t> objectSlots_;
+  std::vector<uint32_t> objectLeaves_;
+  // refit scratch, by node
+  std::vector<uint8_t> refitting_;
+  std::vector<uint32_t> refitNodes_;
+  // sum of every node's half area, times objects for leaves, kept up by setBounds
+  double weightedArea_ = 0;
+  float builtCost_ = 0;
+
+  std::future<std::unique_ptr<Bvh>> rebuild_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_BVH_H
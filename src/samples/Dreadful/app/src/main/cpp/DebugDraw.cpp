@@ -0,0 +1,234 @@
+#include "DebugDraw.h"
+
+#include <cstddef>
+
+#include "AndroidOut.h"
+#include "FramePacer.h"
+#include "Shader.h"
+
+using namespace std;
+
+static const char* debugVertex = R"vertex(#version 300 es
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec4 inColor;
+
+out vec4 fragColor;
+
+uniform mat4 uViewProjection;
+
+void main() {
+    fragColor = inColor;
+    gl_Position = uViewProjection * vec4(inPosition, 1.0);
+}
+)vertex";
+
+static const char* debugFragment = R"fragment(#version 300 es
+precision mediump float;
+
+in vec4 fragColor;
+
+out vec4 outColor;
+
+void main() {
+    // colors are given straight, the renderer blends premultiplied
+    outColor = vec4(fragColor.rgb * fragColor.a, fragColor.a);
+}
+)fragment";
+
+static constexpr GLuint kLocationPosition = 0;
+static constexpr GLuint kLocationColor = 1;
+
+// The twelve edges of a box whose corners are numbered by their x, y and z signs as bits
+static constexpr uint32_t kBoxEdges[] = {0, 1, 2, 3, 4, 5, 6, 7, 0, 2, 1, 3, 4, 6, 5, 7, 0, 4, 1, 5, 2, 6, 3, 7};
+
+std::unique_ptr<DebugDraw> DebugDraw::create(uint32_t frameCount, uint32_t maxVertices, uint32_t maxIndices) {
+  unique_ptr<DebugDraw> debugDraw(new DebugDraw(frameCount, maxVertices, maxIndices));
+
+  GLuint vertex = Shader::loadShader(GL_VERTEX_SHADER, debugVertex);
+  GLuint fragment = Shader::loadShader(GL_FRAGMENT_SHADER, debugFragment);
+  if (vertex && fragment) {
+    debugDraw->program_ = Shader::linkProgram({vertex, fragment});
+  }
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  if (!debugDraw->program_) {
+    aout << "DebugDraw: failed to build the shader" << endl;
+    return nullptr;
+  }
+  debugDraw->viewProjectionUniform_ = glGetUniformLocation(debugDraw->program_, "uViewProjection");
+
+  glGenVertexArrays(1, &debugDraw->vao_);
+  glBindVertexArray(debugDraw->vao_);
+  glEnableVertexAttribArray(kLocationPosition);
+  glEnableVertexAttribArray(kLocationColor);
+  glBindVertexArray(0);
+  return debugDraw;
+}
+
+DebugDraw::DebugDraw(uint32_t frameCount, uint32_t maxVertices, uint32_t maxIndices)
+    : vertices_(maxVertices * sizeof(Vertex), frameCount),
+      lineIndices_(maxIndices * sizeof(uint32_t), frameCount),
+      triangleIndices_(maxIndices * sizeof(uint32_t), frameCount) {}
+
+DebugDraw::~DebugDraw() {
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteProgram(program_);
+}
+
+void DebugDraw::begin(const FramePacer& pacer) {
+  uint64_t frame = pacer.getFrame();
+  uint64_t completed = pacer.getCompletedFrame();
+  vertices_.beginFrame(frame, completed);
+  lineIndices_.beginFrame(frame, completed);
+  triangleIndices_.beginFrame(frame, completed);
+  vertexCount_ = 0;
+  dropped_ = 0;
+  recording_ = true;
+}
+
+void DebugDraw::end() {
+  if (!recording_) {
+    return;
+  }
+  vertices_.endFrame();
+  lineIndices_.endFrame();
+  triangleIndices_.endFrame();
+  recording_ = false;
+  if (dropped_) {
+    aout << "DebugDraw: dropped " << dropped_ << " primitives, the per-frame buffers are full" << endl;
+  }
+}
+
+void DebugDraw::draw(const r3::Matrix4f& viewProjection) const {
+  if (recording_ || vertexCount_ == 0) {
+    return;
+  }
+  glUseProgram(program_);
+  glUniformMatrix4fv(viewProjectionUniform_, 1, GL_FALSE, viewProjection.GetValue());
+
+  // Indices are relative to the start of this frame's vertices, so point the attributes there
+  auto base = vertices_.getRegionOffset();
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertices_.getBuffer());
+  glVertexAttribPointer(kLocationPosition, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                        reinterpret_cast<const void*>(base + offsetof(Vertex, position)));
+  glVertexAttribPointer(kLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                        reinterpret_cast<const void*>(base + offsetof(Vertex, color)));
+  drawElements(GL_TRIANGLES, triangleIndices_);
+  drawElements(GL_LINES, lineIndices_);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void DebugDraw::drawElements(GLenum mode, const StreamBuffer& indices) const {
+  auto count = static_cast<GLsizei>(indices.getUsed() / sizeof(uint32_t));
+  if (count == 0) {
+    return;
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices.getBuffer());
+  glDrawElements(mode, count, GL_UNSIGNED_INT, reinterpret_cast<const void*>(indices.getRegionOffset()));
+}
+
+bool DebugDraw::reserve(uint32_t vertexCount, StreamBuffer& indices, uint32_t indexCount, Vertex** vertexOut,
+                        uint32_t** indexOut, uint32_t* baseVertexOut) {
+  size_t vertexBytes = vertexCount * sizeof(Vertex);
+  size_t indexBytes = indexCount * sizeof(uint32_t);
+  // Both strides are multiples of the default alignment, so checking the sizes is enough
+  if (!recording_ || vertices_.getUsed() + vertexBytes > vertices_.getCapacity() ||
+      indices.getUsed() + indexBytes > indices.getCapacity()) {
+    dropped_++;
+    return false;
+  }
+  *vertexOut = static_cast<Vertex*>(vertices_.allocate(vertexBytes));
+  *indexOut = static_cast<uint32_t*>(indices.allocate(indexBytes));
+  if (!*vertexOut || !*indexOut) {
+    // not mapped this frame
+    dropped_++;
+    return false;
+  }
+  *baseVertexOut = vertexCount_;
+  vertexCount_ += vertexCount;
+  return true;
+}
+
+static void setVertex(DebugDraw::Vertex& v, const r3::Vec3f& position, const r3::Vec4ub& color) {
+  v.position[0] = position.x;
+  v.position[1] = position.y;
+  v.position[2] = position.z;
+  v.color[0] = color.x;
+  v.color[1] = color.y;
+  v.color[2] = color.z;
+  v.color[3] = color.w;
+}
+
+void DebugDraw::line(const r3::Vec3f& a, const r3::Vec3f& b, const r3::Vec4ub& color) {
+  Vertex* v;
+  uint32_t* i;
+  uint32_t base;
+  if (!reserve(2, lineIndices_, 2, &v, &i, &base)) {
+    return;
+  }
+  setVertex(v[0], a, color);
+  setVertex(v[1], b, color);
+  i[0] = base;
+  i[1] = base + 1;
+}
+
+void DebugDraw::box(const r3::Posef& pose, const r3::Vec3f& halfExtents, const r3::Vec4ub& color) {
+  Vertex* v;
+  uint32_t* i;
+  uint32_t base;
+  if (!reserve(8, lineIndices_, 24, &v, &i, &base)) {
+    return;
+  }
+  for (uint32_t c = 0; c < 8; c++) {
+    r3::Vec3f corner((c & 1) ? halfExtents.x : -halfExtents.x, (c & 2) ? halfExtents.y : -halfExtents.y,
+                     (c & 4) ? halfExtents.z : -halfExtents.z);
+    setVertex(v[c], pose.Transform(corner), color);
+  }
+  for (uint32_t e = 0; e < 24; e++) {
+    i[e] = base + kBoxEdges[e];
+  }
+}
+
+void DebugDraw::axes(const r3::Posef& pose, float size) {
+  line(pose.t, pose.Transform(r3::Vec3f(size, 0, 0)), r3::Vec4ub(255, 0, 0, 255));
+  line(pose.t, pose.Transform(r3::Vec3f(0, size, 0)), r3::Vec4ub(0, 255, 0, 255));
+  line(pose.t, pose.Transform(r3::Vec3f(0, 0, size)), r3::Vec4ub(0, 0, 255, 255));
+}
+
+void DebugDraw::frustum(const r3::Matrix4f& viewProjection, const r3::Vec4ub& color) {
+  Vertex* v;
+  uint32_t* i;
+  uint32_t base;
+  if (!reserve(8, lineIndices_, 24, &v, &i, &base)) {
+    return;
+  }
+  // the corners of the clip space cube, taken back to world space
+  auto inverse = viewProjection.Inverted();
+  for (uint32_t c = 0; c < 8; c++) {
+    r3::Vec4f corner = inverse * r3::Vec4f((c & 1) ? 1.f : -1.f, (c & 2) ? 1.f : -1.f, (c & 4) ? 1.f : -1.f, 1.f);
+    setVertex(v[c], r3::Vec3f(corner.x / corner.w, corner.y / corner.w, corner.z / corner.w), color);
+  }
+  for (uint32_t e = 0; e < 24; e++) {
+    i[e] = base + kBoxEdges[e];
+  }
+}
+
+void DebugDraw::quad(const r3::Vec3f& a, const r3::Vec3f& b, const r3::Vec3f& c, const r3::Vec3f& d,
+                     const r3::Vec4ub& color) {
+  Vertex* v;
+  uint32_t* i;
+  uint32_t base;
+  if (!reserve(4, triangleIndices_, 6, &v, &i, &base)) {
+    return;
+  }
+  setVertex(v[0], a, color);
+  setVertex(v[1], b, color);
+  setVertex(v[2], c, color);
+  setVertex(v[3], d, color);
+  const uint32_t order[] = {0, 1, 2, 0, 2, 3};
+  for (uint32_t k = 0; k < 6; k++) {
+    i[k] = base + order[k];
+  }
+}
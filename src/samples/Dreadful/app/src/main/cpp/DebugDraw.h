@@ -0,0 +1,110 @@
+#ifndef ANDROIDGLINVESTIGATIONS_DEBUGDRAW_H
+#define ANDROIDGLINVESTIGATIONS_DEBUGDRAW_H
+
+#include <GLES3/gl3.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "StreamBuffer.h"
+#include "linear.h"
+
+class FramePacer;
+
+/*!
+ * Immediate mode drawing of lines and flat colored triangles for gizmos, rays and simple UI.
+ * Everything submitted between begin() and end() goes into per-frame StreamBuffers and is drawn by
+ * draw() with one call for lines and one for triangles, however many primitives were added.
+ *
+ * Primitives that don't fit in the frame's buffers are dropped and counted rather than growing the
+ * buffers mid-frame.
+ */
+class DebugDraw {
+ public:
+  struct Vertex {
+    float position[3];
+    uint8_t color[4];
+  };
+
+  /*!
+   * @param frameCount frames the buffers are split into, at least the FramePacer's frames in flight
+   * @param maxVertices vertices that can be submitted per frame
+   * @param maxIndices line and triangle indices that can be submitted per frame, each
+   * @return a DebugDraw, or null if the shader failed to build
+   */
+  static std::unique_ptr<DebugDraw> create(uint32_t frameCount, uint32_t maxVertices = 16384,
+                                           uint32_t maxIndices = 32768);
+
+  ~DebugDraw();
+
+  /*!
+   * Starts a frame. Must be called after FramePacer::beginFrame() of the frame that will draw it.
+   */
+  void begin(const FramePacer& pacer);
+
+  /*!
+   * Ends a frame. Call before any GL work that draws from it.
+   */
+  void end();
+
+  /*!
+   * Draws everything submitted this frame.
+   * @param viewProjection the matrix taking world positions to clip space
+   */
+  void draw(const r3::Matrix4f& viewProjection) const;
+
+  void line(const r3::Vec3f& a, const r3::Vec3f& b, const r3::Vec4ub& color);
+
+  /*!
+   * An oriented wire box.
+   * @param halfExtents half the size of the box along each axis of pose
+   */
+  void box(const r3::Posef& pose, const r3::Vec3f& halfExtents, const r3::Vec4ub& color);
+
+  /*!
+   * The axes of pose in red, green and blue for x, y and z.
+   */
+  void axes(const r3::Posef& pose, float size);
+
+  /*!
+   * The edges of the volume that viewProjection maps to clip space.
+   */
+  void frustum(const r3::Matrix4f& viewProjection, const r3::Vec4ub& color);
+
+  /*!
+   * A filled quad, corners given counter-clockwise. A rectangle for UI is a quad at constant z.
+   */
+  void quad(const r3::Vec3f& a, const r3::Vec3f& b, const r3::Vec3f& c, const r3::Vec3f& d, const r3::Vec4ub& color);
+
+  /*!
+   * @return primitives dropped this frame because the buffers were full
+   */
+  uint32_t getDroppedCount() const {
+    return dropped_;
+  }
+
+ private:
+  DebugDraw(uint32_t frameCount, uint32_t maxVertices, uint32_t maxIndices);
+
+  /*!
+   * Reserves vertices and indices of one primitive. Either everything is reserved or nothing is.
+   * @return false if the primitive has to be dropped
+   */
+  bool reserve(uint32_t vertexCount, StreamBuffer& indices, uint32_t indexCount, Vertex** vertexOut,
+               uint32_t** indexOut, uint32_t* baseVertexOut);
+
+  void drawElements(GLenum mode, const StreamBuffer& indices) const;
+
+  StreamBuffer vertices_;
+  StreamBuffer lineIndices_;
+  StreamBuffer triangleIndices_;
+  uint32_t vertexCount_ = 0;
+  uint32_t dropped_ = 0;
+  bool recording_ = false;
+
+  GLuint program_ = 0;
+  GLint viewProjectionUniform_ = -1;
+  GLuint vao_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_DEBUGDRAW_H
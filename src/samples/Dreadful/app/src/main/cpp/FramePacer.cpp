@@ -0,0 +1,123 @@
+#include "FramePacer.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+#include "GpuTimer.h"
+
+using namespace std;
+
+// Long enough to ride out a slow frame, after which a stuck GPU gets logged
+static constexpr GLuint64 kWaitTimeoutNs = 1000000000ull;
+
+FramePacer::FramePacer(uint32_t maxFramesInFlight) {
+  setMaxFramesInFlight(maxFramesInFlight);
+}
+
+FramePacer::~FramePacer() {
+  for (auto& f : inFlight_) {
+    if (f.fence) {
+      glDeleteSync(f.fence);
+    }
+    if (f.completedQuery) {
+      GpuTimer::deleteQuery(f.completedQuery);
+    }
+  }
+}
+
+void FramePacer::setMaxFramesInFlight(uint32_t maxFramesInFlight) {
+  maxFramesInFlight_ = clamp(maxFramesInFlight, 1u, kMaxFramesInFlight);
+}
+
+void FramePacer::beginFrame() {
+  frame_++;
+
+  // Retire whatever has already finished, oldest first.
+  while (count_ > 0) {
+    auto& oldest = inFlight_[head_];
+    GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    retire(oldest);
+  }
+
+  // Then block until there is room for this frame.
+  while (count_ >= maxFramesInFlight_) {
+    auto& oldest = inFlight_[head_];
+    auto start = Clock::now();
+    GLenum status = glClientWaitSync(oldest.fence, GL_SYNC_FLUSH_COMMANDS_BIT, kWaitTimeoutNs);
+    // Resources of the frame get overwritten once it retires, so it only does when the GPU is done
+    if (status == GL_TIMEOUT_EXPIRED) {
+      aout << "FramePacer: frame " << oldest.frame << " is taking over " << kWaitTimeoutNs / 1000000
+           << " ms, still waiting" << endl;
+      while (status == GL_TIMEOUT_EXPIRED) {
+        status = glClientWaitSync(oldest.fence, 0, kWaitTimeoutNs);
+      }
+    }
+    if (status == GL_WAIT_FAILED) {
+      aout << "FramePacer: can't wait on frame " << oldest.frame << ", GL error " << glGetError()
+           << ", finishing everything instead" << endl;
+      glFinish();
+    }
+    auto end = Clock::now();
+    double waitMs = chrono::duration<double, milli>(end - start).count();
+    stats_.totalWaitMs += waitMs;
+    stats_.maxWaitMs = max(stats_.maxWaitMs, waitMs);
+    retire(oldest);
+  }
+}
+
+void FramePacer::endFrame() {
+  auto& f = inFlight_[(head_ + count_) % kMaxFramesInFlight];
+  if (GpuTimer::hasTimestamps()) {
+    if (!f.completedQuery) {
+      f.completedQuery = GpuTimer::createQuery();
+    }
+    GpuTimer::writeTimestamp(f.completedQuery);
+  }
+  f.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  f.frame = frame_;
+  // make sure the fence actually reaches the GPU before anyone waits on it
+  glFlush();
+  if (f.completedQuery) {
+    f.submittedNs = GpuTimer::getGpuTime();
+    f.disjointCount = GpuTimer::getDisjointCount();
+  }
+  count_++;
+
+  stats_.frames++;
+  if (stats_.frames >= kReportFrames) {
+    report();
+  }
+}
+
+void FramePacer::retire(InFlight& f) {
+  // The fence has signaled, so the timestamp should be there too, but don't wait if it isn't
+  int64_t completedNs = 0;
+  if (f.completedQuery && GpuTimer::readTimestamp(f.completedQuery, completedNs) &&
+      GpuTimer::getDisjointCount() == f.disjointCount) {
+    double latencyMs = max<int64_t>(completedNs - f.submittedNs, 0) * 1e-6;
+    stats_.latencySamples++;
+    stats_.totalLatencyMs += latencyMs;
+    stats_.maxLatencyMs = max(stats_.maxLatencyMs, latencyMs);
+  }
+
+  completedFrame_ = max(completedFrame_, f.frame);
+  glDeleteSync(f.fence);
+  f.fence = nullptr;
+  head_ = (head_ + 1) % kMaxFramesInFlight;
+  count_--;
+}
+
+void FramePacer::report() {
+  aout << "FramePacer: " << maxFramesInFlight_ << " frames in flight, CPU wait avg "
+       << stats_.totalWaitMs / stats_.frames << " ms max " << stats_.maxWaitMs << " ms";
+  if (stats_.latencySamples) {
+    aout << ", GPU latency avg " << stats_.totalLatencyMs / stats_.latencySamples << " ms max "
+         << stats_.maxLatencyMs << " ms" << endl;
+  } else {
+    aout << ", no GPU timestamps to measure latency with" << endl;
+  }
+  stats_ = {};
+}
@@ -0,0 +1,110 @@
+#ifndef ANDROIDGLINVESTIGATIONS_FRAMEPACER_H
+#define ANDROIDGLINVESTIGATIONS_FRAMEPACER_H
+
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+
+/*!
+ * Bounds how far the CPU can run ahead of the GPU. A fence is inserted at the end of every frame,
+ * and beginFrame() waits on the oldest one once the configured number of frames is in flight.
+ *
+ * The time spent waiting and the latency from the end of CPU submission to GPU completion are
+ * measured per frame and periodically logged. getCompletedFrame() tells per-frame resources (e.g.
+ * dynamic buffers) which frames the GPU is done with, so their memory can be reused.
+ *
+ * The latency is the GPU clock when the frame's last command finished, from a timestamp query,
+ * less the GPU clock when it was submitted. A fence found signaled only says the frame finished
+ * some time before the poll, a frame later at best, so without GPU timestamps (see
+ * GpuTimer::hasTimestamps) latency isn't measured.
+ */
+class FramePacer {
+ public:
+  static constexpr uint32_t kMaxFramesInFlight = 4;
+
+  struct Stats {
+    uint32_t frames = 0;
+    double totalWaitMs = 0;
+    double maxWaitMs = 0;
+    uint32_t latencySamples = 0;
+    double totalLatencyMs = 0;
+    double maxLatencyMs = 0;
+  };
+
+  /*!
+   * @param maxFramesInFlight frames the CPU may submit before waiting on the GPU, 1 to
+   * kMaxFramesInFlight. 1 gives the lowest latency, larger values more overlap.
+   */
+  explicit FramePacer(uint32_t maxFramesInFlight);
+  FramePacer(const FramePacer&) = delete;
+  FramePacer& operator=(const FramePacer&) = delete;
+  ~FramePacer();
+
+  void setMaxFramesInFlight(uint32_t maxFramesInFlight);
+
+  uint32_t getMaxFramesInFlight() const {
+    return maxFramesInFlight_;
+  }
+
+  /*!
+   * Call before any GL work of a frame. Retires finished frames and waits if too many are in flight,
+   * for as long as the oldest one takes; a frame only retires once the GPU has finished it.
+   */
+  void beginFrame();
+
+  /*!
+   * Call after the frame's GL work has been issued. Inserts the frame's fence and flushes.
+   */
+  void endFrame();
+
+  /*!
+   * @return the index of the frame being recorded, starting at 1
+   */
+  uint64_t getFrame() const {
+    return frame_;
+  }
+
+  /*!
+   * @return the newest frame the GPU is known to have finished. Resources last used by this frame
+   * or an earlier one can be reused without synchronization.
+   */
+  uint64_t getCompletedFrame() const {
+    return completedFrame_;
+  }
+
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  // How often stats are logged and reset, in frames
+  static constexpr uint32_t kReportFrames = 300;
+
+  struct InFlight {
+    GLsync fence = nullptr;
+    uint64_t frame = 0;
+    // timestamp query written after the frame's commands, 0 without timestamps
+    GLuint completedQuery = 0;
+    // GPU clock at submission, and the disjoint count then
+    int64_t submittedNs = 0;
+    uint64_t disjointCount = 0;
+  };
+
+  void retire(InFlight& f);
+  void report();
+
+  uint32_t maxFramesInFlight_;
+  uint64_t frame_ = 0;
+  uint64_t completedFrame_ = 0;
+  std::array<InFlight, kMaxFramesInFlight> inFlight_;
+  // oldest in flight frame is inFlight_[head_], count_ of them are live
+  uint32_t head_ = 0;
+  uint32_t count_ = 0;
+  Stats stats_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_FRAMEPACER_H
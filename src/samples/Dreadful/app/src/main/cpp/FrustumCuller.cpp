@@ -0,0 +1,356 @@
+#include "FrustumCuller.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+using namespace std;
+
+// Tangents closer to straight ahead than this are widened to it, so every side of a combined
+// frustum leans outwards and pulling its apex back takes in more
+static constexpr float kMinCombinedTangent = 0.01f;
+
+void FrustumCuller::Spheres::resize(size_t count) {
+  x.resize(count);
+  y.resize(count);
+  z.resize(count);
+  radius.resize(count);
+}
+
+void FrustumCuller::Boxes::resize(size_t count) {
+  centerX.resize(count);
+  centerY.resize(count);
+  centerZ.resize(count);
+  extentX.resize(count);
+  extentY.resize(count);
+  extentZ.resize(count);
+}
+
+void FrustumCuller::Boxes::set(size_t i, const BoundingBox& box) {
+  auto center = box.getCenter();
+  auto extent = (box.max - box.min) * 0.5f;
+  centerX[i] = center.x;
+  centerY[i] = center.y;
+  centerZ[i] = center.z;
+  extentX[i] = extent.x;
+  extentY[i] = extent.y;
+  extentZ[i] = extent.z;
+}
+
+BoundingBox FrustumCuller::Boxes::get(size_t i) const {
+  r3::Vec3f center(centerX[i], centerY[i], centerZ[i]);
+  r3::Vec3f extent(extentX[i], extentY[i], extentZ[i]);
+  return {center - extent, center + extent};
+}
+
+/*!
+ * The planes of a view at pose with the given tangents of its angles, nearZ and farZ away along
+ * its -z axis.
+ */
+static FrustumCuller::Planes makeTangentPlanes(const r3::Posef& pose, float left, float right, float up, float down,
+                                               float nearZ, float farZ) {
+  auto plane = [&pose](const r3::Vec3f& normal, const r3::Vec3f& point) {
+    return r3::Planef(pose.r.Rotate(normal), pose.Transform(point));
+  };
+  r3::Vec3f apex(0, 0, 0);
+  return {
+      plane(r3::Vec3f(1, 0, left), apex),
+      plane(r3::Vec3f(-1, 0, -right), apex),
+      plane(r3::Vec3f(0, 1, down), apex),
+      plane(r3::Vec3f(0, -1, -up), apex),
+      plane(r3::Vec3f(0, 0, -1), r3::Vec3f(0, 0, -nearZ)),
+      plane(r3::Vec3f(0, 0, 1), r3::Vec3f(0, 0, -farZ)),
+  };
+}
+
+FrustumCuller::Planes FrustumCuller::makePlanes(const r3::Posef& pose, const Fov& fov, float nearZ, float farZ) {
+  return makeTangentPlanes(pose, tanf(fov.angleLeft), tanf(fov.angleRight), tanf(fov.angleUp), tanf(fov.angleDown),
+                           nearZ, farZ);
+}
+
+FrustumCuller::Planes FrustumCuller::makeCombinedPlanes(span<const r3::Posef> poses, span<const Fov> fovs,
+                                                        float nearZ, float farZ) {
+  // The widest tangents on each side, facing the first view's way from the middle of the views
+  const auto& orientation = poses[0].r;
+  auto toCombined = orientation.Inverted();
+  r3::Vec3f middle(0, 0, 0);
+  float left = -kMinCombinedTangent;
+  float right = kMinCombinedTangent;
+  float up = kMinCombinedTangent;
+  float down = -kMinCombinedTangent;
+  for (size_t v = 0; v < poses.size(); v++) {
+    middle += poses[v].t / float(poses.size());
+    left = min(left, tanf(fovs[v].angleLeft));
+    right = max(right, tanf(fovs[v].angleRight));
+    up = max(up, tanf(fovs[v].angleUp));
+    down = min(down, tanf(fovs[v].angleDown));
+  }
+
+  // The views' corners relative to the middle, in the combined frustum's frame
+  vector<r3::Vec3f> corners;
+  for (size_t v = 0; v < poses.size(); v++) {
+    float tangents[4] = {tanf(fovs[v].angleLeft), tanf(fovs[v].angleRight), tanf(fovs[v].angleDown),
+                         tanf(fovs[v].angleUp)};
+    for (float depth : {nearZ, farZ}) {
+      for (int x = 0; x < 2; x++) {
+        for (int y = 2; y < 4; y++) {
+          auto corner = poses[v].Transform(r3::Vec3f(tangents[x] * depth, tangents[y] * depth, -depth));
+          corners.push_back(toCombined.Rotate(corner - middle));
+        }
+      }
+    }
+  }
+
+  // A corner at p is inside the side planes of an apex at (0, 0, back) if p.x is between
+  // left * (back - p.z) and right * (back - p.z), and likewise for p.y. Then the near and far
+  // planes go through the nearest and furthest corners.
+  float back = 0;
+  for (const auto& p : corners) {
+    back = max({back, p.z + p.x / left, p.z + p.x / right, p.z + p.y / down, p.z + p.y / up});
+  }
+  float nearest = HUGE_VALF;
+  float furthest = 0;
+  for (const auto& p : corners) {
+    nearest = min(nearest, back - p.z);
+    furthest = max(furthest, back - p.z);
+  }
+  r3::Posef apex(orientation, middle + orientation.Rotate(r3::Vec3f(0, 0, back)));
+  return makeTangentPlanes(apex, left, right, up, down, nearest, furthest);
+}
+
+FrustumCuller::PlaneArrays FrustumCuller::toArrays(const Planes& planes) {
+  PlaneArrays arrays;
+  for (int i = 0; i < 6; i++) {
+    const auto& n = planes[i].planenormal;
+    fill_n(arrays.x[i], 4, n.x);
+    fill_n(arrays.y[i], 4, n.y);
+    fill_n(arrays.z[i], 4, n.z);
+    fill_n(arrays.distance[i], 4, planes[i].planedistance);
+    fill_n(arrays.absX[i], 4, fabsf(n.x));
+    fill_n(arrays.absY[i], 4, fabsf(n.y));
+    fill_n(arrays.absZ[i], 4, fabsf(n.z));
+  }
+  return arrays;
+}
+
+void FrustumCuller::setViews(span<const Planes> views, const Planes* combined) {
+  auto count = min<size_t>(views.size(), kMaxViews);
+  views_.assign(views.begin(), views.begin() + count);
+  viewArrays_.clear();
+  for (const auto& view : views_) {
+    viewArrays_.push_back(toArrays(view));
+  }
+  hasCombined_ = combined != nullptr;
+  if (combined) {
+    combined_ = toArrays(*combined);
+  }
+}
+
+void FrustumCuller::setEyes(span<const r3::Posef> poses, span<const Fov> fovs, float nearZ, float farZ) {
+  vector<Planes> views;
+  for (size_t v = 0; v < poses.size(); v++) {
+    views.push_back(makePlanes(poses[v], fovs[v], nearZ, farZ));
+  }
+  auto combined = makeCombinedPlanes(poses, fovs, nearZ, farZ);
+  setViews(views, poses.size() > 1 ? &combined : nullptr);
+}
+
+// Four lanes of floats and a comparison result per lane, with the few operations the tests need.
+// Multiplies and adds stay separate, not fused, so the results round like the scalar tests'.
+#if defined(__aarch64__)
+using Lanes = float32x4_t;
+using LaneMask = uint32x4_t;
+
+static Lanes load(const float* p) {
+  return vld1q_f32(p);
+}
+static LaneMask noLanes() {
+  return vdupq_n_u32(0);
+}
+static Lanes add(Lanes a, Lanes b) {
+  return vaddq_f32(a, b);
+}
+static Lanes mul(Lanes a, Lanes b) {
+  return vmulq_f32(a, b);
+}
+static LaneMask isLess(Lanes a, Lanes b) {
+  return vcltq_f32(a, b);
+}
+static LaneMask either(LaneMask a, LaneMask b) {
+  return vorrq_u32(a, b);
+}
+//! @return bit i set for each lane i that's set
+static uint32_t toBits(LaneMask mask) {
+  static const uint32_t kLaneBits[4] = {1, 2, 4, 8};
+  return vaddvq_u32(vandq_u32(mask, vld1q_u32(kLaneBits)));
+}
+#elif defined(__SSE2__)
+using Lanes = __m128;
+using LaneMask = __m128;
+
+static Lanes load(const float* p) {
+  return _mm_loadu_ps(p);
+}
+static LaneMask noLanes() {
+  return _mm_setzero_ps();
+}
+static Lanes add(Lanes a, Lanes b) {
+  return _mm_add_ps(a, b);
+}
+static Lanes mul(Lanes a, Lanes b) {
+  return _mm_mul_ps(a, b);
+}
+static LaneMask isLess(Lanes a, Lanes b) {
+  return _mm_cmplt_ps(a, b);
+}
+static LaneMask either(LaneMask a, LaneMask b) {
+  return _mm_or_ps(a, b);
+}
+static uint32_t toBits(LaneMask mask) {
+  return static_cast<uint32_t>(_mm_movemask_ps(mask));
+}
+#endif
+
+#if defined(__aarch64__) || defined(__SSE2__)
+/*!
+ * @return bit i set if sphere i of the four is at least partly inside every plane
+ */
+template <typename PlaneArrays>
+static uint32_t testSpheres(const PlaneArrays& planes, Lanes x, Lanes y, Lanes z, Lanes radius) {
+  LaneMask outside = noLanes();
+  for (int i = 0; i < 6; i++) {
+    Lanes dot = add(add(mul(x, load(planes.x[i])), mul(y, load(planes.y[i]))), mul(z, load(planes.z[i])));
+    outside = either(outside, isLess(add(dot, radius), load(planes.distance[i])));
+  }
+  return ~toBits(outside) & 0xf;
+}
+
+/*!
+ * @return bit i set if box i of the four is at least partly inside every plane, going by its
+ * corner furthest along each plane's normal
+ */
+template <typename PlaneArrays>
+static uint32_t testBoxes(const PlaneArrays& planes, Lanes centerX, Lanes centerY, Lanes centerZ, Lanes extentX,
+                          Lanes extentY, Lanes extentZ) {
+  LaneMask outside = noLanes();
+  for (int i = 0; i < 6; i++) {
+    Lanes dot = add(add(mul(centerX, load(planes.x[i])), mul(centerY, load(planes.y[i]))),
+                    mul(centerZ, load(planes.z[i])));
+    Lanes reach = add(add(mul(extentX, load(planes.absX[i])), mul(extentY, load(planes.absY[i]))),
+                      mul(extentZ, load(planes.absZ[i])));
+    outside = either(outside, isLess(add(dot, reach), load(planes.distance[i])));
+  }
+  return ~toBits(outside) & 0xf;
+}
+#endif
+
+/*!
+ * By the bits of which of four lanes a view sees, those lanes' bytes set to 1, to shift into place
+ * for the view and store as four masks at once.
+ */
+static constexpr auto kLaneBytes = [] {
+  array<uint32_t, 16> bytes = {};
+  for (uint32_t bits = 0; bits < 16; bits++) {
+    for (uint32_t lane = 0; lane < 4; lane++) {
+      bytes[bits] |= ((bits >> lane) & 1) << (lane * 8);
+    }
+  }
+  return bytes;
+}();
+
+void FrustumCuller::cull(const Spheres& spheres, size_t first, size_t last, span<uint8_t> masks, bool simd) const {
+  auto viewCount = getViewCount();
+  size_t scalarStart = first;
+#if defined(__aarch64__) || defined(__SSE2__)
+  if (simd) {
+    scalarStart = first + ((last - first) & ~size_t(3));
+    for (size_t i = first; i < scalarStart; i += 4) {
+      Lanes x = load(&spheres.x[i]);
+      Lanes y = load(&spheres.y[i]);
+      Lanes z = load(&spheres.z[i]);
+      Lanes radius = load(&spheres.radius[i]);
+      uint32_t anyView = 0xf;
+      if (hasCombined_) {
+        anyView = testSpheres(combined_, x, y, z, radius);
+        if (anyView == 0) {
+          fill_n(&masks[i], 4, 0);
+          continue;
+        }
+      }
+      uint32_t laneMasks = 0;
+      for (uint32_t v = 0; v < viewCount; v++) {
+        laneMasks |= kLaneBytes[testSpheres(viewArrays_[v], x, y, z, radius) & anyView] << v;
+      }
+      memcpy(&masks[i], &laneMasks, 4);
+    }
+  }
+#else
+  (void)simd;
+#endif
+  for (size_t i = scalarStart; i < last; i++) {
+    auto sphere = spheres.get(i);
+    uint8_t mask = 0;
+    for (uint32_t v = 0; v < viewCount; v++) {
+      mask |= uint8_t(intersects(views_[v], sphere) << v);
+    }
+    masks[i] = mask;
+  }
+}
+
+void FrustumCuller::cull(const Boxes& boxes, size_t first, size_t last, span<uint8_t> masks, bool simd) const {
+  auto viewCount = getViewCount();
+  size_t scalarStart = first;
+#if defined(__aarch64__) || defined(__SSE2__)
+  if (simd) {
+    scalarStart = first + ((last - first) & ~size_t(3));
+    for (size_t i = first; i < scalarStart; i += 4) {
+      Lanes centerX = load(&boxes.centerX[i]);
+      Lanes centerY = load(&boxes.centerY[i]);
+      Lanes centerZ = load(&boxes.centerZ[i]);
+      Lanes extentX = load(&boxes.extentX[i]);
+      Lanes extentY = load(&boxes.extentY[i]);
+      Lanes extentZ = load(&boxes.extentZ[i]);
+      uint32_t anyView = 0xf;
+      if (hasCombined_) {
+        anyView = testBoxes(combined_, centerX, centerY, centerZ, extentX, extentY, extentZ);
+        if (anyView == 0) {
+          fill_n(&masks[i], 4, 0);
+          continue;
+        }
+      }
+      uint32_t laneMasks = 0;
+      for (uint32_t v = 0; v < viewCount; v++) {
+        uint32_t bits = testBoxes(viewArrays_[v], centerX, centerY, centerZ, extentX, extentY, extentZ);
+        laneMasks |= kLaneBytes[bits & anyView] << v;
+      }
+      memcpy(&masks[i], &laneMasks, 4);
+    }
+  }
+#else
+  (void)simd;
+#endif
+  for (size_t i = scalarStart; i < last; i++) {
+    auto box = boxes.get(i);
+    uint8_t mask = 0;
+    for (uint32_t v = 0; v < viewCount; v++) {
+      mask |= uint8_t(intersects(views_[v], box) << v);
+    }
+    masks[i] = mask;
+  }
+}
+
+const char* FrustumCuller::getSimdName() {
+#if defined(__aarch64__)
+  return "NEON";
+#elif defined(__SSE2__)
+  return "SSE2";
+#else
+  return "scalar";
+#endif
+}
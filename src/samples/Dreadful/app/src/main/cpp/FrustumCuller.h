@@ -0,0 +1,156 @@
+#ifndef ANDROIDGLINVESTIGATIONS_FRUSTUMCULLER_H
+#define ANDROIDGLINVESTIGATIONS_FRUSTUMCULLER_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Bounds.h"
+#include "linear.h"
+
+/*!
+ * Tests bounding spheres and boxes against the frusta of up to kMaxViews views at once, such as
+ * the two eyes of a stereo pair, writing a mask per object with a bit for each view that sees it.
+ *
+ * Objects are stored as separate arrays of each coordinate, so four of them load into one register
+ * per coordinate and every plane tests all four with a few multiply-adds: NEON on arm64, SSE2 on
+ * x86. Each group of four is first tested against a frustum enclosing every view, and only tested
+ * per view if one of them is at least partly inside it, so objects out of sight of every view cost
+ * one frustum's tests rather than one per view. That pays when objects near each other are stored
+ * near each other, as in Bvh order, so groups of four tend to be out of sight together; for
+ * objects in no particular order the skip is a coin toss the branch predictor loses, and leaving
+ * the combined frustum out is quicker. The last few objects that don't fill a group of four, and
+ * everything when simd is off, go through the plain tests of Bounds.h, view by view.
+ *
+ * Like those tests, this is conservative: objects near a frustum's corners can pass without being
+ * in it. Not thread safe, but culling different objects from different threads is fine.
+ */
+class FrustumCuller {
+ public:
+  static constexpr uint32_t kMaxViews = 8;
+
+  using Planes = std::array<r3::Planef, 6>;
+
+  //! The angles of an XrFovf, in radians; left and down are usually negative
+  struct Fov {
+    float angleLeft = 0;
+    float angleRight = 0;
+    float angleUp = 0;
+    float angleDown = 0;
+  };
+
+  //! Spheres as one array per coordinate
+  struct Spheres {
+    std::vector<float> x, y, z, radius;
+
+    void resize(size_t count);
+
+    void set(size_t i, const BoundingSphere& sphere) {
+      x[i] = sphere.center.x;
+      y[i] = sphere.center.y;
+      z[i] = sphere.center.z;
+      radius[i] = sphere.radius;
+    }
+
+    BoundingSphere get(size_t i) const {
+      return {r3::Vec3f(x[i], y[i], z[i]), radius[i]};
+    }
+
+    size_t size() const {
+      return x.size();
+    }
+  };
+
+  //! Axis aligned boxes as their centers and half extents, one array per coordinate
+  struct Boxes {
+    std::vector<float> centerX, centerY, centerZ, extentX, extentY, extentZ;
+
+    void resize(size_t count);
+
+    void set(size_t i, const BoundingBox& box);
+
+    BoundingBox get(size_t i) const;
+
+    size_t size() const {
+      return centerX.size();
+    }
+  };
+
+  /*!
+   * The planes of a perspective view at pose, looking down its -z axis, in the order and
+   * orientation of extractFrustumPlanes.
+   */
+  static Planes makePlanes(const r3::Posef& pose, const Fov& fov, float nearZ, float farZ);
+
+  /*!
+   * The planes of one frustum holding the frusta of all the views, facing the way the first one
+   * does. Its apex is pulled back behind the views far enough for the widest of their angles on
+   * each side to take in every view's corners, so for eyes a few centimeters apart it's barely
+   * larger than their union.
+   */
+  static Planes makeCombinedPlanes(std::span<const r3::Posef> poses, std::span<const Fov> fovs, float nearZ,
+                                   float farZ);
+
+  /*!
+   * Sets the views objects are tested against.
+   * @param combined a frustum holding all of them, or null to test every view for every object
+   */
+  void setViews(std::span<const Planes> views, const Planes* combined);
+
+  /*!
+   * Sets a view per eye from their poses and XrFovfs, plus the combined frustum of them all.
+   */
+  void setEyes(std::span<const r3::Posef> poses, std::span<const Fov> fovs, float nearZ, float farZ);
+
+  uint32_t getViewCount() const {
+    return static_cast<uint32_t>(views_.size());
+  }
+
+  /*!
+   * Writes each sphere's mask: bit v is set if view v sees it.
+   * @param masks as many as spheres
+   * @param simd use the vector tests where available, only turned off to compare against them
+   */
+  void cull(const Spheres& spheres, std::span<uint8_t> masks, bool simd = true) const {
+    cull(spheres, 0, spheres.size(), masks, simd);
+  }
+
+  /*!
+   * The same for the spheres from first to before last only, so ranges can be culled on different
+   * threads. masks is still indexed like spheres.
+   */
+  void cull(const Spheres& spheres, size_t first, size_t last, std::span<uint8_t> masks, bool simd = true) const;
+
+  /*!
+   * The same for boxes.
+   */
+  void cull(const Boxes& boxes, std::span<uint8_t> masks, bool simd = true) const {
+    cull(boxes, 0, boxes.size(), masks, simd);
+  }
+
+  void cull(const Boxes& boxes, size_t first, size_t last, std::span<uint8_t> masks, bool simd = true) const;
+
+  /*!
+   * @return "NEON", "SSE2" or "scalar", whichever tests cull uses when simd is set
+   */
+  static const char* getSimdName();
+
+ private:
+  //! One frustum's planes as one array per component, with the normals' absolute values for boxes.
+  //! Each value is repeated for the four lanes of a vector, to load rather than broadcast.
+  struct PlaneArrays {
+    alignas(16) float x[6][4], y[6][4], z[6][4], distance[6][4];
+    alignas(16) float absX[6][4], absY[6][4], absZ[6][4];
+  };
+
+  static PlaneArrays toArrays(const Planes& planes);
+
+  std::vector<Planes> views_;
+  std::vector<PlaneArrays> viewArrays_;
+  PlaneArrays combined_;
+  bool hasCombined_ = false;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_FRUSTUMCULLER_H
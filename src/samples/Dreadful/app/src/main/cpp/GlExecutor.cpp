@@ -0,0 +1,26 @@
+#include "GlExecutor.h"
+
+using namespace std;
+
+void GlExecutor::post(function<void()> job, shared_ptr<const TaskControl> control) {
+  lock_guard<mutex> lock(mutex_);
+  jobs_.push(std::move(job), std::move(control));
+  pendingCount_++;
+}
+
+void GlExecutor::run() {
+  auto start = Clock::now();
+  do {
+    function<void()> job;
+    {
+      lock_guard<mutex> lock(mutex_);
+      if (jobs_.empty()) {
+        return;
+      }
+      job = jobs_.pop();
+      pendingCount_--;
+    }
+    // steps run unlocked, since they post their next one
+    job();
+  } while (chrono::duration<double, milli>(Clock::now() - start).count() < budgetMs_);
+}
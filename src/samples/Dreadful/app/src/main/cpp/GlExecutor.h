@@ -0,0 +1,49 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLEXECUTOR_H
+#define ANDROIDGLINVESTIGATIONS_GLEXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <mutex>
+
+#include "Task.h"
+
+/*!
+ * Runs steps of tasks on the GL thread, highest priority first, for as long as a per-frame budget
+ * allows. Any thread can post; run() does the work once per frame.
+ *
+ * A step runs to its next co_await, so the budget only holds if the GL part of each task is
+ * short. Big uploads belong in the UploadScheduler, which splits them.
+ */
+class GlExecutor : public Executor {
+ public:
+  /*!
+   * @param budgetMs GL thread time run() may spend per frame
+   */
+  explicit GlExecutor(double budgetMs) : budgetMs_(budgetMs) {}
+  GlExecutor(const GlExecutor&) = delete;
+  GlExecutor& operator=(const GlExecutor&) = delete;
+
+  void post(std::function<void()> job, std::shared_ptr<const TaskControl> control) override;
+
+  /*!
+   * Runs queued steps until there are none or the budget is spent, at least one however long it
+   * takes. Call once per frame on the GL thread.
+   */
+  void run();
+
+  //! @return steps posted and not run yet
+  size_t getPendingCount() const {
+    return pendingCount_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  double budgetMs_;
+  std::mutex mutex_;
+  TaskQueue jobs_;
+  std::atomic<size_t> pendingCount_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_GLEXECUTOR_H
@@ -0,0 +1,195 @@
+#include "GlbAsset.h"
+
+#include <chrono>
+#include <cstdint>
+
+#include "AndroidOut.h"
+#include "GlbFile.h"
+
+using namespace std;
+
+namespace {
+
+//! Keeps the file's bytes where they are while embedded images decode from them
+struct Source {
+  AAsset* asset = nullptr;
+  vector<uint8_t> unpacked;
+
+  ~Source() {
+    if (asset) {
+      AAsset_close(asset);
+    }
+  }
+};
+
+}  // namespace
+
+static GLenum getIndexType(const GlbAccessor& accessor) {
+  if (accessor.components != 1) {
+    return GL_NONE;
+  }
+  switch (accessor.componentType) {
+    case kGltfUnsignedByte:
+      return GL_UNSIGNED_BYTE;
+    case kGltfUnsignedShort:
+      return GL_UNSIGNED_SHORT;
+    case kGltfUnsignedInt:
+      return GL_UNSIGNED_INT;
+    default:
+      return GL_NONE;
+  }
+}
+
+//! The uv encodings glTF allows: float, or normalized unsigned bytes or shorts
+static VertexComponentType getUvType(const GlbAccessor& accessor) {
+  if (accessor.components != 2) {
+    return VertexComponentType::None;
+  }
+  if (accessor.componentType == kGltfFloat) {
+    return VertexComponentType::Float;
+  }
+  if (accessor.normalized && accessor.componentType == kGltfUnsignedByte) {
+    return VertexComponentType::Unorm8;
+  }
+  if (accessor.normalized && accessor.componentType == kGltfUnsignedShort) {
+    return VertexComponentType::Unorm16;
+  }
+  return VertexComponentType::None;
+}
+
+unique_ptr<GlbAsset> GlbAsset::load(AAssetManager* assetManager, const string& assetPath, const AssetArchive* archive,
+                                    TextureStreamer& streamer) {
+  auto start = chrono::steady_clock::now();
+
+  // As for .dmesh files, the bytes are used in place if they're stored uncompressed
+  auto source = make_shared<Source>();
+  span<const uint8_t> bytes;
+  const AssetArchive::Entry* entry = archive ? archive->find(assetPath) : nullptr;
+  if (entry) {
+    bytes = archive->getMapped(*entry);
+    if (bytes.empty() && archive->read(*entry, source->unpacked)) {
+      bytes = source->unpacked;
+    }
+  } else {
+    source->asset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_BUFFER);
+    if (!source->asset) {
+      aout << "GlbAsset: can't open " << assetPath << endl;
+      return nullptr;
+    }
+    auto buffer = static_cast<const uint8_t*>(AAsset_getBuffer(source->asset));
+    if (buffer) {
+      bytes = {buffer, static_cast<size_t>(AAsset_getLength64(source->asset))};
+    }
+  }
+
+  GlbFile file;
+  const char* error = "can't read it";
+  if (bytes.empty() || !GlbFile::parse(bytes.data(), bytes.size(), file, &error)) {
+    aout << "GlbAsset: " << assetPath << ": " << error << endl;
+    return nullptr;
+  }
+  auto parsed = chrono::steady_clock::now();
+
+  // Every view a primitive reads goes to GL once, at a 4 byte aligned offset, and the attributes
+  // and indices point at it there
+  vector<size_t> vertexOffsets(file.bufferViews.size(), SIZE_MAX);
+  vector<size_t> indexOffsets(file.bufferViews.size(), SIZE_MAX);
+  Mesh::BufferData vertices;
+  Mesh::BufferData indices;
+  auto place = [&file](uint32_t view, vector<size_t>& offsets, Mesh::BufferData& data) {
+    if (offsets[view] == SIZE_MAX) {
+      offsets[view] = data.size;
+      data.ranges.push_back({data.size, file.getBufferView(view)});
+      data.size += (file.bufferViews[view].byteLength + 3) / 4 * 4;
+    }
+    return offsets[view];
+  };
+  auto setAttribute = [&](VertexAttributeFormat& attribute, const GlbAccessor& accessor, VertexComponentType type) {
+    uint32_t byteStride = file.bufferViews[accessor.bufferView].byteStride;
+    attribute.type = type;
+    attribute.components = accessor.components;
+    attribute.offset = uint32_t(place(accessor.bufferView, vertexOffsets, vertices) + accessor.byteOffset);
+    attribute.stride = byteStride ? byteStride : accessor.getElementSize();
+  };
+
+  vector<Mesh::Submesh> submeshes;
+  // the material of each submesh
+  vector<uint32_t> materials;
+  size_t skipped = 0;
+  for (const auto& mesh : file.meshes) {
+    for (const auto& p : mesh.primitives) {
+      const GlbAccessor* position = p.position != kGltfNone ? &file.accessors[p.position] : nullptr;
+      const GlbAccessor* index = p.indices != kGltfNone ? &file.accessors[p.indices] : nullptr;
+      bool drawable = p.mode == kGltfTriangles && position && position->bufferView != kGltfNone &&
+                      position->componentType == kGltfFloat && position->components == 3 && position->hasBounds &&
+                      index && index->bufferView != kGltfNone && getIndexType(*index) != GL_NONE;
+      if (!drawable) {
+        skipped++;
+        continue;
+      }
+
+      Mesh::Submesh submesh;
+      submesh.indexType = getIndexType(*index);
+      size_t indexOffset = place(index->bufferView, indexOffsets, indices) + index->byteOffset;
+      submesh.firstIndex = uint32_t(indexOffset / index->getElementSize());
+      submesh.indexCount = index->count;
+      setAttribute(submesh.format.attributes[size_t(VertexAttribute::Position)], *position, VertexComponentType::Float);
+      submesh.format.stride = submesh.format.get(VertexAttribute::Position).stride;
+      if (p.uv != kGltfNone) {
+        const auto& uv = file.accessors[p.uv];
+        auto type = getUvType(uv);
+        if (type != VertexComponentType::None && uv.bufferView != kGltfNone) {
+          setAttribute(submesh.format.attributes[size_t(VertexAttribute::Uv)], uv, type);
+        }
+      }
+      // POSITION has to give its bounds, so nothing needs reading to get a sphere
+      r3::Vec3f lo(position->min);
+      r3::Vec3f hi(position->max);
+      submesh.bounds.center = (lo + hi) * 0.5f;
+      submesh.bounds.radius = (hi - lo).Length() * 0.5f;
+      vertices.count += position->count;
+      indices.count += index->count;
+      submeshes.push_back(std::move(submesh));
+      materials.push_back(p.material);
+    }
+  }
+  if (submeshes.empty()) {
+    aout << "GlbAsset: " << assetPath << " has no primitives that can be drawn" << endl;
+    return nullptr;
+  }
+
+  unique_ptr<GlbAsset> glb(new GlbAsset());
+  size_t submeshCount = submeshes.size();
+  glb->mesh_ = Mesh::create(vertices, indices, std::move(submeshes));
+  if (!glb->mesh_) {
+    return nullptr;
+  }
+  auto uploaded = chrono::steady_clock::now();
+
+  // A texture per image, however many materials use it
+  vector<shared_ptr<TextureAsset>> textures(file.images.size());
+  size_t imageCount = 0;
+  for (uint32_t s = 0; s < submeshCount; s++) {
+    uint32_t image = materials[s] != kGltfNone ? file.materials[materials[s]].baseColorImage : kGltfNone;
+    if (image == kGltfNone || file.images[image].bufferView == kGltfNone) {
+      continue;
+    }
+    auto& texture = textures[image];
+    if (!texture) {
+      const auto& name = file.images[image].name;
+      texture = streamer.loadImage(assetPath + "#" + (name.empty() ? "image" + to_string(image) : name),
+                                   file.getBufferView(file.images[image].bufferView), source);
+      imageCount += texture != nullptr;
+    }
+    if (texture) {
+      glb->models_.emplace_back(glb->mesh_, texture, s);
+    }
+  }
+
+  auto ms = [](auto from, auto to) { return chrono::duration<double, milli>(to - from).count(); };
+  aout << "GlbAsset: " << assetPath << ", " << submeshCount << " primitives (" << skipped << " skipped), "
+       << glb->models_.size() << " models, " << imageCount << " images streaming; parsed in " << ms(start, parsed)
+       << " ms, " << vertices.ranges.size() + indices.ranges.size() << " buffer views uploaded in "
+       << ms(parsed, uploaded) << " ms" << endl;
+  return glb;
+}
@@ -0,0 +1,53 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLBASSET_H
+#define ANDROIDGLINVESTIGATIONS_GLBASSET_H
+
+#include <android/asset_manager.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "Mesh.h"
+#include "Model.h"
+#include "TextureStreamer.h"
+
+/*!
+ * The models of a binary glTF file (see GlbFile.h). Loading uses the file where it lies: mapped from
+ * the apk by the asset manager (glb is in noCompress) or from the asset pack. The JSON is parsed
+ * once, and every buffer view the primitives read goes to GL as it is, without touching a vertex.
+ * The accessors then describe the attributes, so interleaved, separate and normalized 8 and 16 bit
+ * uvs all draw as they're stored.
+ *
+ * All the file's triangle primitives share one Mesh, a submesh each, and each one with a base color
+ * texture becomes a Model. Embedded images are decoded on the streamer's workers, straight from the
+ * file, which stays open until they're done.
+ *
+ * Only positions and the first uv set are read, which is what Shader draws. Node transforms aren't
+ * applied, and primitives without indices or with positions other than float are skipped.
+ */
+class GlbAsset {
+ public:
+  /*!
+   * Loads a .glb asset, from archive if it has it. Call on the GL thread.
+   * @return the models, or null if the asset is missing or invalid
+   */
+  static std::unique_ptr<GlbAsset> load(AAssetManager* assetManager, const std::string& assetPath,
+                                        const AssetArchive* archive, TextureStreamer& streamer);
+
+  const std::shared_ptr<Mesh>& getMesh() const {
+    return mesh_;
+  }
+
+  const std::vector<Model>& getModels() const {
+    return models_;
+  }
+
+ private:
+  GlbAsset() = default;
+
+  std::shared_ptr<Mesh> mesh_;
+  std::vector<Model> models_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_GLBASSET_H
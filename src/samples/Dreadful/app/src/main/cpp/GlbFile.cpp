@@ -0,0 +1,184 @@
+#include "GlbFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "Json.h"
+
+using namespace std;
+
+static uint32_t getComponentSize(uint32_t componentType) {
+  switch (componentType) {
+    case kGltfByte:
+    case kGltfUnsignedByte:
+      return 1;
+    case kGltfShort:
+    case kGltfUnsignedShort:
+      return 2;
+    case kGltfUnsignedInt:
+    case kGltfFloat:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+static uint32_t getComponentCount(string_view type) {
+  if (type == "SCALAR") {
+    return 1;
+  }
+  if (type.size() == 4 && type.substr(0, 3) == "VEC" && type[3] >= '2' && type[3] <= '4') {
+    return type[3] - '0';
+  }
+  return 0;
+}
+
+uint32_t GlbAccessor::getElementSize() const {
+  return getComponentSize(componentType) * components;
+}
+
+bool GlbFile::parse(const uint8_t* data, size_t size, GlbFile& out, const char** error) {
+  auto fail = [error](const char* message) {
+    if (error) {
+      *error = message;
+    }
+    return false;
+  };
+  auto read32 = [data](size_t offset) {
+    uint32_t value;
+    memcpy(&value, data + offset, sizeof(value));
+    return value;
+  };
+
+  // 12 byte header, then chunks of a length, a type and the data, padded to 4 bytes
+  if (size < 20 || read32(0) != kGlbMagic) {
+    return fail("not a GLB file");
+  }
+  if (read32(4) != kGlbVersion) {
+    return fail("unsupported glTF version");
+  }
+  size = min<size_t>(size, read32(8));
+  string_view jsonText;
+  out.bin = nullptr;
+  out.binSize = 0;
+  for (size_t offset = 12; offset + 8 <= size;) {
+    size_t length = read32(offset);
+    uint32_t type = read32(offset + 4);
+    if (length > size - offset - 8) {
+      return fail("truncated chunk");
+    }
+    const uint8_t* chunk = data + offset + 8;
+    if (type == kGlbChunkJson && jsonText.empty()) {
+      jsonText = {reinterpret_cast<const char*>(chunk), length};
+    } else if (type == kGlbChunkBin && !out.bin) {
+      out.bin = chunk;
+      out.binSize = length;
+    }
+    offset += 8 + (length + 3) / 4 * 4;
+  }
+
+  JsonValue json;
+  const char* jsonError = nullptr;
+  if (jsonText.empty()) {
+    return fail("no JSON chunk");
+  }
+  if (!JsonValue::parse(jsonText, json, &jsonError)) {
+    return fail(jsonError);
+  }
+
+  out.bufferViews.clear();
+  for (const auto& v : json["bufferViews"].getElements()) {
+    GlbBufferView view;
+    // views of other buffers are left empty, so nothing can read from them
+    if (v["buffer"].getUint() == 0 && out.bin) {
+      view.byteOffset = v["byteOffset"].getUint();
+      view.byteLength = v["byteLength"].getUint();
+      view.byteStride = v["byteStride"].getUint();
+      if (view.byteOffset > out.binSize || view.byteLength > out.binSize - view.byteOffset) {
+        return fail("buffer view outside the BIN chunk");
+      }
+    }
+    out.bufferViews.push_back(view);
+  }
+
+  out.accessors.clear();
+  for (const auto& a : json["accessors"].getElements()) {
+    GlbAccessor accessor;
+    accessor.componentType = a["componentType"].getUint();
+    accessor.components = getComponentCount(a["type"].getString());
+    accessor.count = a["count"].getUint();
+    accessor.normalized = a["normalized"].getBool();
+    accessor.byteOffset = a["byteOffset"].getUint();
+    const auto& lo = a["min"];
+    const auto& hi = a["max"];
+    accessor.hasBounds = lo.size() >= 3 && hi.size() >= 3;
+    for (int c = 0; accessor.hasBounds && c < 3; c++) {
+      accessor.min[c] = float(lo[c].getNumber());
+      accessor.max[c] = float(hi[c].getNumber());
+    }
+    uint32_t viewIndex = a["bufferView"].getUint(kGltfNone);
+    uint32_t elementSize = accessor.getElementSize();
+    if (viewIndex < out.bufferViews.size() && elementSize != 0 && accessor.count != 0) {
+      // the last element has to end inside the view
+      const auto& view = out.bufferViews[viewIndex];
+      size_t stride = view.byteStride ? view.byteStride : elementSize;
+      size_t end = accessor.byteOffset + stride * (accessor.count - 1) + elementSize;
+      if (end > view.byteLength || accessor.byteOffset % getComponentSize(accessor.componentType) != 0) {
+        return fail("accessor outside its buffer view");
+      }
+      accessor.bufferView = viewIndex;
+    }
+    out.accessors.push_back(accessor);
+  }
+
+  // base color textures go through textures to images
+  const auto& textures = json["textures"];
+  out.materials.clear();
+  for (const auto& m : json["materials"].getElements()) {
+    GlbMaterial material;
+    uint32_t texture = m["pbrMetallicRoughness"]["baseColorTexture"]["index"].getUint(kGltfNone);
+    material.baseColorImage = textures[texture]["source"].getUint(kGltfNone);
+    out.materials.push_back(material);
+  }
+
+  out.images.clear();
+  for (const auto& i : json["images"].getElements()) {
+    GlbImage image;
+    uint32_t view = i["bufferView"].getUint(kGltfNone);
+    image.bufferView = view < out.bufferViews.size() ? view : kGltfNone;
+    image.mimeType = i["mimeType"].getString();
+    image.name = i["name"].getString();
+    out.images.push_back(std::move(image));
+  }
+
+  out.meshes.clear();
+  for (const auto& m : json["meshes"].getElements()) {
+    GlbMesh mesh;
+    mesh.name = m["name"].getString();
+    for (const auto& p : m["primitives"].getElements()) {
+      GlbPrimitive primitive;
+      const auto& attributes = p["attributes"];
+      primitive.position = attributes["POSITION"].getUint(kGltfNone);
+      primitive.uv = attributes["TEXCOORD_0"].getUint(kGltfNone);
+      primitive.indices = p["indices"].getUint(kGltfNone);
+      primitive.material = p["material"].getUint(kGltfNone);
+      primitive.mode = p["mode"].getUint(kGltfTriangles);
+      for (uint32_t* accessor : {&primitive.position, &primitive.uv, &primitive.indices}) {
+        if (*accessor != kGltfNone && *accessor >= out.accessors.size()) {
+          return fail("primitive uses a missing accessor");
+        }
+      }
+      if (primitive.material != kGltfNone && primitive.material >= out.materials.size()) {
+        primitive.material = kGltfNone;
+      }
+      mesh.primitives.push_back(primitive);
+    }
+    out.meshes.push_back(std::move(mesh));
+  }
+  for (auto& material : out.materials) {
+    if (material.baseColorImage >= out.images.size()) {
+      material.baseColorImage = kGltfNone;
+    }
+  }
+  return true;
+}
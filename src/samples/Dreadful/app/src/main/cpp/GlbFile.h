@@ -0,0 +1,112 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GLBFILE_H
+#define ANDROIDGLINVESTIGATIONS_GLBFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*!
+ * A binary glTF 2.0 file (.glb), which GlbAsset loads. This is the GL-free part: it checks the
+ * container, parses the JSON chunk once and keeps the parts a renderer needs as flat tables that
+ * point into the BIN chunk, which stays where it is. Every range is checked against the chunk
+ * here, so users can read them without checks.
+ *
+ * Only the file's own BIN chunk is read. Buffers with a uri, sparse accessors and extensions
+ * aren't supported; accessors on other buffers are treated as missing.
+ */
+
+static constexpr uint32_t kGlbMagic = 0x46546c67;  // "glTF"
+static constexpr uint32_t kGlbVersion = 2;
+static constexpr uint32_t kGlbChunkJson = 0x4e4f534a;  // "JSON"
+static constexpr uint32_t kGlbChunkBin = 0x004e4942;   // "BIN\0"
+
+//! accessor component types, the GL enums of the same names
+static constexpr uint32_t kGltfByte = 5120;
+static constexpr uint32_t kGltfUnsignedByte = 5121;
+static constexpr uint32_t kGltfShort = 5122;
+static constexpr uint32_t kGltfUnsignedShort = 5123;
+static constexpr uint32_t kGltfUnsignedInt = 5125;
+static constexpr uint32_t kGltfFloat = 5126;
+
+//! primitive mode for triangle lists, the only one loaded
+static constexpr uint32_t kGltfTriangles = 4;
+
+//! An index that's absent
+static constexpr uint32_t kGltfNone = ~0u;
+
+struct GlbBufferView {
+  // offset and length in the BIN chunk
+  size_t byteOffset = 0;
+  size_t byteLength = 0;
+  // 0 if elements are tightly packed
+  uint32_t byteStride = 0;
+};
+
+struct GlbAccessor {
+  uint32_t bufferView = kGltfNone;
+  // from the start of the view
+  size_t byteOffset = 0;
+  uint32_t componentType = kGltfFloat;
+  // 1 for SCALAR up to 4 for VEC4, 0 for matrices, which aren't loaded
+  uint32_t components = 0;
+  uint32_t count = 0;
+  bool normalized = false;
+  // min and max as given, for POSITION, which has to give them
+  bool hasBounds = false;
+  float min[3] = {};
+  float max[3] = {};
+
+  //! @return bytes of one element
+  uint32_t getElementSize() const;
+};
+
+struct GlbPrimitive {
+  // accessors
+  uint32_t position = kGltfNone;
+  uint32_t uv = kGltfNone;
+  uint32_t indices = kGltfNone;
+  uint32_t material = kGltfNone;
+  uint32_t mode = kGltfTriangles;
+};
+
+struct GlbMesh {
+  std::string name;
+  std::vector<GlbPrimitive> primitives;
+};
+
+struct GlbMaterial {
+  // the image of the base color texture
+  uint32_t baseColorImage = kGltfNone;
+};
+
+struct GlbImage {
+  // embedded images have a view, others a uri that isn't loaded
+  uint32_t bufferView = kGltfNone;
+  std::string mimeType;
+  std::string name;
+};
+
+struct GlbFile {
+  const uint8_t* bin = nullptr;
+  size_t binSize = 0;
+  std::vector<GlbBufferView> bufferViews;
+  std::vector<GlbAccessor> accessors;
+  std::vector<GlbMesh> meshes;
+  std::vector<GlbMaterial> materials;
+  std::vector<GlbImage> images;
+
+  /*!
+   * Checks the container and parses the JSON chunk. out points into data afterwards.
+   * @param error set to why data can't be used, if it can't
+   */
+  static bool parse(const uint8_t* data, size_t size, GlbFile& out, const char** error = nullptr);
+
+  std::span<const uint8_t> getBufferView(uint32_t view) const {
+    const auto& v = bufferViews[view];
+    return {bin + v.byteOffset, v.byteLength};
+  }
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_GLBFILE_H
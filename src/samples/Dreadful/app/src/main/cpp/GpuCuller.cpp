@@ -0,0 +1,324 @@
+#include "GpuCuller.h"
+
+#include <cmath>
+
+#include "AndroidOut.h"
+#include "Model.h"
+#include "Shader.h"
+
+using namespace std;
+
+// One invocation per instance. Survivors are appended to the view's slice of the visible buffer and
+// counted in the view's indirect draw arguments.
+static const char* cullCompute = R"compute(#version 310 es
+layout(local_size_x = 64) in;
+
+struct Instance {
+    vec4 sphere;
+    vec4 rows[3];
+};
+
+struct DrawCommand {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint reservedMustBeZero;
+};
+
+layout(std430, binding = 0) readonly buffer Instances {
+    Instance instances[];
+};
+
+layout(std430, binding = 1) writeonly buffer Visible {
+    vec4 visibleRows[];
+};
+
+layout(std430, binding = 2) buffer Draws {
+    DrawCommand draws[];
+};
+
+uniform vec4 uPlanes[12];
+uniform uint uInstanceCount;
+uniform uint uViewCount;
+uniform uint uCapacity;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= uInstanceCount) {
+        return;
+    }
+    vec4 sphere = instances[i].sphere;
+    for (uint v = 0u; v < uViewCount; v++) {
+        bool visible = true;
+        for (uint p = 0u; p < 6u; p++) {
+            vec4 plane = uPlanes[v * 6u + p];
+            if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w) {
+                visible = false;
+                break;
+            }
+        }
+        if (visible) {
+            uint slot = atomicAdd(draws[v].instanceCount, 1u);
+            uint base = (v * uCapacity + slot) * 3u;
+            visibleRows[base + 0u] = instances[i].rows[0];
+            visibleRows[base + 1u] = instances[i].rows[1];
+            visibleRows[base + 2u] = instances[i].rows[2];
+        }
+    }
+}
+)compute";
+
+// Same as the main shader, but placed by the per instance rows
+static const char* instancedVertex = R"vertex(#version 300 es
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inRow0;
+layout(location = 3) in vec4 inRow1;
+layout(location = 4) in vec4 inRow2;
+
+out vec2 fragUV;
+
+uniform mat4 uProjection;
+uniform vec4 uDequantize[3];
+
+void main() {
+    vec4 p = vec4(inPosition * uDequantize[0].xyz + uDequantize[1].xyz, 1.0);
+    fragUV = inUV * uDequantize[2].xy + uDequantize[2].zw;
+    gl_Position = uProjection * vec4(dot(inRow0, p), dot(inRow1, p), dot(inRow2, p), 1.0);
+}
+)vertex";
+
+static const char* instancedFragment = R"fragment(#version 300 es
+precision mediump float;
+
+in vec2 fragUV;
+
+uniform sampler2D uTexture;
+
+out vec4 outColor;
+
+void main() {
+    outColor = texture(uTexture, fragUV);
+}
+)fragment";
+
+bool GpuCuller::isSupported() {
+  GLint major = 0;
+  GLint minor = 0;
+  glGetIntegerv(GL_MAJOR_VERSION, &major);
+  glGetIntegerv(GL_MINOR_VERSION, &minor);
+  return major > 3 || (major == 3 && minor >= 1);
+}
+
+std::unique_ptr<GpuCuller> GpuCuller::create(const Model& model) {
+  if (!isSupported()) {
+    aout << "GpuCuller: GLES 3.1 is not available, staying on the CPU path" << endl;
+    return nullptr;
+  }
+
+  unique_ptr<GpuCuller> culler(new GpuCuller());
+
+  GLuint compute = Shader::loadShader(GL_COMPUTE_SHADER, cullCompute);
+  if (!compute) {
+    return nullptr;
+  }
+  culler->cullProgram_ = Shader::linkProgram({compute});
+  glDeleteShader(compute);
+
+  GLuint vertex = Shader::loadShader(GL_VERTEX_SHADER, instancedVertex);
+  GLuint fragment = Shader::loadShader(GL_FRAGMENT_SHADER, instancedFragment);
+  if (vertex && fragment) {
+    culler->drawProgram_ = Shader::linkProgram({vertex, fragment});
+  }
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+
+  if (!culler->cullProgram_ || !culler->drawProgram_) {
+    return nullptr;
+  }
+
+  culler->planesUniform_ = glGetUniformLocation(culler->cullProgram_, "uPlanes");
+  culler->instanceCountUniform_ = glGetUniformLocation(culler->cullProgram_, "uInstanceCount");
+  culler->viewCountUniform_ = glGetUniformLocation(culler->cullProgram_, "uViewCount");
+  culler->capacityUniform_ = glGetUniformLocation(culler->cullProgram_, "uCapacity");
+  culler->projectionUniform_ = glGetUniformLocation(culler->drawProgram_, "uProjection");
+
+  // The culler draws straight from the model's buffers, and keeps the model so they stay resident
+  culler->model_ = make_unique<Model>(model);
+  const auto& mesh = model.getMesh();
+  const auto& submesh = model.getSubmesh();
+  culler->localBounds_ = submesh.bounds;
+  culler->indexCount_ = static_cast<GLsizei>(submesh.indexCount);
+  culler->firstIndex_ = submesh.firstIndex;
+  culler->indexType_ = submesh.indexType;
+  culler->texture_ = model.getTexture().getTextureID();
+
+  // The mesh never changes, so neither does its dequantization
+  glUseProgram(culler->drawProgram_);
+  mesh.setDequantizeUniform(glGetUniformLocation(culler->drawProgram_, "uDequantize"), submesh);
+  glUseProgram(0);
+
+  glGenVertexArrays(1, &culler->vao_);
+  glGenBuffers(1, &culler->instanceBuffer_);
+  glGenBuffers(1, &culler->visibleBuffer_);
+  glGenBuffers(1, &culler->drawBuffer_);
+
+  glBindVertexArray(culler->vao_);
+  // ES 3.1 indirect draws have no base vertex either
+  mesh.bindAttributes({kLocationPosition, kLocationUV, -1, -1}, submesh);
+  for (GLuint r = 0; r < 3; r++) {
+    glVertexAttribDivisor(kLocationRow0 + r, 1);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.getIndexBuffer());
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, culler->drawBuffer_);
+  glBufferData(GL_DRAW_INDIRECT_BUFFER, kMaxViews * sizeof(DrawCommand), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+  return culler;
+}
+
+GpuCuller::Instance GpuCuller::makeInstance(const r3::Matrix4f& transform) const {
+  Instance inst;
+  r3::Vec3f center = transform * localBounds_.center;
+  float scale = 0.f;
+  for (int c = 0; c < 3; c++) {
+    scale = max(scale, r3::Vec3f(transform(0, c), transform(1, c), transform(2, c)).Length());
+  }
+  inst.sphere[0] = center.x;
+  inst.sphere[1] = center.y;
+  inst.sphere[2] = center.z;
+  inst.sphere[3] = localBounds_.radius * scale;
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 4; c++) {
+      inst.transform[r * 4 + c] = transform(r, c);
+    }
+  }
+  return inst;
+}
+
+GpuCuller::~GpuCuller() {
+  GLuint buffers[] = {instanceBuffer_, visibleBuffer_, drawBuffer_};
+  glDeleteBuffers(3, buffers);
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteProgram(cullProgram_);
+  glDeleteProgram(drawProgram_);
+}
+
+void GpuCuller::setInstances(std::span<const Instance> instances) {
+  instances_.assign(instances.begin(), instances.end());
+
+  // Grow, never shrink, so instance churn doesn't reallocate every frame
+  if (instances_.size() > capacity_) {
+    capacity_ = instances_.size();
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, kMaxViews * capacity_ * kVisibleStride, nullptr, GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity_ * sizeof(Instance), nullptr, GL_DYNAMIC_DRAW);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instances_.size() * sizeof(Instance), instances_.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::cull(std::span<const r3::Matrix4f> viewProjections) {
+  if (instances_.empty()) {
+    return;
+  }
+  uint32_t viewCount = min<uint32_t>(viewProjections.size(), kMaxViews);
+
+  float planes[kMaxViews * 6 * 4] = {};
+  DrawCommand draws[kMaxViews];
+  for (uint32_t v = 0; v < viewCount; v++) {
+    auto frustum = extractFrustumPlanes(viewProjections[v]);
+    for (int p = 0; p < 6; p++) {
+      float* dst = &planes[(v * 6 + p) * 4];
+      dst[0] = frustum[p].planenormal.x;
+      dst[1] = frustum[p].planenormal.y;
+      dst[2] = frustum[p].planenormal.z;
+      dst[3] = -frustum[p].planedistance;
+    }
+  }
+  for (auto& d : draws) {
+    d = {static_cast<GLuint>(indexCount_), 0, firstIndex_, 0, 0};
+  }
+
+  // reset the instance counts, the compute shader accumulates into them
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(draws), draws);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  glUseProgram(cullProgram_);
+  glUniform4fv(planesUniform_, kMaxViews * 6, planes);
+  glUniform1ui(instanceCountUniform_, static_cast<GLuint>(instances_.size()));
+  glUniform1ui(viewCountUniform_, viewCount);
+  glUniform1ui(capacityUniform_, static_cast<GLuint>(capacity_));
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer_);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, drawBuffer_);
+  glDispatchCompute((static_cast<GLuint>(instances_.size()) + 63) / 64, 1, 1);
+
+  // the draw reads the results as indirect arguments and instanced attributes
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+}
+
+void GpuCuller::draw(uint32_t view, const r3::Matrix4f& viewProjection) const {
+  if (instances_.empty() || view >= kMaxViews) {
+    return;
+  }
+  glUseProgram(drawProgram_);
+  glUniformMatrix4fv(projectionUniform_, 1, GL_FALSE, viewProjection.GetValue());
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+
+  glBindVertexArray(vao_);
+  bindInstanceRows(view * capacity_ * kVisibleStride);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawBuffer_);
+  glDrawElementsIndirect(GL_TRIANGLES, indexType_, reinterpret_cast<const void*>(view * sizeof(DrawCommand)));
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+size_t GpuCuller::drawCpuCulled(const r3::Matrix4f& viewProjection) const {
+  auto planes = extractFrustumPlanes(viewProjection);
+
+  glUseProgram(drawProgram_);
+  glUniformMatrix4fv(projectionUniform_, 1, GL_FALSE, viewProjection.GetValue());
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, texture_);
+
+  // The rows come from the current attribute values instead of arrays.
+  glBindVertexArray(vao_);
+  for (GLuint r = 0; r < 3; r++) {
+    glDisableVertexAttribArray(kLocationRow0 + r);
+  }
+
+  size_t indexOffset = model_->getSubmesh().getIndexOffset();
+  size_t drawn = 0;
+  for (const auto& inst : instances_) {
+    BoundingSphere s{r3::Vec3f(inst.sphere), inst.sphere[3]};
+    if (!intersects(planes, s)) {
+      continue;
+    }
+    for (GLuint r = 0; r < 3; r++) {
+      glVertexAttrib4fv(kLocationRow0 + r, &inst.transform[r * 4]);
+    }
+    glDrawElements(GL_TRIANGLES, indexCount_, indexType_, reinterpret_cast<const void*>(indexOffset));
+    drawn++;
+  }
+  glBindVertexArray(0);
+  return drawn;
+}
+
+void GpuCuller::bindInstanceRows(GLintptr offset) const {
+  glBindBuffer(GL_ARRAY_BUFFER, visibleBuffer_);
+  for (GLuint r = 0; r < 3; r++) {
+    glVertexAttribPointer(kLocationRow0 + r, 4, GL_FLOAT, GL_FALSE, kVisibleStride,
+                          reinterpret_cast<const void*>(offset + r * 4 * sizeof(float)));
+    glEnableVertexAttribArray(kLocationRow0 + r);
+  }
+}
@@ -0,0 +1,127 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GPUCULLER_H
+#define ANDROIDGLINVESTIGATIONS_GPUCULLER_H
+
+#include <GLES3/gl31.h>
+
+#include <memory>
+#include <span>
+#include <vector>
+
+#include "Bounds.h"
+#include "Model.h"
+#include "linear.h"
+
+/*!
+ * Draws many instances of one model with culling done on the GPU. Requires GLES 3.1.
+ *
+ * Instance bounds and transforms live in a shader storage buffer. cull() dispatches a compute
+ * shader that tests every instance against each view's frustum, appends the survivors to a per view
+ * instance list and bumps the instance count of that view's glDrawElementsIndirect arguments.
+ * draw() then issues a single indirect draw per view, whatever the instance count.
+ *
+ * drawCpuCulled() is the equivalent CPU path (a sphere test and a glDrawElements per visible
+ * instance) kept for comparison.
+ */
+class GpuCuller {
+ public:
+  static constexpr uint32_t kMaxViews = 2;
+
+  /*!
+   * Per instance data, laid out to match the std430 struct in the compute shader.
+   */
+  struct Instance {
+    float sphere[4];      // world space center and radius
+    float transform[12];  // rows of the 3x4 object to world matrix
+  };
+
+  /*!
+   * @return true if the current context can run the compute path
+   */
+  static bool isSupported();
+
+  /*!
+   * Creates a culler for the model. Returns null if GLES 3.1 isn't available or the shaders fail to
+   * build, in which case the caller should stay on the CPU path.
+   */
+  static std::unique_ptr<GpuCuller> create(const Model& model);
+
+  /*!
+   * Builds an instance of the model placed by transform.
+   */
+  Instance makeInstance(const r3::Matrix4f& transform) const;
+
+  ~GpuCuller();
+
+  /*!
+   * Replaces the instance set. Uploads it to the GPU and keeps a CPU copy for drawCpuCulled().
+   */
+  void setInstances(std::span<const Instance> instances);
+
+  const Model& getModel() const {
+    return *model_;
+  }
+
+  size_t getInstanceCount() const {
+    return instances_.size();
+  }
+
+  /*!
+   * Culls every instance against each view. Call outside of any draw pass that uses the results.
+   */
+  void cull(std::span<const r3::Matrix4f> viewProjections);
+
+  /*!
+   * Draws the instances found visible in view by the last cull().
+   */
+  void draw(uint32_t view, const r3::Matrix4f& viewProjection) const;
+
+  /*!
+   * Culls on the CPU and draws each visible instance separately.
+   * @return the number of instances drawn
+   */
+  size_t drawCpuCulled(const r3::Matrix4f& viewProjection) const;
+
+ private:
+  // 3 rows of the instance transform
+  static constexpr GLsizeiptr kVisibleStride = sizeof(float) * 12;
+  static constexpr GLuint kLocationPosition = 0;
+  static constexpr GLuint kLocationUV = 1;
+  static constexpr GLuint kLocationRow0 = 2;
+
+  struct DrawCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint reservedMustBeZero;
+  };
+
+  GpuCuller() = default;
+
+  void bindInstanceRows(GLintptr offset) const;
+
+  std::unique_ptr<Model> model_;
+  std::vector<Instance> instances_;
+  BoundingSphere localBounds_;
+  GLsizei indexCount_ = 0;
+  GLuint firstIndex_ = 0;
+  GLenum indexType_ = GL_UNSIGNED_SHORT;
+  GLuint texture_ = 0;
+  size_t capacity_ = 0;
+
+  GLuint cullProgram_ = 0;
+  GLint planesUniform_ = -1;
+  GLint instanceCountUniform_ = -1;
+  GLint viewCountUniform_ = -1;
+  GLint capacityUniform_ = -1;
+
+  GLuint drawProgram_ = 0;
+  GLint projectionUniform_ = -1;
+
+  GLuint vao_ = 0;
+  GLuint instanceBuffer_ = 0;
+  GLuint visibleBuffer_ = 0;
+  GLuint drawBuffer_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_GPUCULLER_H
@@ -0,0 +1,189 @@
+#include "GpuTimer.h"
+
+#include <EGL/egl.h>
+#include <GLES2/gl2ext.h>
+
+#include <cstring>
+
+using namespace std;
+
+//! The extension's entry points, which libGLESv3 doesn't export
+struct TimerQueryFunctions {
+  PFNGLGENQUERIESEXTPROC genQueries = nullptr;
+  PFNGLDELETEQUERIESEXTPROC deleteQueries = nullptr;
+  PFNGLBEGINQUERYEXTPROC beginQuery = nullptr;
+  PFNGLENDQUERYEXTPROC endQuery = nullptr;
+  PFNGLGETQUERYOBJECTUIVEXTPROC getQueryObjectuiv = nullptr;
+  PFNGLGETQUERYOBJECTUI64VEXTPROC getQueryObjectui64v = nullptr;
+  PFNGLQUERYCOUNTEREXTPROC queryCounter = nullptr;
+  PFNGLGETQUERYIVEXTPROC getQueryiv = nullptr;
+  PFNGLGETQUERYOBJECTI64VEXTPROC getQueryObjecti64v = nullptr;
+  PFNGLGETINTEGER64VEXTPROC getInteger64v = nullptr;
+};
+
+static const TimerQueryFunctions* getFunctions() {
+  static const TimerQueryFunctions* functions = []() -> const TimerQueryFunctions* {
+    auto extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    if (!extensions || !strstr(extensions, "GL_EXT_disjoint_timer_query")) {
+      return nullptr;
+    }
+    static TimerQueryFunctions f;
+    f.genQueries = reinterpret_cast<PFNGLGENQUERIESEXTPROC>(eglGetProcAddress("glGenQueriesEXT"));
+    f.deleteQueries = reinterpret_cast<PFNGLDELETEQUERIESEXTPROC>(eglGetProcAddress("glDeleteQueriesEXT"));
+    f.beginQuery = reinterpret_cast<PFNGLBEGINQUERYEXTPROC>(eglGetProcAddress("glBeginQueryEXT"));
+    f.endQuery = reinterpret_cast<PFNGLENDQUERYEXTPROC>(eglGetProcAddress("glEndQueryEXT"));
+    f.getQueryObjectuiv =
+        reinterpret_cast<PFNGLGETQUERYOBJECTUIVEXTPROC>(eglGetProcAddress("glGetQueryObjectuivEXT"));
+    f.getQueryObjectui64v =
+        reinterpret_cast<PFNGLGETQUERYOBJECTUI64VEXTPROC>(eglGetProcAddress("glGetQueryObjectui64vEXT"));
+    // These are only needed for timestamps
+    f.queryCounter = reinterpret_cast<PFNGLQUERYCOUNTEREXTPROC>(eglGetProcAddress("glQueryCounterEXT"));
+    f.getQueryiv = reinterpret_cast<PFNGLGETQUERYIVEXTPROC>(eglGetProcAddress("glGetQueryivEXT"));
+    f.getQueryObjecti64v =
+        reinterpret_cast<PFNGLGETQUERYOBJECTI64VEXTPROC>(eglGetProcAddress("glGetQueryObjecti64vEXT"));
+    f.getInteger64v = reinterpret_cast<PFNGLGETINTEGER64VEXTPROC>(eglGetProcAddress("glGetInteger64vEXT"));
+    bool complete = f.genQueries && f.deleteQueries && f.beginQuery && f.endQuery && f.getQueryObjectuiv &&
+                    f.getQueryObjectui64v;
+    return complete ? &f : nullptr;
+  }();
+  return functions;
+}
+
+//! Times the driver has reported a disjoint clock. The flag clears when read, so timers share this.
+static uint64_t disjointCount = 0;
+
+static uint64_t pollDisjoint() {
+  GLint disjoint = 0;
+  glGetIntegerv(GL_GPU_DISJOINT_EXT, &disjoint);
+  if (disjoint) {
+    disjointCount++;
+  }
+  return disjointCount;
+}
+
+bool GpuTimer::isSupported() {
+  return getFunctions() != nullptr;
+}
+
+unique_ptr<GpuTimer> GpuTimer::create() {
+  if (!isSupported()) {
+    return nullptr;
+  }
+  unique_ptr<GpuTimer> timer(new GpuTimer());
+  timer->disjointCount_ = pollDisjoint();
+  return timer;
+}
+
+GpuTimer::~GpuTimer() {
+  auto f = getFunctions();
+  free_.insert(free_.end(), pending_.begin(), pending_.end());
+  if (active_) {
+    f->endQuery(GL_TIME_ELAPSED_EXT);
+    free_.push_back(active_);
+  }
+  if (!free_.empty()) {
+    f->deleteQueries(GLsizei(free_.size()), free_.data());
+  }
+}
+
+void GpuTimer::begin() {
+  auto f = getFunctions();
+  if (free_.empty()) {
+    GLuint query = 0;
+    f->genQueries(1, &query);
+    free_.push_back(query);
+  }
+  active_ = free_.back();
+  free_.pop_back();
+  f->beginQuery(GL_TIME_ELAPSED_EXT, active_);
+}
+
+void GpuTimer::end() {
+  if (!active_) {
+    return;
+  }
+  getFunctions()->endQuery(GL_TIME_ELAPSED_EXT);
+  pending_.push_back(active_);
+  active_ = 0;
+}
+
+void GpuTimer::collect() {
+  auto f = getFunctions();
+  // Queries finish in order, so stop at the first one that hasn't
+  uint32_t samples = 0;
+  double totalMs = 0;
+  while (!pending_.empty()) {
+    GLuint available = GL_FALSE;
+    f->getQueryObjectuiv(pending_.front(), GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+    if (!available) {
+      break;
+    }
+    GLuint64 ns = 0;
+    f->getQueryObjectui64v(pending_.front(), GL_QUERY_RESULT_EXT, &ns);
+    samples++;
+    totalMs += ns * 1e-6;
+    free_.push_back(pending_.front());
+    pending_.pop_front();
+  }
+  uint64_t disjoint = pollDisjoint();
+  if (disjoint == disjointCount_) {
+    samples_ += samples;
+    totalMs_ += totalMs;
+  }
+  disjointCount_ = disjoint;
+}
+
+void GpuTimer::reset() {
+  samples_ = 0;
+  totalMs_ = 0;
+}
+
+bool GpuTimer::hasTimestamps() {
+  static const bool supported = [] {
+    auto f = getFunctions();
+    if (!f || !f->queryCounter || !f->getQueryiv || !f->getQueryObjecti64v || !f->getInteger64v) {
+      return false;
+    }
+    GLint bits = 0;
+    f->getQueryiv(GL_TIMESTAMP_EXT, GL_QUERY_COUNTER_BITS_EXT, &bits);
+    return bits > 0;
+  }();
+  return supported;
+}
+
+int64_t GpuTimer::getGpuTime() {
+  GLint64 ns = 0;
+  getFunctions()->getInteger64v(GL_TIMESTAMP_EXT, &ns);
+  return ns;
+}
+
+void GpuTimer::writeTimestamp(GLuint query) {
+  getFunctions()->queryCounter(query, GL_TIMESTAMP_EXT);
+}
+
+bool GpuTimer::readTimestamp(GLuint query, int64_t& ns) {
+  auto f = getFunctions();
+  GLuint available = GL_FALSE;
+  f->getQueryObjectuiv(query, GL_QUERY_RESULT_AVAILABLE_EXT, &available);
+  if (!available) {
+    return false;
+  }
+  GLint64 result = 0;
+  f->getQueryObjecti64v(query, GL_QUERY_RESULT_EXT, &result);
+  ns = result;
+  return true;
+}
+
+GLuint GpuTimer::createQuery() {
+  GLuint query = 0;
+  getFunctions()->genQueries(1, &query);
+  return query;
+}
+
+void GpuTimer::deleteQuery(GLuint query) {
+  getFunctions()->deleteQueries(1, &query);
+}
+
+uint64_t GpuTimer::getDisjointCount() {
+  return pollDisjoint();
+}
@@ -0,0 +1,109 @@
+#ifndef ANDROIDGLINVESTIGATIONS_GPUTIMER_H
+#define ANDROIDGLINVESTIGATIONS_GPUTIMER_H
+
+#include <GLES3/gl3.h>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+/*!
+ * Measures how long the GPU spends on ranges of GL commands, with GL_EXT_disjoint_timer_query.
+ *
+ * Each begin()/end() pair takes a query object, and collect() adds up the ones that have finished
+ * without waiting for the rest, so results arrive a frame or two after their work and the pipeline
+ * never stalls. GL has one elapsed time query active at a time, so ranges can't nest or overlap,
+ * even those of different timers. A collect() drops what it finds when the driver has reported a
+ * disjoint clock (a frequency change or a context switch) since the one before. GL thread only.
+ */
+class GpuTimer {
+ public:
+  /*!
+   * @return true if the current context has GL_EXT_disjoint_timer_query
+   */
+  static bool isSupported();
+
+  /*!
+   * @return null if the context can't time GPU work
+   */
+  static std::unique_ptr<GpuTimer> create();
+
+  GpuTimer(const GpuTimer&) = delete;
+  GpuTimer& operator=(const GpuTimer&) = delete;
+  ~GpuTimer();
+
+  void begin();
+
+  void end();
+
+  /*!
+   * Adds the ranges that have finished since the last call to the totals.
+   */
+  void collect();
+
+  //! @return ranges collected since reset()
+  uint32_t getSampleCount() const {
+    return samples_;
+  }
+
+  double getTotalMs() const {
+    return totalMs_;
+  }
+
+  //! @return the average range in ms, 0 if none were collected
+  double getAverageMs() const {
+    return samples_ ? totalMs_ / samples_ : 0.0;
+  }
+
+  /*!
+   * Clears the totals. Ranges still in flight count towards the next ones.
+   */
+  void reset();
+
+  /*!
+   * @return true if the GPU can also write timestamps, as GL_EXT_disjoint_timer_query allows it not to
+   */
+  static bool hasTimestamps();
+
+  /*!
+   * @return the GPU's clock in ns as of now on the CPU, once the commands issued so far reach it
+   */
+  static int64_t getGpuTime();
+
+  /*!
+   * Makes the GPU write its clock to query once the commands issued so far are done. The query comes
+   * from and goes back to createQuery() and deleteQuery().
+   */
+  static void writeTimestamp(GLuint query);
+
+  /*!
+   * @param ns set to the time written, in the clock of getGpuTime
+   * @return false if the GPU hasn't got to it yet
+   */
+  static bool readTimestamp(GLuint query, int64_t& ns);
+
+  static GLuint createQuery();
+
+  static void deleteQuery(GLuint query);
+
+  /*!
+   * @return how many times the driver has reported a disjoint clock so far. GPU times taken while
+   * this changed can't be compared.
+   */
+  static uint64_t getDisjointCount();
+
+ private:
+  GpuTimer() = default;
+
+  std::vector<GLuint> free_;
+  // ended ranges, oldest first
+  std::deque<GLuint> pending_;
+  GLuint active_ = 0;
+  uint32_t samples_ = 0;
+  double totalMs_ = 0;
+  // disjoint clocks reported as of the last collect()
+  uint64_t disjointCount_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_GPUTIMER_H
@@ -0,0 +1,196 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+using namespace std;
+
+// The system the calling thread works for and its index there
+static thread_local const JobSystem* tSystem = nullptr;
+static thread_local uint32_t tWorker = 0;
+
+bool JobSystem::Deque::push(Job* job) {
+  int64_t b = bottom.load(memory_order_relaxed);
+  int64_t t = top.load(memory_order_acquire);
+  if (b - t >= int64_t(kDequeCapacity)) {
+    return false;
+  }
+  jobs[b & (kDequeCapacity - 1)].store(job, memory_order_relaxed);
+  // The paper's release fence, as a release store so thread sanitizers follow it too
+  bottom.store(b + 1, memory_order_release);
+  return true;
+}
+
+JobSystem::Job* JobSystem::Deque::pop() {
+  int64_t b = bottom.load(memory_order_relaxed) - 1;
+  bottom.store(b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t t = top.load(memory_order_relaxed);
+  if (t > b) {
+    // empty
+    bottom.store(b + 1, memory_order_relaxed);
+    return nullptr;
+  }
+  Job* job = jobs[b & (kDequeCapacity - 1)].load(memory_order_relaxed);
+  if (t == b) {
+    // the last one, which a thief may be taking too
+    if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+      job = nullptr;
+    }
+    bottom.store(b + 1, memory_order_relaxed);
+  }
+  return job;
+}
+
+JobSystem::Job* JobSystem::Deque::steal() {
+  int64_t t = top.load(memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  int64_t b = bottom.load(memory_order_acquire);
+  if (t >= b) {
+    return nullptr;
+  }
+  Job* job = jobs[t & (kDequeCapacity - 1)].load(memory_order_relaxed);
+  if (!top.compare_exchange_strong(t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+    return nullptr;
+  }
+  return job;
+}
+
+JobSystem::JobSystem(uint32_t threadCount, uint32_t jobsPerFrame) : jobs_(jobsPerFrame) {
+  threadCount = max(1u, threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    deques_.push_back(make_unique<Deque>());
+  }
+  tSystem = this;
+  tWorker = 0;
+  threads_.reserve(threadCount - 1);
+  for (uint32_t i = 1; i < threadCount; i++) {
+    threads_.emplace_back(&JobSystem::workerLoop, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+  if (tSystem == this) {
+    tSystem = nullptr;
+  }
+}
+
+void JobSystem::beginFrame() {
+  nextJob_.store(0, memory_order_relaxed);
+}
+
+JobSystem::Job* JobSystem::allocate() {
+  uint32_t index = nextJob_.fetch_add(1, memory_order_relaxed);
+  return index < jobs_.size() ? &jobs_[index] : nullptr;
+}
+
+uint32_t JobSystem::getWorker() const {
+  return tSystem == this ? tWorker : getThreadCount();
+}
+
+void JobSystem::submit(Job* job) {
+  uint32_t worker = getWorker();
+  if (worker == getThreadCount() || !deques_[worker]->push(job)) {
+    execute(job);
+    return;
+  }
+  // Sleepers count themselves before checking queued_, and this counts the job before checking
+  // sleeping_, so either this sees them or they see the job
+  queued_.fetch_add(1);
+  if (sleeping_.load() > 0) {
+    { lock_guard<mutex> lock(mutex_); }
+    wake_.notify_one();
+  }
+}
+
+void JobSystem::submitAfter(Counter& counter, Job* job) {
+  counter.lock();
+  if (counter.pending_.load(memory_order_acquire) == 0) {
+    counter.unlock();
+    submit(job);
+    return;
+  }
+  job->next = counter.waiting_;
+  counter.waiting_ = job;
+  counter.unlock();
+}
+
+void JobSystem::execute(Job* job) {
+  job->run(*job);
+  finish(*job->done);
+}
+
+void JobSystem::finish(Counter& counter) {
+  // Decrements that don't finish the counter skip the lock. The last one takes it, so wait()
+  // taking it after seeing zero knows nothing touches the counter any more.
+  uint32_t pending = counter.pending_.load(memory_order_relaxed);
+  while (pending > 1) {
+    if (counter.pending_.compare_exchange_weak(pending, pending - 1, memory_order_acq_rel, memory_order_relaxed)) {
+      return;
+    }
+  }
+  counter.lock();
+  Job* waiting = nullptr;
+  if (counter.pending_.fetch_sub(1, memory_order_acq_rel) == 1) {
+    waiting = exchange(counter.waiting_, nullptr);
+  }
+  counter.unlock();
+  while (waiting) {
+    Job* next = waiting->next;
+    submit(waiting);
+    waiting = next;
+  }
+}
+
+JobSystem::Job* JobSystem::find(uint32_t worker, bool own) {
+  Job* job = own ? deques_[worker]->pop() : nullptr;
+  auto count = getThreadCount();
+  for (uint32_t i = 1; !job && i <= count; i++) {
+    job = deques_[(worker + i) % count]->steal();
+  }
+  if (job) {
+    queued_.fetch_sub(1, memory_order_relaxed);
+  }
+  return job;
+}
+
+void JobSystem::wait(Counter& counter) {
+  uint32_t worker = getWorker();
+  bool own = worker < getThreadCount();
+  while (!counter.isDone()) {
+    if (Job* job = find(own ? worker : 0, own)) {
+      execute(job);
+    } else {
+      this_thread::yield();
+    }
+  }
+  counter.lock();
+  counter.unlock();
+}
+
+void JobSystem::workerLoop(uint32_t worker) {
+  tSystem = this;
+  tWorker = worker;
+  uint32_t idle = 0;
+  while (!stopping_.load(memory_order_relaxed)) {
+    if (Job* job = find(worker, true)) {
+      execute(job);
+      idle = 0;
+    } else if (++idle < kIdleSpins) {
+      this_thread::yield();
+    } else {
+      unique_lock<mutex> lock(mutex_);
+      sleeping_.fetch_add(1);
+      wake_.wait(lock, [this] { return stopping_ || queued_.load() > 0; });
+      sleeping_.fetch_sub(1);
+      idle = 0;
+    }
+  }
+}
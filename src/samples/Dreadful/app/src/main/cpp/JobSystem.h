@@ -0,0 +1,281 @@
+#ifndef ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
+#define ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*!
+ * Runs short, fine grained jobs of one frame on several threads, for work such as culling and
+ * transform updates that splits into many pieces and has to be done before the frame is drawn.
+ * Asset loading and other long work belongs in a WorkerPool instead.
+ *
+ * The thread that creates the system is worker 0 and works on jobs while it waits for them; the
+ * others are threads of the system's own. Each worker has a deque of jobs: it pushes and pops its
+ * own at one end, most recent first so the data it just touched is still in cache, and when it
+ * runs out it steals the oldest, and so usually largest, piece of work from another's other end.
+ * Idle workers spin briefly and then sleep until more is queued.
+ *
+ * Jobs are tracked with counters: every job counts towards a Counter until it's finished, a job
+ * can wait for a counter to reach zero before starting, and wait() works on jobs until one does.
+ * That's enough to build graphs of jobs, and parallelFor splits a range into them.
+ *
+ * Jobs are allocated from an array reused every frame, with the job's captures stored in place,
+ * so submitting doesn't allocate. That's why captures have to fit kJobDataSize bytes and be
+ * trivially destructible: capture pointers and references, not containers. Everything submitted
+ * in a frame has to be waited for before the next beginFrame(). A frame that runs out of jobs,
+ * or a worker whose deque is full, runs the extra jobs at once instead of queueing them.
+ *
+ * Only the creating thread and jobs may submit and wait. Jobs submitted from any other thread run
+ * at once on it.
+ */
+class JobSystem {
+ public:
+  //! Bytes of captures a job can hold
+  static constexpr size_t kJobDataSize = 40;
+
+  struct Job;
+
+  /*!
+   * Counts the jobs submitted with it that haven't finished. It must outlive them, so wait for it
+   * before it goes out of scope.
+   */
+  class Counter {
+   public:
+    Counter() = default;
+    Counter(const Counter&) = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    bool isDone() const {
+      return pending_.load(std::memory_order_acquire) == 0;
+    }
+
+   private:
+    friend class JobSystem;
+
+    void lock() {
+      while (lock_.test_and_set(std::memory_order_acquire)) {
+        std::this_thread::yield();
+      }
+    }
+
+    void unlock() {
+      lock_.clear(std::memory_order_release);
+    }
+
+    std::atomic<uint32_t> pending_ = 0;
+    // guards waiting_ and the decrement to zero
+    std::atomic_flag lock_;
+    // jobs to start once pending_ is zero, linked through Job::next
+    Job* waiting_ = nullptr;
+  };
+
+  //! 64 bytes, a cache line
+  struct Job {
+    void (*run)(Job& job);
+    Counter* done;
+    Job* next;
+    alignas(8) unsigned char data[kJobDataSize];
+  };
+
+  /*!
+   * @param threadCount workers including the calling thread, at least 1
+   * @param jobsPerFrame jobs that can be submitted between calls to beginFrame
+   */
+  JobSystem(uint32_t threadCount, uint32_t jobsPerFrame);
+  JobSystem(const JobSystem&) = delete;
+  JobSystem& operator=(const JobSystem&) = delete;
+
+  /*!
+   * Drops jobs that haven't started and waits for the running ones.
+   */
+  ~JobSystem();
+
+  uint32_t getThreadCount() const {
+    return static_cast<uint32_t>(deques_.size());
+  }
+
+  /*!
+   * Makes every job slot free again. Every job of the last frame must be finished.
+   */
+  void beginFrame();
+
+  /*!
+   * Queues f to run on any worker, counting towards done.
+   */
+  template <typename F>
+  void run(Counter& done, F&& f);
+
+  /*!
+   * Queues f to run once dependency reaches zero, counting towards done from now.
+   */
+  template <typename F>
+  void runAfter(Counter& dependency, Counter& done, F&& f);
+
+  /*!
+   * Calls f(first, last) over subranges of [begin, end) of grain items or fewer, on any workers,
+   * counting towards done. Ranges are split in halves as the jobs run, so an idle worker steals
+   * half of what's left rather than one piece at a time.
+   */
+  template <typename F>
+  void parallelFor(Counter& done, uint32_t begin, uint32_t end, uint32_t grain, F&& f);
+
+  /*!
+   * Runs jobs until counter reaches zero.
+   */
+  void wait(Counter& counter);
+
+  //! @return jobs submitted since beginFrame, including any that ran at once for lack of slots
+  uint32_t getFrameJobCount() const {
+    return nextJob_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  //! Jobs a worker's deque holds before pushing runs them at once
+  static constexpr uint32_t kDequeCapacity = 4096;
+  //! How many times an idle worker looks for jobs, yielding in between, before it sleeps
+  static constexpr uint32_t kIdleSpins = 64;
+
+  /*!
+   * A fixed size work stealing deque of Chase and Lev, with the memory orders of Lê et al.,
+   * "Correct and Efficient Work-Stealing for Weak Memory Models". The owner pushes and pops at the
+   * bottom, other workers steal from the top.
+   */
+  struct Deque {
+    alignas(64) std::atomic<int64_t> top = 0;
+    alignas(64) std::atomic<int64_t> bottom = 0;
+    alignas(64) std::array<std::atomic<Job*>, kDequeCapacity> jobs;
+
+    //! Owner only. @return false if it's full
+    bool push(Job* job);
+    //! Owner only
+    Job* pop();
+    //! Any thread. @return null if it's empty or another thread took the job first
+    Job* steal();
+  };
+
+  //! @return a free job slot, or null if the frame has used them all
+  Job* allocate();
+
+  template <typename F>
+  Job* create(Counter& done, F&& f);
+
+  //! Queues a job on the calling worker's deque
+  void submit(Job* job);
+
+  //! Adds job to counter's waiting list, or submits it if counter is done already
+  void submitAfter(Counter& counter, Job* job);
+
+  void execute(Job* job);
+
+  //! Counts a job of counter as finished, submitting the jobs waiting for it when it's the last
+  void finish(Counter& counter);
+
+  //! @return a job from worker's deque or, failing that, stolen from another's
+  Job* find(uint32_t worker, bool own);
+
+  void workerLoop(uint32_t worker);
+
+  //! @return the calling thread's worker index, or getThreadCount() if it isn't one of ours
+  uint32_t getWorker() const;
+
+  template <typename F>
+  static void runRange(JobSystem& system, Counter& done, const F& body, uint32_t begin, uint32_t end, uint32_t grain);
+
+  std::vector<Job> jobs_;
+  std::atomic<uint32_t> nextJob_ = 0;
+  std::vector<std::unique_ptr<Deque>> deques_;
+  // jobs in deques, to tell sleeping workers whether there's anything to wake for
+  std::atomic<int32_t> queued_ = 0;
+  std::atomic<uint32_t> sleeping_ = 0;
+  std::atomic<bool> stopping_ = false;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::vector<std::thread> threads_;
+};
+
+template <typename F>
+JobSystem::Job* JobSystem::create(Counter& done, F&& f) {
+  using Body = std::decay_t<F>;
+  static_assert(sizeof(Body) <= kJobDataSize, "job captures don't fit kJobDataSize");
+  static_assert(alignof(Body) <= 8, "job captures need more than 8 byte alignment");
+  static_assert(std::is_trivially_destructible_v<Body>, "jobs are reused without destroying their captures");
+  Job* job = allocate();
+  if (!job) {
+    return nullptr;
+  }
+  new (job->data) Body(std::forward<F>(f));
+  job->run = [](Job& j) { (*std::launder(reinterpret_cast<Body*>(j.data)))(); };
+  job->done = &done;
+  job->next = nullptr;
+  return job;
+}
+
+template <typename F>
+void JobSystem::run(Counter& done, F&& f) {
+  done.pending_.fetch_add(1, std::memory_order_relaxed);
+  if (Job* job = create(done, std::forward<F>(f))) {
+    submit(job);
+  } else {
+    f();
+    finish(done);
+  }
+}
+
+template <typename F>
+void JobSystem::runAfter(Counter& dependency, Counter& done, F&& f) {
+  done.pending_.fetch_add(1, std::memory_order_relaxed);
+  if (Job* job = create(done, std::forward<F>(f))) {
+    submitAfter(dependency, job);
+  } else {
+    wait(dependency);
+    f();
+    finish(done);
+  }
+}
+
+template <typename F>
+void JobSystem::runRange(JobSystem& system, Counter& done, const F& body, uint32_t begin, uint32_t end,
+                         uint32_t grain) {
+  // Hand off the upper half until what's left is small enough, then do that here
+  while (end - begin > grain) {
+    uint32_t middle = begin + (end - begin) / 2;
+    system.run(done, [&system, &done, &body, middle, end, grain] {
+      runRange(system, done, body, middle, end, grain);
+    });
+    end = middle;
+  }
+  body(begin, end);
+}
+
+template <typename F>
+void JobSystem::parallelFor(Counter& done, uint32_t begin, uint32_t end, uint32_t grain, F&& f) {
+  if (begin >= end) {
+    return;
+  }
+  grain = std::max(grain, 1u);
+  // The body is stored once, in a job slot that never runs, and the range jobs point at it
+  using Body = std::decay_t<F>;
+  static_assert(sizeof(Body) <= kJobDataSize, "parallelFor body doesn't fit kJobDataSize");
+  static_assert(alignof(Body) <= 8, "parallelFor body needs more than 8 byte alignment");
+  static_assert(std::is_trivially_destructible_v<Body>, "jobs are reused without destroying their captures");
+  Job* holder = allocate();
+  if (!holder) {
+    f(begin, end);
+    return;
+  }
+  const Body* body = new (holder->data) Body(std::forward<F>(f));
+  run(done, [this, &done, body, begin, end, grain] { runRange(*this, done, *body, begin, end, grain); });
+}
+
+#endif  // ANDROIDGLINVESTIGATIONS_JOBSYSTEM_H
@@ -0,0 +1,312 @@
+#include "Json.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+//! Nesting deeper than this is refused rather than risking the stack
+static constexpr int kMaxDepth = 64;
+
+/*!
+ * A recursive descent parser over the text, failing at the first error.
+ */
+class JsonParser {
+ public:
+  explicit JsonParser(string_view text) : text_(text) {}
+
+  bool parseDocument(JsonValue& out) {
+    if (!parseValue(out, 0)) {
+      return false;
+    }
+    skipWhitespace();
+    return pos_ == text_.size() || fail("trailing characters after the value");
+  }
+
+  const char* getError() const {
+    return error_;
+  }
+
+ private:
+  bool fail(const char* error) {
+    if (!error_) {
+      error_ = error;
+    }
+    return false;
+  }
+
+  void skipWhitespace() {
+    while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\t' || text_[pos_] == '\n' || text_[pos_] == '\r')) {
+      pos_++;
+    }
+  }
+
+  bool consume(char c) {
+    skipWhitespace();
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      pos_++;
+      return true;
+    }
+    return false;
+  }
+
+  bool consumeWord(string_view word) {
+    if (text_.substr(pos_, word.size()) != word) {
+      return false;
+    }
+    pos_ += word.size();
+    return true;
+  }
+
+  bool parseValue(JsonValue& out, int depth) {
+    if (depth > kMaxDepth) {
+      return fail("nested too deeply");
+    }
+    skipWhitespace();
+    if (pos_ == text_.size()) {
+      return fail("unexpected end of text");
+    }
+    char c = text_[pos_];
+    if (c == '{') {
+      return parseObject(out, depth);
+    }
+    if (c == '[') {
+      return parseArray(out, depth);
+    }
+    if (c == '"') {
+      out.type_ = JsonValue::Type::String;
+      return parseString(out.string_);
+    }
+    if (consumeWord("true") || consumeWord("false")) {
+      out.type_ = JsonValue::Type::Bool;
+      out.bool_ = c == 't';
+      return true;
+    }
+    if (consumeWord("null")) {
+      out.type_ = JsonValue::Type::Null;
+      return true;
+    }
+    return parseNumber(out);
+  }
+
+  bool parseObject(JsonValue& out, int depth) {
+    out.type_ = JsonValue::Type::Object;
+    pos_++;
+    if (consume('}')) {
+      return true;
+    }
+    do {
+      skipWhitespace();
+      if (pos_ == text_.size() || text_[pos_] != '"') {
+        return fail("expected a member name");
+      }
+      auto& member = out.members_.emplace_back();
+      if (!parseString(member.first)) {
+        return false;
+      }
+      if (!consume(':')) {
+        return fail("expected ':' after a member name");
+      }
+      if (!parseValue(member.second, depth + 1)) {
+        return false;
+      }
+    } while (consume(','));
+    return consume('}') || fail("expected ',' or '}' in an object");
+  }
+
+  bool parseArray(JsonValue& out, int depth) {
+    out.type_ = JsonValue::Type::Array;
+    pos_++;
+    if (consume(']')) {
+      return true;
+    }
+    do {
+      if (!parseValue(out.elements_.emplace_back(), depth + 1)) {
+        return false;
+      }
+    } while (consume(','));
+    return consume(']') || fail("expected ',' or ']' in an array");
+  }
+
+  bool parseNumber(JsonValue& out) {
+    // strtod accepts more than JSON does (hex, inf, leading +), so check the shape first
+    size_t start = pos_;
+    auto digits = [this]() {
+      size_t first = pos_;
+      while (pos_ < text_.size() && text_[pos_] >= '0' && text_[pos_] <= '9') {
+        pos_++;
+      }
+      return pos_ > first;
+    };
+    if (pos_ < text_.size() && text_[pos_] == '-') {
+      pos_++;
+    }
+    if (!digits()) {
+      return fail("unexpected character");
+    }
+    if (pos_ < text_.size() && text_[pos_] == '.') {
+      pos_++;
+      if (!digits()) {
+        return fail("expected digits after '.'");
+      }
+    }
+    if (pos_ < text_.size() && (text_[pos_] == 'e' || text_[pos_] == 'E')) {
+      pos_++;
+      if (pos_ < text_.size() && (text_[pos_] == '+' || text_[pos_] == '-')) {
+        pos_++;
+      }
+      if (!digits()) {
+        return fail("expected digits in an exponent");
+      }
+    }
+    string number(text_.substr(start, pos_ - start));
+    out.type_ = JsonValue::Type::Number;
+    out.number_ = strtod(number.c_str(), nullptr);
+    return true;
+  }
+
+  bool parseHex4(uint32_t& out) {
+    if (text_.size() - pos_ < 4) {
+      return fail("truncated \\u escape");
+    }
+    out = 0;
+    for (int i = 0; i < 4; i++) {
+      char c = text_[pos_++];
+      uint32_t digit;
+      if (c >= '0' && c <= '9') {
+        digit = c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        digit = c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        digit = c - 'A' + 10;
+      } else {
+        return fail("bad \\u escape");
+      }
+      out = out << 4 | digit;
+    }
+    return true;
+  }
+
+  static void appendUtf8(string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+      out += char(codePoint);
+    } else if (codePoint < 0x800) {
+      out += char(0xc0 | codePoint >> 6);
+      out += char(0x80 | (codePoint & 0x3f));
+    } else if (codePoint < 0x10000) {
+      out += char(0xe0 | codePoint >> 12);
+      out += char(0x80 | (codePoint >> 6 & 0x3f));
+      out += char(0x80 | (codePoint & 0x3f));
+    } else {
+      out += char(0xf0 | codePoint >> 18);
+      out += char(0x80 | (codePoint >> 12 & 0x3f));
+      out += char(0x80 | (codePoint >> 6 & 0x3f));
+      out += char(0x80 | (codePoint & 0x3f));
+    }
+  }
+
+  bool parseString(string& out) {
+    pos_++;
+    while (pos_ < text_.size()) {
+      // copy the run up to the next quote or escape in one go
+      size_t end = text_.find_first_of("\"\\", pos_);
+      if (end == string_view::npos) {
+        break;
+      }
+      out.append(text_.substr(pos_, end - pos_));
+      pos_ = end + 1;
+      if (text_[end] == '"') {
+        return true;
+      }
+      if (pos_ == text_.size()) {
+        break;
+      }
+      char escape = text_[pos_++];
+      switch (escape) {
+        case '"':
+        case '\\':
+        case '/':
+          out += escape;
+          break;
+        case 'b':
+          out += '\b';
+          break;
+        case 'f':
+          out += '\f';
+          break;
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        case 'u': {
+          uint32_t codePoint;
+          if (!parseHex4(codePoint)) {
+            return false;
+          }
+          // a high surrogate pairs with the low one escaped after it
+          if (codePoint >= 0xd800 && codePoint < 0xdc00 && consumeWord("\\u")) {
+            uint32_t low;
+            if (!parseHex4(low)) {
+              return false;
+            }
+            if (low < 0xdc00 || low >= 0xe000) {
+              return fail("unpaired surrogate");
+            }
+            codePoint = 0x10000 + ((codePoint - 0xd800) << 10) + (low - 0xdc00);
+          }
+          appendUtf8(out, codePoint);
+          break;
+        }
+        default:
+          return fail("bad escape in a string");
+      }
+    }
+    return fail("unterminated string");
+  }
+
+  string_view text_;
+  size_t pos_ = 0;
+  const char* error_ = nullptr;
+};
+
+bool JsonValue::parse(string_view text, JsonValue& out, const char** error) {
+  out = JsonValue();
+  JsonParser parser(text);
+  if (!parser.parseDocument(out)) {
+    if (error) {
+      *error = parser.getError();
+    }
+    out = JsonValue();
+    return false;
+  }
+  return true;
+}
+
+uint32_t JsonValue::getUint(uint32_t fallback) const {
+  if (type_ != Type::Number || number_ < 0 || number_ > 4294967295.0 || floor(number_) != number_) {
+    return fallback;
+  }
+  return uint32_t(number_);
+}
+
+static const JsonValue kNull;
+
+const JsonValue& JsonValue::operator[](size_t index) const {
+  return type_ == Type::Array && index < elements_.size() ? elements_[index] : kNull;
+}
+
+const JsonValue& JsonValue::operator[](string_view key) const {
+  if (type_ == Type::Object) {
+    for (const auto& [name, value] : members_) {
+      if (name == key) {
+        return value;
+      }
+    }
+  }
+  return kNull;
+}
@@ -0,0 +1,81 @@
+#ifndef ANDROIDGLINVESTIGATIONS_JSON_H
+#define ANDROIDGLINVESTIGATIONS_JSON_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/*!
+ * A parsed JSON document, just enough of one for the glTF loader. There are no GL or Android
+ * dependencies, so host tools can share it.
+ *
+ * Lookups never fail: a missing member, an index past the end or a value of the wrong type reads
+ * as null, and the getters return their fallback for it. So a chain like
+ * json["materials"][0]["pbrMetallicRoughness"]["baseColorTexture"]["index"].getUint(~0u) needs no
+ * checks in between.
+ */
+class JsonValue {
+ public:
+  enum class Type { Null, Bool, Number, String, Array, Object };
+
+  /*!
+   * Parses text, which must be one value with nothing but whitespace around it.
+   * @param error set to why parsing failed, if it did
+   */
+  static bool parse(std::string_view text, JsonValue& out, const char** error = nullptr);
+
+  Type getType() const {
+    return type_;
+  }
+
+  bool isNull() const {
+    return type_ == Type::Null;
+  }
+
+  bool getBool(bool fallback = false) const {
+    return type_ == Type::Bool ? bool_ : fallback;
+  }
+
+  double getNumber(double fallback = 0) const {
+    return type_ == Type::Number ? number_ : fallback;
+  }
+
+  /*!
+   * @return the number if it's a whole number in range, otherwise fallback
+   */
+  uint32_t getUint(uint32_t fallback = 0) const;
+
+  std::string_view getString(std::string_view fallback = {}) const {
+    return type_ == Type::String ? std::string_view(string_) : fallback;
+  }
+
+  //! @return the element count of an array or the member count of an object, otherwise 0
+  size_t size() const {
+    return type_ == Type::Array ? elements_.size() : type_ == Type::Object ? members_.size() : 0;
+  }
+
+  std::span<const JsonValue> getElements() const {
+    return type_ == Type::Array ? std::span<const JsonValue>(elements_) : std::span<const JsonValue>();
+  }
+
+  const JsonValue& operator[](size_t index) const;
+
+  //! Members are searched in order, glTF objects are small
+  const JsonValue& operator[](std::string_view key) const;
+
+ private:
+  friend class JsonParser;
+
+  Type type_ = Type::Null;
+  bool bool_ = false;
+  double number_ = 0;
+  std::string string_;
+  std::vector<JsonValue> elements_;
+  std::vector<std::pair<std::string, JsonValue>> members_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_JSON_H
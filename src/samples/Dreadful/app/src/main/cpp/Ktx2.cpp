@@ -0,0 +1,96 @@
+#include "Ktx2.h"
+
+#include <cstring>
+
+uint64_t Ktx2Texture::getImageSize(uint32_t vkFormat, uint32_t width, uint32_t height) {
+  // ASTC block footprints, in the order of the VkFormat values
+  static constexpr uint8_t kAstcBlocks[14][2] = {{4, 4}, {5, 4},  {5, 5},  {6, 5},   {6, 6},   {8, 5},   {8, 6},
+                                                 {8, 8}, {10, 5}, {10, 6}, {10, 8}, {10, 10}, {12, 10}, {12, 12}};
+  uint32_t blockWidth = 4;
+  uint32_t blockHeight = 4;
+  uint32_t blockBytes = 16;
+  switch (vkFormat) {
+    case kVkFormatR8G8B8A8Unorm:
+    case kVkFormatR8G8B8A8Srgb:
+      return uint64_t(width) * height * 4;
+    case kVkFormatEtc2R8G8B8UnormBlock:
+    case kVkFormatEtc2R8G8B8SrgbBlock:
+    case kVkFormatEtc2R8G8B8A1UnormBlock:
+    case kVkFormatEtc2R8G8B8A1SrgbBlock:
+    case kVkFormatEacR11UnormBlock:
+    case kVkFormatEacR11SnormBlock:
+      blockBytes = 8;
+      break;
+    case kVkFormatEtc2R8G8B8A8UnormBlock:
+    case kVkFormatEtc2R8G8B8A8SrgbBlock:
+    case kVkFormatEacR11G11UnormBlock:
+    case kVkFormatEacR11G11SnormBlock:
+      break;
+    default:
+      if (vkFormat < kVkFormatAstc4x4UnormBlock || vkFormat > kVkFormatAstc12x12SrgbBlock) {
+        return 0;
+      }
+      blockWidth = kAstcBlocks[(vkFormat - kVkFormatAstc4x4UnormBlock) / 2][0];
+      blockHeight = kAstcBlocks[(vkFormat - kVkFormatAstc4x4UnormBlock) / 2][1];
+      break;
+  }
+  uint64_t blocksX = (uint64_t(width) + blockWidth - 1) / blockWidth;
+  uint64_t blocksY = (uint64_t(height) + blockHeight - 1) / blockHeight;
+  return blocksX * blocksY * blockBytes;
+}
+
+bool Ktx2Texture::parse(const uint8_t* data, size_t size, Ktx2Texture& out, const char** error) {
+  auto fail = [error](const char* message) {
+    if (error) {
+      *error = message;
+    }
+    return false;
+  };
+
+  if (size < sizeof(Ktx2Header) || memcmp(data, kKtx2Identifier, sizeof(kKtx2Identifier)) != 0) {
+    return fail("not a KTX2 file");
+  }
+  memcpy(&out.header, data, sizeof(Ktx2Header));
+  const auto& h = out.header;
+  if (h.supercompressionScheme != kKtx2SupercompressionNone) {
+    return fail("supercompressed KTX2 files are not supported");
+  }
+  if (h.pixelWidth == 0 || h.pixelHeight == 0 || h.pixelDepth > 1) {
+    return fail("only 2D textures are supported");
+  }
+  if (h.faceCount != 1) {
+    return fail("cube textures are not supported");
+  }
+
+  // a level count of 0 asks the loader to generate mips, there's still one level stored
+  uint32_t levelCount = h.levelCount ? h.levelCount : 1;
+  size_t indexEnd = sizeof(Ktx2Header) + levelCount * sizeof(Ktx2Level);
+  if (levelCount > 32 || indexEnd > size) {
+    return fail("truncated level index");
+  }
+  out.levels.resize(levelCount);
+  memcpy(out.levels.data(), data + sizeof(Ktx2Header), levelCount * sizeof(Ktx2Level));
+  for (const auto& level : out.levels) {
+    if (level.byteLength == 0 || level.byteOffset > size || level.byteLength > size - level.byteOffset) {
+      return fail("level data out of bounds");
+    }
+  }
+  // The loaders upload, and generate mips from, as many bytes as the format and size take, so a
+  // level holding any other amount is refused rather than read past
+  uint32_t layerCount = out.getLayerCount();
+  for (uint32_t i = 0; i < levelCount; i++) {
+    uint64_t imageSize = getImageSize(h.vkFormat, out.getLevelWidth(i), out.getLevelHeight(i));
+    if (imageSize == 0) {
+      return fail("unsupported vkFormat");
+    }
+    // divided, since imageSize * layerCount can overflow
+    uint64_t byteLength = out.levels[i].byteLength;
+    if (byteLength % layerCount != 0 || byteLength / layerCount != imageSize) {
+      return fail("level size doesn't match the format and dimensions");
+    }
+  }
+
+  out.data = data;
+  out.size = size;
+  return true;
+}
@@ -0,0 +1,149 @@
+#ifndef ANDROIDGLINVESTIGATIONS_KTX2_H
+#define ANDROIDGLINVESTIGATIONS_KTX2_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * The parts of the KTX 2.0 container (https://registry.khronos.org/KTX/specs/2.0/ktxspec.v2.html)
+ * this sample reads and src/tools/ktx2conv writes. This header has no GL or Android dependencies so
+ * the host tool can share it.
+ */
+
+static constexpr uint8_t kKtx2Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'};
+
+struct Ktx2Header {
+  uint8_t identifier[12];
+  uint32_t vkFormat;
+  uint32_t typeSize;
+  uint32_t pixelWidth;
+  uint32_t pixelHeight;
+  uint32_t pixelDepth;
+  uint32_t layerCount;
+  uint32_t faceCount;
+  uint32_t levelCount;
+  uint32_t supercompressionScheme;
+  // index
+  uint32_t dfdByteOffset;
+  uint32_t dfdByteLength;
+  uint32_t kvdByteOffset;
+  uint32_t kvdByteLength;
+  uint64_t sgdByteOffset;
+  uint64_t sgdByteLength;
+};
+static_assert(sizeof(Ktx2Header) == 80, "KTX2 header is 80 bytes");
+
+//! One entry of the level index, which follows the header. Level 0 is the largest.
+struct Ktx2Level {
+  uint64_t byteOffset;
+  uint64_t byteLength;
+  uint64_t uncompressedByteLength;
+};
+static_assert(sizeof(Ktx2Level) == 24, "KTX2 level index entries are 24 bytes");
+
+//! The VkFormat values we know how to upload
+enum Ktx2VkFormat : uint32_t {
+  kVkFormatR8G8B8A8Unorm = 37,
+  kVkFormatR8G8B8A8Srgb = 43,
+  kVkFormatEtc2R8G8B8UnormBlock = 147,
+  kVkFormatEtc2R8G8B8SrgbBlock = 148,
+  kVkFormatEtc2R8G8B8A1UnormBlock = 149,
+  kVkFormatEtc2R8G8B8A1SrgbBlock = 150,
+  kVkFormatEtc2R8G8B8A8UnormBlock = 151,
+  kVkFormatEtc2R8G8B8A8SrgbBlock = 152,
+  kVkFormatEacR11UnormBlock = 153,
+  kVkFormatEacR11SnormBlock = 154,
+  kVkFormatEacR11G11UnormBlock = 155,
+  kVkFormatEacR11G11SnormBlock = 156,
+  // ASTC 4x4 through 12x12, UNORM and SRGB alternating
+  kVkFormatAstc4x4UnormBlock = 157,
+  kVkFormatAstc12x12SrgbBlock = 184,
+};
+
+//! Only uncompressed data is supported
+static constexpr uint32_t kKtx2SupercompressionNone = 0;
+
+// Data format descriptor values used by ktx2conv
+static constexpr uint32_t kKhrDfModelRgbsda = 1;
+static constexpr uint32_t kKhrDfModelEtc2 = 161;
+static constexpr uint32_t kKhrDfPrimariesBt709 = 1;
+static constexpr uint32_t kKhrDfTransferLinear = 1;
+static constexpr uint32_t kKhrDfTransferSrgb = 2;
+static constexpr uint32_t kKhrDfChannelEtc2Color = 2;
+static constexpr uint32_t kKhrDfChannelEtc2Alpha = 15;
+static constexpr uint32_t kKhrDfFlagAlphaPremultiplied = 1;
+
+/*!
+ * A KTX2 file in memory, validated and with its level index read. Doesn't own the data.
+ */
+struct Ktx2Texture {
+  Ktx2Header header;
+  std::vector<Ktx2Level> levels;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  /*!
+   * Checks the header and level index of a 2D or 2D array texture.
+   * @param error receives a description of the problem on failure
+   * @return true if out describes a usable texture
+   */
+  static bool parse(const uint8_t* data, size_t size, Ktx2Texture& out, const char** error);
+
+  /*!
+   * @return the bytes one width x height image takes in vkFormat, whole blocks for compressed
+   * formats, or 0 if it isn't one of the Ktx2VkFormat values
+   */
+  static uint64_t getImageSize(uint32_t vkFormat, uint32_t width, uint32_t height);
+
+  uint32_t getLevelWidth(uint32_t level) const {
+    uint32_t w = header.pixelWidth >> level;
+    return w ? w : 1;
+  }
+
+  uint32_t getLevelHeight(uint32_t level) const {
+    uint32_t h = header.pixelHeight >> level;
+    return h ? h : 1;
+  }
+
+  //! 0 in the header means not an array, which still stores one image per level
+  uint32_t getLayerCount() const {
+    return header.layerCount ? header.layerCount : 1;
+  }
+
+  bool isArray() const {
+    return header.layerCount > 0;
+  }
+
+  /*!
+   * @return true if the data format descriptor says color is premultiplied by alpha
+   */
+  bool isPremultiplied() const {
+    // the flags are the last byte of the first word of the basic descriptor block
+    size_t flags = header.dfdByteOffset + 15;
+    return header.dfdByteLength >= 16 && flags < size && (data[flags] & kKhrDfFlagAlphaPremultiplied) != 0;
+  }
+
+  /*!
+   * @return true for formats with a full alpha channel whose color isn't premultiplied, which
+   * blend wrongly with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+   */
+  bool hasStraightAlpha() const {
+    switch (header.vkFormat) {
+      case kVkFormatR8G8B8A8Unorm:
+      case kVkFormatR8G8B8A8Srgb:
+      case kVkFormatEtc2R8G8B8A8UnormBlock:
+      case kVkFormatEtc2R8G8B8A8SrgbBlock:
+        return !isPremultiplied();
+      default:
+        return false;
+    }
+  }
+
+  //! Every layer of the level, one after the other
+  const uint8_t* getLevelData(uint32_t level) const {
+    return data + levels[level].byteOffset;
+  }
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_KTX2_H
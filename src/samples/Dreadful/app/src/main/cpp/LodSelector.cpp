@@ -0,0 +1,107 @@
+#include "LodSelector.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+//! Views nearer a sphere than this, or inside it, see it at full detail
+static constexpr float kMinDistance = 1e-3f;
+
+LodSelector::View LodSelector::View::fromFov(const r3::Vec3f& position, float angleUp, float angleDown,
+                                             uint32_t heightPixels) {
+  View view;
+  view.position = position;
+  view.pixelsPerUnit = float(heightPixels) / (tan(angleUp) - tan(angleDown));
+  view.perspective = true;
+  return view;
+}
+
+LodSelector::View LodSelector::View::orthographic(float halfHeight, uint32_t heightPixels) {
+  View view;
+  view.pixelsPerUnit = float(heightPixels) / (2 * halfHeight);
+  view.perspective = false;
+  return view;
+}
+
+uint32_t LodSelector::selectLod(const Mesh::Submesh& submesh, float pixelsPerUnit, uint32_t current) const {
+  // Errors grow with the level, so the first one over the limit ends the search
+  uint32_t level = 0;
+  for (uint32_t l = 1; l < submesh.getLodCount(); l++) {
+    float limit = config_.maxPixelError * (l > current ? 1 - config_.hysteresis : 1);
+    if (submesh.lods[l - 1].error * pixelsPerUnit > limit) {
+      break;
+    }
+    level = l;
+  }
+  return level;
+}
+
+void LodSelector::update(span<const Model> models, span<const View> views, const SceneGraph& scene) {
+  frame_++;
+  current_.resize(models.size());
+  size_t seen = 0;
+  triangles_ = 0;
+  fullTriangles_ = 0;
+  for (size_t m = 0; m < models.size(); m++) {
+    const auto& model = models[m];
+    const auto& submesh = model.getSubmesh();
+    auto& state = states_[{&model.getMesh(), model.getSubmeshIndex(), model.getNode()}];
+    current_[m] = &state;
+    // A model listed twice steps once
+    if (state.frame != frame_) {
+      state.frame = frame_;
+      seen++;
+      step(state, model, views, scene);
+    }
+    for (uint32_t d = 0; d < state.drawCount; d++) {
+      triangles_ += submesh.getLod(state.draws[d].lod).indexCount / 3;
+    }
+    fullTriangles_ += submesh.indexCount / 3;
+  }
+
+  // Forget models that are gone
+  if (states_.size() > seen) {
+    erase_if(states_, [this](const auto& entry) { return entry.second.frame != frame_; });
+  }
+}
+
+void LodSelector::step(State& state, const Model& model, span<const View> views, const SceneGraph& scene) const {
+  const auto& submesh = model.getSubmesh();
+  if (state.fade < 1) {
+    state.fade = min(state.fade + 1.f / float(config_.fadeFrames), 1.f);
+  }
+
+  // A fade finishes before the next switch starts
+  if (state.fade >= 1 && submesh.getLodCount() > 1) {
+    // The same world bounds as Renderer::cullModels. World poses are rigid, so the radius holds.
+    auto bounds = submesh.bounds;
+    if (model.getNode() != SceneGraph::kNoNode) {
+      bounds.center = scene.getWorld(model.getNode()).Transform(bounds.center);
+    }
+    // without a view, nothing can be judged too small
+    float pixelsPerUnit = views.empty() ? HUGE_VALF : 0.f;
+    for (const auto& view : views) {
+      float scale = view.pixelsPerUnit;
+      if (view.perspective) {
+        float distance = (bounds.center - view.position).Length() - bounds.radius;
+        scale /= max(distance, kMinDistance);
+      }
+      pixelsPerUnit = max(pixelsPerUnit, scale);
+    }
+    uint32_t lod = selectLod(submesh, pixelsPerUnit, state.lod);
+    if (lod != state.lod) {
+      state.previousLod = state.lod;
+      state.lod = lod;
+      // the new level starts a step in, since 0 would draw it whole
+      state.fade = config_.fadeFrames ? 1.f / float(config_.fadeFrames) : 1.f;
+    }
+  }
+
+  state.draws[0] = {state.lod, state.fade < 1 ? state.fade : 0.f};
+  state.drawCount = 1;
+  if (state.fade < 1) {
+    state.draws[1] = {state.previousLod, -state.fade};
+    state.drawCount = 2;
+  }
+}
@@ -0,0 +1,134 @@
+#ifndef ANDROIDGLINVESTIGATIONS_LODSELECTOR_H
+#define ANDROIDGLINVESTIGATIONS_LODSELECTOR_H
+
+#include <cstdint>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+#include "Model.h"
+#include "SceneGraph.h"
+#include "linear.h"
+
+/*!
+ * Picks a level of detail for each model every frame (see Mesh::Lod), the coarsest whose error
+ * covers at most maxPixelError pixels on screen. The error is projected at the nearest point of
+ * the submesh's bounding sphere, placed in the world by the model's scene node, in whichever view
+ * sees it largest, so both eyes of a stereo pair draw the same level.
+ *
+ * A model only moves to a coarser level once that level's error is under the limit by the
+ * hysteresis margin, so one sitting at a threshold doesn't flip between levels. With fadeFrames
+ * set, a switch cross-fades over that many frames: both levels draw, each covering the pixels of
+ * a dither pattern the other leaves, as the uFade uniform of the sample's shader describes.
+ */
+class LodSelector {
+ public:
+  struct Config {
+    float maxPixelError = 1.f;
+    // how far under maxPixelError a coarser level has to be, as a fraction of it
+    float hysteresis = 0.25f;
+    // 0 switches at once
+    uint32_t fadeFrames = 0;
+  };
+
+  struct View {
+    r3::Vec3f position;
+    // pixels a unit spans at distance 1 for perspective views, at any distance for orthographic ones
+    float pixelsPerUnit = 0;
+    bool perspective = true;
+
+    /*!
+     * A perspective view from the up and down angles of an XrFovf, in radians.
+     * @param heightPixels the height of the image the view renders
+     */
+    static View fromFov(const r3::Vec3f& position, float angleUp, float angleDown, uint32_t heightPixels);
+
+    /*!
+     * An orthographic view showing halfHeight units either side of its center.
+     */
+    static View orthographic(float halfHeight, uint32_t heightPixels);
+  };
+
+  //! A level to draw and the shader's uFade for it: 0 to draw it whole, > 0 fading in, < 0 fading out
+  struct Draw {
+    uint32_t lod = 0;
+    float fade = 0;
+  };
+
+  explicit LodSelector(const Config& config) : config_(config) {}
+
+  /*!
+   * Picks the levels for this frame. Models are tracked by their mesh, submesh and node, so they
+   * keep their levels and fades when others are added or removed or the list is reordered; a model
+   * that's new starts at full detail.
+   * @param scene holds the models' nodes, updated for this frame
+   */
+  void update(std::span<const Model> models, std::span<const View> views, const SceneGraph& scene);
+
+  //! @return what to draw of models[model] of the last update, one level or two while they cross-fade
+  std::span<const Draw> getDraws(size_t model) const {
+    const auto& state = *current_[model];
+    return {state.draws, state.drawCount};
+  }
+
+  //! @return the triangles the levels picked by the last update have, counting both of a fade
+  size_t getTriangleCount() const {
+    return triangles_;
+  }
+
+  //! @return the triangles the models have at full detail
+  size_t getFullTriangleCount() const {
+    return fullTriangles_;
+  }
+
+  /*!
+   * @param pixelsPerUnit how many pixels a unit spans where the submesh is nearest
+   * @param current the level drawn now
+   * @return the level to draw
+   */
+  uint32_t selectLod(const Mesh::Submesh& submesh, float pixelsPerUnit, uint32_t current) const;
+
+ private:
+  //! What identifies a model from one frame to the next
+  struct ModelKey {
+    const Mesh* mesh;
+    uint32_t submesh;
+    SceneGraph::Node node;
+
+    bool operator==(const ModelKey&) const = default;
+  };
+
+  struct ModelKeyHash {
+    // Mixed in 64 bits and folded down, since size_t is 32 bits on armeabi-v7a and x86
+    size_t operator()(const ModelKey& key) const {
+      uint64_t h = ((uint64_t(key.submesh) << 32) | key.node) * 0x9e3779b97f4a7c15ull;
+      h ^= uint64_t(reinterpret_cast<uintptr_t>(key.mesh)) * 0xc2b2ae3d27d4eb4full;
+      return size_t(h ^ (h >> 32));
+    }
+  };
+
+  struct State {
+    uint32_t lod = 0;
+    // the level fading out, while fade < 1
+    uint32_t previousLod = 0;
+    float fade = 1;
+    Draw draws[2];
+    uint32_t drawCount = 1;
+    // the update that last saw the model
+    uint64_t frame = 0;
+  };
+
+  //! Advances a model's fade and picks its next level
+  void step(State& state, const Model& model, std::span<const View> views, const SceneGraph& scene) const;
+
+  Config config_;
+  // node based, so the pointers in current_ stay valid as models come and go
+  std::unordered_map<ModelKey, State, ModelKeyHash> states_;
+  // by index into the models of the last update
+  std::vector<const State*> current_;
+  uint64_t frame_ = 0;
+  size_t triangles_ = 0;
+  size_t fullTriangles_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_LODSELECTOR_H
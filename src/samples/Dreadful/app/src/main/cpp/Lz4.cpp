@@ -0,0 +1,172 @@
+#include "Lz4.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+static constexpr size_t kMinMatch = 4;
+// A block ends with at least this many literals
+static constexpr size_t kLastLiterals = 5;
+// and no match starts within this many bytes of its end
+static constexpr size_t kMatchStartLimit = 12;
+static constexpr size_t kMaxOffset = 65535;
+static constexpr int kHashBits = 16;
+
+static uint32_t read32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static uint32_t hashSequence(uint32_t sequence) {
+  return (sequence * 2654435761u) >> (32 - kHashBits);
+}
+
+//! Writes what's left of a length after its token nibble of 15
+static uint8_t* writeLength(uint8_t* op, size_t length) {
+  for (; length >= 255; length -= 255) {
+    *op++ = 255;
+  }
+  *op++ = uint8_t(length);
+  return op;
+}
+
+size_t lz4CompressBound(size_t size) {
+  return size + size / 255 + 16;
+}
+
+size_t lz4Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity) {
+  uint8_t* op = dst;
+  uint8_t* end = dst + capacity;
+
+  // One sequence: literals, then a match unless it's the last one
+  auto emit = [&](const uint8_t* literals, size_t literalCount, size_t offset, size_t matchLength) {
+    size_t worst = 1 + literalCount / 255 + 1 + literalCount + 2 + matchLength / 255 + 1;
+    if (size_t(end - op) < worst) {
+      return false;
+    }
+    uint8_t* token = op++;
+    *token = uint8_t(min<size_t>(literalCount, 15) << 4);
+    if (literalCount >= 15) {
+      op = writeLength(op, literalCount - 15);
+    }
+    memcpy(op, literals, literalCount);
+    op += literalCount;
+    if (matchLength) {
+      *op++ = uint8_t(offset);
+      *op++ = uint8_t(offset >> 8);
+      size_t extra = matchLength - kMinMatch;
+      *token |= uint8_t(min<size_t>(extra, 15));
+      if (extra >= 15) {
+        op = writeLength(op, extra - 15);
+      }
+    }
+    return true;
+  };
+
+  // Position + 1 of the last sequence seen with each hash, 0 for none
+  vector<uint32_t> table(size_t(1) << kHashBits, 0);
+  size_t anchor = 0;
+  size_t ip = 0;
+  if (size > kMatchStartLimit) {
+    size_t matchStartEnd = size - kMatchStartLimit;
+    size_t matchEnd = size - kLastLiterals;
+    while (ip < matchStartEnd) {
+      uint32_t sequence = read32(src + ip);
+      uint32_t h = hashSequence(sequence);
+      size_t candidate = table[h];
+      table[h] = uint32_t(ip + 1);
+      if (candidate == 0 || ip - (candidate - 1) > kMaxOffset || read32(src + candidate - 1) != sequence) {
+        ip++;
+        continue;
+      }
+      size_t match = candidate - 1;
+      // extend back over literals, then forward as far as the end rules allow
+      while (ip > anchor && match > 0 && src[ip - 1] == src[match - 1]) {
+        ip--;
+        match--;
+      }
+      size_t length = kMinMatch;
+      while (ip + length < matchEnd && src[ip + length] == src[match + length]) {
+        length++;
+      }
+      if (!emit(src + anchor, ip - anchor, ip - match, length)) {
+        return 0;
+      }
+      ip += length;
+      anchor = ip;
+    }
+  }
+  if (!emit(src + anchor, size - anchor, 0, 0)) {
+    return 0;
+  }
+  return size_t(op - dst);
+}
+
+bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) {
+  const uint8_t* ip = src;
+  const uint8_t* ipEnd = src + srcSize;
+  uint8_t* op = dst;
+  uint8_t* opEnd = dst + dstSize;
+
+  auto readLength = [&](size_t& length) {
+    uint8_t b;
+    do {
+      if (ip >= ipEnd) {
+        return false;
+      }
+      b = *ip++;
+      length += b;
+    } while (b == 255);
+    return true;
+  };
+
+  while (op < opEnd) {
+    if (ip >= ipEnd) {
+      return false;
+    }
+    uint8_t token = *ip++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !readLength(literals)) {
+      return false;
+    }
+    if (literals > size_t(ipEnd - ip)) {
+      return false;
+    }
+    size_t copy = min(literals, size_t(opEnd - op));
+    memcpy(op, ip, copy);
+    op += copy;
+    ip += literals;
+    if (op == opEnd) {
+      break;
+    }
+
+    // Only the last sequence has no match, and the output isn't full yet
+    if (ipEnd - ip < 2) {
+      return false;
+    }
+    size_t offset = ip[0] | ip[1] << 8;
+    ip += 2;
+    if (offset == 0 || offset > size_t(op - dst)) {
+      return false;
+    }
+    size_t length = token & 15;
+    if (length == 15 && !readLength(length)) {
+      return false;
+    }
+    length = min(length + kMinMatch, size_t(opEnd - op));
+    const uint8_t* match = op - offset;
+    if (offset >= length) {
+      memcpy(op, match, length);
+    } else {
+      // overlapping, the match repeats bytes it's writing
+      for (size_t i = 0; i < length; i++) {
+        op[i] = match[i];
+      }
+    }
+    op += length;
+  }
+  return true;
+}
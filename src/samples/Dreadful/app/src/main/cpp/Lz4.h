@@ -0,0 +1,31 @@
+#ifndef ANDROIDGLINVESTIGATIONS_LZ4_H
+#define ANDROIDGLINVESTIGATIONS_LZ4_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * The LZ4 block format (https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md), used for
+ * entries of asset packs. Decompression runs on device, compression in src/tools/assetpack; there
+ * are no GL or Android dependencies so both share this file.
+ */
+
+/*!
+ * @return the most bytes lz4Compress can produce for size input bytes
+ */
+size_t lz4CompressBound(size_t size);
+
+/*!
+ * Compresses src as a single block with a greedy hash chain of one, like the reference fast mode.
+ * @return the compressed size, or 0 if it doesn't fit in capacity
+ */
+size_t lz4Compress(const uint8_t* src, size_t size, uint8_t* dst, size_t capacity);
+
+/*!
+ * Decompresses a block, stopping once dstSize bytes are written. Passing less than the full size
+ * decodes just a prefix, e.g. a file header, without touching the rest.
+ * @return false if the block is malformed or ends before dstSize bytes
+ */
+bool lz4Decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize);
+
+#endif  // ANDROIDGLINVESTIGATIONS_LZ4_H
@@ -0,0 +1,279 @@
+#include "Mesh.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "AndroidOut.h"
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+
+using namespace std;
+
+static_assert(sizeof(Vertex) == 5 * sizeof(float), "Vertex is the kMeshVertexFormatPositionUv layout");
+
+static GLenum getGlType(VertexComponentType type) {
+  switch (type) {
+    case VertexComponentType::Half:
+      return GL_HALF_FLOAT;
+    case VertexComponentType::Snorm16:
+      return GL_SHORT;
+    case VertexComponentType::Unorm16:
+      return GL_UNSIGNED_SHORT;
+    case VertexComponentType::Unorm8:
+      return GL_UNSIGNED_BYTE;
+    default:
+      return GL_FLOAT;
+  }
+}
+
+static BoundingSphere computeVertexBounds(span<const Vertex> vertices) {
+  vector<Vector3> positions;
+  positions.reserve(vertices.size());
+  for (const auto& v : vertices) {
+    positions.push_back(v.position);
+  }
+  return computeBoundingSphere<Vector3>(positions);
+}
+
+shared_ptr<Mesh> Mesh::create(span<const Vertex> vertices, span<const Index> indices, bool keepCpuCopy) {
+  if (vertices.empty() || indices.empty()) {
+    return nullptr;
+  }
+
+  shared_ptr<Mesh> mesh(new Mesh());
+  mesh->bounds_ = computeVertexBounds(vertices);
+
+  Submesh whole;
+  whole.indexCount = static_cast<uint32_t>(indices.size());
+  whole.format = VertexFormat::fromFlags(kMeshVertexFormatPositionUv);
+  whole.bounds = mesh->bounds_;
+  mesh->submeshes_.push_back(whole);
+
+  mesh->upload(vertices.data(), vertices.size(), vertices.size_bytes(), indices.data(), indices.size(),
+               indices.size_bytes());
+
+  if (keepCpuCopy) {
+    mesh->vertices_.assign(vertices.begin(), vertices.end());
+    mesh->indices_.assign(indices.begin(), indices.end());
+  }
+  return mesh;
+}
+
+shared_ptr<Mesh> Mesh::create(span<const Vertex> vertices, span<const uint32_t> indices, bool keepCpuCopy,
+                              bool split) {
+  if (vertices.empty() || indices.empty()) {
+    return nullptr;
+  }
+
+  shared_ptr<Mesh> mesh(new Mesh());
+  mesh->bounds_ = computeVertexBounds(vertices);
+  auto format = VertexFormat::fromFlags(kMeshVertexFormatPositionUv);
+
+  uint32_t maxIndex = *max_element(indices.begin(), indices.end());
+  if (maxIndex < MeshOptimizer::kMaxShortIndexVertices) {
+    // Everything fits in 16 bits, which halves the index fetch bandwidth
+    vector<Index> narrow(indices.begin(), indices.end());
+    Submesh whole;
+    whole.indexCount = static_cast<uint32_t>(indices.size());
+    whole.format = format;
+    whole.bounds = mesh->bounds_;
+    mesh->submeshes_.push_back(whole);
+    mesh->upload(vertices.data(), vertices.size(), vertices.size_bytes(), narrow.data(), narrow.size(),
+                 narrow.size() * sizeof(Index));
+  } else if (!split) {
+    Submesh whole;
+    whole.indexCount = static_cast<uint32_t>(indices.size());
+    whole.indexType = GL_UNSIGNED_INT;
+    whole.format = format;
+    whole.bounds = mesh->bounds_;
+    mesh->submeshes_.push_back(whole);
+    mesh->upload(vertices.data(), vertices.size(), vertices.size_bytes(), indices.data(), indices.size(),
+                 indices.size_bytes());
+  } else {
+    // Morton order suits culling but not the post-transform cache, so each chunk is reordered again
+    vector<uint32_t> chunked(indices.begin(), indices.end());
+    vector<uint8_t> chunkVertices;
+    auto chunks = MeshOptimizer::splitIntoChunks(reinterpret_cast<const uint8_t*>(vertices.data()), vertices.size(),
+                                                 sizeof(Vertex), chunked, chunkVertices);
+    span<const Vertex> copies(reinterpret_cast<const Vertex*>(chunkVertices.data()),
+                              chunkVertices.size() / sizeof(Vertex));
+    for (const auto& chunk : chunks) {
+      MeshOptimizer::optimizeVertexCache(span(chunked).subspan(chunk.firstIndex, chunk.indexCount), chunk.vertexCount);
+      Submesh submesh;
+      submesh.firstIndex = chunk.firstIndex;
+      submesh.indexCount = chunk.indexCount;
+      submesh.baseVertex = chunk.baseVertex;
+      submesh.format = format;
+      submesh.bounds = computeVertexBounds(copies.subspan(chunk.baseVertex, chunk.vertexCount));
+      mesh->submeshes_.push_back(submesh);
+    }
+    vector<Index> narrow(chunked.begin(), chunked.end());
+    mesh->upload(copies.data(), copies.size(), copies.size_bytes(), narrow.data(), narrow.size(),
+                 narrow.size() * sizeof(Index));
+    aout << "Mesh: split " << vertices.size() << " vertices into " << chunks.size() << " chunks of 16 bit indices, "
+         << copies.size() - vertices.size() << " vertices copied across chunks" << endl;
+  }
+
+  if (keepCpuCopy) {
+    mesh->vertices_.assign(vertices.begin(), vertices.end());
+    mesh->indices_.assign(indices.begin(), indices.end());
+  }
+  return mesh;
+}
+
+shared_ptr<Mesh> Mesh::create(const BufferData& vertices, const BufferData& indices, vector<Submesh> submeshes) {
+  if (vertices.size == 0 || indices.size == 0 || submeshes.empty()) {
+    return nullptr;
+  }
+
+  shared_ptr<Mesh> mesh(new Mesh());
+  // the sphere around the box of the submeshes' spheres
+  r3::Vec3f lo = submeshes[0].bounds.center;
+  r3::Vec3f hi = lo;
+  for (const auto& s : submeshes) {
+    r3::Vec3f extent(s.bounds.radius, s.bounds.radius, s.bounds.radius);
+    lo = r3::Min(lo, s.bounds.center - extent);
+    hi = r3::Max(hi, s.bounds.center + extent);
+  }
+  mesh->bounds_.center = (lo + hi) * 0.5f;
+  for (const auto& s : submeshes) {
+    mesh->bounds_.radius = max(mesh->bounds_.radius, (s.bounds.center - mesh->bounds_.center).Length() + s.bounds.radius);
+  }
+  mesh->submeshes_ = std::move(submeshes);
+
+  mesh->upload(nullptr, vertices.count, vertices.size, nullptr, indices.count, indices.size);
+  glBindBuffer(GL_ARRAY_BUFFER, mesh->vertexBuffer_);
+  for (const auto& range : vertices.ranges) {
+    glBufferSubData(GL_ARRAY_BUFFER, GLintptr(range.offset), GLsizeiptr(range.bytes.size()), range.bytes.data());
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  for (const auto& range : indices.ranges) {
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, GLintptr(range.offset), GLsizeiptr(range.bytes.size()), range.bytes.data());
+  }
+  return mesh;
+}
+
+shared_ptr<Mesh> Mesh::loadAsset(AAssetManager* assetManager, const string& assetPath, const AssetArchive* archive) {
+  auto start = chrono::steady_clock::now();
+
+  // Either way the file is used where it lies if it's stored uncompressed: in the pack's mapping,
+  // or in the apk, which the asset manager maps for buffers of uncompressed assets
+  span<const uint8_t> bytes;
+  vector<uint8_t> unpacked;
+  AAsset* asset = nullptr;
+  const AssetArchive::Entry* entry = archive ? archive->find(assetPath) : nullptr;
+  if (entry) {
+    bytes = archive->getMapped(*entry);
+    if (bytes.empty() && archive->read(*entry, unpacked)) {
+      bytes = unpacked;
+    }
+  } else {
+    asset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_BUFFER);
+    if (!asset) {
+      aout << "Mesh: can't open " << assetPath << endl;
+      return nullptr;
+    }
+    auto buffer = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+    if (buffer) {
+      bytes = {buffer, static_cast<size_t>(AAsset_getLength64(asset))};
+    }
+  }
+
+  MeshFile file;
+  const char* error = "can't read it";
+  shared_ptr<Mesh> mesh;
+  if (!bytes.empty() && MeshFile::parse(bytes.data(), bytes.size(), file, &error)) {
+    mesh.reset(new Mesh());
+    const auto& h = file.header;
+    mesh->bounds_.center = r3::Vec3f(h.center[0], h.center[1], h.center[2]);
+    mesh->bounds_.radius = h.radius;
+    auto format = file.getVertexFormat();
+    auto lod = file.lods.begin();
+    for (const auto& s : file.submeshes) {
+      Submesh submesh;
+      submesh.firstIndex = s.firstIndex;
+      submesh.indexCount = s.indexCount;
+      submesh.baseVertex = s.baseVertex;
+      submesh.format = format;
+      submesh.bounds.center = r3::Vec3f(s.center[0], s.center[1], s.center[2]);
+      submesh.bounds.radius = s.radius;
+      if (s.material != kMeshFileNoMaterial) {
+        const auto& material = file.materials[s.material];
+        submesh.texture = file.getString(material.textureOffset, material.textureLength);
+      }
+      for (uint32_t l = 0; l < s.lodCount; l++, lod++) {
+        submesh.lods.push_back({lod->firstIndex, lod->indexCount, lod->error});
+      }
+      mesh->submeshes_.push_back(std::move(submesh));
+    }
+    mesh->upload(file.getVertexData(), h.vertexCount, file.getVertexDataSize(), file.getIndexData(), h.indexCount,
+                 file.getIndexDataSize());
+  } else {
+    aout << "Mesh: " << assetPath << ": " << error << endl;
+  }
+  if (asset) {
+    AAsset_close(asset);
+  }
+
+  if (mesh) {
+    aout << "Mesh: " << assetPath << ", " << mesh->vertexCount_ << " vertices, " << mesh->indexCount_ / 3
+         << " triangles, " << mesh->submeshes_.size() << " submeshes, loaded in "
+         << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() << " ms" << endl;
+  }
+  return mesh;
+}
+
+void Mesh::upload(const void* vertices, size_t vertexCount, size_t vertexBytes, const void* indices, size_t indexCount,
+                  size_t indexBytes) {
+  vertexCount_ = vertexCount;
+  indexCount_ = indexCount;
+  vertexBytes_ = vertexBytes;
+  indexBytes_ = indexBytes;
+
+  glGenBuffers(1, &vertexBuffer_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  glBufferData(GL_ARRAY_BUFFER, vertexBytes, vertices, GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glGenBuffers(1, &indexBuffer_);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, indices, GL_STATIC_DRAW);
+}
+
+void Mesh::bindAttributes(const AttributeLocations& locations, const Submesh& submesh) const {
+  glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer_);
+  const auto& format = submesh.format;
+  for (size_t a = 0; a < kVertexAttributeCount; a++) {
+    GLint location = locations[a];
+    if (location < 0) {
+      continue;
+    }
+    const auto& attribute = format.attributes[a];
+    if (attribute.type == VertexComponentType::None) {
+      glDisableVertexAttribArray(location);
+      glVertexAttrib4f(location, 0.f, 0.f, 1.f, 1.f);
+      continue;
+    }
+    // Quantized attributes are normalized, the shader scales them back with the dequantize uniform
+    bool normalized = attribute.type == VertexComponentType::Snorm16 || attribute.type == VertexComponentType::Unorm16 ||
+                      attribute.type == VertexComponentType::Unorm8;
+    size_t stride = attribute.stride ? attribute.stride : format.stride;
+    size_t offset = size_t(submesh.baseVertex) * stride + attribute.offset;
+    glVertexAttribPointer(location, GLint(attribute.components), getGlType(attribute.type), normalized ? GL_TRUE : GL_FALSE,
+                          GLsizei(stride), reinterpret_cast<const void*>(offset));
+    glEnableVertexAttribArray(location);
+  }
+}
+
+void Mesh::setDequantizeUniform(GLint location, const Submesh& submesh) const {
+  const auto& f = submesh.format;
+  float values[12] = {f.positionScale[0], f.positionScale[1], f.positionScale[2], 0.f,
+                      f.positionOffset[0], f.positionOffset[1], f.positionOffset[2], 0.f,
+                      f.uvScale[0], f.uvScale[1], f.uvOffset[0], f.uvOffset[1]};
+  glUniform4fv(location, 3, values);
+}
+
+Mesh::~Mesh() {
+  GLuint buffers[] = {vertexBuffer_, indexBuffer_};
+  glDeleteBuffers(2, buffers);
+}
@@ -0,0 +1,263 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MESH_H
+#define ANDROIDGLINVESTIGATIONS_MESH_H
+
+#include <GLES3/gl3.h>
+#include <android/asset_manager.h>
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "Bounds.h"
+#include "VertexFormat.h"
+
+union Vector3 {
+  struct {
+    float x, y, z;
+  };
+  float idx[3];
+};
+
+union Vector2 {
+  struct {
+    float x, y;
+  };
+  struct {
+    float u, v;
+  };
+  float idx[2];
+};
+
+//! The kVertexPositionFloat | kVertexUvFloat layout, which meshes built in code use
+struct Vertex {
+  constexpr Vertex(const Vector3& inPosition, const Vector2& inUV) : position(inPosition), uv(inUV) {}
+
+  Vector3 position;
+  Vector2 uv;
+};
+
+//! The index type of small meshes. Larger ones take 32 bit indices, see Mesh::create
+typedef uint16_t Index;
+
+/*!
+ * Indexed triangles in GL buffer objects. The CPU copy of the vertices and indices is dropped after
+ * upload unless asked for, only the bounds are kept.
+ *
+ * A mesh is split into submeshes, each drawn with its own material. Meshes built in code have one
+ * covering everything, unless they were split into chunks for 16 bit indices. Each submesh has the
+ * narrowest index type its vertices allow. Submeshes from .dmesh files may also have coarser levels
+ * of detail, triangles of their own over the same vertices, which LodSelector picks between.
+ *
+ * Vertices are in the layout each submesh's VertexFormat describes: floats for meshes built in code,
+ * usually quantized for .dmesh files, and whatever the accessors say for glTF. Shaders get the
+ * attributes from bindAttributes() and undo the quantization with a vec4[3] uniform set by
+ * setDequantizeUniform():
+ *
+ *   vec3 position = inPosition * uDequantize[0].xyz + uDequantize[1].xyz;
+ *   vec2 uv = inUV * uDequantize[2].xy + uDequantize[2].zw;
+ */
+class Mesh {
+ public:
+  //! Attribute locations by VertexAttribute, -1 for ones a shader doesn't read
+  using AttributeLocations = std::array<GLint, kVertexAttributeCount>;
+
+  //! A range of indices, of the submesh's type, and how far it strays from the full submesh
+  struct Lod {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    // in position units, 0 for the full submesh
+    float error = 0;
+  };
+
+  struct Submesh {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    // indices count from this vertex
+    uint32_t baseVertex = 0;
+    // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT. firstIndex counts indices of this type from the start
+    // of the index buffer.
+    GLenum indexType = GL_UNSIGNED_SHORT;
+    // attribute offsets count from baseVertex
+    VertexFormat format;
+    BoundingSphere bounds;
+    // base color texture asset path from the material, empty if there's none
+    std::string texture;
+    // coarser levels than the submesh itself, each coarser than the last
+    std::vector<Lod> lods;
+
+    //! @return the byte offset of the first index, for glDrawElements
+    size_t getIndexOffset() const {
+      return getIndexOffset(firstIndex);
+    }
+
+    //! @return the byte offset of an index
+    size_t getIndexOffset(uint32_t index) const {
+      switch (indexType) {
+        case GL_UNSIGNED_INT:
+          return size_t(index) * sizeof(uint32_t);
+        case GL_UNSIGNED_BYTE:
+          return index;
+        default:
+          return size_t(index) * sizeof(Index);
+      }
+    }
+
+    //! @return the number of levels of detail, counting the submesh itself as level 0
+    uint32_t getLodCount() const {
+      return uint32_t(lods.size()) + 1;
+    }
+
+    //! @return a level of detail, clamped to the coarsest there is
+    Lod getLod(uint32_t level) const {
+      if (level == 0 || lods.empty()) {
+        return {firstIndex, indexCount, 0};
+      }
+      return lods[std::min<size_t>(level, lods.size()) - 1];
+    }
+  };
+
+  /*!
+   * Uploads the mesh. Leaves GL_ARRAY_BUFFER unbound and the element buffer of the current vertex
+   * array pointing at this mesh.
+   * @param keepCpuCopy keep the vertices and indices in memory too, for CPU side picking or physics
+   * @return the mesh, or null if there's nothing to draw
+   */
+  static std::shared_ptr<Mesh> create(std::span<const Vertex> vertices, std::span<const Index> indices,
+                                      bool keepCpuCopy = false);
+
+  /*!
+   * The same for meshes that may have more vertices than 16 bit indices can address. Unless split
+   * is set, there's one submesh, with 16 bit indices if they're enough and 32 bit ones otherwise.
+   * With split, a mesh too large for 16 bit indices is cut into spatially compact chunks that each
+   * fit (see MeshOptimizer::splitIntoChunks), as submeshes with their own bounds for culling. Draw
+   * a Model per submesh.
+   */
+  static std::shared_ptr<Mesh> create(std::span<const Vertex> vertices, std::span<const uint32_t> indices,
+                                      bool keepCpuCopy = false, bool split = false);
+
+  /*!
+   * Loads a .dmesh file (see MeshFile.h), from archive if it has the asset. The vertex and index
+   * data go to GL straight from the mapped file, there's no parsing or conversion per vertex. Leaves
+   * the same bindings as create().
+   * @return the mesh, or null if the asset is missing or invalid
+   */
+  static std::shared_ptr<Mesh> loadAsset(AAssetManager* assetManager, const std::string& assetPath,
+                                         const AssetArchive* archive = nullptr);
+
+  //! Bytes to copy to an offset in a GL buffer
+  struct BufferRange {
+    size_t offset = 0;
+    std::span<const uint8_t> bytes;
+  };
+
+  //! The contents of a GL buffer, as ranges of memory that already have the layout GL takes
+  struct BufferData {
+    size_t size = 0;
+    // vertices or indices the ranges hold, for stats
+    size_t count = 0;
+    std::vector<BufferRange> ranges;
+  };
+
+  /*!
+   * Uploads GPU-ready data from a file, without looking at a vertex: each range goes to GL as it
+   * is. The submeshes say how to read the buffers. Leaves the same bindings as create().
+   * @return the mesh, or null if there's nothing to draw
+   */
+  static std::shared_ptr<Mesh> create(const BufferData& vertices, const BufferData& indices,
+                                      std::vector<Submesh> submeshes);
+
+  Mesh(const Mesh&) = delete;
+  Mesh& operator=(const Mesh&) = delete;
+  ~Mesh();
+
+  GLuint getVertexBuffer() const {
+    return vertexBuffer_;
+  }
+
+  GLuint getIndexBuffer() const {
+    return indexBuffer_;
+  }
+
+  size_t getVertexCount() const {
+    return vertexCount_;
+  }
+
+  size_t getIndexCount() const {
+    return indexCount_;
+  }
+
+  const BoundingSphere& getBounds() const {
+    return bounds_;
+  }
+
+  std::span<const Submesh> getSubmeshes() const {
+    return submeshes_;
+  }
+
+  /*!
+   * Points the attributes at a submesh's vertices and enables them, leaving the vertex buffer bound
+   * to GL_ARRAY_BUFFER. An attribute the submesh doesn't have is disabled and reads as (0, 0, 1, 1).
+   */
+  void bindAttributes(const AttributeLocations& locations, const Submesh& submesh) const;
+
+  /*!
+   * Sets the current program's vec4[3] dequantization uniform for a submesh.
+   */
+  void setDequantizeUniform(GLint location, const Submesh& submesh) const;
+
+  /*!
+   * @return the size of the GL buffers
+   */
+  size_t getByteSize() const {
+    return vertexBytes_ + indexBytes_;
+  }
+
+  /*!
+   * @return the size of the CPU copy, 0 if it wasn't kept
+   */
+  size_t getCpuByteSize() const {
+    return vertices_.size() * sizeof(Vertex) + indices_.size() * sizeof(uint32_t);
+  }
+
+  /*!
+   * @return the CPU copy of the vertices, empty unless the mesh was created with keepCpuCopy
+   */
+  std::span<const Vertex> getVertices() const {
+    return vertices_;
+  }
+
+  /*!
+   * @return the CPU copy of the indices as they were given, before any splitting
+   */
+  std::span<const uint32_t> getIndices() const {
+    return indices_;
+  }
+
+ private:
+  Mesh() = default;
+
+  /*!
+   * Creates the buffers and fills them from data in the GL layout, indices of whichever types the
+   * submeshes say.
+   */
+  void upload(const void* vertices, size_t vertexCount, size_t vertexBytes, const void* indices, size_t indexCount,
+              size_t indexBytes);
+
+  GLuint vertexBuffer_ = 0;
+  GLuint indexBuffer_ = 0;
+  size_t vertexCount_ = 0;
+  size_t indexCount_ = 0;
+  size_t vertexBytes_ = 0;
+  size_t indexBytes_ = 0;
+  BoundingSphere bounds_;
+  std::vector<Submesh> submeshes_;
+  std::vector<Vertex> vertices_;
+  std::vector<uint32_t> indices_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_MESH_H
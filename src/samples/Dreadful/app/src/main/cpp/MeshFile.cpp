@@ -0,0 +1,89 @@
+#include "MeshFile.h"
+
+#include <cstring>
+
+bool MeshFile::parse(const uint8_t* data, size_t size, MeshFile& out, const char** error) {
+  auto fail = [error](const char* message) {
+    if (error) {
+      *error = message;
+    }
+    return false;
+  };
+
+  if (size < sizeof(MeshFileHeader) || memcmp(data, kMeshFileMagic, sizeof(kMeshFileMagic)) != 0) {
+    return fail("not a mesh file");
+  }
+  memcpy(&out.header, data, sizeof(MeshFileHeader));
+  const auto& h = out.header;
+  if (h.version != kMeshFileVersion) {
+    return fail("unsupported mesh file version");
+  }
+  if (VertexFormat::fromFlags(h.vertexFormat).stride != h.vertexStride || h.vertexStride == 0) {
+    return fail("unsupported vertex format");
+  }
+  if (h.indexSize != 2) {
+    return fail("unsupported index size");
+  }
+
+  size_t submeshesSize = size_t(h.submeshCount) * sizeof(MeshFileSubmesh);
+  if (submeshesSize > size - sizeof(MeshFileHeader)) {
+    return fail("truncated tables");
+  }
+  out.submeshes.resize(h.submeshCount);
+  memcpy(out.submeshes.data(), data + sizeof(MeshFileHeader), submeshesSize);
+  // The level table's size comes from the submeshes
+  size_t lodCount = 0;
+  for (const auto& submesh : out.submeshes) {
+    lodCount += submesh.lodCount;
+  }
+  size_t lodsSize = lodCount * sizeof(MeshFileLod);
+  size_t materialsSize = size_t(h.materialCount) * sizeof(MeshFileMaterial);
+  if (lodCount > size || submeshesSize + lodsSize + materialsSize + h.stringsSize > size - sizeof(MeshFileHeader)) {
+    return fail("truncated tables");
+  }
+  out.lods.resize(lodCount);
+  memcpy(out.lods.data(), data + sizeof(MeshFileHeader) + submeshesSize, lodsSize);
+  out.materials.resize(h.materialCount);
+  memcpy(out.materials.data(), data + sizeof(MeshFileHeader) + submeshesSize + lodsSize, materialsSize);
+
+  // Counts are checked against the size first so the products can't overflow
+  auto inBounds = [size](uint64_t offset, uint64_t count, uint32_t elementSize) {
+    return offset <= size && count <= (size - offset) / elementSize;
+  };
+  if (!inBounds(h.vertexOffset, h.vertexCount, h.vertexStride) || !inBounds(h.indexOffset, h.indexCount, h.indexSize)) {
+    return fail("vertex or index data out of bounds");
+  }
+  for (const auto& submesh : out.submeshes) {
+    bool indicesInBounds = submesh.firstIndex <= h.indexCount && submesh.indexCount <= h.indexCount - submesh.firstIndex;
+    bool verticesInBounds =
+        submesh.baseVertex <= h.vertexCount && submesh.vertexCount <= h.vertexCount - submesh.baseVertex;
+    bool materialValid = submesh.material == kMeshFileNoMaterial || submesh.material < h.materialCount;
+    if (!indicesInBounds || !verticesInBounds || !materialValid || submesh.indexCount % 3 != 0) {
+      return fail("corrupt submesh");
+    }
+  }
+  for (const auto& lod : out.lods) {
+    if (lod.firstIndex > h.indexCount || lod.indexCount > h.indexCount - lod.firstIndex || lod.indexCount % 3 != 0) {
+      return fail("corrupt level of detail");
+    }
+  }
+  for (const auto& material : out.materials) {
+    if (size_t(material.nameOffset) + material.nameLength > h.stringsSize ||
+        size_t(material.textureOffset) + material.textureLength > h.stringsSize) {
+      return fail("corrupt material");
+    }
+  }
+
+  out.data = data;
+  out.size = size;
+  return true;
+}
+
+VertexFormat MeshFile::getVertexFormat() const {
+  auto format = VertexFormat::fromFlags(header.vertexFormat);
+  memcpy(format.positionScale, header.positionScale, sizeof(format.positionScale));
+  memcpy(format.positionOffset, header.positionOffset, sizeof(format.positionOffset));
+  memcpy(format.uvScale, header.uvScale, sizeof(format.uvScale));
+  memcpy(format.uvOffset, header.uvOffset, sizeof(format.uvOffset));
+  return format;
+}
@@ -0,0 +1,152 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MESHFILE_H
+#define ANDROIDGLINVESTIGATIONS_MESHFILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "VertexFormat.h"
+
+/*!
+ * The .dmesh format, which Mesh::loadAsset reads and src/tools/meshconv writes. This header has no
+ * GL or Android dependencies so the host tool can share it.
+ *
+ * Vertex and index data are stored exactly as the GL buffers hold them, so loading is a bounds
+ * check and two buffer uploads straight from the mapped asset. A file is a header, the submeshes,
+ * their levels of detail, the materials, their strings, then the vertices and the indices, each
+ * starting on a kMeshFileAlignment boundary. All integers are little endian.
+ */
+
+static constexpr uint8_t kMeshFileMagic[4] = {'D', 'M', 'S', 'H'};
+static constexpr uint32_t kMeshFileVersion = 3;
+static constexpr uint32_t kMeshFileAlignment = 16;
+
+//! float position[3], float uv[2]: Vertex in Mesh.h
+static constexpr uint32_t kMeshVertexFormatPositionUv = kVertexPositionFloat | kVertexUvFloat;
+
+//! A submesh without a material
+static constexpr uint32_t kMeshFileNoMaterial = ~0u;
+
+struct MeshFileHeader {
+  uint8_t magic[4];
+  uint32_t version;
+  // a combination of the flags in VertexFormat.h
+  uint32_t vertexFormat;
+  uint32_t vertexStride;
+  // bytes per index, 2
+  uint32_t indexSize;
+  uint32_t submeshCount;
+  uint32_t materialCount;
+  uint32_t stringsSize;
+  uint64_t vertexCount;
+  uint64_t vertexOffset;
+  uint64_t indexCount;
+  uint64_t indexOffset;
+  // of every vertex, the sphere centered on the box like computeBoundingSphere's
+  float center[3];
+  float radius;
+  float boundsMin[3];
+  float boundsMax[3];
+  // ranges of quantized attributes, see VertexFormat
+  float positionScale[3];
+  float positionOffset[3];
+  float uvScale[2];
+  float uvOffset[2];
+};
+static_assert(sizeof(MeshFileHeader) == 144, "mesh file header is 144 bytes");
+
+struct MeshFileSubmesh {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // Indices count from this vertex, so every submesh can address 65536 vertices with 16 bit
+  // indices however big the whole mesh is
+  uint32_t baseVertex;
+  uint32_t vertexCount;
+  uint32_t material;
+  float center[3];
+  float radius;
+  float boundsMin[3];
+  float boundsMax[3];
+  // coarser levels of detail, the next ones in the level table
+  uint32_t lodCount;
+};
+static_assert(sizeof(MeshFileSubmesh) == 64, "mesh file submeshes are 64 bytes");
+
+/*!
+ * A coarser level of a submesh: its own triangles, indexing the submesh's vertices from its
+ * baseVertex. Levels of a submesh get coarser and their errors grow.
+ */
+struct MeshFileLod {
+  uint32_t firstIndex;
+  uint32_t indexCount;
+  // how far the surface may have moved from the full submesh, in position units
+  float error;
+  uint32_t reserved;
+};
+static_assert(sizeof(MeshFileLod) == 16, "mesh file levels of detail are 16 bytes");
+
+struct MeshFileMaterial {
+  // into the strings, which aren't null terminated
+  uint32_t nameOffset;
+  uint32_t nameLength;
+  // base color texture asset path, may be empty
+  uint32_t textureOffset;
+  uint32_t textureLength;
+  float baseColor[4];
+};
+static_assert(sizeof(MeshFileMaterial) == 32, "mesh file materials are 32 bytes");
+
+/*!
+ * A .dmesh file in memory, validated and with its tables read. Doesn't own the data.
+ */
+struct MeshFile {
+  MeshFileHeader header;
+  std::vector<MeshFileSubmesh> submeshes;
+  // every submesh's levels, in submesh order
+  std::vector<MeshFileLod> lods;
+  std::vector<MeshFileMaterial> materials;
+  const uint8_t* data = nullptr;
+  size_t size = 0;
+
+  /*!
+   * Checks the header, the tables and that every submesh is within the vertex and index data.
+   * Indices themselves aren't checked, the GPU reads them.
+   * @param error receives a description of the problem on failure
+   * @return true if out describes a usable mesh
+   */
+  static bool parse(const uint8_t* data, size_t size, MeshFile& out, const char** error);
+
+  const uint8_t* getVertexData() const {
+    return data + header.vertexOffset;
+  }
+
+  size_t getVertexDataSize() const {
+    return header.vertexCount * header.vertexStride;
+  }
+
+  const uint8_t* getIndexData() const {
+    return data + header.indexOffset;
+  }
+
+  size_t getIndexDataSize() const {
+    return header.indexCount * header.indexSize;
+  }
+
+  /*!
+   * @return the layout of the vertex data, with the file's ranges
+   */
+  VertexFormat getVertexFormat() const;
+
+  std::string_view getString(uint32_t offset, uint32_t length) const {
+    return {reinterpret_cast<const char*>(getStrings()) + offset, length};
+  }
+
+ private:
+  const uint8_t* getStrings() const {
+    return data + sizeof(MeshFileHeader) + submeshes.size() * sizeof(MeshFileSubmesh) +
+           lods.size() * sizeof(MeshFileLod) + materials.size() * sizeof(MeshFileMaterial);
+  }
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_MESHFILE_H
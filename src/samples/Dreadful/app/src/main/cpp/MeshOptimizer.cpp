@@ -0,0 +1,582 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+
+using namespace std;
+
+size_t MeshOptimizer::optimize(uint8_t* vertices, size_t vertexCount, size_t stride, span<uint32_t> indices,
+                               const Options& options) {
+  if (options.deduplicate) {
+    vertexCount = deduplicate(vertices, vertexCount, stride, indices);
+  }
+  if (options.vertexCache) {
+    optimizeVertexCache(indices, vertexCount, options.cacheSize);
+  }
+  if (options.overdraw) {
+    optimizeOverdraw(indices, vertices, vertexCount, stride, options.cacheSize);
+  }
+  if (options.vertexFetch) {
+    vertexCount = optimizeVertexFetch(vertices, vertexCount, stride, indices);
+  }
+  return vertexCount;
+}
+
+size_t MeshOptimizer::deduplicate(uint8_t* vertices, size_t vertexCount, size_t stride, span<uint32_t> indices) {
+  // Find every vertex's first equal before moving anything, the keys point into vertices
+  vector<uint32_t> remap(vertexCount);
+  unordered_map<string_view, uint32_t> firsts;
+  firsts.reserve(vertexCount);
+  size_t unique = 0;
+  for (size_t v = 0; v < vertexCount; v++) {
+    string_view key(reinterpret_cast<const char*>(vertices + v * stride), stride);
+    auto [it, added] = firsts.try_emplace(key, uint32_t(unique));
+    remap[v] = it->second;
+    unique += added;
+  }
+  if (unique == vertexCount) {
+    return vertexCount;
+  }
+
+  // A vertex only ever moves down, so compacting in order never overwrites one still to be moved
+  for (size_t v = 0, next = 0; v < vertexCount; v++) {
+    if (remap[v] == next) {
+      memmove(vertices + next * stride, vertices + v * stride, stride);
+      next++;
+    }
+  }
+  for (auto& index : indices) {
+    index = remap[index];
+  }
+  return unique;
+}
+
+void MeshOptimizer::optimizeVertexCache(span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+
+  // Triangles using each vertex, packed: those of vertex v are adjacency[first[v]] onwards
+  vector<uint32_t> live(vertexCount, 0);
+  for (uint32_t index : indices) {
+    live[index]++;
+  }
+  vector<uint32_t> first(vertexCount + 1, 0);
+  for (size_t v = 0; v < vertexCount; v++) {
+    first[v + 1] = first[v] + live[v];
+  }
+  vector<uint32_t> adjacency(indices.size());
+  vector<uint32_t> filled(first.begin(), first.end() - 1);
+  for (size_t i = 0; i < indices.size(); i++) {
+    adjacency[filled[indices[i]]++] = uint32_t(i / 3);
+  }
+
+  // Tipsify: fan around a vertex, emitting all its triangles, then move to the candidate that will
+  // still be in the cache after its own remaining triangles are emitted, the oldest such first.
+  // With none, back up through recently used vertices (the dead-end stack) or scan forward.
+  vector<uint32_t> output;
+  output.reserve(indices.size());
+  vector<uint32_t> timestamp(vertexCount, 0);
+  vector<bool> emitted(triangleCount, false);
+  vector<uint32_t> deadEnd;
+  vector<uint32_t> candidates;
+  uint32_t time = cacheSize + 1;
+  size_t cursor = 0;
+  int64_t fan = 0;
+  while (fan >= 0) {
+    candidates.clear();
+    for (uint32_t a = first[fan]; a < first[fan + 1]; a++) {
+      uint32_t t = adjacency[a];
+      if (emitted[t]) {
+        continue;
+      }
+      for (int k = 0; k < 3; k++) {
+        uint32_t v = indices[t * 3 + k];
+        output.push_back(v);
+        deadEnd.push_back(v);
+        candidates.push_back(v);
+        live[v]--;
+        if (time - timestamp[v] > cacheSize) {
+          timestamp[v] = time++;
+        }
+      }
+      emitted[t] = true;
+    }
+
+    fan = -1;
+    int64_t best = -1;
+    for (uint32_t v : candidates) {
+      if (live[v] == 0) {
+        continue;
+      }
+      // vertices whose triangles would push them out of the cache rank lowest
+      int64_t priority = 0;
+      if (time - timestamp[v] + 2 * live[v] <= cacheSize) {
+        priority = time - timestamp[v];
+      }
+      if (priority > best) {
+        best = priority;
+        fan = v;
+      }
+    }
+    while (fan < 0 && !deadEnd.empty()) {
+      uint32_t v = deadEnd.back();
+      deadEnd.pop_back();
+      if (live[v] > 0) {
+        fan = v;
+      }
+    }
+    for (; fan < 0 && cursor < vertexCount; cursor++) {
+      if (live[cursor] > 0) {
+        fan = int64_t(cursor);
+      }
+    }
+  }
+  copy(output.begin(), output.end(), indices.begin());
+}
+
+void MeshOptimizer::optimizeOverdraw(span<uint32_t> indices, const uint8_t* vertices, size_t vertexCount,
+                                     size_t stride, uint32_t cacheSize) {
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0) {
+    return;
+  }
+  auto position = [vertices, stride](uint32_t v, float out[3]) {
+    memcpy(out, vertices + v * stride, 3 * sizeof(float));
+  };
+
+  // Clusters start wherever a triangle misses the cache on all three vertices: the cache order
+  // started over there anyway, so moving clusters around costs little
+  vector<uint32_t> clusterStarts;
+  vector<uint32_t> timestamp(vertexCount, 0);
+  uint32_t time = cacheSize + 1;
+  for (size_t t = 0; t < triangleCount; t++) {
+    int misses = 0;
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[t * 3 + k];
+      if (time - timestamp[v] > cacheSize) {
+        timestamp[v] = time++;
+        misses++;
+      }
+    }
+    if (misses == 3 || t == 0) {
+      clusterStarts.push_back(uint32_t(t));
+    }
+  }
+  clusterStarts.push_back(uint32_t(triangleCount));
+  size_t clusterCount = clusterStarts.size() - 1;
+  if (clusterCount < 2) {
+    return;
+  }
+
+  // Area weighted centroids and normals, per cluster and for the mesh
+  struct Cluster {
+    double centroid[3] = {};
+    double normal[3] = {};
+    double area = 0;
+    float score = 0;
+  };
+  vector<Cluster> clusters(clusterCount);
+  double meshCentroid[3] = {};
+  double meshArea = 0;
+  for (size_t c = 0; c < clusterCount; c++) {
+    auto& cluster = clusters[c];
+    for (uint32_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+      float p[3][3];
+      for (int k = 0; k < 3; k++) {
+        position(indices[t * 3 + k], p[k]);
+      }
+      double e1[3], e2[3];
+      for (int i = 0; i < 3; i++) {
+        e1[i] = p[1][i] - p[0][i];
+        e2[i] = p[2][i] - p[0][i];
+      }
+      double n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+      double area = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) / 2;
+      for (int i = 0; i < 3; i++) {
+        cluster.centroid[i] += (p[0][i] + p[1][i] + p[2][i]) / 3 * area;
+        cluster.normal[i] += n[i];
+      }
+      cluster.area += area;
+    }
+    for (int i = 0; i < 3; i++) {
+      meshCentroid[i] += cluster.centroid[i];
+    }
+    meshArea += cluster.area;
+  }
+  for (auto& cluster : clusters) {
+    double toCluster[3];
+    double normalLength = 0;
+    for (int i = 0; i < 3; i++) {
+      double centroid = cluster.area > 0 ? cluster.centroid[i] / cluster.area : 0;
+      toCluster[i] = centroid - (meshArea > 0 ? meshCentroid[i] / meshArea : 0);
+      normalLength += cluster.normal[i] * cluster.normal[i];
+    }
+    normalLength = sqrt(normalLength);
+    // how far the cluster faces away from the middle: those in front get drawn first
+    double dot = toCluster[0] * cluster.normal[0] + toCluster[1] * cluster.normal[1] + toCluster[2] * cluster.normal[2];
+    cluster.score = normalLength > 0 ? float(dot / normalLength) : 0.f;
+  }
+
+  vector<uint32_t> order(clusterCount);
+  for (size_t c = 0; c < clusterCount; c++) {
+    order[c] = uint32_t(c);
+  }
+  stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return clusters[a].score > clusters[b].score; });
+
+  vector<uint32_t> output;
+  output.reserve(indices.size());
+  for (uint32_t c : order) {
+    output.insert(output.end(), indices.begin() + clusterStarts[c] * 3, indices.begin() + clusterStarts[c + 1] * 3);
+  }
+  copy(output.begin(), output.end(), indices.begin());
+}
+
+size_t MeshOptimizer::optimizeVertexFetch(uint8_t* vertices, size_t vertexCount, size_t stride,
+                                          span<uint32_t> indices) {
+  vector<uint32_t> remap(vertexCount, ~0u);
+  uint32_t next = 0;
+  for (auto& index : indices) {
+    if (remap[index] == ~0u) {
+      remap[index] = next++;
+    }
+    index = remap[index];
+  }
+  vector<uint8_t> original(vertices, vertices + vertexCount * stride);
+  for (size_t v = 0; v < vertexCount; v++) {
+    if (remap[v] != ~0u) {
+      memcpy(vertices + size_t(remap[v]) * stride, original.data() + v * stride, stride);
+    }
+  }
+  return next;
+}
+
+//! Interleaves the low 10 bits of x, y and z, x lowest
+static uint32_t interleave3(uint32_t x, uint32_t y, uint32_t z) {
+  auto spread = [](uint32_t v) {
+    v &= 0x3ff;
+    v = (v | v << 16) & 0x030000ff;
+    v = (v | v << 8) & 0x0300f00f;
+    v = (v | v << 4) & 0x030c30c3;
+    v = (v | v << 2) & 0x09249249;
+    return v;
+  };
+  return spread(x) | spread(y) << 1 | spread(z) << 2;
+}
+
+vector<MeshOptimizer::Chunk> MeshOptimizer::splitIntoChunks(const uint8_t* vertices, size_t vertexCount,
+                                                            size_t stride, vector<uint32_t>& indices,
+                                                            vector<uint8_t>& out, uint32_t maxVertices) {
+  vector<Chunk> chunks;
+  out.clear();
+  size_t triangleCount = indices.size() / 3;
+  if (triangleCount == 0 || maxVertices < 3) {
+    return chunks;
+  }
+
+  // Centroids and their box, to place each triangle on a 1024^3 Morton curve
+  vector<array<float, 3>> centroids(triangleCount);
+  float lo[3] = {INFINITY, INFINITY, INFINITY};
+  float hi[3] = {-INFINITY, -INFINITY, -INFINITY};
+  for (size_t t = 0; t < triangleCount; t++) {
+    auto& centroid = centroids[t];
+    centroid = {};
+    for (int k = 0; k < 3; k++) {
+      float position[3];
+      memcpy(position, vertices + size_t(indices[t * 3 + k]) * stride, sizeof(position));
+      for (int c = 0; c < 3; c++) {
+        centroid[c] += position[c] / 3;
+      }
+    }
+    for (int c = 0; c < 3; c++) {
+      lo[c] = min(lo[c], centroid[c]);
+      hi[c] = max(hi[c], centroid[c]);
+    }
+  }
+  vector<pair<uint32_t, uint32_t>> order(triangleCount);
+  for (size_t t = 0; t < triangleCount; t++) {
+    uint32_t cell[3];
+    for (int c = 0; c < 3; c++) {
+      float extent = hi[c] - lo[c];
+      cell[c] = extent > 0 ? uint32_t((centroids[t][c] - lo[c]) / extent * 1023.f) : 0;
+    }
+    order[t] = {interleave3(cell[0], cell[1], cell[2]), uint32_t(t)};
+  }
+  sort(order.begin(), order.end());
+
+  // Walk the curve, starting a chunk whenever a triangle might not fit. A vertex's copy belongs to
+  // the current chunk if it was made at or after the chunk's base.
+  vector<uint32_t> copies(vertexCount, ~0u);
+  vector<uint32_t> output;
+  output.reserve(indices.size());
+  out.reserve(vertexCount * stride);
+  uint32_t outVertices = 0;
+  Chunk chunk;
+  auto finish = [&]() {
+    chunk.indexCount = uint32_t(output.size()) - chunk.firstIndex;
+    chunk.vertexCount = outVertices - chunk.baseVertex;
+    chunks.push_back(chunk);
+  };
+  for (const auto& [code, t] : order) {
+    if (outVertices - chunk.baseVertex + 3 > maxVertices) {
+      finish();
+      chunk = {uint32_t(output.size()), 0, outVertices, 0};
+    }
+    for (int k = 0; k < 3; k++) {
+      uint32_t v = indices[size_t(t) * 3 + k];
+      if (copies[v] == ~0u || copies[v] < chunk.baseVertex) {
+        copies[v] = outVertices++;
+        out.insert(out.end(), vertices + size_t(v) * stride, vertices + size_t(v + 1) * stride);
+      }
+      output.push_back(copies[v] - chunk.baseVertex);
+    }
+  }
+  finish();
+  indices = std::move(output);
+  return chunks;
+}
+
+namespace {
+
+//! Sums squared distances to planes: a symmetric 4x4 matrix, the upper triangle row by row
+struct Quadric {
+  double a[10] = {};
+
+  void addPlane(const double plane[4]) {
+    for (int r = 0, k = 0; r < 4; r++) {
+      for (int c = r; c < 4; c++) {
+        a[k++] += plane[r] * plane[c];
+      }
+    }
+  }
+
+  void add(const Quadric& q) {
+    for (int k = 0; k < 10; k++) {
+      a[k] += q.a[k];
+    }
+  }
+
+  double evaluate(const array<float, 3>& p) const {
+    double v[4] = {p[0], p[1], p[2], 1};
+    double sum = 0;
+    for (int r = 0, k = 0; r < 4; r++) {
+      for (int c = r; c < 4; c++) {
+        sum += (r == c ? 1 : 2) * a[k++] * v[r] * v[c];
+      }
+    }
+    // rounding can take it just below zero
+    return max(sum, 0.0);
+  }
+};
+
+}  // namespace
+
+static array<float, 3> getNormal(const array<float, 3>& p0, const array<float, 3>& p1, const array<float, 3>& p2) {
+  float e1[3] = {p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2]};
+  float e2[3] = {p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2]};
+  return {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+}
+
+static float dot(const array<float, 3>& a, const array<float, 3>& b) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+vector<uint32_t> MeshOptimizer::simplify(span<const uint32_t> indices, const uint8_t* vertices, size_t vertexCount,
+                                         size_t stride, size_t targetIndexCount, float maxError, float* error) {
+  vector<uint32_t> result(indices.begin(), indices.end());
+  vector<array<float, 3>> positions(vertexCount);
+  for (size_t v = 0; v < vertexCount; v++) {
+    memcpy(positions[v].data(), vertices + v * stride, sizeof(positions[v]));
+  }
+
+  // Each triangle's plane goes into the quadrics of its corners
+  vector<Quadric> quadrics(vertexCount);
+  for (size_t i = 0; i + 2 < result.size(); i += 3) {
+    const auto& p0 = positions[result[i]];
+    auto n = getNormal(p0, positions[result[i + 1]], positions[result[i + 2]]);
+    float length = sqrt(dot(n, n));
+    if (length == 0) {
+      continue;
+    }
+    double plane[4] = {n[0] / length, n[1] / length, n[2] / length, 0};
+    plane[3] = -(plane[0] * p0[0] + plane[1] * p0[1] + plane[2] * p0[2]);
+    for (int k = 0; k < 3; k++) {
+      quadrics[result[i + k]].addPlane(plane);
+    }
+  }
+
+  // An edge no triangle has the other way round is open, and its ends stay put
+  auto key = [](uint32_t a, uint32_t b) { return uint64_t(a) << 32 | b; };
+  vector<uint64_t> directed;
+  directed.reserve(result.size());
+  for (size_t i = 0; i + 2 < result.size(); i += 3) {
+    for (int k = 0; k < 3; k++) {
+      directed.push_back(key(result[i + k], result[i + (k + 1) % 3]));
+    }
+  }
+  sort(directed.begin(), directed.end());
+  vector<uint8_t> locked(vertexCount, 0);
+  for (uint64_t edge : directed) {
+    uint32_t a = uint32_t(edge >> 32);
+    uint32_t b = uint32_t(edge);
+    if (!binary_search(directed.begin(), directed.end(), key(b, a))) {
+      locked[a] = locked[b] = 1;
+    }
+  }
+
+  struct Collapse {
+    double cost;
+    uint32_t from;
+    uint32_t to;
+  };
+  double maxCost = double(maxError) * maxError;
+  float worst = 0;
+  vector<uint32_t> remap(vertexCount);
+  vector<uint8_t> touched(vertexCount);
+  vector<uint32_t> firstTriangle(vertexCount + 1);
+  vector<uint32_t> triangles;
+  vector<uint64_t> edges;
+  vector<Collapse> collapses;
+  // Passes collapse the cheapest edges that don't share triangles, then rebuild the triangles
+  while (result.size() > targetIndexCount) {
+    edges.clear();
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+      for (int k = 0; k < 3; k++) {
+        uint32_t a = result[i + k];
+        uint32_t b = result[i + (k + 1) % 3];
+        edges.push_back(key(min(a, b), max(a, b)));
+      }
+    }
+    sort(edges.begin(), edges.end());
+    edges.erase(unique(edges.begin(), edges.end()), edges.end());
+
+    // Each edge can go either way; the end that's kept is the one the merged quadric likes better
+    collapses.clear();
+    for (uint64_t edge : edges) {
+      uint32_t a = uint32_t(edge >> 32);
+      uint32_t b = uint32_t(edge);
+      Quadric q = quadrics[a];
+      q.add(quadrics[b]);
+      Collapse best{HUGE_VAL, 0, 0};
+      if (!locked[a]) {
+        best = {q.evaluate(positions[b]), a, b};
+      }
+      if (!locked[b] && q.evaluate(positions[a]) < best.cost) {
+        best = {q.evaluate(positions[a]), b, a};
+      }
+      if (best.cost <= maxCost) {
+        collapses.push_back(best);
+      }
+    }
+    sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+
+    // The triangles around each vertex
+    fill(firstTriangle.begin(), firstTriangle.end(), 0);
+    for (uint32_t v : result) {
+      firstTriangle[v + 1]++;
+    }
+    for (size_t v = 0; v < vertexCount; v++) {
+      firstTriangle[v + 1] += firstTriangle[v];
+    }
+    triangles.resize(result.size());
+    {
+      vector<uint32_t> next(firstTriangle.begin(), firstTriangle.end() - 1);
+      for (size_t i = 0; i < result.size(); i++) {
+        triangles[next[result[i]]++] = uint32_t(i / 3);
+      }
+    }
+
+    for (size_t v = 0; v < vertexCount; v++) {
+      remap[v] = uint32_t(v);
+    }
+    fill(touched.begin(), touched.end(), 0);
+    size_t triangleCount = result.size() / 3;
+    size_t collapsed = 0;
+    for (const auto& c : collapses) {
+      if (triangleCount <= targetIndexCount / 3) {
+        break;
+      }
+      if (touched[c.from] || touched[c.to]) {
+        continue;
+      }
+      // Moving the corner mustn't turn any triangle that stays over
+      size_t removed = 0;
+      bool flips = false;
+      for (uint32_t t = firstTriangle[c.from]; t < firstTriangle[c.from + 1] && !flips; t++) {
+        const uint32_t* corners = &result[size_t(triangles[t]) * 3];
+        if (corners[0] == c.to || corners[1] == c.to || corners[2] == c.to) {
+          removed++;
+          continue;
+        }
+        array<float, 3> before[3];
+        array<float, 3> after[3];
+        for (int k = 0; k < 3; k++) {
+          before[k] = positions[corners[k]];
+          after[k] = positions[corners[k] == c.from ? c.to : corners[k]];
+        }
+        auto n = getNormal(before[0], before[1], before[2]);
+        flips = dot(n, n) > 0 && dot(n, getNormal(after[0], after[1], after[2])) <= 0;
+      }
+      if (flips) {
+        continue;
+      }
+      remap[c.from] = c.to;
+      quadrics[c.to].add(quadrics[c.from]);
+      worst = max(worst, float(sqrt(c.cost)));
+      triangleCount -= removed;
+      collapsed++;
+      // The triangles around from change shape, so nothing else of theirs collapses this pass
+      for (uint32_t t = firstTriangle[c.from]; t < firstTriangle[c.from + 1]; t++) {
+        for (int k = 0; k < 3; k++) {
+          touched[result[size_t(triangles[t]) * 3 + k]] = 1;
+        }
+      }
+    }
+    if (collapsed == 0) {
+      break;
+    }
+
+    // Triangles that lost a corner go
+    size_t out = 0;
+    for (size_t i = 0; i + 2 < result.size(); i += 3) {
+      uint32_t a = remap[result[i]];
+      uint32_t b = remap[result[i + 1]];
+      uint32_t c = remap[result[i + 2]];
+      if (a != b && b != c && a != c) {
+        result[out++] = a;
+        result[out++] = b;
+        result[out++] = c;
+      }
+    }
+    result.resize(out);
+  }
+  if (error) {
+    *error = worst;
+  }
+  return result;
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::analyzeVertexCache(span<const uint32_t> indices, size_t vertexCount,
+                                                            uint32_t cacheSize) {
+  CacheStats stats;
+  if (indices.empty() || vertexCount == 0) {
+    return stats;
+  }
+  vector<uint32_t> timestamp(vertexCount, 0);
+  uint32_t time = cacheSize + 1;
+  size_t misses = 0;
+  for (uint32_t v : indices) {
+    if (time - timestamp[v] > cacheSize) {
+      timestamp[v] = time++;
+      misses++;
+    }
+  }
+  stats.acmr = double(misses) / double(indices.size() / 3);
+  stats.atvr = double(misses) / double(vertexCount);
+  return stats;
+}
@@ -0,0 +1,131 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MESHOPTIMIZER_H
+#define ANDROIDGLINVESTIGATIONS_MESHOPTIMIZER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+/*!
+ * Reorders indexed triangle lists so mobile GPUs shade fewer vertices, cover fewer pixels twice
+ * and fetch vertices from fewer cache lines. There are no GL or Android dependencies, so
+ * src/tools/meshconv runs it offline and loaders can run it on worker threads.
+ *
+ * The passes, in the order optimize runs them:
+ * - deduplicate merges vertices whose bytes are identical
+ * - optimizeVertexCache orders triangles for the post-transform cache (Tipsify, Sander et al. 2007)
+ * - optimizeOverdraw splits that order where the cache starts over and draws the outward facing
+ *   clusters first, so they occlude the rest, without losing much cache efficiency
+ * - optimizeVertexFetch numbers vertices in the order triangles first use them
+ *
+ * splitIntoChunks is separate: it cuts meshes with too many vertices for 16 bit indices into
+ * spatially compact pieces that each fit. So is simplify, which builds coarser levels of detail.
+ *
+ * Vertices are opaque records of stride bytes, except that overdraw and splitting read a float
+ * x, y, z position from their start.
+ */
+class MeshOptimizer {
+ public:
+  //! A FIFO this size is a fair model of the post-transform cache of current mobile GPUs
+  static constexpr uint32_t kDefaultCacheSize = 16;
+
+  struct Options {
+    uint32_t cacheSize = kDefaultCacheSize;
+    bool deduplicate = true;
+    bool vertexCache = true;
+    bool overdraw = true;
+    bool vertexFetch = true;
+  };
+
+  //! The most vertices 16 bit indices can address
+  static constexpr uint32_t kMaxShortIndexVertices = 65536;
+
+  //! A range of triangles using a range of vertices of their own
+  struct Chunk {
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    // indices count from this vertex
+    uint32_t baseVertex = 0;
+    uint32_t vertexCount = 0;
+  };
+
+  struct CacheStats {
+    // vertices shaded per triangle: 3 with no reuse, approaching 0.5 for large regular meshes
+    double acmr = 0;
+    // vertices shaded per vertex: 1 is ideal
+    double atvr = 0;
+  };
+
+  /*!
+   * Runs the passes options selects on a triangle list.
+   * @return the vertex count afterwards, which is lower if vertices were merged or unused
+   */
+  static size_t optimize(uint8_t* vertices, size_t vertexCount, size_t stride, std::span<uint32_t> indices,
+                         const Options& options);
+
+  /*!
+   * The same for vectors of any trivially copyable vertex and index types, shrinking vertices.
+   */
+  template <typename VertexType, typename IndexType>
+  static void optimize(std::vector<VertexType>& vertices, std::vector<IndexType>& indices, const Options& options) {
+    static_assert(std::is_trivially_copyable_v<VertexType>, "vertices are moved as bytes");
+    std::vector<uint32_t> wide(indices.begin(), indices.end());
+    size_t count = optimize(reinterpret_cast<uint8_t*>(vertices.data()), vertices.size(), sizeof(VertexType), wide,
+                            options);
+    vertices.erase(vertices.begin() + count, vertices.end());
+    indices.assign(wide.begin(), wide.end());
+  }
+
+  /*!
+   * Merges vertices with identical bytes into the first of them, compacting vertices.
+   * @return the vertex count afterwards
+   */
+  static size_t deduplicate(uint8_t* vertices, size_t vertexCount, size_t stride, std::span<uint32_t> indices);
+
+  static void optimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount,
+                                  uint32_t cacheSize = kDefaultCacheSize);
+
+  static void optimizeOverdraw(std::span<uint32_t> indices, const uint8_t* vertices, size_t vertexCount,
+                               size_t stride, uint32_t cacheSize = kDefaultCacheSize);
+
+  /*!
+   * Renumbers and moves vertices into the order the indices first use them, dropping unused ones.
+   * @return the vertex count afterwards
+   */
+  static size_t optimizeVertexFetch(uint8_t* vertices, size_t vertexCount, size_t stride, std::span<uint32_t> indices);
+
+  /*!
+   * Splits triangles into chunks of at most maxVertices vertices, so each can be drawn with 16 bit
+   * indices. Triangles are sorted along a Morton curve through their centroids first, which keeps
+   * every chunk compact in space and its bounds tight enough to cull. A vertex used on both sides of
+   * a cut is copied into each chunk.
+   * @param out receives the vertices of the chunks one after another
+   * @param indices is rewritten in chunk order, each index counting from its chunk's baseVertex
+   */
+  static std::vector<Chunk> splitIntoChunks(const uint8_t* vertices, size_t vertexCount, size_t stride,
+                                            std::vector<uint32_t>& indices, std::vector<uint8_t>& out,
+                                            uint32_t maxVertices = kMaxShortIndexVertices);
+
+  /*!
+   * Builds a coarser level of detail by collapsing edges in order of their quadric error (Garland
+   * and Heckbert 1997), until at most targetIndexCount indices are left or the next collapse would
+   * cost more than maxError. Only the indices change, each vertex collapsing onto another, so every
+   * level can share the vertex buffer of the full mesh. Vertices on open edges are locked, which
+   * keeps the outline, uv seams and the cuts between chunks where they were, so neighbouring pieces
+   * still meet.
+   * @param error receives the largest error of a collapse made, roughly how far the surface moved
+   * @return the triangles of the level, in no particular order
+   */
+  static std::vector<uint32_t> simplify(std::span<const uint32_t> indices, const uint8_t* vertices,
+                                        size_t vertexCount, size_t stride, size_t targetIndexCount,
+                                        float maxError, float* error = nullptr);
+
+  /*!
+   * Simulates a FIFO post-transform cache over the triangles.
+   */
+  static CacheStats analyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount,
+                                       uint32_t cacheSize = kDefaultCacheSize);
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_MESHOPTIMIZER_H
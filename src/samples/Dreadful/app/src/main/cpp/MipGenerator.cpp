@@ -0,0 +1,140 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+using namespace std;
+
+// Linear values have 14 bits, so the sum of a 2x2 box still fits in 16
+static constexpr uint32_t kLinearMax = (1 << 14) - 1;
+
+// Scratch kept per thread between images, enough for 512x512. Larger images free theirs when done,
+// so a worker doesn't hold on to its largest texture's worth for good.
+static constexpr size_t kMaxKeptScratchBytes = 4 * 1024 * 1024;
+
+struct ConversionTables {
+  uint16_t srgbToLinear[256];
+  uint16_t unormToLinear[256];
+  uint8_t linearToSrgb[kLinearMax + 1];
+  uint8_t linearToUnorm[kLinearMax + 1];
+};
+
+static const ConversionTables& getTables() {
+  static const ConversionTables* tables = [] {
+    auto* t = new ConversionTables;
+    for (uint32_t i = 0; i < 256; i++) {
+      float c = i / 255.f;
+      float linear = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+      t->srgbToLinear[i] = uint16_t(lroundf(linear * kLinearMax));
+      t->unormToLinear[i] = uint16_t((i * kLinearMax + 127) / 255);
+    }
+    for (uint32_t i = 0; i <= kLinearMax; i++) {
+      float c = float(i) / kLinearMax;
+      float srgb = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+      t->linearToSrgb[i] = uint8_t(lroundf(srgb * 255.f));
+      t->linearToUnorm[i] = uint8_t((i * 255 + kLinearMax / 2) / kLinearMax);
+    }
+    return t;
+  }();
+  return *tables;
+}
+
+/*!
+ * Averages 2x2 blocks of two source rows into a row of dstWidth pixels. Columns past the edge of a
+ * 1 pixel wide source repeat the last one.
+ */
+static void downsampleRow(const uint16_t* row0, const uint16_t* row1, uint32_t srcWidth, uint16_t* out,
+                          uint32_t dstWidth) {
+  for (uint32_t x = 0; x < dstWidth; x++) {
+    uint32_t x0 = min(x * 2, srcWidth - 1) * 4;
+    uint32_t x1 = min(x * 2 + 1, srcWidth - 1) * 4;
+    for (uint32_t c = 0; c < 4; c++) {
+      out[x * 4 + c] = uint16_t((row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c] + 2) >> 2);
+    }
+  }
+}
+
+size_t MipGenerator::getChainSize(uint32_t width, uint32_t height) {
+  size_t size = size_t(width) * height * 4;
+  while (width > 1 || height > 1) {
+    width = max(1u, width / 2);
+    height = max(1u, height / 2);
+    size += size_t(width) * height * 4;
+  }
+  return size;
+}
+
+vector<MipGenerator::Level> MipGenerator::generate(const uint8_t* source, uint32_t width, uint32_t height,
+                                                   uint8_t* level0, uint8_t* mips, const Options& options) {
+  const auto& tables = getTables();
+  const uint16_t* toLinear = options.srgb ? tables.srgbToLinear : tables.unormToLinear;
+  const uint8_t* fromLinear = options.srgb ? tables.linearToSrgb : tables.linearToUnorm;
+
+  // Two linear levels at a time: the one being read and the one being written. Kept per thread
+  // so workers reuse it from one texture to the next, up to kMaxKeptScratchBytes.
+  size_t pixels = size_t(width) * height;
+  size_t halfPixels = size_t(max(1u, width / 2)) * max(1u, height / 2);
+  static thread_local vector<uint16_t> scratch;
+  if (scratch.size() < (pixels + halfPixels) * 4) {
+    scratch.resize((pixels + halfPixels) * 4);
+  }
+  uint16_t* src = scratch.data();
+  uint16_t* dst = src + pixels * 4;
+
+  // Whole pixels are written so a mapped level0 sees one sequential store each
+  bool copy = level0 != source;
+  for (size_t i = 0; i < pixels; i++) {
+    const uint8_t* p = source + i * 4;
+    uint8_t out[4] = {p[0], p[1], p[2], p[3]};
+    uint32_t alpha = p[3];
+    for (int c = 0; c < 3; c++) {
+      uint32_t linear = toLinear[p[c]];
+      if (options.premultiply) {
+        linear = (linear * alpha + 127) / 255;
+        out[c] = fromLinear[linear];
+      }
+      src[i * 4 + c] = uint16_t(linear);
+    }
+    src[i * 4 + 3] = tables.unormToLinear[alpha];
+    if (options.premultiply || copy) {
+      memcpy(level0 + i * 4, out, 4);
+    }
+  }
+
+  vector<Level> levels;
+  size_t offset = 0;
+  uint32_t srcWidth = width;
+  uint32_t srcHeight = height;
+  while (srcWidth > 1 || srcHeight > 1) {
+    uint32_t dstWidth = max(1u, srcWidth / 2);
+    uint32_t dstHeight = max(1u, srcHeight / 2);
+    for (uint32_t y = 0; y < dstHeight; y++) {
+      const uint16_t* row0 = src + size_t(min(y * 2, srcHeight - 1)) * srcWidth * 4;
+      const uint16_t* row1 = src + size_t(min(y * 2 + 1, srcHeight - 1)) * srcWidth * 4;
+      uint16_t* out = dst + size_t(y) * dstWidth * 4;
+      downsampleRow(row0, row1, srcWidth, out, dstWidth);
+    }
+
+    Level level = {dstWidth, dstHeight, offset, size_t(dstWidth) * dstHeight * 4};
+    uint8_t* encoded = mips + offset;
+    for (size_t i = 0; i < size_t(dstWidth) * dstHeight; i++) {
+      encoded[i * 4 + 0] = fromLinear[dst[i * 4 + 0]];
+      encoded[i * 4 + 1] = fromLinear[dst[i * 4 + 1]];
+      encoded[i * 4 + 2] = fromLinear[dst[i * 4 + 2]];
+      encoded[i * 4 + 3] = tables.linearToUnorm[dst[i * 4 + 3]];
+    }
+    levels.push_back(level);
+    offset += level.size;
+
+    // the level just written is the next source; the old source has room for anything smaller
+    swap(src, dst);
+    srcWidth = dstWidth;
+    srcHeight = dstHeight;
+  }
+  if (scratch.size() * sizeof(uint16_t) > kMaxKeptScratchBytes) {
+    scratch = {};
+  }
+  return levels;
+}
@@ -0,0 +1,68 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MIPGENERATOR_H
+#define ANDROIDGLINVESTIGATIONS_MIPGENERATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Builds RGBA8 mip chains on the CPU so the GL thread only uploads, into immutable storage, instead
+ * of calling glGenerateMipmap. Safe to call from worker threads; nothing here touches GL.
+ *
+ * Filtering is gamma correct: level 0 is converted once to 14 bit linear values (premultiplying
+ * color by alpha on the way if asked), every smaller level is a 2x2 box filter of the one above in
+ * that linear space, and each level is encoded back to 8 bits as it's produced. The conversions
+ * are table lookups, and converting level 0 takes most of the time; the box filter is a small part
+ * of it, so it's plain scalar code.
+ */
+class MipGenerator {
+ public:
+  struct Level {
+    uint32_t width;
+    uint32_t height;
+    size_t offset;
+    size_t size;
+  };
+
+  struct Options {
+    // color channels are sRGB encoded, so they're filtered after decoding to linear
+    bool srgb = true;
+    // multiply color by alpha, level 0 included, for blending with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+    bool premultiply = true;
+  };
+
+  /*!
+   * @return the bytes of an RGBA8 image and all its mips
+   */
+  static size_t getChainSize(uint32_t width, uint32_t height);
+
+  /*!
+   * @return the bytes of the levels below an RGBA8 image
+   */
+  static size_t getMipsSize(uint32_t width, uint32_t height) {
+    return getChainSize(width, height) - size_t(width) * height * 4;
+  }
+
+  /*!
+   * Premultiplies level 0 in place if asked, then writes every smaller level down to 1x1 into mips,
+   * tightly packed one after the other.
+   * @param level0 tightly packed RGBA8 rows
+   * @param mips getMipsSize bytes; it may directly follow level0. Only written, never read, so
+   * it can be a mapped pixel buffer.
+   * @return the levels written, largest first, with offsets relative to mips
+   */
+  static std::vector<Level> generate(uint8_t* level0, uint32_t width, uint32_t height, uint8_t* mips,
+                                     const Options& options) {
+    return generate(level0, width, height, level0, mips, options);
+  }
+
+  /*!
+   * The same, but level 0 is read from source and written, premultiplied if asked, to level0, so
+   * the image can be decoded into cached memory while level0 and mips are a mapped pixel buffer
+   * that's only ever written. source may be level0.
+   */
+  static std::vector<Level> generate(const uint8_t* source, uint32_t width, uint32_t height, uint8_t* level0,
+                                     uint8_t* mips, const Options& options);
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_MIPGENERATOR_H
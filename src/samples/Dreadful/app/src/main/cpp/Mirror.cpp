@@ -0,0 +1,264 @@
+#include "Mirror.h"
+
+#include <EGL/eglext.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+std::unique_ptr<Mirror> Mirror::create(EGLDisplay display, EGLConfig eglConfig, EGLContext ctx, EGLSurface restoreSurface,
+                                       ANativeWindow* window, const Config& config) {
+  unique_ptr<Mirror> mirror(new Mirror(display, ctx, restoreSurface, config));
+  mirror->config_.interval = max(1u, config.interval);
+  mirror->config_.scale = clamp(config.scale, 0.05f, 1.f);
+
+  if (window && config.toWindow) {
+    // The rendered images are sRGB encoded, so ask for an sRGB window to keep the blit from
+    // decoding them. Fall back to a plain window if that's not supported.
+    const EGLint srgbAttribs[] = {EGL_GL_COLORSPACE_KHR, EGL_GL_COLORSPACE_SRGB_KHR, EGL_NONE};
+    auto nativeWindow = reinterpret_cast<EGLNativeWindowType>(window);
+    mirror->windowSurface_ = eglCreateWindowSurface(display, eglConfig, nativeWindow, srgbAttribs);
+    if (mirror->windowSurface_ == EGL_NO_SURFACE) {
+      mirror->windowSurface_ = eglCreateWindowSurface(display, eglConfig, nativeWindow, nullptr);
+    }
+    if (mirror->windowSurface_ == EGL_NO_SURFACE) {
+      aout << "Mirror: eglCreateWindowSurface() failed, mirroring offscreen only" << endl;
+    } else if (eglMakeCurrent(display, mirror->windowSurface_, mirror->windowSurface_, ctx) == EGL_FALSE) {
+      aout << "Mirror: eglMakeCurrent() with the window failed, mirroring offscreen only" << endl;
+      eglDestroySurface(display, mirror->windowSurface_);
+      mirror->windowSurface_ = EGL_NO_SURFACE;
+    } else {
+      // never let the mirror wait for the display's vsync
+      eglSwapInterval(display, 0);
+    }
+  }
+
+  if (config.record) {
+    if (mkdir(config.recordDirectory.c_str(), 0755) != 0 && errno != EEXIST) {
+      aout << "Mirror: can't create " << config.recordDirectory << ", not recording" << endl;
+      mirror->config_.record = false;
+    } else {
+      mirror->writer_ = thread(&Mirror::writerLoop, mirror.get());
+    }
+  }
+
+  glGenFramebuffers(1, &mirror->readFbo_);
+  return mirror;
+}
+
+Mirror::~Mirror() {
+  if (writer_.joinable()) {
+    {
+      lock_guard<mutex> lock(writeMutex_);
+      stopWriter_ = true;
+    }
+    writeCv_.notify_one();
+    writer_.join();
+  }
+
+  for (auto& rb : readbacks_) {
+    if (rb.fence) {
+      glDeleteSync(rb.fence);
+    }
+    if (rb.pbo) {
+      glDeleteBuffers(1, &rb.pbo);
+    }
+  }
+  if (target_) {
+    glDeleteTextures(1, &target_);
+  }
+  glDeleteFramebuffers(1, &readFbo_);
+
+  if (windowSurface_ != EGL_NO_SURFACE) {
+    eglMakeCurrent(display_, restoreSurface_, restoreSurface_, context_);
+    eglDestroySurface(display_, windowSurface_);
+  }
+}
+
+bool Mirror::beginFrame() {
+  pollReadbacks();
+  return (++frameCount_ % config_.interval) == 0;
+}
+
+void Mirror::addPass(RenderGraph& graph, RenderGraph::ResourceHandle source, uint32_t sourceWidth, uint32_t sourceHeight) {
+  // source region in texels
+  GLint x0 = 0;
+  GLint x1 = sourceWidth;
+  if (config_.source == Source::LeftEye) {
+    x1 = sourceWidth / 2;
+  } else if (config_.source == Source::RightEye) {
+    x0 = sourceWidth / 2;
+  }
+  uint32_t width = max(1u, static_cast<uint32_t>((x1 - x0) * config_.scale));
+  uint32_t height = max(1u, static_cast<uint32_t>(sourceHeight * config_.scale));
+  ensureTarget(width, height);
+
+  auto target = graph.importTexture("mirror", target_, width, height, GL_SRGB8_ALPHA8);
+  graph
+      .addPass("mirror",
+               [this, &graph, source, x0, x1, sourceHeight, width, height]() {
+                 GLint drawFbo = 0;
+                 glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &drawFbo);
+                 glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo_);
+                 glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, graph.getTexture(source), 0);
+                 glBlitFramebuffer(x0, 0, x1, sourceHeight, 0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+                 glBindFramebuffer(GL_READ_FRAMEBUFFER, drawFbo);
+               })
+      .read(source)
+      .writeColor(target);
+}
+
+void Mirror::present() {
+  mirroredCount_++;
+  if (windowSurface_ != EGL_NO_SURFACE) {
+    blitToWindow();
+  }
+  if (config_.record) {
+    startReadback();
+  }
+}
+
+void Mirror::ensureTarget(uint32_t width, uint32_t height) {
+  if (target_ && width == targetWidth_ && height == targetHeight_) {
+    return;
+  }
+  if (target_) {
+    glDeleteTextures(1, &target_);
+  }
+  glGenTextures(1, &target_);
+  glBindTexture(GL_TEXTURE_2D, target_);
+  glTexStorage2D(GL_TEXTURE_2D, 1, GL_SRGB8_ALPHA8, width, height);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  targetWidth_ = width;
+  targetHeight_ = height;
+}
+
+void Mirror::blitToWindow() {
+  EGLint windowWidth = 0;
+  EGLint windowHeight = 0;
+  eglQuerySurface(display_, windowSurface_, EGL_WIDTH, &windowWidth);
+  eglQuerySurface(display_, windowSurface_, EGL_HEIGHT, &windowHeight);
+  if (windowWidth <= 0 || windowHeight <= 0) {
+    return;
+  }
+
+  // letterbox to keep the aspect ratio
+  float scale = min(float(windowWidth) / targetWidth_, float(windowHeight) / targetHeight_);
+  GLint w = static_cast<GLint>(targetWidth_ * scale);
+  GLint h = static_cast<GLint>(targetHeight_ * scale);
+  GLint x = (windowWidth - w) / 2;
+  GLint y = (windowHeight - h) / 2;
+
+  const float black[] = {0, 0, 0, 1};
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glViewport(0, 0, windowWidth, windowHeight);
+  glClearBufferfv(GL_COLOR, 0, black);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo_);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target_, 0);
+  glBlitFramebuffer(0, 0, targetWidth_, targetHeight_, x, y, x + w, y + h, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  eglSwapBuffers(display_, windowSurface_);
+}
+
+void Mirror::startReadback() {
+  auto& rb = readbacks_[nextReadback_];
+  if (rb.fence) {
+    // every buffer is still waiting on the GPU, skip this capture rather than stall
+    droppedCount_++;
+    if ((droppedCount_ % 60) == 1) {
+      aout << "Mirror: dropped " << droppedCount_ << " captures waiting on readbacks" << endl;
+    }
+    return;
+  }
+
+  size_t bytes = size_t(targetWidth_) * targetHeight_ * 4;
+  if (!rb.pbo) {
+    glGenBuffers(1, &rb.pbo);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+  if (rb.width != targetWidth_ || rb.height != targetHeight_) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, bytes, nullptr, GL_STREAM_READ);
+    rb.width = targetWidth_;
+    rb.height = targetHeight_;
+  }
+
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, readFbo_);
+  glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target_, 0);
+  glReadPixels(0, 0, targetWidth_, targetHeight_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  rb.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  rb.frame = mirroredCount_;
+  nextReadback_ = (nextReadback_ + 1) % kReadbackSlots;
+}
+
+void Mirror::pollReadbacks() {
+  // Oldest first. Fences signal in order, so stop at the first one that hasn't.
+  for (size_t i = 0; i < kReadbackSlots; i++) {
+    auto& rb = readbacks_[(nextReadback_ + i) % kReadbackSlots];
+    if (!rb.fence) {
+      continue;
+    }
+    GLenum status = glClientWaitSync(rb.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      break;
+    }
+    glDeleteSync(rb.fence);
+    rb.fence = nullptr;
+
+    size_t bytes = size_t(rb.width) * rb.height * 4;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, rb.pbo);
+    auto* mapped = static_cast<const uint8_t*>(glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, bytes, GL_MAP_READ_BIT));
+    if (mapped) {
+      PendingWrite write{vector<uint8_t>(mapped, mapped + bytes), rb.width, rb.height, rb.frame};
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      {
+        lock_guard<mutex> lock(writeMutex_);
+        writes_.push_back(std::move(write));
+      }
+      writeCv_.notify_one();
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  }
+}
+
+void Mirror::writerLoop() {
+  for (;;) {
+    PendingWrite write;
+    {
+      unique_lock<mutex> lock(writeMutex_);
+      writeCv_.wait(lock, [this] { return stopWriter_ || !writes_.empty(); });
+      if (writes_.empty()) {
+        return;
+      }
+      write = std::move(writes_.front());
+      writes_.pop_front();
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "/mirror_%06u.pam", write.frame);
+    string path = config_.recordDirectory + name;
+    FILE* f = fopen(path.c_str(), "wb");
+    if (!f) {
+      aout << "Mirror: can't write " << path << endl;
+      continue;
+    }
+    fprintf(f, "P7\nWIDTH %u\nHEIGHT %u\nDEPTH 4\nMAXVAL 255\nTUPLTYPE RGB_ALPHA\nENDHDR\n", write.width, write.height);
+    // GL rows are bottom up
+    size_t rowBytes = size_t(write.width) * 4;
+    for (uint32_t y = write.height; y-- > 0;) {
+      fwrite(write.pixels.data() + y * rowBytes, 1, rowBytes, f);
+    }
+    fclose(f);
+  }
+}
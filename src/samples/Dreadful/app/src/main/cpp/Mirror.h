@@ -0,0 +1,142 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MIRROR_H
+#define ANDROIDGLINVESTIGATIONS_MIRROR_H
+
+#include <EGL/egl.h>
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "RenderGraph.h"
+
+struct ANativeWindow;
+
+/*!
+ * Shows what the app renders without a headset. Every few frames a pass downsamples part of the
+ * rendered image into an offscreen target. The target is shown in the Android window, and it can
+ * optionally be recorded as a numbered sequence of PAM images.
+ *
+ * Recording reads the target back through a ring of pixel pack buffers. Each read is guarded by a
+ * glFenceSync and only mapped once the fence has signaled, so the XR frame never waits on the GPU.
+ * If every buffer is still in flight, that capture is dropped. Files are written on a worker thread.
+ */
+class Mirror {
+ public:
+  /*!
+   * The part of the rendered image to mirror.
+   */
+  enum class Source {
+    Full,      // the whole image, e.g. the quad layer contents
+    LeftEye,   // left half of a side by side stereo image
+    RightEye,  // right half of a side by side stereo image
+  };
+
+  struct Config {
+    Source source = Source::Full;
+    // mirror every interval-th frame
+    uint32_t interval = 2;
+    // size of the offscreen target relative to the source region
+    float scale = 0.5f;
+    // show the target in the Android window, if there is one
+    bool toWindow = true;
+    // write the target out as <recordDirectory>/mirror_NNNNNN.pam
+    bool record = false;
+    std::string recordDirectory;
+  };
+
+  /*!
+   * Creates a mirror. If window is non-null and config.toWindow is set, the window surface is made
+   * current with ctx for the lifetime of the mirror. restoreSurface is made current again on
+   * destruction.
+   */
+  static std::unique_ptr<Mirror> create(EGLDisplay display, EGLConfig eglConfig, EGLContext ctx, EGLSurface restoreSurface,
+                                        ANativeWindow* window, const Config& config);
+
+  ~Mirror();
+
+  /*!
+   * Advances the frame counter.
+   * @return true if this frame should be mirrored, in which case call addPass and present
+   */
+  bool beginFrame();
+
+  /*!
+   * Adds a pass to the graph that downsamples source into the offscreen target.
+   */
+  void addPass(RenderGraph& graph, RenderGraph::ResourceHandle source, uint32_t sourceWidth, uint32_t sourceHeight);
+
+  /*!
+   * Call after the graph has executed. Shows the target in the window and starts a readback.
+   */
+  void present();
+
+  /*!
+   * Maps any readbacks whose fences have signaled and hands them to the writer thread. Cheap when
+   * nothing is ready; call once per frame.
+   */
+  void pollReadbacks();
+
+  /*!
+   * @return the offscreen target, valid after the first mirrored frame
+   */
+  GLuint getTexture() const {
+    return target_;
+  }
+
+ private:
+  static constexpr size_t kReadbackSlots = 3;
+
+  struct Readback {
+    GLuint pbo = 0;
+    GLsync fence = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t frame = 0;
+  };
+
+  struct PendingWrite {
+    std::vector<uint8_t> pixels;
+    uint32_t width;
+    uint32_t height;
+    uint32_t frame;
+  };
+
+  Mirror(EGLDisplay display, EGLContext ctx, EGLSurface restoreSurface, const Config& config)
+      : display_(display), context_(ctx), restoreSurface_(restoreSurface), config_(config) {}
+
+  void ensureTarget(uint32_t width, uint32_t height);
+  void blitToWindow();
+  void startReadback();
+  void writerLoop();
+
+  EGLDisplay display_;
+  EGLContext context_;
+  EGLSurface restoreSurface_;
+  EGLSurface windowSurface_ = EGL_NO_SURFACE;
+  Config config_;
+
+  uint32_t frameCount_ = 0;
+  uint32_t mirroredCount_ = 0;
+  uint32_t droppedCount_ = 0;
+
+  GLuint target_ = 0;
+  uint32_t targetWidth_ = 0;
+  uint32_t targetHeight_ = 0;
+  GLuint readFbo_ = 0;
+  std::array<Readback, kReadbackSlots> readbacks_;
+  size_t nextReadback_ = 0;
+
+  std::thread writer_;
+  std::mutex writeMutex_;
+  std::condition_variable writeCv_;
+  std::deque<PendingWrite> writes_;
+  bool stopWriter_ = false;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_MIRROR_H
@@ -1,61 +1,51 @@
 #ifndef ANDROIDGLINVESTIGATIONS_MODEL_H
 #define ANDROIDGLINVESTIGATIONS_MODEL_H
 
-#include <vector>
+#include <memory>
 
+#include "Mesh.h"
+#include "SceneGraph.h"
 #include "TextureAsset.h"
 
-union Vector3 {
-  struct {
-    float x, y, z;
-  };
-  float idx[3];
-};
-
-union Vector2 {
-  struct {
-    float x, y;
-  };
-  struct {
-    float u, v;
-  };
-  float idx[2];
-};
-
-struct Vertex {
-  constexpr Vertex(const Vector3& inPosition, const Vector2& inUV) : position(inPosition), uv(inUV) {}
-
-  Vector3 position;
-  Vector2 uv;
-};
-
-typedef uint16_t Index;
-
+/*!
+ * A submesh of a mesh and the texture it's drawn with. Both are shared, typically with a
+ * ResourceCache, and stay resident for as long as the model holds them. The submesh's levels of
+ * detail come with it, see LodSelector. Its transform is a SceneGraph node.
+ */
 class Model {
  public:
-  inline Model(std::vector<Vertex> vertices, std::vector<Index> indices, std::shared_ptr<TextureAsset> spTexture)
-      : vertices_(std::move(vertices)), indices_(std::move(indices)), spTexture_(std::move(spTexture)) {}
-
-  inline const Vertex* getVertexData() const {
-    return vertices_.data();
+  /*!
+   * @param node where the model is in the renderer's scene, or kNoNode to draw it untransformed
+   */
+  inline Model(std::shared_ptr<Mesh> spMesh, std::shared_ptr<TextureAsset> spTexture, uint32_t submesh = 0,
+               SceneGraph::Node node = SceneGraph::kNoNode)
+      : spMesh_(std::move(spMesh)), spTexture_(std::move(spTexture)), submesh_(submesh), node_(node) {}
+
+  inline const Mesh& getMesh() const {
+    return *spMesh_;
   }
 
-  inline const size_t getIndexCount() const {
-    return indices_.size();
+  inline const Mesh::Submesh& getSubmesh() const {
+    return spMesh_->getSubmeshes()[submesh_];
   }
 
-  inline const Index* getIndexData() const {
-    return indices_.data();
+  inline uint32_t getSubmeshIndex() const {
+    return submesh_;
   }
 
   inline const TextureAsset& getTexture() const {
     return *spTexture_;
   }
 
+  inline SceneGraph::Node getNode() const {
+    return node_;
+  }
+
  private:
-  std::vector<Vertex> vertices_;
-  std::vector<Index> indices_;
+  std::shared_ptr<Mesh> spMesh_;
   std::shared_ptr<TextureAsset> spTexture_;
+  uint32_t submesh_;
+  SceneGraph::Node node_;
 };
 
-#endif  // ANDROIDGLINVESTIGATIONS_MODEL_H
\ No newline at end of file
+#endif  // ANDROIDGLINVESTIGATIONS_MODEL_H
@@ -0,0 +1,182 @@
+#include "ModelBatch.h"
+
+#include <cstddef>
+#include <string>
+
+#include "AndroidOut.h"
+#include "FramePacer.h"
+#include "Shader.h"
+
+using namespace std;
+
+// Both shaders follow a #version line, and a TEXTURE_ARRAY define when drawing from an array
+static const char* batchVertex = R"vertex(
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+layout(location = 2) in vec4 inRow0;
+layout(location = 3) in vec4 inRow1;
+layout(location = 4) in vec4 inRow2;
+layout(location = 5) in vec4 inUVRect;
+layout(location = 6) in float inLayer;
+
+out vec2 fragUV;
+flat out float fragLayer;
+
+uniform mat4 uViewProjection;
+uniform vec4 uDequantize[3];
+
+void main() {
+    vec4 p = vec4(inPosition * uDequantize[0].xyz + uDequantize[1].xyz, 1.0);
+    fragUV = inUVRect.xy + (inUV * uDequantize[2].xy + uDequantize[2].zw) * inUVRect.zw;
+    fragLayer = inLayer;
+    gl_Position = uViewProjection * vec4(dot(inRow0, p), dot(inRow1, p), dot(inRow2, p), 1.0);
+}
+)vertex";
+
+static const char* batchFragment = R"fragment(
+precision mediump float;
+
+in vec2 fragUV;
+flat in float fragLayer;
+
+#ifdef TEXTURE_ARRAY
+uniform mediump sampler2DArray uTexture;
+#else
+uniform sampler2D uTexture;
+#endif
+
+out vec4 outColor;
+
+void main() {
+#ifdef TEXTURE_ARRAY
+    outColor = texture(uTexture, vec3(fragUV, fragLayer));
+#else
+    outColor = texture(uTexture, fragUV);
+#endif
+}
+)fragment";
+
+std::unique_ptr<ModelBatch> ModelBatch::create(shared_ptr<Mesh> mesh, shared_ptr<TextureAsset> texture,
+                                               uint32_t frameCount, uint32_t maxInstances) {
+  unique_ptr<ModelBatch> batch(new ModelBatch(std::move(mesh), std::move(texture), frameCount, maxInstances));
+
+  string header = "#version 300 es\n";
+  if (batch->texture_->getTarget() == GL_TEXTURE_2D_ARRAY) {
+    header += "#define TEXTURE_ARRAY\n";
+  }
+  GLuint vertex = Shader::loadShader(GL_VERTEX_SHADER, header + batchVertex);
+  GLuint fragment = Shader::loadShader(GL_FRAGMENT_SHADER, header + batchFragment);
+  if (vertex && fragment) {
+    batch->program_ = Shader::linkProgram({vertex, fragment});
+  }
+  glDeleteShader(vertex);
+  glDeleteShader(fragment);
+  if (!batch->program_) {
+    aout << "ModelBatch: failed to build the shader" << endl;
+    return nullptr;
+  }
+  batch->viewProjectionUniform_ = glGetUniformLocation(batch->program_, "uViewProjection");
+
+  // The mesh never changes, so neither does its dequantization
+  glUseProgram(batch->program_);
+  batch->mesh_->setDequantizeUniform(glGetUniformLocation(batch->program_, "uDequantize"),
+                                     batch->mesh_->getSubmeshes().front());
+  glUseProgram(0);
+
+  // The mesh attributes never change. The instance attributes point into a different region of the
+  // stream buffer every frame, so they're set in draw().
+  const auto& m = *batch->mesh_;
+  glGenVertexArrays(1, &batch->vao_);
+  glBindVertexArray(batch->vao_);
+  m.bindAttributes({kLocationPosition, kLocationUV, -1, -1}, m.getSubmeshes().front());
+  for (GLuint location = kLocationRow0; location <= kLocationLayer; location++) {
+    glVertexAttribDivisor(location, 1);
+    glEnableVertexAttribArray(location);
+  }
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m.getIndexBuffer());
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return batch;
+}
+
+ModelBatch::ModelBatch(shared_ptr<Mesh> mesh, shared_ptr<TextureAsset> texture, uint32_t frameCount,
+                       uint32_t maxInstances)
+    : mesh_(std::move(mesh)), texture_(std::move(texture)), instances_(maxInstances * sizeof(Instance), frameCount) {}
+
+ModelBatch::~ModelBatch() {
+  glDeleteVertexArrays(1, &vao_);
+  glDeleteProgram(program_);
+}
+
+void ModelBatch::begin(const FramePacer& pacer) {
+  instances_.beginFrame(pacer.getFrame(), pacer.getCompletedFrame());
+  instanceCount_ = 0;
+  dropped_ = 0;
+  recording_ = true;
+}
+
+void ModelBatch::end() {
+  if (!recording_) {
+    return;
+  }
+  instances_.endFrame();
+  recording_ = false;
+  if (dropped_) {
+    aout << "ModelBatch: dropped " << dropped_ << " instances, the per-frame buffer is full" << endl;
+  }
+}
+
+void ModelBatch::add(const r3::Matrix4f& transform, uint32_t layer) {
+  add(transform, layer, r3::Vec4f(0.f, 0.f, 1.f, 1.f));
+}
+
+void ModelBatch::add(const r3::Matrix4f& transform, uint32_t layer, const r3::Vec4f& uvRect) {
+  if (!recording_ || instances_.getUsed() + sizeof(Instance) > instances_.getCapacity()) {
+    dropped_++;
+    return;
+  }
+  auto* instance = static_cast<Instance*>(instances_.allocate(sizeof(Instance)));
+  if (!instance) {
+    // not mapped this frame
+    dropped_++;
+    return;
+  }
+  for (int r = 0; r < 3; r++) {
+    for (int c = 0; c < 4; c++) {
+      instance->transform[r * 4 + c] = transform(r, c);
+    }
+  }
+  instance->uvRect[0] = uvRect.x;
+  instance->uvRect[1] = uvRect.y;
+  instance->uvRect[2] = uvRect.z;
+  instance->uvRect[3] = uvRect.w;
+  instance->layer = float(layer);
+  instanceCount_++;
+}
+
+void ModelBatch::draw(const r3::Matrix4f& viewProjection) const {
+  if (recording_ || instanceCount_ == 0 || !texture_->isResident()) {
+    return;
+  }
+  glUseProgram(program_);
+  glUniformMatrix4fv(viewProjectionUniform_, 1, GL_FALSE, viewProjection.GetValue());
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(texture_->getTarget(), texture_->getTextureID());
+
+  auto base = instances_.getRegionOffset();
+  auto attribute = [base](size_t offset) { return reinterpret_cast<const void*>(base + offset); };
+  glBindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, instances_.getBuffer());
+  for (GLuint r = 0; r < 3; r++) {
+    glVertexAttribPointer(kLocationRow0 + r, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+                          attribute(offsetof(Instance, transform) + r * 4 * sizeof(float)));
+  }
+  glVertexAttribPointer(kLocationUVRect, 4, GL_FLOAT, GL_FALSE, sizeof(Instance), attribute(offsetof(Instance, uvRect)));
+  glVertexAttribPointer(kLocationLayer, 1, GL_FLOAT, GL_FALSE, sizeof(Instance), attribute(offsetof(Instance, layer)));
+  const auto& submesh = mesh_->getSubmeshes().front();
+  glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(submesh.indexCount), submesh.indexType,
+                          reinterpret_cast<const void*>(submesh.getIndexOffset()), static_cast<GLsizei>(instanceCount_));
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindTexture(texture_->getTarget(), 0);
+}
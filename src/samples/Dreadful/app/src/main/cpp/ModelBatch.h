@@ -0,0 +1,119 @@
+#ifndef ANDROIDGLINVESTIGATIONS_MODELBATCH_H
+#define ANDROIDGLINVESTIGATIONS_MODELBATCH_H
+
+#include <GLES3/gl3.h>
+
+#include <cstdint>
+#include <memory>
+
+#include "Mesh.h"
+#include "StreamBuffer.h"
+#include "TextureAsset.h"
+#include "linear.h"
+
+class FramePacer;
+
+/*!
+ * Draws many copies of one mesh that differ only in placement and in which image they show, with a
+ * single glDrawElementsInstanced and a single texture bind per frame. Drawing them as separate
+ * Models costs a draw and a bind each.
+ *
+ * The images are packed together ahead of time, either as the layers of a GL_TEXTURE_2D_ARRAY
+ * (ktx2conv --array) or as regions of one 2D atlas. Each instance picks its layer and a UV rect,
+ * which scales and offsets the mesh's UVs. Arrays are preferred since mips of one layer never bleed
+ * into another.
+ *
+ * Instances are submitted between begin() and end() into a per-frame StreamBuffer. Instances past
+ * the capacity are dropped and counted, like DebugDraw does.
+ */
+class ModelBatch {
+ public:
+  /*!
+   * Per instance vertex data
+   */
+  struct Instance {
+    float transform[12];  // rows of the 3x4 object to world matrix
+    float uvRect[4];      // u and v offset, then u and v scale
+    float layer;          // array layer, ignored for 2D textures
+  };
+
+  /*!
+   * @param mesh the mesh whose first submesh every instance draws
+   * @param texture a 2D array texture, or a 2D atlas
+   * @param frameCount frames the instance buffer is split into, at least the frames in flight
+   * @param maxInstances instances that can be drawn per frame
+   * @return a batch, or null if the shader failed to build
+   */
+  static std::unique_ptr<ModelBatch> create(std::shared_ptr<Mesh> mesh, std::shared_ptr<TextureAsset> texture,
+                                            uint32_t frameCount, uint32_t maxInstances = 1024);
+
+  ~ModelBatch();
+
+  /*!
+   * Starts a frame. Must be called after FramePacer::beginFrame() of the frame that will draw it.
+   */
+  void begin(const FramePacer& pacer);
+
+  /*!
+   * Adds an instance showing the whole of a layer.
+   */
+  void add(const r3::Matrix4f& transform, uint32_t layer);
+
+  /*!
+   * Adds an instance showing part of a layer, e.g. one image of an atlas.
+   * @param uvRect u and v offset, then u and v scale, of the region in normalized coordinates
+   */
+  void add(const r3::Matrix4f& transform, uint32_t layer, const r3::Vec4f& uvRect);
+
+  /*!
+   * Ends a frame. Call before any GL work that draws from it.
+   */
+  void end();
+
+  /*!
+   * Draws every instance submitted this frame with one call, if the texture is resident.
+   * @param viewProjection the matrix taking world positions to clip space
+   */
+  void draw(const r3::Matrix4f& viewProjection) const;
+
+  const TextureAsset& getTexture() const {
+    return *texture_;
+  }
+
+  /*!
+   * @return instances submitted this frame
+   */
+  uint32_t getInstanceCount() const {
+    return instanceCount_;
+  }
+
+  /*!
+   * @return instances dropped this frame because the buffer was full
+   */
+  uint32_t getDroppedCount() const {
+    return dropped_;
+  }
+
+ private:
+  static constexpr GLuint kLocationPosition = 0;
+  static constexpr GLuint kLocationUV = 1;
+  static constexpr GLuint kLocationRow0 = 2;
+  static constexpr GLuint kLocationUVRect = 5;
+  static constexpr GLuint kLocationLayer = 6;
+
+  ModelBatch(std::shared_ptr<Mesh> mesh, std::shared_ptr<TextureAsset> texture, uint32_t frameCount,
+             uint32_t maxInstances);
+
+  std::shared_ptr<Mesh> mesh_;
+  std::shared_ptr<TextureAsset> texture_;
+  StreamBuffer instances_;
+  uint32_t instanceCount_ = 0;
+  uint32_t dropped_ = 0;
+  bool recording_ = false;
+
+  GLuint program_ = 0;
+  GLint viewProjectionUniform_ = -1;
+  GLuint vao_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_MODELBATCH_H
@@ -0,0 +1,133 @@
+#include "PixelBufferPool.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+//! Smallest buffer handed out, so tiny textures share a size class
+static constexpr size_t kMinCapacity = 64 * 1024;
+
+PixelBufferPool::PixelBufferPool(size_t maxIdleBytes) : maxIdleBytes_(maxIdleBytes) {}
+
+PixelBufferPool::~PixelBufferPool() {
+  for (auto& idle : idle_) {
+    glDeleteSync(idle.fence);
+  }
+  glDeleteBuffers(static_cast<GLsizei>(owned_.size()), owned_.data());
+}
+
+//! The size class size falls in
+static size_t roundCapacity(size_t size) {
+  size_t capacity = kMinCapacity;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  return capacity;
+}
+
+PixelBufferPool::Buffer PixelBufferPool::acquire(size_t size) {
+  size_t capacity = roundCapacity(size);
+
+  Buffer buffer;
+  for (size_t i = 0; i < idle_.size(); i++) {
+    if (idle_[i].capacity != capacity) {
+      continue;
+    }
+    // still being read by an upload the GPU hasn't run yet
+    GLenum status = glClientWaitSync(idle_[i].fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+      continue;
+    }
+    glDeleteSync(idle_[i].fence);
+    buffer.id = idle_[i].id;
+    buffer.capacity = capacity;
+    stats_.idleBytes -= capacity;
+    stats_.reused++;
+    idle_.erase(idle_.begin() + i);
+    break;
+  }
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+  if (!buffer) {
+    glGenBuffers(1, &buffer.id);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, capacity, nullptr, GL_STREAM_DRAW);
+    buffer.capacity = capacity;
+    owned_.push_back(buffer.id);
+    stats_.ownedBytes += capacity;
+    stats_.created++;
+  }
+  buffer.mapped = static_cast<uint8_t*>(
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, capacity, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (!buffer.mapped) {
+    aout << "PixelBufferPool: can't map a " << capacity << " byte buffer" << endl;
+    release(buffer);
+    return {};
+  }
+  return buffer;
+}
+
+bool PixelBufferPool::unmap(Buffer& buffer) {
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.id);
+  if (!buffer.mapped) {
+    return true;
+  }
+  buffer.mapped = nullptr;
+  return glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER) == GL_TRUE;
+}
+
+void PixelBufferPool::release(Buffer& buffer) {
+  if (!buffer) {
+    return;
+  }
+  unmap(buffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  idle_.push_back({buffer.id, buffer.capacity, glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0)});
+  stats_.idleBytes += buffer.capacity;
+  buffer = {};
+  while (stats_.idleBytes > maxIdleBytes_ && !idle_.empty()) {
+    deleteIdle(0);
+  }
+}
+
+void PixelBufferPool::deleteIdle(size_t index) {
+  auto idle = idle_[index];
+  idle_.erase(idle_.begin() + index);
+  // deleting a buffer the GPU still reads from is fine, GL keeps it alive until it's done
+  glDeleteSync(idle.fence);
+  glDeleteBuffers(1, &idle.id);
+  owned_.erase(find(owned_.begin(), owned_.end(), idle.id));
+  stats_.idleBytes -= idle.capacity;
+  stats_.ownedBytes -= idle.capacity;
+}
+
+vector<uint8_t> PixelBufferPool::acquireScratch(size_t size) {
+  size_t capacity = roundCapacity(size);
+  for (size_t i = 0; i < idleScratch_.size(); i++) {
+    if (idleScratch_[i].size() == capacity) {
+      vector<uint8_t> scratch = std::move(idleScratch_[i]);
+      idleScratch_.erase(idleScratch_.begin() + i);
+      stats_.idleScratchBytes -= capacity;
+      return scratch;
+    }
+  }
+  return vector<uint8_t>(capacity);
+}
+
+void PixelBufferPool::releaseScratch(vector<uint8_t>&& scratch) {
+  if (scratch.empty()) {
+    return;
+  }
+  stats_.idleScratchBytes += scratch.size();
+  idleScratch_.push_back(std::move(scratch));
+  scratch = {};
+  while (stats_.idleScratchBytes > maxIdleBytes_ && !idleScratch_.empty()) {
+    stats_.idleScratchBytes -= idleScratch_.front().size();
+    idleScratch_.erase(idleScratch_.begin());
+  }
+}
@@ -0,0 +1,108 @@
+#ifndef ANDROIDGLINVESTIGATIONS_PIXELBUFFERPOOL_H
+#define ANDROIDGLINVESTIGATIONS_PIXELBUFFERPOOL_H
+
+#include <GLES3/gl3.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*!
+ * Recycles GL_PIXEL_UNPACK_BUFFERs for texture uploads. A loader acquires a mapped buffer, fills it
+ * (on any thread, the mapping stays valid until it's unmapped), then uploads from buffer offsets so
+ * the driver copies on its side instead of from client memory. KTX2 files are read straight into
+ * the mapping. Images are decoded into scratch from acquireScratch(), because building their mips
+ * reads level 0 back, and MipGenerator writes the whole chain from there into the mapping. Released
+ * buffers are fenced and only handed out again once the GPU has finished reading them.
+ *
+ * Sizes are rounded up to a power of two so buffers fit many textures. All calls are GL thread only.
+ */
+class PixelBufferPool {
+ public:
+  struct Buffer {
+    GLuint id = 0;
+    size_t capacity = 0;
+    // valid from acquire() until unmap() or release()
+    uint8_t* mapped = nullptr;
+
+    explicit operator bool() const {
+      return id != 0;
+    }
+  };
+
+  struct Stats {
+    uint32_t created = 0;
+    uint32_t reused = 0;
+    size_t ownedBytes = 0;
+    size_t idleBytes = 0;
+    // scratch memory waiting to be handed out again
+    size_t idleScratchBytes = 0;
+  };
+
+  /*!
+   * @param maxIdleBytes idle buffers past this are deleted, oldest first
+   */
+  explicit PixelBufferPool(size_t maxIdleBytes);
+  PixelBufferPool(const PixelBufferPool&) = delete;
+  PixelBufferPool& operator=(const PixelBufferPool&) = delete;
+
+  /*!
+   * Deletes every buffer, including ones not released yet. Anything still writing to a mapping
+   * has to be stopped first.
+   */
+  ~PixelBufferPool();
+
+  /*!
+   * @return a buffer of at least size bytes mapped for writing, or an empty one if mapping failed.
+   * GL_PIXEL_UNPACK_BUFFER is left unbound.
+   */
+  Buffer acquire(size_t size);
+
+  /*!
+   * Unmaps the buffer and leaves it bound to GL_PIXEL_UNPACK_BUFFER, ready to upload from.
+   * @return false if the data was lost while mapped (GL_FALSE from glUnmapBuffer), and it has to be
+   * written again
+   */
+  bool unmap(Buffer& buffer);
+
+  /*!
+   * Gives the buffer back once the uploads reading it have been issued. Unmaps it if needed.
+   */
+  void release(Buffer& buffer);
+
+  /*!
+   * @return heap memory of at least size bytes to decode into where the result has to be read back
+   * before it goes into a mapping, as mapped memory is slow to read. It can be used on any thread
+   * until it's given back with releaseScratch().
+   */
+  std::vector<uint8_t> acquireScratch(size_t size);
+
+  /*!
+   * Keeps scratch for the next acquireScratch(), or frees it if idle scratch would pass the pool's
+   * maxIdleBytes.
+   */
+  void releaseScratch(std::vector<uint8_t>&& scratch);
+
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+ private:
+  struct Idle {
+    GLuint id;
+    size_t capacity;
+    GLsync fence;
+  };
+
+  void deleteIdle(size_t index);
+
+  size_t maxIdleBytes_;
+  Stats stats_;
+  // oldest first
+  std::vector<Idle> idle_;
+  std::vector<GLuint> owned_;
+  // oldest first
+  std::vector<std::vector<uint8_t>> idleScratch_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_PIXELBUFFERPOOL_H
@@ -0,0 +1,359 @@
+#include "RenderGraph.h"
+
+#include <algorithm>
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeColor(ResourceHandle resource, const float* clearColor) {
+  Write w{resource, clearColor != nullptr, {0, 0, 0, 0}, 1.0f};
+  if (clearColor) {
+    copy(clearColor, clearColor + 4, w.clearColor.begin());
+  }
+  graph_.passes_[passIndex_].writes.push_back(w);
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::writeDepth(ResourceHandle resource, bool clear, float clearDepth) {
+  graph_.passes_[passIndex_].writes.push_back({resource, clear, {0, 0, 0, 0}, clearDepth});
+  return *this;
+}
+
+RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(ResourceHandle resource) {
+  graph_.passes_[passIndex_].reads.push_back(resource);
+  return *this;
+}
+
+RenderGraph::~RenderGraph() {
+  for (auto& p : physicals_) {
+    if (p.desc.sampled) {
+      glDeleteTextures(1, &p.name);
+    } else {
+      glDeleteRenderbuffers(1, &p.name);
+    }
+  }
+  if (fbo_) {
+    glDeleteFramebuffers(1, &fbo_);
+  }
+}
+
+void RenderGraph::reset() {
+  resources_.clear();
+  passes_.clear();
+  compiled_ = false;
+}
+
+RenderGraph::ResourceHandle RenderGraph::importTexture(const char* name, GLuint texture, uint32_t width, uint32_t height,
+                                                       GLenum internalFormat) {
+  resources_.push_back({name, {width, height, internalFormat, true}, true, texture, 0, 0, 0});
+  return static_cast<ResourceHandle>(resources_.size() - 1);
+}
+
+RenderGraph::ResourceHandle RenderGraph::createTransient(const char* name, const AttachmentDesc& desc) {
+  resources_.push_back({name, desc, false, 0, 0, 0, 0});
+  return static_cast<ResourceHandle>(resources_.size() - 1);
+}
+
+RenderGraph::PassBuilder RenderGraph::addPass(const char* name, std::function<void()> execute) {
+  Pass pass{};
+  pass.name = name;
+  pass.execute = std::move(execute);
+  passes_.push_back(std::move(pass));
+  compiled_ = false;
+  return PassBuilder(*this, static_cast<uint32_t>(passes_.size() - 1));
+}
+
+bool RenderGraph::compile() {
+  compiled_ = false;
+  constexpr uint32_t kUnused = ~0u;
+  for (auto& r : resources_) {
+    r.firstPass = kUnused;
+    r.lastPass = 0;
+  }
+
+  // Lifetimes are the span of passes that touch a resource.
+  for (uint32_t i = 0; i < passes_.size(); i++) {
+    auto& pass = passes_[i];
+    uint32_t colorCount = 0;
+    uint32_t depthCount = 0;
+    for (const auto& w : pass.writes) {
+      if (!validHandle(w.resource)) {
+        aout << "RenderGraph: pass " << pass.name << " writes an invalid resource" << endl;
+        return false;
+      }
+      if (isDepthFormat(resources_[w.resource].desc.internalFormat)) {
+        depthCount++;
+      } else {
+        colorCount++;
+      }
+    }
+    if (pass.writes.empty() || colorCount > kMaxColorAttachments || depthCount > 1) {
+      aout << "RenderGraph: pass " << pass.name << " has an unsupported attachment set" << endl;
+      return false;
+    }
+    for (auto r : pass.reads) {
+      if (!validHandle(r) || !resources_[r].desc.sampled) {
+        aout << "RenderGraph: pass " << pass.name << " reads a resource that can't be sampled" << endl;
+        return false;
+      }
+      for (const auto& w : pass.writes) {
+        if (w.resource == r) {
+          aout << "RenderGraph: pass " << pass.name << " reads and writes " << resources_[r].name << endl;
+          return false;
+        }
+      }
+    }
+    auto touch = [&](ResourceHandle h) {
+      auto& res = resources_[h];
+      res.firstPass = min(res.firstPass, i);
+      res.lastPass = max(res.lastPass, i);
+    };
+    for (const auto& w : pass.writes) {
+      touch(w.resource);
+    }
+    for (auto r : pass.reads) {
+      // a transient read before anything wrote it has undefined contents
+      if (!resources_[r].imported && resources_[r].firstPass == kUnused) {
+        aout << "RenderGraph: pass " << pass.name << " reads " << resources_[r].name << " before it is written" << endl;
+        return false;
+      }
+      touch(r);
+    }
+  }
+
+  releaseIdlePhysicals();
+
+  // Assign transients to physical memory in order of first use, so a physical resource whose last
+  // user has already run can be handed to the next transient that needs the same description.
+  vector<ResourceHandle> transients;
+  for (ResourceHandle h = 0; h < resources_.size(); h++) {
+    if (!resources_[h].imported && resources_[h].firstPass != kUnused) {
+      transients.push_back(h);
+    }
+  }
+  sort(transients.begin(), transients.end(),
+       [this](ResourceHandle a, ResourceHandle b) { return resources_[a].firstPass < resources_[b].firstPass; });
+  for (auto h : transients) {
+    auto& res = resources_[h];
+    res.physical = acquirePhysical(res.desc, res.firstPass, res.lastPass);
+  }
+
+  // Transients start with undefined contents, so their first write either clears or tells the driver
+  // not to bother loading. After their last use there is nothing worth storing.
+  for (uint32_t i = 0; i < passes_.size(); i++) {
+    auto& pass = passes_[i];
+    pass.discardBefore.clear();
+    pass.discardAfter.clear();
+    for (const auto& w : pass.writes) {
+      const auto& res = resources_[w.resource];
+      GLenum point = attachmentPoint(pass, w.resource);
+      if (res.firstPass == i && !w.clear && !res.imported) {
+        pass.discardBefore.push_back(point);
+      }
+      if (res.lastPass == i && !res.imported) {
+        pass.discardAfter.push_back(point);
+      }
+    }
+  }
+
+  compiled_ = true;
+  return true;
+}
+
+void RenderGraph::execute() {
+  if (!compiled_) {
+    return;
+  }
+  if (!fbo_) {
+    glGenFramebuffers(1, &fbo_);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo_);
+
+  for (uint32_t i = 0; i < passes_.size(); i++) {
+    const auto& pass = passes_[i];
+    attach(pass);
+
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+      aout << "RenderGraph: framebuffer for pass " << pass.name << " not complete: 0x" << std::hex << status << std::dec
+           << endl;
+      continue;
+    }
+
+    const auto& desc = resources_[pass.writes.front().resource].desc;
+    glViewport(0, 0, desc.width, desc.height);
+
+    if (!pass.discardBefore.empty()) {
+      glInvalidateFramebuffer(GL_FRAMEBUFFER, pass.discardBefore.size(), pass.discardBefore.data());
+    }
+
+    GLint drawBuffer = 0;
+    for (const auto& w : pass.writes) {
+      const auto& res = resources_[w.resource];
+      bool isFirstWrite = res.firstPass == i;
+      if (isDepthFormat(res.desc.internalFormat)) {
+        if (isFirstWrite && w.clear) {
+          glDepthMask(GL_TRUE);
+          glClearBufferfv(GL_DEPTH, 0, &w.clearDepth);
+        }
+      } else {
+        if (isFirstWrite && w.clear) {
+          glClearBufferfv(GL_COLOR, drawBuffer, w.clearColor.data());
+        }
+        drawBuffer++;
+      }
+    }
+
+    pass.execute();
+
+    if (!pass.discardAfter.empty()) {
+      glInvalidateFramebuffer(GL_FRAMEBUFFER, pass.discardAfter.size(), pass.discardAfter.data());
+    }
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint RenderGraph::getTexture(ResourceHandle resource) const {
+  if (!compiled_ || !validHandle(resource) || !resources_[resource].desc.sampled) {
+    return 0;
+  }
+  const auto& res = resources_[resource];
+  return res.imported ? res.importedTexture : physicals_[res.physical].name;
+}
+
+bool RenderGraph::isDepthFormat(GLenum internalFormat) {
+  switch (internalFormat) {
+    case GL_DEPTH_COMPONENT16:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+    case GL_DEPTH32F_STENCIL8:
+      return true;
+    default:
+      return false;
+  }
+}
+
+size_t RenderGraph::bytesPerTexel(GLenum internalFormat) {
+  switch (internalFormat) {
+    case GL_R8:
+      return 1;
+    case GL_RG8:
+    case GL_RGB565:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGBA16F:
+    case GL_DEPTH32F_STENCIL8:
+      return 8;
+    default:
+      // RGBA8, sRGB8_A8, R11F_G11F_B10F and the 24/32 bit depth formats
+      return 4;
+  }
+}
+
+GLenum RenderGraph::attachmentPoint(const Pass& pass, ResourceHandle resource) const {
+  GLenum format = resources_[resource].desc.internalFormat;
+  if (isDepthFormat(format)) {
+    return (format == GL_DEPTH24_STENCIL8 || format == GL_DEPTH32F_STENCIL8) ? GL_DEPTH_STENCIL_ATTACHMENT
+                                                                              : GL_DEPTH_ATTACHMENT;
+  }
+  GLenum point = GL_COLOR_ATTACHMENT0;
+  for (const auto& w : pass.writes) {
+    if (w.resource == resource) {
+      break;
+    }
+    if (!isDepthFormat(resources_[w.resource].desc.internalFormat)) {
+      point++;
+    }
+  }
+  return point;
+}
+
+uint32_t RenderGraph::acquirePhysical(const AttachmentDesc& desc, uint32_t firstPass, uint32_t lastPass) {
+  for (uint32_t i = 0; i < physicals_.size(); i++) {
+    auto& p = physicals_[i];
+    if (p.desc == desc && (!p.usedThisFrame || p.busyUntilPass < firstPass)) {
+      p.usedThisFrame = true;
+      p.busyUntilPass = lastPass;
+      return i;
+    }
+  }
+
+  Physical p{desc, 0, lastPass, true, 0};
+  if (desc.sampled) {
+    glGenTextures(1, &p.name);
+    glBindTexture(GL_TEXTURE_2D, p.name);
+    glTexStorage2D(GL_TEXTURE_2D, 1, desc.internalFormat, desc.width, desc.height);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+  } else {
+    glGenRenderbuffers(1, &p.name);
+    glBindRenderbuffer(GL_RENDERBUFFER, p.name);
+    glRenderbufferStorage(GL_RENDERBUFFER, desc.internalFormat, desc.width, desc.height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  }
+  poolBytes_ += size_t(desc.width) * desc.height * bytesPerTexel(desc.internalFormat);
+  physicals_.push_back(p);
+  aout << "RenderGraph: allocated " << desc.width << "x" << desc.height << " attachment, pool is now " << poolBytes_
+       << " bytes" << endl;
+  return static_cast<uint32_t>(physicals_.size() - 1);
+}
+
+void RenderGraph::releaseIdlePhysicals() {
+  auto idle = [this](Physical& p) {
+    p.idleFrames = p.usedThisFrame ? 0 : p.idleFrames + 1;
+    p.usedThisFrame = false;
+    if (p.idleFrames <= kMaxIdleFrames) {
+      return false;
+    }
+    if (p.desc.sampled) {
+      glDeleteTextures(1, &p.name);
+    } else {
+      glDeleteRenderbuffers(1, &p.name);
+    }
+    poolBytes_ -= size_t(p.desc.width) * p.desc.height * bytesPerTexel(p.desc.internalFormat);
+    return true;
+  };
+  physicals_.erase(remove_if(physicals_.begin(), physicals_.end(), idle), physicals_.end());
+}
+
+void RenderGraph::attach(const Pass& pass) {
+  array<GLenum, kMaxColorAttachments> drawBuffers{GL_NONE, GL_NONE, GL_NONE, GL_NONE};
+  GLsizei colorCount = 0;
+  bool hasDepth = false;
+  GLenum depthPoint = GL_DEPTH_ATTACHMENT;
+  for (const auto& w : pass.writes) {
+    const auto& res = resources_[w.resource];
+    GLenum point = attachmentPoint(pass, w.resource);
+    if (isDepthFormat(res.desc.internalFormat)) {
+      hasDepth = true;
+      depthPoint = point;
+    } else {
+      drawBuffers[colorCount++] = point;
+    }
+    if (res.imported) {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, point, GL_TEXTURE_2D, res.importedTexture, 0);
+    } else if (res.desc.sampled) {
+      glFramebufferTexture2D(GL_FRAMEBUFFER, point, GL_TEXTURE_2D, physicals_[res.physical].name, 0);
+    } else {
+      glFramebufferRenderbuffer(GL_FRAMEBUFFER, point, GL_RENDERBUFFER, physicals_[res.physical].name);
+    }
+  }
+
+  // Detach whatever the previous pass left behind so it can't be written by accident.
+  for (GLsizei c = colorCount; c < GLsizei(kMaxColorAttachments); c++) {
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + c, GL_RENDERBUFFER, 0);
+  }
+  if (!hasDepth || depthPoint == GL_DEPTH_ATTACHMENT) {
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_STENCIL_ATTACHMENT, GL_RENDERBUFFER, 0);
+  }
+  if (!hasDepth) {
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
+  }
+  glDrawBuffers(colorCount, drawBuffers.data());
+}
@@ -0,0 +1,186 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RENDERGRAPH_H
+#define ANDROIDGLINVESTIGATIONS_RENDERGRAPH_H
+
+#include <GLES3/gl3.h>
+
+#include <array>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*!
+ * A small render graph for the GL renderer. Each frame the renderer declares its passes and the
+ * attachments they read and write. compile() works out the lifetime of every attachment, aliases
+ * transient attachments whose lifetimes don't overlap onto the same GL objects, and decides where
+ * clears and glInvalidateFramebuffer calls belong. execute() then runs the passes in order.
+ *
+ * The physical GL objects backing transient attachments live in a pool that survives from frame to
+ * frame, so a steady-state frame allocates nothing. Pool entries that go unused for a while are
+ * released.
+ */
+class RenderGraph {
+ public:
+  using ResourceHandle = uint32_t;
+  static constexpr ResourceHandle kInvalidResource = ~0u;
+
+  /*!
+   * Describes a transient attachment. Attachments with the same description can share memory.
+   */
+  struct AttachmentDesc {
+    uint32_t width;
+    uint32_t height;
+    GLenum internalFormat;
+    // sampled attachments are backed by a texture so a later pass can read them, the rest use
+    // renderbuffers
+    bool sampled;
+
+    bool operator==(const AttachmentDesc& rhs) const {
+      return width == rhs.width && height == rhs.height && internalFormat == rhs.internalFormat &&
+             sampled == rhs.sampled;
+    }
+  };
+
+  /*!
+   * Returned by addPass to declare what the pass touches.
+   */
+  class PassBuilder {
+   public:
+    /*!
+     * The pass renders into this color attachment. If clearColor is given and this is the first
+     * pass to write the attachment this frame, the graph clears it before the pass runs.
+     */
+    PassBuilder& writeColor(ResourceHandle resource, const float* clearColor = nullptr);
+
+    /*!
+     * The pass renders into this depth attachment, optionally clearing it on first write.
+     */
+    PassBuilder& writeDepth(ResourceHandle resource, bool clear = true, float clearDepth = 1.0f);
+
+    /*!
+     * The pass samples this attachment as a texture. It must have been created as sampled.
+     */
+    PassBuilder& read(ResourceHandle resource);
+
+   private:
+    friend class RenderGraph;
+    PassBuilder(RenderGraph& graph, uint32_t passIndex) : graph_(graph), passIndex_(passIndex) {}
+
+    RenderGraph& graph_;
+    uint32_t passIndex_;
+  };
+
+  RenderGraph() = default;
+  RenderGraph(const RenderGraph&) = delete;
+  RenderGraph& operator=(const RenderGraph&) = delete;
+  ~RenderGraph();
+
+  /*!
+   * Drops the passes and resources declared for the previous frame. The physical pool is kept.
+   */
+  void reset();
+
+  /*!
+   * Makes an externally owned texture (e.g. a swapchain image) available to passes. Imported
+   * attachments are never aliased and their contents are always stored at the end of the frame.
+   */
+  ResourceHandle importTexture(const char* name, GLuint texture, uint32_t width, uint32_t height, GLenum internalFormat);
+
+  /*!
+   * Declares an attachment that only lives within this frame. Its contents are undefined before
+   * the first pass that writes it and are discarded after the last pass that uses it.
+   */
+  ResourceHandle createTransient(const char* name, const AttachmentDesc& desc);
+
+  /*!
+   * Adds a pass. Passes execute in the order they are added.
+   * @param execute issues the pass's draw calls with its framebuffer bound and viewport set
+   */
+  PassBuilder addPass(const char* name, std::function<void()> execute);
+
+  /*!
+   * Computes lifetimes and assigns physical memory. Returns false if the graph is malformed, in
+   * which case execute() does nothing.
+   */
+  bool compile();
+
+  /*!
+   * Runs the compiled passes.
+   */
+  void execute();
+
+  /*!
+   * @return the GL texture backing a sampled attachment, valid between compile() and the end of
+   * the frame. Use this from a pass that declared a read of the attachment.
+   */
+  GLuint getTexture(ResourceHandle resource) const;
+
+  /*!
+   * @return bytes of GPU memory currently held by the transient pool.
+   */
+  size_t getPoolBytes() const {
+    return poolBytes_;
+  }
+
+ private:
+  static constexpr uint32_t kMaxColorAttachments = 4;
+
+  // Pool entries that haven't been used for this many frames are released.
+  static constexpr uint32_t kMaxIdleFrames = 120;
+
+  struct Resource {
+    std::string name;
+    AttachmentDesc desc;
+    bool imported;
+    GLuint importedTexture;
+    uint32_t physical;   // index into physicals_ once compiled, transient only
+    uint32_t firstPass;  // first pass that uses the resource
+    uint32_t lastPass;   // last pass that uses the resource
+  };
+
+  struct Write {
+    ResourceHandle resource;
+    bool clear;
+    std::array<float, 4> clearColor;
+    float clearDepth;
+  };
+
+  struct Pass {
+    std::string name;
+    std::function<void()> execute;
+    std::vector<Write> writes;
+    std::vector<ResourceHandle> reads;
+
+    // computed by compile()
+    GLbitfield clearMask;
+    std::vector<GLenum> discardBefore;
+    std::vector<GLenum> discardAfter;
+  };
+
+  struct Physical {
+    AttachmentDesc desc;
+    GLuint name;
+    uint32_t busyUntilPass;  // aliasing bookkeeping for the frame being compiled
+    bool usedThisFrame;
+    uint32_t idleFrames;
+  };
+
+  static bool isDepthFormat(GLenum internalFormat);
+  static size_t bytesPerTexel(GLenum internalFormat);
+
+  bool validHandle(ResourceHandle resource) const {
+    return resource < resources_.size();
+  }
+  GLenum attachmentPoint(const Pass& pass, ResourceHandle resource) const;
+  uint32_t acquirePhysical(const AttachmentDesc& desc, uint32_t firstPass, uint32_t lastPass);
+  void releaseIdlePhysicals();
+  void attach(const Pass& pass);
+
+  std::vector<Resource> resources_;
+  std::vector<Pass> passes_;
+  std::vector<Physical> physicals_;
+  size_t poolBytes_ = 0;
+  bool compiled_ = false;
+  GLuint fbo_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_RENDERGRAPH_H
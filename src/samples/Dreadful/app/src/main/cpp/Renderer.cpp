@@ -4,10 +4,19 @@
 #include <android/imagedecoder.h>
 #include <game-activity/native_app_glue/android_native_app_glue.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <future>
 #include <memory>
+#include <thread>
 #include <vector>
 
 #include "AndroidOut.h"
+#include "FrustumCuller.h"
+#include "GlbAsset.h"
+#include "MeshFile.h"
 #include "Shader.h"
 #include "TextureAsset.h"
 
@@ -46,10 +55,12 @@ in vec2 inUV;
 out vec2 fragUV;
 
 uniform mat4 uProjection;
+// position scale and offset, then uv scale and offset, for quantized meshes
+uniform vec4 uDequantize[3];
 
 void main() {
-    fragUV = inUV;
-    gl_Position = uProjection * vec4(inPosition, 1.0);
+    fragUV = inUV * uDequantize[2].xy + uDequantize[2].zw;
+    gl_Position = uProjection * vec4(inPosition * uDequantize[0].xyz + uDequantize[1].xyz, 1.0);
 }
 )vertex";
 
@@ -60,10 +71,18 @@ precision mediump float;
 in vec2 fragUV;
 
 uniform sampler2D uTexture;
+// while levels of detail cross-fade, the share of pixels to draw: > 0 for the incoming level, < 0 for
+// the outgoing one, which draws the pixels the other leaves
+uniform float uFade;
 
 out vec4 outColor;
 
 void main() {
+    // interleaved gradient noise, a threshold per pixel evenly spread over [0, 1)
+    float threshold = fract(52.9829189 * fract(dot(gl_FragCoord.xy, vec2(0.06711056, 0.00583715))));
+    if ((uFade > 0.0 && threshold >= uFade) || (uFade < 0.0 && threshold < -uFade)) {
+        discard;
+    }
     outColor = texture(uTexture, fragUV);
 }
 )fragment";
@@ -86,7 +105,156 @@ static constexpr float kProjectionNearPlane = -1.f;
  */
 static constexpr float kProjectionFarPlane = 1.f;
 
+/*!
+ * Number of extra instances of the demo model to draw through the GpuCuller. Set this to something
+ * in the 10k - 100k range to benchmark GPU culling with indirect draws against CPU culling with a
+ * draw per instance. The renderer alternates between the two and logs the CPU time spent in each
+ * and, with GL_EXT_disjoint_timer_query, the GPU time of its compute pass and draws.
+ */
+static constexpr uint32_t kCullingBenchmarkInstances = 0;
+
+/*!
+ * How many frames each culling path runs before the benchmark switches to the other one.
+ */
+static constexpr uint32_t kCullingBenchmarkFrames = 300;
+
+/*!
+ * Mirror the rendered image to the Android window every other frame at half resolution. Set
+ * kMirrorRecord to also write every mirrored frame to <internal data path>/mirror.
+ */
+static constexpr uint32_t kMirrorInterval = 2;
+static constexpr float kMirrorScale = 0.5f;
+static constexpr bool kMirrorRecord = false;
+
+/*!
+ * How many frames the CPU may submit before waiting for the GPU to finish the oldest. Lower is less
+ * latency, higher lets CPU and GPU overlap more.
+ */
+static constexpr uint32_t kMaxFramesInFlight = 2;
+
+/*!
+ * GPU and CPU memory the resource cache may keep textures and meshes in. Resources in use are never
+ * evicted, so this mostly bounds how much unused data stays warm for reuse.
+ */
+static constexpr size_t kResourceCacheBudget = 64 * 1024 * 1024;
+
+/*!
+ * GL thread time per frame that queued uploads, such as the finer mips of streamed textures, may
+ * take. Large uploads are split to fit, and the scheduler's stats are logged whenever its queue
+ * empties to show how close frames came to the budget.
+ */
+static constexpr double kUploadBudgetMs = 1.5;
+
+/*!
+ * Textures are decoded on this many worker threads and uploaded coarsest mip first, the finer
+ * levels within kUploadBudgetMs. Set kTextureStreaming to false to load them synchronously instead.
+ */
+static constexpr bool kTextureStreaming = true;
+static constexpr uint32_t kTextureStreamingThreads = 2;
+
+/*!
+ * Load the square's textures as tasks (see Task.h) that read each file on an IO thread, decode it
+ * on the streaming workers and upload it on the GL thread within kGlTaskBudgetMs a frame, nearest
+ * first. Models show up as their textures arrive. Needs kTextureStreaming for the workers.
+ */
+static constexpr bool kTaskLoading = false;
+static constexpr uint32_t kTaskIoThreads = 1;
+static constexpr double kGlTaskBudgetMs = 1.;
+
+/*!
+ * Upload textures from recycled pixel unpack buffers that their mip chains are written straight
+ * into (see PixelBufferPool), rather than from a heap chain per texture. Idle buffers past
+ * kPixelBufferPoolIdleBytes are freed. Both paths log load time and peak RSS to compare them.
+ */
+static constexpr bool kTextureUploadThroughPixelBuffers = true;
+static constexpr size_t kPixelBufferPoolIdleBytes = 16 * 1024 * 1024;
+
+/*!
+ * Assets are read from this pack (built by src/tools/assetpack) when it's in the apk, and from
+ * individual files otherwise or when the pack lacks them. With kAssetArchiveBenchmark, reading every
+ * entry of the pack is timed at startup against opening each as a separate asset.
+ */
+static constexpr char kAssetArchive[] = "assets.dpak";
+static constexpr bool kAssetArchiveBenchmark = false;
+static constexpr uint32_t kAssetArchiveBenchmarkRuns = 5;
+
+/*!
+ * The mesh createModels() draws, a .dmesh built by src/tools/meshconv.
+ */
+static constexpr char kSquareMesh[] = "square.dmesh";
+
+/*!
+ * Time loading kMeshBenchmarkAsset at startup, straight from the file into GL buffers, against
+ * copying the same data into Vertex and Index vectors and building meshes with Mesh::create, the
+ * way meshes were made in code. The asset isn't shipped; generate a large one with meshconv --grid.
+ */
+static constexpr bool kMeshLoadBenchmark = false;
+static constexpr char kMeshBenchmarkAsset[] = "benchmark.dmesh";
+static constexpr uint32_t kMeshBenchmarkRuns = 3;
+
+/*!
+ * Per-frame work such as culling models runs as jobs on kJobThreads threads, the render thread
+ * included, with up to kJobsPerFrame jobs a frame. Models are culled kCullGrain at a time, so a
+ * scene needs thousands of them before a second thread helps. See src/tools/jobbench for how the
+ * job system scales.
+ */
+static constexpr uint32_t kJobThreads = 4;
+static constexpr uint32_t kJobsPerFrame = 4096;
+static constexpr uint32_t kCullGrain = 1024;
+
+/*!
+ * Levels of detail are picked per model so their error stays under kLodMaxPixelError pixels, see
+ * LodSelector. kLodFadeFrames > 0 dithers between levels over that many frames instead of popping.
+ * The square has none; meshconv --lods generates them.
+ */
+static constexpr float kLodMaxPixelError = 1.f;
+static constexpr float kLodHysteresis = 0.25f;
+static constexpr uint32_t kLodFadeFrames = 0;
+
+/*!
+ * A binary glTF asset to draw next to the square, or empty for none. It's loaded straight from the
+ * file by GlbAsset, which logs how long the parse and the upload took; its images stream in like
+ * any other texture. Needs kTextureStreaming. None is shipped; drop a .glb in the assets to try one.
+ */
+static constexpr char kGlbScene[] = "";
+
+/*!
+ * A strip of UI icons across the top of the view, all drawn from the layers of one array texture
+ * with a single instanced draw. The layers are packed by ktx2conv --array.
+ */
+static constexpr uint32_t kUiIconCount = 32;
+static constexpr uint32_t kUiIconColumns = 16;
+static constexpr float kUiIconSize = 0.2f;
+
 Renderer::~Renderer() {
+  // Tasks hold the pools and this renderer, so they're cancelled and run until they've all unwound
+  for (auto& task : tasks_) {
+    task->cancel();
+  }
+  while (!all_of(tasks_.begin(), tasks_.end(), [](const auto& task) { return task->isDone(); })) {
+    glExecutor_->run();
+    this_thread::yield();
+  }
+  tasks_.clear();
+  ioPool_.reset();
+
+  // GL objects have to go while the context is still current
+  mirror_.reset();
+  debugDraw_.reset();
+  uiBatch_.reset();
+  culler_.reset();
+  models_.clear();
+  resources_.reset();
+  // workers may still be writing into pixel buffers, so they stop first, and queued uploads point
+  // into the streamer
+  workers_.reset();
+  uploadScheduler_.reset();
+  textureStreamer_.reset();
+  pixelBuffers_.reset();
+  archive_.reset();
+  framePacer_.reset();
+  renderGraph_.reset();
+
   if (display_ != EGL_NO_DISPLAY) {
     eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
     if (context_ != EGL_NO_CONTEXT) {
@@ -114,41 +282,113 @@ void Renderer::render(uint32_t imageIndex) {
     return;
   }
 
-  // Configure the fbo
-  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorImages_[imageIndex].textureId, 0);
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthImages_[imageIndex].textureId, 0);
-  // Check FBO completeness
-  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-  if (status != GL_FRAMEBUFFER_COMPLETE) {
-    aout << "Framebuffer not complete: 0x" << std::hex << status << std::dec << endl;
-    return;
+  // Wait here, before touching anything the GPU may still be reading, if we're too far ahead
+  framePacer_->beginFrame();
+  jobs_->beginFrame();
+  if (textureStreamer_ && textureStreamer_->getPendingCount()) {
+    textureStreamer_->update();
+    resources_->trim();
+  }
+  bool uploading = uploadScheduler_->getPendingCount() > 0;
+  uploadScheduler_->run();
+  if (uploading && uploadScheduler_->getPendingCount() == 0) {
+    uploadScheduler_->logStats();
+  }
+  glExecutor_->run();
+  if (debugDraw_) {
+    debugDraw_->begin(*framePacer_);
+    drawDebugGizmos();
+    debugDraw_->end();
+  }
+  if (uiBatch_) {
+    uiBatch_->begin(*framePacer_);
+    drawUi();
+    uiBatch_->end();
   }
 
-  glViewport(0, 0, colorImages_[imageIndex].width, colorImages_[imageIndex].height);
+  const auto& color = colorImages_[imageIndex];
+
+  scene_->update();
+  cullModels();
+  lodSelector_->update(models_, lodViews_, *scene_);
+  if (lodSelector_->getTriangleCount() != lodTriangles_) {
+    lodTriangles_ = lodSelector_->getTriangleCount();
+    aout << "LOD: " << lodTriangles_ << " of " << lodSelector_->getFullTriangleCount() << " triangles" << endl;
+  }
 
   static int frameCount = 0;
   frameCount++;
+  float clearColor[4];
   {
     float t = frameCount / 60.f;
-    glClearColor(sin(1.7212 * t + 1.813) * 0.5f + 0.5f, sin(0.6212 * t + 2.13) * 0.5f + 0.5f,
-                 sin(0.7612 * t + .213) * 0.5f + 0.5f, 0.5f);
+    clearColor[0] = sin(1.7212 * t + 1.813) * 0.5f + 0.5f;
+    clearColor[1] = sin(0.6212 * t + 2.13) * 0.5f + 0.5f;
+    clearColor[2] = sin(0.7612 * t + .213) * 0.5f + 0.5f;
+    clearColor[3] = 0.5f;
   }
 
-  // clear the color and depth buffers
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  // Describe the frame. The graph clears the color and depth buffers on first write and discards
+  // depth once the last pass is done with it.
+  renderGraph_->reset();
+  auto colorTarget =
+      renderGraph_->importTexture("swapchain", color.textureId, color.width, color.height, GL_SRGB8_ALPHA8);
+  auto depthTarget = renderGraph_->createTransient("depth", {color.width, color.height, GL_DEPTH_COMPONENT24, false});
 
   // Render all the models. There's no depth testing in this sample so they're accepted in the
   // order provided. But the sample EGL setup requests a 24 bit depth buffer so you could
   // configure it at the end of initRenderer
-  if (!models_.empty()) {
-    for (const auto& model : models_) {
-      shader_->drawModel(model);
-    }
+  renderGraph_
+      ->addPass("scene",
+                [this]() {
+                  shader_->activate();
+                  for (size_t i = 0; i < models_.size(); i++) {
+                    // streamed textures show up once their coarsest levels are uploaded
+                    if (modelVisibility_[i] && models_[i].getTexture().isResident()) {
+                      auto transform = projection_;
+                      if (models_[i].getNode() != SceneGraph::kNoNode) {
+                        transform = projection_ * scene_->getWorldMatrix(models_[i].getNode());
+                      }
+                      shader_->setProjectionMatrix(transform.m);
+                      for (const auto& draw : lodSelector_->getDraws(i)) {
+                        shader_->drawModel(models_[i], draw.lod, draw.fade);
+                      }
+                    }
+                  }
+                  if (culler_ && culler_->getModel().getTexture().isResident()) {
+                    drawInstances();
+                  }
+                  if (uiBatch_) {
+                    uiBatch_->draw(projection_);
+                  }
+                  if (debugDraw_) {
+                    debugDraw_->draw(projection_);
+                  }
+                })
+      .writeColor(colorTarget, clearColor)
+      .writeDepth(depthTarget);
+
+  bool mirrorFrame = mirror_ && mirror_->beginFrame();
+  if (mirrorFrame) {
+    mirror_->addPass(*renderGraph_, colorTarget, color.width, color.height);
   }
 
-  // Unbind the fbo
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  if (!renderGraph_->compile()) {
+    aout << "Failed to compile the render graph" << endl;
+    framePacer_->endFrame();
+    return;
+  }
+
+  if (culler_) {
+    cullInstances();
+  }
+  renderGraph_->execute();
+  if (mirrorFrame) {
+    mirror_->present();
+  }
+  framePacer_->endFrame();
+  if (culler_) {
+    updateCullingBenchmark();
+  }
 }
 
 void Renderer::initRenderer() {
@@ -251,6 +491,7 @@ void Renderer::initRenderer() {
   }
 
   display_ = display;
+  config_ = config;
   surface_ = vestigialSurface;
   context_ = context;
 
@@ -259,10 +500,12 @@ void Renderer::initRenderer() {
   PRINT_GL_STRING(GL_VERSION);
   PRINT_GL_STRING_AS_LIST(GL_EXTENSIONS);
 
-  // Create a framebuffer object to render to
-  glGenFramebuffers(1, &fbo);
+  framePacer_ = make_unique<FramePacer>(kMaxFramesInFlight);
+
+  // Passes and their attachments are declared per frame in render()
+  renderGraph_ = make_unique<RenderGraph>();
 
-  shader_ = unique_ptr<Shader>(Shader::loadShader(vertex, fragment, "inPosition", "inUV", "uProjection"));
+  shader_ = unique_ptr<Shader>(Shader::loadShader(vertex, fragment, "inPosition", "inUV", "uProjection", "uDequantize", "uFade"));
 
   // Note: there's only one shader in this demo, so I'll activate it here. For a more complex game
   // you'll want to track the active shader and activate/deactivate it as necessary
@@ -271,61 +514,428 @@ void Renderer::initRenderer() {
   // setup any other gl related global states
   glClearColor(CORNFLOWER_BLUE);
 
-  // enable alpha globally for now, you probably don't want to do this in a game
+  // enable alpha globally for now, you probably don't want to do this in a game. Textures are
+  // premultiplied (see MipGenerator), which keeps filtered edges free of dark fringes
   glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
 
   // get some demo models into memory
+  archive_ = AssetArchive::open(app_->activity->assetManager, kAssetArchive);
+  resources_ = make_unique<ResourceCache>(app_->activity->assetManager, kResourceCacheBudget);
+  if (kTextureUploadThroughPixelBuffers) {
+    pixelBuffers_ = make_unique<PixelBufferPool>(kPixelBufferPoolIdleBytes);
+    resources_->setPixelBufferPool(pixelBuffers_.get());
+  }
+  uploadScheduler_ = make_unique<UploadScheduler>(kUploadBudgetMs);
+  glExecutor_ = make_unique<GlExecutor>(kGlTaskBudgetMs);
+  scene_ = make_unique<SceneGraph>();
+  jobs_ = make_unique<JobSystem>(kJobThreads, kJobsPerFrame);
+  lodSelector_ = make_unique<LodSelector>(LodSelector::Config{kLodMaxPixelError, kLodHysteresis, kLodFadeFrames});
+  if (kTextureStreaming) {
+    workers_ = make_unique<WorkerPool>(kTextureStreamingThreads);
+    textureStreamer_ = make_unique<TextureStreamer>(app_->activity->assetManager, *workers_, pixelBuffers_.get(),
+                                                    *uploadScheduler_);
+    textureStreamer_->setArchive(archive_.get());
+    resources_->setStreamer(textureStreamer_.get());
+  }
+  if (kAssetArchiveBenchmark) {
+    runAssetArchiveBenchmark();
+  }
+  if (kMeshLoadBenchmark) {
+    runMeshLoadBenchmark();
+  }
   createModels();
+  createUi();
+  resources_->logStats();
+
+  debugDraw_ = DebugDraw::create(kMaxFramesInFlight);
+
+  Mirror::Config mirrorConfig;
+  mirrorConfig.interval = kMirrorInterval;
+  mirrorConfig.scale = kMirrorScale;
+  mirrorConfig.record = kMirrorRecord;
+  mirrorConfig.recordDirectory = string(app_->activity->internalDataPath) + "/mirror";
+  mirror_ = Mirror::create(display_, config_, context_, surface_, app_->window, mirrorConfig);
 }
 
 /**
  * @brief Create any demo models we want for this demo.
  */
 void Renderer::createModels() {
-  /*
-   * This is a square:
-   * 3 --- 2
-   * |   / |
-   * |  /  |
-   * | /   |
-   * 0 --- 1
-   */
+  // The square is converted from src/samples/Dreadful/art/meshes/square.obj by meshconv
+  auto spSquare = resources_->getMesh(
+      kSquareMesh, [this]() { return Mesh::loadAsset(app_->activity->assetManager, kSquareMesh, archive_.get()); });
+  if (!spSquare) {
+    return;
+  }
+
+  // The square is one node of the scene, its submeshes move with it
+  auto squareNode = scene_->add(r3::Posef());
+
+  // A model per submesh, with the texture its material names. The cache hands out the same texture
+  // for every request of a path, so reusing an image in many models only loads it once.
+  auto submeshes = spSquare->getSubmeshes();
+  for (uint32_t i = 0; i < submeshes.size(); i++) {
+    const auto& texturePath = submeshes[i].texture;
+    if (texturePath.empty()) {
+      continue;
+    }
+    if (kTaskLoading && workers_) {
+      loadModelAsync(spSquare, i, squareNode);
+      continue;
+    }
+    // ETC2 versions are a quarter of the GPU memory; keep the png around for devices that can't use them
+    auto spTexture = resources_->getTexture(texturePath);
+    if (!spTexture && TextureAsset::isKtx2Path(texturePath)) {
+      spTexture = resources_->getTexture(texturePath.substr(0, texturePath.size() - 4) + "png");
+    }
+    if (spTexture) {
+      models_.emplace_back(spSquare, spTexture, i, squareNode);
+    }
+  }
+
+  // The models hold the scene's mesh and textures, so the asset itself can go
+  if (kGlbScene[0] && textureStreamer_) {
+    auto scene = GlbAsset::load(app_->activity->assetManager, kGlbScene, archive_.get(), *textureStreamer_);
+    if (scene) {
+      models_.insert(models_.end(), scene->getModels().begin(), scene->getModels().end());
+    }
+  }
+
+  createBenchmarkInstances();
+}
+
+void Renderer::loadModelAsync(shared_ptr<Mesh> mesh, uint32_t submesh, SceneGraph::Node node) {
+  if (!ioPool_) {
+    ioPool_ = make_unique<WorkerPool>(kTaskIoThreads);
+  }
+  // The view is at the origin, so nearer is a bigger priority
+  const auto& bounds = mesh->getSubmeshes()[submesh].bounds;
+  auto control = make_shared<TaskControl>(-bounds.center.Length());
+  tasks_.push_back(control);
+  TaskExecutors executors{*ioPool_, *workers_, *glExecutor_};
+  auto task = TextureAsset::loadAsync(app_->activity->assetManager, mesh->getSubmeshes()[submesh].texture, executors,
+                                      control);
+  // A texture only comes back on the GL thread, failures and cancellations may finish anywhere
+  spawn(std::move(task), control, [this, mesh, submesh, node](shared_ptr<TextureAsset> texture) {
+    if (texture) {
+      models_.emplace_back(mesh, texture, submesh, node);
+    }
+  });
+}
+
+void Renderer::createUi() {
+  // A unit quad facing +z, with the top of the image at the top
   vector<Vertex> vertices = {
-      Vertex(Vector3{1, 1, 0}, Vector2{0, 0}),    // 0
-      Vertex(Vector3{-1, 1, 0}, Vector2{1, 0}),   // 1
-      Vertex(Vector3{-1, -1, 0}, Vector2{1, 1}),  // 2
-      Vertex(Vector3{1, -1, 0}, Vector2{0, 1})    // 3
+      Vertex(Vector3{-0.5f, -0.5f, 0}, Vector2{0, 1}),  // 0
+      Vertex(Vector3{0.5f, -0.5f, 0}, Vector2{1, 1}),   // 1
+      Vertex(Vector3{0.5f, 0.5f, 0}, Vector2{1, 0}),    // 2
+      Vertex(Vector3{-0.5f, 0.5f, 0}, Vector2{0, 0})    // 3
   };
   vector<Index> indices = {0, 1, 2, 0, 2, 3};
+  auto quad = resources_->getMesh("ui_quad", [&]() { return Mesh::create(vertices, indices); });
+  auto icons = resources_->getTexture("ui_icons.ktx2");
+  if (!quad || !icons) {
+    return;
+  }
+  uiBatch_ = ModelBatch::create(quad, icons, kMaxFramesInFlight, kUiIconCount);
+  if (uiBatch_) {
+    aout << "UI: " << kUiIconCount << " icons from " << icons->getLayerCount()
+         << " array layers in 1 instanced draw and 1 texture bind per frame, instead of " << kUiIconCount
+         << " of each" << endl;
+  }
+}
+
+void Renderer::drawUi() {
+  static int frameCount = 0;
+  frameCount++;
+
+  // rows of icons along the top edge, each pulsing slightly out of step with its neighbours
+  uint32_t layers = uiBatch_->getTexture().getLayerCount();
+  float spacing = kUiIconSize * 1.2f;
+  float left = -spacing * (kUiIconColumns - 1) / 2;
+  float top = kProjectionHalfHeight - spacing;
+  for (uint32_t i = 0; i < kUiIconCount; i++) {
+    float scale = kUiIconSize * (1.f + 0.1f * sin(frameCount / 30.f + i * 0.7f));
+    r3::Vec3f position(left + spacing * (i % kUiIconColumns), top - spacing * (i / kUiIconColumns), 0.f);
+    uiBatch_->add(r3::Matrix4f::Translate(position) * r3::Matrix4f::Scale(scale), i % layers);
+  }
+}
+
+void Renderer::createBenchmarkInstances() {
+  if (kCullingBenchmarkInstances == 0 || models_.empty()) {
+    return;
+  }
+  culler_ = GpuCuller::create(models_.back());
+  if (!culler_) {
+    return;
+  }
+
+  // A grid twice the size of the visible area in each direction, so most instances get culled
+  uint32_t side = static_cast<uint32_t>(ceil(sqrt(float(kCullingBenchmarkInstances))));
+  float extent = 4 * kProjectionHalfHeight;
+  float spacing = extent / side;
+  vector<GpuCuller::Instance> instances;
+  instances.reserve(kCullingBenchmarkInstances);
+  for (uint32_t i = 0; i < kCullingBenchmarkInstances; i++) {
+    r3::Vec3f position(-extent / 2 + spacing * (i % side + 0.5f), -extent / 2 + spacing * (i / side + 0.5f), 0.f);
+    auto transform = r3::Matrix4f::Translate(position) * r3::Matrix4f::Scale(spacing * 0.4f);
+    instances.push_back(culler_->makeInstance(transform));
+  }
+  culler_->setInstances(instances);
+  cullingBenchmark_.gpuCull = GpuTimer::create();
+  cullingBenchmark_.gpuDraw = GpuTimer::create();
+  cullingBenchmark_.cpuDraw = GpuTimer::create();
+  aout << "Culling benchmark: " << culler_->getInstanceCount() << " instances"
+       << (GpuTimer::isSupported() ? "" : ", no GL_EXT_disjoint_timer_query to time the GPU with") << endl;
+}
+
+void Renderer::runAssetArchiveBenchmark() {
+  if (!archive_) {
+    aout << "Asset archive benchmark: " << kAssetArchive << " isn't in the apk" << endl;
+    return;
+  }
+  auto assetManager = app_->activity->assetManager;
+  auto entries = archive_->getEntries();
+  size_t totalBytes = 0;
+  for (const auto& entry : entries) {
+    totalBytes += entry.size;
+  }
+  vector<vector<uint8_t>> buffers(entries.size());
+
+  auto report = [&entries, totalBytes](const char* path, double ms) {
+    aout << "Asset archive benchmark: " << path << ", " << ms << " ms for " << entries.size() << " assets, "
+         << double(totalBytes) / 1e6 / (ms / 1000) << " MB/s" << endl;
+  };
+  auto time = [](auto&& run) {
+    double ms = 0;
+    for (uint32_t i = 0; i < kAssetArchiveBenchmarkRuns; i++) {
+      auto start = chrono::steady_clock::now();
+      run();
+      ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    return ms / kAssetArchiveBenchmarkRuns;
+  };
+
+  // The way assets were loaded before: a lookup and a buffer per file, copied out
+  size_t missing = 0;
+  double ms = time([&] {
+    missing = 0;
+    for (size_t i = 0; i < entries.size(); i++) {
+      string path(archive_->getName(entries[i]));
+      auto asset = AAssetManager_open(assetManager, path.c_str(), AASSET_MODE_BUFFER);
+      if (!asset) {
+        missing++;
+        continue;
+      }
+      buffers[i].resize(AAsset_getLength(asset));
+      memcpy(buffers[i].data(), AAsset_getBuffer(asset), buffers[i].size());
+      AAsset_close(asset);
+    }
+  });
+  if (missing) {
+    aout << "Asset archive benchmark: " << missing << " packed assets aren't also separate files" << endl;
+  }
+  report("one asset per file", ms);
+
+  report("archive", time([&] {
+           for (size_t i = 0; i < entries.size(); i++) {
+             archive_->read(entries[i], buffers[i]);
+           }
+         }));
+
+  if (!workers_) {
+    return;
+  }
+  // Entries are independent, so they decompress in parallel
+  report("archive on workers", time([&] {
+           vector<future<void>> done;
+           for (size_t i = 0; i < entries.size(); i++) {
+             auto finished = make_shared<promise<void>>();
+             done.push_back(finished->get_future());
+             workers_->submit([archive = archive_.get(), entry = &entries[i], buffer = &buffers[i], finished] {
+               archive->read(*entry, *buffer);
+               finished->set_value();
+             });
+           }
+           for (auto& d : done) {
+             d.wait();
+           }
+         }));
+}
 
-  // loads an image and assigns it to the square.
-  //
-  // Note: there is no texture management in this sample, so if you reuse an image be careful not
-  // to load it repeatedly. Since you get a shared_ptr you can safely reuse it in many models.
+void Renderer::runMeshLoadBenchmark() {
   auto assetManager = app_->activity->assetManager;
-  auto spAndroidRobotTexture = TextureAsset::loadAsset(assetManager, "android_robot.png");
+  auto asset = AAssetManager_open(assetManager, kMeshBenchmarkAsset, AASSET_MODE_BUFFER);
+  if (!asset) {
+    aout << "Mesh benchmark: " << kMeshBenchmarkAsset << " isn't in the apk, see meshconv --grid" << endl;
+    return;
+  }
+  MeshFile file;
+  const char* error = nullptr;
+  auto data = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+  if (!data || !MeshFile::parse(data, AAsset_getLength64(asset), file, &error)) {
+    aout << "Mesh benchmark: " << kMeshBenchmarkAsset << ": " << (error ? error : "can't read it") << endl;
+    AAsset_close(asset);
+    return;
+  }
+  double triangles = double(file.header.indexCount) / 3;
+
+  // Both wait for the GPU to have the buffers, since that's when the mesh is usable
+  auto report = [triangles](const char* path, double ms) {
+    aout << "Mesh benchmark: " << path << ", " << ms << " ms for " << triangles / 1e6 << "M triangles, "
+         << triangles / 1e3 / ms << "M triangles/s" << endl;
+  };
+  auto time = [](auto&& run) {
+    double ms = 0;
+    for (uint32_t i = 0; i < kMeshBenchmarkRuns; i++) {
+      auto start = chrono::steady_clock::now();
+      run();
+      glFinish();
+      ms += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    return ms / kMeshBenchmarkRuns;
+  };
+
+  report(".dmesh", time([&] { Mesh::loadAsset(assetManager, kMeshBenchmarkAsset); }));
+  auto format = file.getVertexFormat();
+  report("vectors and Mesh::create", time([&] {
+           for (const auto& submesh : file.submeshes) {
+             auto vertexData = file.getVertexData() + size_t(submesh.baseVertex) * format.stride;
+             auto indexData = file.getIndexData() + size_t(submesh.firstIndex) * sizeof(Index);
+             vector<Vertex> vertices;
+             vertices.reserve(submesh.vertexCount);
+             for (uint32_t i = 0; i < submesh.vertexCount; i++) {
+               auto v = format.decode(vertexData + i * format.stride);
+               vertices.emplace_back(Vector3{v.position[0], v.position[1], v.position[2]}, Vector2{v.uv[0], v.uv[1]});
+             }
+             vector<Index> indices(submesh.indexCount);
+             memcpy(indices.data(), indexData, indices.size() * sizeof(Index));
+             Mesh::create(vertices, indices);
+           }
+         }));
+  AAsset_close(asset);
+}
 
-  // Create a model and put it in the back of the render list.
-  models_.emplace_back(vertices, indices, spAndroidRobotTexture);
+void Renderer::cullModels() {
+  modelSpheres_.resize(models_.size());
+  for (size_t i = 0; i < models_.size(); i++) {
+    auto bounds = models_[i].getSubmesh().bounds;
+    if (models_[i].getNode() != SceneGraph::kNoNode) {
+      bounds.center = scene_->getWorld(models_[i].getNode()).Transform(bounds.center);
+    }
+    modelSpheres_.set(i, bounds);
+  }
+  modelVisibility_.resize(models_.size());
+  JobSystem::Counter culled;
+  jobs_->parallelFor(culled, 0, uint32_t(models_.size()), kCullGrain, [this](uint32_t first, uint32_t last) {
+    frustumCuller_.cull(modelSpheres_, first, last, modelVisibility_);
+  });
+  jobs_->wait(culled);
+}
+
+void Renderer::cullInstances() {
+  if (!useGpuCulling_) {
+    return;
+  }
+  auto& bench = cullingBenchmark_;
+  auto start = chrono::steady_clock::now();
+  if (bench.gpuCull) {
+    bench.gpuCull->begin();
+  }
+  culler_->cull(span(&projection_, 1));
+  if (bench.gpuCull) {
+    bench.gpuCull->end();
+  }
+  bench.cpuMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void Renderer::drawInstances() {
+  auto& bench = cullingBenchmark_;
+  auto& timer = useGpuCulling_ ? bench.gpuDraw : bench.cpuDraw;
+  auto start = chrono::steady_clock::now();
+  if (timer) {
+    timer->begin();
+  }
+  if (useGpuCulling_) {
+    culler_->draw(0, projection_);
+  } else {
+    culler_->drawCpuCulled(projection_);
+  }
+  if (timer) {
+    timer->end();
+  }
+  bench.cpuMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+void Renderer::updateCullingBenchmark() {
+  auto& bench = cullingBenchmark_;
+  for (auto timer : {bench.gpuCull.get(), bench.gpuDraw.get(), bench.cpuDraw.get()}) {
+    if (timer) {
+      timer->collect();
+    }
+  }
+  bench.frames++;
+  if (bench.frames < kCullingBenchmarkFrames) {
+    return;
+  }
+  aout << "Culling benchmark: " << (useGpuCulling_ ? "GPU" : "CPU") << " path, " << culler_->getInstanceCount()
+       << " instances, " << bench.cpuMs / bench.frames << " ms CPU";
+  if (!bench.gpuDraw) {
+    aout << endl;
+  } else if (useGpuCulling_) {
+    aout << ", " << bench.gpuCull->getAverageMs() << " ms GPU culling + " << bench.gpuDraw->getAverageMs()
+         << " ms GPU drawing" << endl;
+  } else {
+    aout << ", " << bench.cpuDraw->getAverageMs() << " ms GPU drawing" << endl;
+  }
+  // Results still in flight are of the path just measured, so they count towards its next turn
+  for (auto timer : {bench.gpuCull.get(), bench.gpuDraw.get(), bench.cpuDraw.get()}) {
+    if (timer) {
+      timer->reset();
+    }
+  }
+  bench.frames = 0;
+  bench.cpuMs = 0;
+  useGpuCulling_ = !useGpuCulling_;
+}
+
+void Renderer::drawDebugGizmos() {
+  static int frameCount = 0;
+  frameCount++;
+
+  // the origin, and a box that spins around the square
+  debugDraw_->axes(r3::Posef(), 0.5f);
+  r3::Posef spin(r3::Quaternionf(r3::Vec3f(0, 1, 0), frameCount / 120.f), r3::Vec3f());
+  debugDraw_->box(spin, r3::Vec3f(1.1f, 1.1f, 0.1f), r3::Vec4ub(255, 255, 0, 255));
+
+  // a translucent panel in the bottom left corner, as UI would use
+  float x = -kProjectionHalfHeight * 0.95f;
+  float y = -kProjectionHalfHeight * 0.95f;
+  debugDraw_->quad(r3::Vec3f(x, y, 0), r3::Vec3f(x + 0.8f, y, 0), r3::Vec3f(x + 0.8f, y + 0.3f, 0),
+                   r3::Vec3f(x, y + 0.3f, 0), r3::Vec4ub(0, 0, 0, 128));
 }
 
 void Renderer::setSwapchainImages(uint32_t width, uint32_t height, const std::span<GLuint>& images) {
-  // Populate the swapchainImages vector with the provided images
+  // Populate the swapchainImages vector with the provided images. Depth is allocated by the render
+  // graph when the first frame is compiled.
   colorImages_.reserve(images.size());
-  depthImages_.reserve(images.size());
   for (auto& image : images) {
     colorImages_.push_back({image, width, height});
-    // Create a depth texture for each swapchain image
-    GLuint depthTex = 0;
-    glGenTextures(1, &depthTex);
-    glBindTexture(GL_TEXTURE_2D, depthTex);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, width, height, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    depthImages_.push_back({depthTex, width, height});
+  }
+
+  // An orthographic projection kProjectionHalfHeight high, with the width matching the images.
+  float halfWidth = kProjectionHalfHeight * float(width) / float(height);
+  projection_ = r3::Ortho(-halfWidth, halfWidth, -kProjectionHalfHeight, kProjectionHalfHeight, kProjectionNearPlane,
+                          kProjectionFarPlane);
+  // The scene goes to a quad layer, so there's one orthographic view rather than an eye per view;
+  // a projection layer would have a LodSelector::View::fromFov for each eye's pose and XrFovf
+  lodViews_ = {LodSelector::View::orthographic(kProjectionHalfHeight, height)};
+  FrustumCuller::Planes view = extractFrustumPlanes(projection_);
+  frustumCuller_.setViews({&view, 1}, nullptr);
+  if (shader_) {
+    shader_->activate();
+    shader_->setProjectionMatrix(projection_.m);
   }
 }
 
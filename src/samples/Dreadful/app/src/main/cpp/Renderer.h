@@ -8,9 +8,29 @@
 
 #include <memory>
 #include <span>
-
+#include <vector>
+
+#include "AssetArchive.h"
+#include "DebugDraw.h"
+#include "FramePacer.h"
+#include "FrustumCuller.h"
+#include "GlExecutor.h"
+#include "GpuCuller.h"
+#include "GpuTimer.h"
+#include "JobSystem.h"
+#include "LodSelector.h"
+#include "Mirror.h"
 #include "Model.h"
+#include "ModelBatch.h"
+#include "PixelBufferPool.h"
+#include "RenderGraph.h"
+#include "ResourceCache.h"
+#include "SceneGraph.h"
 #include "Shader.h"
+#include "TextureStreamer.h"
+#include "UploadScheduler.h"
+#include "WorkerPool.h"
+#include "linear.h"
 
 struct android_app;
 
@@ -60,6 +80,18 @@ class Renderer {
     return context_;
   }
 
+  /*!
+   * @return the pacer bounding frames in flight, for resources that need to know which frames the
+   * GPU has finished
+   */
+  FramePacer& getFramePacer() {
+    return *framePacer_;
+  }
+
+  ResourceCache& getResourceCache() {
+    return *resources_;
+  }
+
  private:
   /*!
    * Performs necessary OpenGL initialization. Customize this if you want to change your EGL
@@ -79,6 +111,64 @@ class Renderer {
    */
   void createModels();
 
+  /*!
+   * Starts loading the texture of a submesh as a task, see kTaskLoading. Its model is added once
+   * the texture is uploaded.
+   */
+  void loadModelAsync(std::shared_ptr<Mesh> mesh, uint32_t submesh, SceneGraph::Node node);
+
+  /*!
+   * Logs how long reading every packed asset takes from the archive and as separate assets, see
+   * kAssetArchiveBenchmark.
+   */
+  void runAssetArchiveBenchmark();
+
+  /*!
+   * Logs how long a large mesh takes to load from a .dmesh and through Mesh::create, see
+   * kMeshLoadBenchmark.
+   */
+  void runMeshLoadBenchmark();
+
+  /*!
+   * Finds which models_ some view sees this frame, into modelVisibility_.
+   */
+  void cullModels();
+
+  /*!
+   * Creates the icon batch, see kUiIconCount.
+   */
+  void createUi();
+
+  /*!
+   * Submits this frame's icons to the batch.
+   */
+  void drawUi();
+
+  /*!
+   * Fills the culler with a grid of instances when the culling benchmark is enabled.
+   */
+  void createBenchmarkInstances();
+
+  /*!
+   * Switches between GPU and CPU culling periodically and logs the cost of each.
+   */
+  void updateCullingBenchmark();
+
+  /*!
+   * Runs the GpuCuller's compute pass when it's the path in use, timing it on the CPU and GPU.
+   */
+  void cullInstances();
+
+  /*!
+   * Draws the GpuCuller's instances through the path in use, timing it on the CPU and GPU.
+   */
+  void drawInstances();
+
+  /*!
+   * Submits this frame's debug geometry.
+   */
+  void drawDebugGizmos();
+
   android_app* app_;
   EGLDisplay display_;
   EGLConfig config_;
@@ -86,7 +176,54 @@ class Renderer {
   EGLContext context_;
 
   std::unique_ptr<Shader> shader_;
+  // Packed assets, see kAssetArchive. Null when the apk has no pack.
+  std::unique_ptr<AssetArchive> archive_;
+  // Textures and meshes, shared by key between models, see kResourceCacheBudget
+  std::unique_ptr<ResourceCache> resources_;
+  // Decodes textures off the GL thread and uploads them over several frames, see kTextureStreaming
+  std::unique_ptr<WorkerPool> workers_;
+  std::unique_ptr<TextureStreamer> textureStreamer_;
+  // GL uploads spread over frames, see kUploadBudgetMs
+  std::unique_ptr<UploadScheduler> uploadScheduler_;
+  // Asset tasks: file reads, GL steps within a per-frame budget, and one control per task, see
+  // kTaskLoading. The tasks decode on workers_.
+  std::unique_ptr<WorkerPool> ioPool_;
+  std::unique_ptr<GlExecutor> glExecutor_;
+  std::vector<std::shared_ptr<TaskControl>> tasks_;
+  // Texture decode targets, see kTextureUploadThroughPixelBuffers
+  std::unique_ptr<PixelBufferPool> pixelBuffers_;
+  // Short per-frame jobs such as culling, see kJobThreads
+  std::unique_ptr<JobSystem> jobs_;
+  // The transforms of models_, which may share nodes
+  std::unique_ptr<SceneGraph> scene_;
   std::vector<Model> models_;
+  r3::Matrix4f projection_;
+
+  // Levels of detail of models_, see kLodMaxPixelError
+  std::unique_ptr<LodSelector> lodSelector_;
+  std::vector<LodSelector::View> lodViews_;
+  // triangles drawn, logged when it changes
+  size_t lodTriangles_ = 0;
+
+  // Which models_ the projection sees, by their submeshes' world bounds. Models out of view aren't
+  // drawn.
+  FrustumCuller frustumCuller_;
+  FrustumCuller::Spheres modelSpheres_;
+  std::vector<uint8_t> modelVisibility_;
+
+  // Optional many-instance path, see kCullingBenchmarkInstances
+  std::unique_ptr<GpuCuller> culler_;
+  bool useGpuCulling_ = true;
+  struct CullingBenchmark {
+    uint32_t frames = 0;
+    // CPU time spent in the culler's calls
+    double cpuMs = 0;
+    // GPU time of the compute pass and the indirect draws, and of the CPU culled draws. Null
+    // without GL_EXT_disjoint_timer_query.
+    std::unique_ptr<GpuTimer> gpuCull;
+    std::unique_ptr<GpuTimer> gpuDraw;
+    std::unique_ptr<GpuTimer> cpuDraw;
+  } cullingBenchmark_;
 
   struct SwapchainImage {
     GLuint textureId;
@@ -95,8 +232,21 @@ class Renderer {
   };
 
   std::vector<SwapchainImage> colorImages_;
-  std::vector<SwapchainImage> depthImages_;
-  GLuint fbo;
+
+  // Depth is a transient attachment of the graph, so one buffer is shared by every swapchain image.
+  std::unique_ptr<RenderGraph> renderGraph_;
+
+  // Shows the rendered image in the Android window, see kMirrorInterval
+  std::unique_ptr<Mirror> mirror_;
+
+  // Fences every frame and bounds how many are in flight, see kMaxFramesInFlight
+  std::unique_ptr<FramePacer> framePacer_;
+
+  // Per-frame lines and flat geometry, drawn at the end of the scene pass
+  std::unique_ptr<DebugDraw> debugDraw_;
+
+  // Textured UI icons, one instanced draw for all of them
+  std::unique_ptr<ModelBatch> uiBatch_;
 };
 
 #endif  // ANDROIDGLINVESTIGATIONS_RENDERER_H
\ No newline at end of file
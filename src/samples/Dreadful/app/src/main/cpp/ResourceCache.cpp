@@ -0,0 +1,111 @@
+#include "ResourceCache.h"
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+ResourceCache::ResourceCache(AAssetManager* assetManager, size_t budgetBytes)
+    : assetManager_(assetManager), budgetBytes_(budgetBytes) {}
+
+ResourceCache::~ResourceCache() {
+  for (const auto& entry : lru_) {
+    if (entry.inUse()) {
+      aout << "ResourceCache: " << entry.key << " is still in use at shutdown" << endl;
+    }
+  }
+}
+
+shared_ptr<TextureAsset> ResourceCache::getTexture(const string& assetPath) {
+  if (auto* entry = lookup(assetPath)) {
+    return entry->texture;
+  }
+  auto texture =
+      streamer_ ? streamer_->load(assetPath) : TextureAsset::loadAsset(assetManager_, assetPath, pixelBuffers_);
+  if (texture) {
+    Entry entry;
+    entry.key = assetPath;
+    entry.texture = texture;
+    entry.gpuBytes = texture->getByteSize();
+    insert(std::move(entry));
+  }
+  return texture;
+}
+
+shared_ptr<Mesh> ResourceCache::getMesh(const string& key, const MeshLoader& load) {
+  string meshKey = "mesh:" + key;
+  if (auto* entry = lookup(meshKey)) {
+    return entry->mesh;
+  }
+  auto mesh = load();
+  if (mesh) {
+    Entry entry;
+    entry.key = std::move(meshKey);
+    entry.mesh = mesh;
+    entry.gpuBytes = mesh->getByteSize();
+    entry.cpuBytes = mesh->getCpuByteSize();
+    insert(std::move(entry));
+  }
+  return mesh;
+}
+
+ResourceCache::Entry* ResourceCache::lookup(const string& key) {
+  auto found = entries_.find(key);
+  if (found == entries_.end()) {
+    stats_.misses++;
+    return nullptr;
+  }
+  stats_.hits++;
+  lru_.splice(lru_.begin(), lru_, found->second);
+  return &lru_.front();
+}
+
+void ResourceCache::insert(Entry entry) {
+  (entry.texture ? stats_.textureBytes : stats_.meshBytes) += entry.gpuBytes;
+  stats_.cpuBytes += entry.cpuBytes;
+  stats_.resourceCount++;
+  lru_.push_front(std::move(entry));
+  entries_[lru_.front().key] = lru_.begin();
+
+  // the new entry is held by the caller, so it's never the one to go
+  trim();
+}
+
+void ResourceCache::evict(list<Entry>::iterator it) {
+  (it->texture ? stats_.textureBytes : stats_.meshBytes) -= it->gpuBytes;
+  stats_.cpuBytes -= it->cpuBytes;
+  stats_.resourceCount--;
+  stats_.evictions++;
+  entries_.erase(it->key);
+  lru_.erase(it);
+}
+
+void ResourceCache::trim() {
+  for (auto& entry : lru_) {
+    if (entry.texture && entry.gpuBytes != entry.texture->getByteSize()) {
+      stats_.textureBytes += entry.texture->getByteSize() - entry.gpuBytes;
+      entry.gpuBytes = entry.texture->getByteSize();
+    }
+  }
+
+  // Walk from the least recently used end, skipping anything still held elsewhere
+  for (auto it = lru_.end(); it != lru_.begin() && getResidentBytes() > budgetBytes_;) {
+    --it;
+    if (!it->inUse()) {
+      auto next = std::next(it);
+      evict(it);
+      it = next;
+    }
+  }
+}
+
+void ResourceCache::setBudget(size_t budgetBytes) {
+  budgetBytes_ = budgetBytes;
+  trim();
+}
+
+void ResourceCache::logStats() const {
+  aout << "ResourceCache: " << stats_.resourceCount << " resources, " << stats_.textureBytes / 1024 << " KiB textures, "
+       << stats_.meshBytes / 1024 << " KiB meshes, " << stats_.cpuBytes / 1024 << " KiB CPU, budget "
+       << budgetBytes_ / 1024 << " KiB; " << stats_.hits << " hits, " << stats_.misses << " misses, "
+       << stats_.evictions << " evictions" << endl;
+}
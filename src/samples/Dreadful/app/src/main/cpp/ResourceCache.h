@@ -0,0 +1,139 @@
+#ifndef ANDROIDGLINVESTIGATIONS_RESOURCECACHE_H
+#define ANDROIDGLINVESTIGATIONS_RESOURCECACHE_H
+
+#include <android/asset_manager.h>
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#include "Mesh.h"
+#include "TextureAsset.h"
+#include "TextureStreamer.h"
+
+/*!
+ * Keeps textures and meshes loaded once per key and tracks what they cost.
+ *
+ * Callers hold what they get as shared_ptrs, and anything held stays resident. When the total goes
+ * over the budget the cache drops the least recently requested resources nobody else holds; asking
+ * for one of those again reloads it. So the budget bounds how much unused data is kept warm, it
+ * can't force out data that's being drawn.
+ *
+ * Must be used on the thread that owns the GL context, and destroyed while it's current.
+ */
+class ResourceCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+    size_t textureBytes = 0;  // GPU memory
+    size_t meshBytes = 0;     // GPU memory
+    size_t cpuBytes = 0;      // CPU copies kept by meshes
+    size_t resourceCount = 0;
+  };
+
+  //! Builds a mesh on a miss, see getMesh
+  using MeshLoader = std::function<std::shared_ptr<Mesh>()>;
+
+  /*!
+   * @param budgetBytes GPU and CPU bytes to stay under, if what's in use allows
+   */
+  ResourceCache(AAssetManager* assetManager, size_t budgetBytes);
+  ResourceCache(const ResourceCache&) = delete;
+  ResourceCache& operator=(const ResourceCache&) = delete;
+  ~ResourceCache();
+
+  /*!
+   * Returns the texture for the asset path, loading it if it isn't resident: through the streamer
+   * if one is set, otherwise with TextureAsset::loadAsset. Failed loads aren't cached, so a missing
+   * asset is looked for again every time.
+   * @return the texture, or null if it can't be loaded. Streamed textures may not be drawable yet,
+   * see TextureAsset::isResident
+   */
+  std::shared_ptr<TextureAsset> getTexture(const std::string& assetPath);
+
+  /*!
+   * Loads textures asynchronously from now on. The streamer must outlive the cache.
+   */
+  void setStreamer(TextureStreamer* streamer) {
+    streamer_ = streamer;
+  }
+
+  /*!
+   * Decodes synchronously loaded images into pooled pixel buffers, see TextureAsset::loadAsset. The
+   * pool must outlive the cache.
+   */
+  void setPixelBufferPool(PixelBufferPool* pixelBuffers) {
+    pixelBuffers_ = pixelBuffers;
+  }
+
+  /*!
+   * Returns the mesh for key, calling load if it isn't resident. The loader has to produce the same
+   * mesh every time since it's called again after an eviction.
+   * @return the mesh, or null if load failed
+   */
+  std::shared_ptr<Mesh> getMesh(const std::string& key, const MeshLoader& load);
+
+  /*!
+   * Evicts unused resources until the cache is within budget. Called after every load; call it
+   * again after releasing models to give their memory back, and every frame while textures stream
+   * since their size is only known once they're decoded.
+   */
+  void trim();
+
+  /*!
+   * Lowers or raises the budget and trims to it.
+   */
+  void setBudget(size_t budgetBytes);
+
+  size_t getBudget() const {
+    return budgetBytes_;
+  }
+
+  size_t getResidentBytes() const {
+    return stats_.textureBytes + stats_.meshBytes + stats_.cpuBytes;
+  }
+
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+  void logStats() const;
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<TextureAsset> texture;
+    std::shared_ptr<Mesh> mesh;
+    size_t gpuBytes = 0;
+    size_t cpuBytes = 0;
+
+    bool inUse() const {
+      return texture ? texture.use_count() > 1 : mesh.use_count() > 1;
+    }
+  };
+
+  /*!
+   * Finds key and makes it the most recently used, or returns null on a miss.
+   */
+  Entry* lookup(const std::string& key);
+
+  void insert(Entry entry);
+  void evict(std::list<Entry>::iterator it);
+
+  AAssetManager* assetManager_;
+  TextureStreamer* streamer_ = nullptr;
+  PixelBufferPool* pixelBuffers_ = nullptr;
+  size_t budgetBytes_;
+  Stats stats_;
+
+  // Most recently used first. Texture keys are asset paths, mesh keys are prefixed with "mesh:".
+  std::list<Entry> lru_;
+  std::unordered_map<std::string, std::list<Entry>::iterator> entries_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_RESOURCECACHE_H
@@ -0,0 +1,188 @@
+#include "SceneGraph.h"
+
+#include <algorithm>
+
+using namespace std;
+
+SceneGraph::Node SceneGraph::add(const r3::Posef& local, Node parent) {
+  Node node;
+  if (freeNodes_.empty()) {
+    node = static_cast<Node>(indices_.size());
+    indices_.push_back(kNoIndex);
+  } else {
+    node = freeNodes_.back();
+    freeNodes_.pop_back();
+  }
+
+  // The parent exists, so it's before the end and the order holds
+  auto index = static_cast<uint32_t>(nodes_.size());
+  indices_[node] = index;
+  parents_.push_back(parent == kNoNode ? kNoIndex : indices_[parent]);
+  locals_.push_back(local);
+  worlds_.push_back(local);
+  worldMatrices_.emplace_back();
+  dirty_.push_back(0);
+  passes_.push_back(0);
+  nodes_.push_back(node);
+  markDirty(index);
+  return node;
+}
+
+void SceneGraph::remove(Node node) {
+  // Dropped with its subtree by the next sort, until then the handles still work
+  parents_[indices_[node]] = kRemoved;
+  unsorted_ = true;
+}
+
+bool SceneGraph::setParent(Node node, Node parent) {
+  uint32_t index = indices_[node];
+  uint32_t parentIndex = parent == kNoNode ? kNoIndex : indices_[parent];
+  for (uint32_t ancestor = parentIndex; ancestor < kRemoved; ancestor = parents_[ancestor]) {
+    if (ancestor == index) {
+      return false;
+    }
+  }
+  parents_[index] = parentIndex;
+  if (parentIndex != kNoIndex && parentIndex > index) {
+    unsorted_ = true;
+  }
+  markDirty(index);
+  return true;
+}
+
+void SceneGraph::setLocal(Node node, const r3::Posef& local) {
+  uint32_t index = indices_[node];
+  locals_[index] = local;
+  markDirty(index);
+}
+
+SceneGraph::Node SceneGraph::getParent(Node node) const {
+  uint32_t parent = parents_[indices_[node]];
+  return parent >= kRemoved ? kNoNode : nodes_[parent];
+}
+
+void SceneGraph::markDirty(uint32_t index) {
+  dirty_[index] = 1;
+  firstDirty_ = min(firstDirty_, index);
+}
+
+void SceneGraph::invalidate() {
+  fill(dirty_.begin(), dirty_.end(), 1);
+  firstDirty_ = 0;
+}
+
+void SceneGraph::sort() {
+  auto count = static_cast<uint32_t>(nodes_.size());
+
+  // Children of each node, as ranges of one array. Removed nodes are nobody's child and not roots,
+  // so neither they nor anything under them is reached.
+  vector<uint32_t> childStarts(count + 1, 0);
+  vector<uint32_t> roots;
+  for (uint32_t i = 0; i < count; i++) {
+    if (parents_[i] == kNoIndex) {
+      roots.push_back(i);
+    } else if (parents_[i] != kRemoved) {
+      childStarts[parents_[i] + 1]++;
+    }
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    childStarts[i + 1] += childStarts[i];
+  }
+  vector<uint32_t> children(childStarts[count]);
+  vector<uint32_t> filled(childStarts.begin(), childStarts.end() - 1);
+  for (uint32_t i = 0; i < count; i++) {
+    if (parents_[i] < kRemoved) {
+      children[filled[parents_[i]]++] = i;
+    }
+  }
+
+  // Depth first, so every subtree ends up in one run of the arrays, in the order nodes were before
+  vector<uint32_t> order;
+  order.reserve(count);
+  vector<uint32_t> stack(roots.rbegin(), roots.rend());
+  while (!stack.empty()) {
+    uint32_t i = stack.back();
+    stack.pop_back();
+    order.push_back(i);
+    for (uint32_t c = childStarts[i + 1]; c > childStarts[i]; c--) {
+      stack.push_back(children[c - 1]);
+    }
+  }
+
+  vector<uint32_t> newIndices(count, kNoIndex);
+  for (uint32_t i = 0; i < order.size(); i++) {
+    newIndices[order[i]] = i;
+  }
+  for (uint32_t i = 0; i < count; i++) {
+    if (newIndices[i] == kNoIndex) {
+      indices_[nodes_[i]] = kNoIndex;
+      freeNodes_.push_back(nodes_[i]);
+    }
+  }
+
+  auto permute = [&order](auto& values) {
+    remove_reference_t<decltype(values)> sorted;
+    sorted.reserve(order.size());
+    for (uint32_t i : order) {
+      sorted.push_back(std::move(values[i]));
+    }
+    values = std::move(sorted);
+  };
+  permute(parents_);
+  permute(locals_);
+  permute(worlds_);
+  permute(worldMatrices_);
+  permute(dirty_);
+  permute(passes_);
+  permute(nodes_);
+
+  firstDirty_ = static_cast<uint32_t>(order.size());
+  for (uint32_t i = 0; i < order.size(); i++) {
+    if (parents_[i] != kNoIndex) {
+      parents_[i] = newIndices[parents_[i]];
+    }
+    indices_[nodes_[i]] = i;
+    if (dirty_[i]) {
+      firstDirty_ = min(firstDirty_, i);
+    }
+  }
+  unsorted_ = false;
+}
+
+void SceneGraph::update() {
+  if (unsorted_) {
+    sort();
+  }
+  updated_.clear();
+  if (++pass_ == 0) {
+    // wrapped, so old passes could look like this one
+    fill(passes_.begin(), passes_.end(), 0);
+    pass_ = 1;
+  }
+
+  // A parent is always recomputed before its children look at it
+  auto count = static_cast<uint32_t>(nodes_.size());
+  for (uint32_t i = firstDirty_; i < count; i++) {
+    uint32_t parent = parents_[i];
+    bool parentUpdated = parent != kNoIndex && passes_[parent] == pass_;
+    if (!dirty_[i] && !parentUpdated) {
+      continue;
+    }
+    auto& world = worlds_[i];
+    const auto& local = locals_[i];
+    if (parent == kNoIndex) {
+      world = local;
+    } else {
+      const auto& parentWorld = worlds_[parent];
+      world.r = parentWorld.r * local.r;
+      world.t = parentWorld.Transform(local.t);
+    }
+    auto& matrix = worldMatrices_[i];
+    world.r.GetValue(matrix);
+    matrix.SetTranslate(world.t);
+    dirty_[i] = 0;
+    passes_[i] = pass_;
+    updated_.push_back(nodes_[i]);
+  }
+  firstDirty_ = count;
+}
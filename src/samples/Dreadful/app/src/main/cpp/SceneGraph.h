@@ -0,0 +1,120 @@
+#ifndef ANDROIDGLINVESTIGATIONS_SCENEGRAPH_H
+#define ANDROIDGLINVESTIGATIONS_SCENEGRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "linear.h"
+
+/*!
+ * A hierarchy of rigid transforms. Each node has a local pose relative to its parent, and update()
+ * turns those into world poses and matrices.
+ *
+ * Nodes are stored as parallel arrays (parents, local poses, world poses, world matrices, flags)
+ * ordered so every parent comes before its children. A change marks its node dirty, and update()
+ * walks the arrays once from the first dirty node: a node is recomputed if it's dirty or its parent
+ * was recomputed in the same pass, which the parent, being earlier, already knows. Nodes outside
+ * changed subtrees cost a flag check and nothing else.
+ *
+ * Adding a node keeps the order, since the parent already exists. Reparenting under a later node
+ * and removing nodes sort the arrays again in the next update, which is a pass over every node;
+ * do those in batches rather than every frame.
+ *
+ * Handles stay valid across the sorting, until their node is removed, after which they may be
+ * reused. Not thread safe.
+ */
+class SceneGraph {
+ public:
+  using Node = uint32_t;
+  static constexpr Node kNoNode = UINT32_MAX;
+
+  /*!
+   * @param parent kNoNode for a root
+   */
+  Node add(const r3::Posef& local, Node parent = kNoNode);
+
+  /*!
+   * Removes node and everything under it. The descendants stay valid until the next update.
+   */
+  void remove(Node node);
+
+  /*!
+   * Moves node under parent, keeping its local pose.
+   * @return false if parent is node or under it, which would make a cycle
+   */
+  bool setParent(Node node, Node parent);
+
+  void setLocal(Node node, const r3::Posef& local);
+
+  const r3::Posef& getLocal(Node node) const {
+    return locals_[indices_[node]];
+  }
+
+  //! @return the world pose as of the last update
+  const r3::Posef& getWorld(Node node) const {
+    return worlds_[indices_[node]];
+  }
+
+  //! @return the world pose as of the last update, as a matrix
+  const r3::Matrix4f& getWorldMatrix(Node node) const {
+    return worldMatrices_[indices_[node]];
+  }
+
+  //! @return kNoNode for a root
+  Node getParent(Node node) const;
+
+  bool isValid(Node node) const {
+    return node < indices_.size() && indices_[node] != kNoIndex && parents_[indices_[node]] != kRemoved;
+  }
+
+  size_t getNodeCount() const {
+    return nodes_.size();
+  }
+
+  /*!
+   * Recomputes the world transforms of dirty nodes and everything under them.
+   */
+  void update();
+
+  //! @return the nodes whose world transforms the last update recomputed, in parent first order
+  std::span<const Node> getUpdated() const {
+    return updated_;
+  }
+
+  //! Marks every node dirty, to compare a full update with an incremental one
+  void invalidate();
+
+ private:
+  static constexpr uint32_t kNoIndex = UINT32_MAX;
+  // the parent index of a removed node, until the next update drops it
+  static constexpr uint32_t kRemoved = UINT32_MAX - 1;
+
+  void markDirty(uint32_t index);
+
+  //! Puts every parent before its children again and drops removed subtrees
+  void sort();
+
+  // By index, parents first
+  std::vector<uint32_t> parents_;
+  std::vector<r3::Posef> locals_;
+  std::vector<r3::Posef> worlds_;
+  std::vector<r3::Matrix4f> worldMatrices_;
+  std::vector<uint8_t> dirty_;
+  // the update pass that last recomputed the node
+  std::vector<uint32_t> passes_;
+  std::vector<Node> nodes_;
+
+  // By handle
+  std::vector<uint32_t> indices_;
+  std::vector<Node> freeNodes_;
+
+  std::vector<Node> updated_;
+  uint32_t pass_ = 0;
+  // nothing before this index is dirty
+  uint32_t firstDirty_ = 0;
+  bool unsorted_ = false;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_SCENEGRAPH_H
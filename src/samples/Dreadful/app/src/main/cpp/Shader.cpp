@@ -5,7 +5,8 @@
 
 Shader* Shader::loadShader(const std::string& vertexSource, const std::string& fragmentSource,
                            const std::string& positionAttributeName, const std::string& uvAttributeName,
-                           const std::string& projectionMatrixUniformName) {
+                           const std::string& projectionMatrixUniformName,
+                           const std::string& dequantizeUniformName, const std::string& fadeUniformName) {
   Shader* shader = nullptr;
 
   GLuint vertexShader = loadShader(GL_VERTEX_SHADER, vertexSource);
@@ -19,39 +20,22 @@ Shader* Shader::loadShader(const std::string& vertexSource, const std::string& f
     return nullptr;
   }
 
-  GLuint program = glCreateProgram();
+  GLuint program = linkProgram({vertexShader, fragmentShader});
   if (program) {
-    glAttachShader(program, vertexShader);
-    glAttachShader(program, fragmentShader);
-
-    glLinkProgram(program);
-    GLint linkStatus = GL_FALSE;
-    glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
-    if (linkStatus != GL_TRUE) {
-      GLint logLength = 0;
-      glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
-
-      // If we fail to link the shader program, log the result for debugging
-      if (logLength) {
-        std::vector<GLchar> log(logLength + 1, 0);
-        glGetProgramInfoLog(program, logLength, nullptr, log.data());
-        aout << "Failed to link program with:\n" << log.data() << std::endl;
-      }
-
-      glDeleteProgram(program);
+    // Get the attribute and uniform locations by name. You may also choose to hardcode
+    // indices with layout= in your shader, but it is not done in this sample
+    GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
+    GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
+    GLint projectionMatrixUniform = glGetUniformLocation(program, projectionMatrixUniformName.c_str());
+    GLint dequantizeUniform = glGetUniformLocation(program, dequantizeUniformName.c_str());
+    GLint fadeUniform = fadeUniformName.empty() ? -1 : glGetUniformLocation(program, fadeUniformName.c_str());
+
+    // Only create a new shader if all the attributes are found. The fade is optional.
+    if (positionAttribute != -1 && uvAttribute != -1 && projectionMatrixUniform != -1 && dequantizeUniform != -1) {
+      shader = new Shader(program, positionAttribute, uvAttribute, projectionMatrixUniform, dequantizeUniform,
+                          fadeUniform);
     } else {
-      // Get the attribute and uniform locations by name. You may also choose to hardcode
-      // indices with layout= in your shader, but it is not done in this sample
-      GLint positionAttribute = glGetAttribLocation(program, positionAttributeName.c_str());
-      GLint uvAttribute = glGetAttribLocation(program, uvAttributeName.c_str());
-      GLint projectionMatrixUniform = glGetUniformLocation(program, projectionMatrixUniformName.c_str());
-
-      // Only create a new shader if all the attributes are found.
-      if (positionAttribute != -1 && uvAttribute != -1 && projectionMatrixUniform != -1) {
-        shader = new Shader(program, positionAttribute, uvAttribute, projectionMatrixUniform);
-      } else {
-        glDeleteProgram(program);
-      }
+      glDeleteProgram(program);
     }
   }
 
@@ -91,6 +75,35 @@ GLuint Shader::loadShader(GLenum shaderType, const std::string& shaderSource) {
   return shader;
 }
 
+GLuint Shader::linkProgram(std::initializer_list<GLuint> shaders) {
+  GLuint program = glCreateProgram();
+  if (!program) {
+    return 0;
+  }
+  for (auto shader : shaders) {
+    glAttachShader(program, shader);
+  }
+
+  glLinkProgram(program);
+  GLint linkStatus = GL_FALSE;
+  glGetProgramiv(program, GL_LINK_STATUS, &linkStatus);
+  if (linkStatus != GL_TRUE) {
+    GLint logLength = 0;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+
+    // If we fail to link the shader program, log the result for debugging
+    if (logLength) {
+      std::vector<GLchar> log(logLength + 1, 0);
+      glGetProgramInfoLog(program, logLength, nullptr, log.data());
+      aout << "Failed to link program with:\n" << log.data() << std::endl;
+    }
+
+    glDeleteProgram(program);
+    return 0;
+  }
+  return program;
+}
+
 void Shader::activate() const {
   glUseProgram(program_);
 }
@@ -99,24 +112,32 @@ void Shader::deactivate() const {
   glUseProgram(0);
 }
 
-void Shader::drawModel(const Model& model) const {
-  // The position attribute is 3 floats
-  glVertexAttribPointer(position_, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), model.getVertexData());
-  glEnableVertexAttribArray(position_);
+void Shader::drawModel(const Model& model, uint32_t lod, float fade) const {
+  const auto& mesh = model.getMesh();
+  const auto& submesh = model.getSubmesh();
+  auto range = submesh.getLod(lod);
 
-  // The uv attribute is 2 floats
-  glVertexAttribPointer(uv_, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), ((uint8_t*)model.getVertexData()) + sizeof(Vector3));
-  glEnableVertexAttribArray(uv_);
+  // GLES 3.0 has no base vertex for draws, so the attributes start at the submesh's first vertex.
+  // Their types come from the mesh's vertex format.
+  mesh.bindAttributes({position_, uv_, -1, -1}, submesh);
+  mesh.setDequantizeUniform(dequantize_, submesh);
 
   // Setup the texture
   glActiveTexture(GL_TEXTURE0);
   glBindTexture(GL_TEXTURE_2D, model.getTexture().getTextureID());
 
-  // Draw as indexed triangles
-  glDrawElements(GL_TRIANGLES, model.getIndexCount(), GL_UNSIGNED_SHORT, model.getIndexData());
+  if (fade_ != -1) {
+    glUniform1f(fade_, fade);
+  }
+
+  // Draw as indexed triangles. Every level uses the submesh's vertices.
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.getIndexBuffer());
+  glDrawElements(GL_TRIANGLES, range.indexCount, submesh.indexType,
+                 reinterpret_cast<void*>(submesh.getIndexOffset(range.firstIndex)));
 
   glDisableVertexAttribArray(uv_);
   glDisableVertexAttribArray(position_);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 void Shader::setProjectionMatrix(float* projectionMatrix) const {
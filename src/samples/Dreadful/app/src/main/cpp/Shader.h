@@ -3,16 +3,18 @@
 
 #include <GLES3/gl3.h>
 
+#include <initializer_list>
 #include <string>
 
 class Model;
 
 /*!
  * A class representing a simple shader program. It consists of vertex and fragment components. The
- * input attributes are a position (as a Vector3) and a uv (as a Vector2). It also takes a uniform
- * to be used as the entire model/view/projection matrix. The shader expects a single texture for
+ * input attributes are a position (as a vec3) and a uv (as a vec2), which may be quantized and are
+ * dequantized with a vec4[3] uniform as described in Mesh.h. It also takes a uniform to be used as
+ * the entire model/view/projection matrix. The shader expects a single texture for
  * fragment shading, and does no other lighting calculations (thus no uniforms for lights or normal
- * attributes).
+ * attributes). An optional float uniform dithers levels of detail in and out, see LodSelector::Draw.
  */
 class Shader {
  public:
@@ -26,11 +28,14 @@ class Shader {
    * @param positionAttributeName The name of the position attribute in your vertex program
    * @param uvAttributeName The name of the uv coordinate attribute in your vertex program
    * @param projectionMatrixUniformName The name of your model/view/projection matrix uniform
+   * @param dequantizeUniformName The name of your vec4[3] dequantization uniform
+   * @param fadeUniformName The name of your level of detail fade uniform, which may be missing
    * @return a valid Shader on success, otherwise null.
    */
   static Shader* loadShader(const std::string& vertexSource, const std::string& fragmentSource,
                             const std::string& positionAttributeName, const std::string& uvAttributeName,
-                            const std::string& projectionMatrixUniformName);
+                            const std::string& projectionMatrixUniformName, const std::string& dequantizeUniformName,
+                            const std::string& fadeUniformName = "");
 
   inline ~Shader() {
     if (program_) {
@@ -52,8 +57,10 @@ class Shader {
   /*!
    * Renders a single model
    * @param model a model to render
+   * @param lod the level of detail of its submesh to draw
+   * @param fade how much of it to draw while it cross-fades, see LodSelector::Draw
    */
-  void drawModel(const Model& model) const;
+  void drawModel(const Model& model, uint32_t lod = 0, float fade = 0) const;
 
   /*!
    * Sets the model/view/projection matrix in the shader.
@@ -61,29 +68,45 @@ class Shader {
    */
   void setProjectionMatrix(float* projectionMatrix) const;
 
- private:
   /*!
    * Helper function to load a shader of a given type
-   * @param shaderType The OpenGL shader type. Should either be GL_VERTEX_SHADER or GL_FRAGMENT_SHADER
+   * @param shaderType The OpenGL shader type. e.g. GL_VERTEX_SHADER, GL_FRAGMENT_SHADER or GL_COMPUTE_SHADER
    * @param shaderSource The full source of the shader
    * @return the id of the shader, as returned by glCreateShader, or 0 in the case of an error
    */
   static GLuint loadShader(GLenum shaderType, const std::string& shaderSource);
 
+  /*!
+   * Helper function to link compiled shaders into a program. The shaders are not deleted.
+   * @param shaders the ids of the shaders to attach, as returned by loadShader
+   * @return the id of the program, or 0 if linking failed
+   */
+  static GLuint linkProgram(std::initializer_list<GLuint> shaders);
+
+ private:
   /*!
    * Constructs a new instance of a shader. Use @a loadShader
    * @param program the GL program id of the shader
    * @param position the attribute location of the position
    * @param uv the attribute location of the uv coordinates
    * @param projectionMatrix the uniform location of the projection matrix
+   * @param dequantize the uniform location of the dequantization ranges
+   * @param fade the uniform location of the level of detail fade, or -1
    */
-  constexpr Shader(GLuint program, GLint position, GLint uv, GLint projectionMatrix)
-      : program_(program), position_(position), uv_(uv), projectionMatrix_(projectionMatrix) {}
+  constexpr Shader(GLuint program, GLint position, GLint uv, GLint projectionMatrix, GLint dequantize, GLint fade)
+      : program_(program),
+        position_(position),
+        uv_(uv),
+        projectionMatrix_(projectionMatrix),
+        dequantize_(dequantize),
+        fade_(fade) {}
 
   GLuint program_;
   GLint position_;
   GLint uv_;
   GLint projectionMatrix_;
+  GLint dequantize_;
+  GLint fade_;
 };
 
 #endif  // ANDROIDGLINVESTIGATIONS_SHADER_H
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "StreamBuffer.h"
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+StreamBuffer::StreamBuffer(size_t bytesPerFrame, uint32_t frameCount)
+    : bytesPerFrame_(bytesPerFrame), frameCount_(frameCount) {
+  glGenBuffers(1, &buffer_);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+  glBufferData(GL_COPY_WRITE_BUFFER, bytesPerFrame_ * frameCount_, nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+StreamBuffer::~StreamBuffer() {
+  glDeleteBuffers(1, &buffer_);
+}
+
+bool StreamBuffer::beginFrame(uint64_t frame, uint64_t completedFrame) {
+  used_ = 0;
+  mapped_ = nullptr;
+  regionOffset_ = static_cast<GLintptr>((frame % frameCount_) * bytesPerFrame_);
+
+  // the previous user of this region was frame - frameCount_
+  if (frame > frameCount_ && completedFrame < frame - frameCount_) {
+    aout << "StreamBuffer: region for frame " << frame << " may still be in use, skipping" << endl;
+    return false;
+  }
+
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+  mapped_ = static_cast<uint8_t*>(
+      glMapBufferRange(GL_COPY_WRITE_BUFFER, regionOffset_, bytesPerFrame_,
+                       GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_FLUSH_EXPLICIT_BIT));
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  return mapped_ != nullptr;
+}
+
+void* StreamBuffer::allocate(size_t bytes, size_t alignment) {
+  if (!mapped_) {
+    return nullptr;
+  }
+  size_t offset = (used_ + alignment - 1) / alignment * alignment;
+  if (offset + bytes > bytesPerFrame_) {
+    return nullptr;
+  }
+  used_ = offset + bytes;
+  return mapped_ + offset;
+}
+
+void StreamBuffer::endFrame() {
+  if (!mapped_) {
+    return;
+  }
+  glBindBuffer(GL_COPY_WRITE_BUFFER, buffer_);
+  if (used_) {
+    glFlushMappedBufferRange(GL_COPY_WRITE_BUFFER, 0, used_);
+  }
+  glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+  mapped_ = nullptr;
+}
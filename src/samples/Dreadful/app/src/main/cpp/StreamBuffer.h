@@ -0,0 +1,80 @@
+#ifndef ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
+#define ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
+
+#include <GLES3/gl3.h>
+
+#include <cstddef>
+#include <cstdint>
+
+/*!
+ * A buffer object for data written by the CPU every frame, split into one region per frame in
+ * flight. A frame's region is mapped with GL_MAP_UNSYNCHRONIZED_BIT, so writing never waits on the
+ * driver. That's safe because the region was last used frameCount frames ago, and the FramePacer
+ * guarantees the GPU has finished that frame before beginFrame() is called.
+ */
+class StreamBuffer {
+ public:
+  /*!
+   * The buffer is only ever bound to GL_COPY_WRITE_BUFFER here, so it can be used as vertex or index
+   * data without disturbing the current vertex array's bindings.
+   * @param bytesPerFrame capacity of each frame's region
+   * @param frameCount number of regions, at least the maximum number of frames in flight
+   */
+  StreamBuffer(size_t bytesPerFrame, uint32_t frameCount);
+  StreamBuffer(const StreamBuffer&) = delete;
+  StreamBuffer& operator=(const StreamBuffer&) = delete;
+  ~StreamBuffer();
+
+  /*!
+   * Maps the region for frame. completedFrame is the newest frame the GPU has finished; if the
+   * region might still be in use the buffer stays unmapped and every allocate() fails.
+   * @return true if the region is mapped
+   */
+  bool beginFrame(uint64_t frame, uint64_t completedFrame);
+
+  /*!
+   * Reserves bytes in the current region.
+   * @return a pointer to write to, or null if the region is full or not mapped
+   */
+  void* allocate(size_t bytes, size_t alignment = 4);
+
+  /*!
+   * Flushes what was written and unmaps, after which the data can be drawn from.
+   */
+  void endFrame();
+
+  GLuint getBuffer() const {
+    return buffer_;
+  }
+
+  /*!
+   * @return the offset of the current region within the buffer
+   */
+  GLintptr getRegionOffset() const {
+    return regionOffset_;
+  }
+
+  /*!
+   * @return the size of each frame's region
+   */
+  size_t getCapacity() const {
+    return bytesPerFrame_;
+  }
+
+  /*!
+   * @return bytes allocated in the current region
+   */
+  size_t getUsed() const {
+    return used_;
+  }
+
+ private:
+  size_t bytesPerFrame_;
+  uint32_t frameCount_;
+  GLuint buffer_ = 0;
+  GLintptr regionOffset_ = 0;
+  uint8_t* mapped_ = nullptr;
+  size_t used_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_STREAMBUFFER_H
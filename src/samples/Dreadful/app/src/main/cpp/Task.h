@@ -0,0 +1,332 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TASK_H
+#define ANDROIDGLINVESTIGATIONS_TASK_H
+
+#include <atomic>
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/*!
+ * C++20 coroutines that let an asset load be one sequential function hopping between threads:
+ *
+ *   Task<shared_ptr<Thing>> load(TaskExecutors executors, shared_ptr<const TaskControl> control) {
+ *     bool running = co_await resumeOn(executors.io, control);
+ *     if (!running) co_return nullptr;
+ *     // read the file
+ *     running = co_await resumeOn(executors.cpu, control);
+ *     if (!running) co_return nullptr;
+ *     // decode it
+ *     running = co_await resumeOn(executors.gl, control);
+ *     if (!running) co_return nullptr;
+ *     // upload it
+ *   }
+ *
+ * The results go through a bool for GCC 12.2, which the app doesn't build with but a host tool
+ * might: there, a task whose if condition awaits something that suspends never runs its body
+ * when started, at -O0 and -O2 alike.
+ *
+ * A Task starts when it's awaited, or when spawn() starts it with nothing awaiting it, and carries
+ * on in whichever thread last resumed it. Executors run queued steps highest priority first,
+ * reading the task's TaskControl as they pick the next step, so raising the priority of an asset
+ * the viewer came closer to moves it ahead of steps already queued. A cancelled task's steps run
+ * before any other so it unwinds quickly: resumeOn returns false and the task returns early.
+ *
+ * Nothing throws in this code base, so an exception escaping a task terminates. A task waiting in
+ * an executor that's destroyed never resumes and its frame leaks; cancel tasks and let them finish
+ * first, see TaskControl::isDone.
+ */
+
+template <typename T = void>
+class Task;
+struct DetachedTask;
+
+//! Shared by a task and whoever started it, to steer it from any thread
+class TaskControl {
+ public:
+  explicit TaskControl(float priority = 0) : priority_(priority) {}
+
+  void cancel() {
+    cancelled_ = true;
+  }
+
+  bool isCancelled() const {
+    return cancelled_;
+  }
+
+  //! Higher runs first. Assets nearer the viewer should be higher.
+  void setPriority(float priority) {
+    priority_ = priority;
+  }
+
+  float getPriority() const {
+    return priority_;
+  }
+
+  //! @return true once a spawned task has finished, cancelled or not
+  bool isDone() const {
+    return done_;
+  }
+
+ private:
+  template <typename T, typename Done>
+  friend DetachedTask runDetached(Task<T> task, std::shared_ptr<TaskControl> control, Done done);
+
+  std::atomic<bool> cancelled_ = false;
+  std::atomic<float> priority_;
+  std::atomic<bool> done_ = false;
+};
+
+/*!
+ * Somewhere steps of tasks run: a pool of threads, or the GL thread.
+ */
+class Executor {
+ public:
+  virtual ~Executor() = default;
+
+  /*!
+   * Queues job, to run in order of control's priority at the time the executor picks it; cancelled
+   * ones first. Jobs without a control have priority 0. Can be called from any thread.
+   */
+  virtual void post(std::function<void()> job, std::shared_ptr<const TaskControl> control) = 0;
+};
+
+//! Where asset loading steps run: file reads, CPU work such as decoding, and GL calls
+struct TaskExecutors {
+  Executor& io;
+  Executor& cpu;
+  Executor& gl;
+};
+
+/*!
+ * The queue of an Executor, ordered by live priorities. Picking the next job looks at every queued
+ * one, which is cheap for the tens of assets in flight at a time. Not thread safe.
+ */
+class TaskQueue {
+ public:
+  void push(std::function<void()> job, std::shared_ptr<const TaskControl> control) {
+    jobs_.push_back({std::move(job), std::move(control), next_++});
+  }
+
+  bool empty() const {
+    return jobs_.empty();
+  }
+
+  size_t size() const {
+    return jobs_.size();
+  }
+
+  void clear() {
+    jobs_.clear();
+  }
+
+  //! Removes and returns the job to run next: cancelled, then highest priority, then oldest
+  std::function<void()> pop() {
+    size_t best = 0;
+    for (size_t i = 1; i < jobs_.size(); i++) {
+      if (isBefore(jobs_[i], jobs_[best])) {
+        best = i;
+      }
+    }
+    auto job = std::move(jobs_[best].job);
+    jobs_[best] = std::move(jobs_.back());
+    jobs_.pop_back();
+    return job;
+  }
+
+ private:
+  struct Job {
+    std::function<void()> job;
+    std::shared_ptr<const TaskControl> control;
+    uint64_t sequence;
+  };
+
+  static bool isBefore(const Job& a, const Job& b) {
+    bool aCancelled = a.control && a.control->isCancelled();
+    bool bCancelled = b.control && b.control->isCancelled();
+    if (aCancelled != bCancelled) {
+      return aCancelled;
+    }
+    float aPriority = a.control ? a.control->getPriority() : 0.f;
+    float bPriority = b.control ? b.control->getPriority() : 0.f;
+    if (aPriority != bPriority) {
+      return aPriority > bPriority;
+    }
+    return a.sequence < b.sequence;
+  }
+
+  std::vector<Job> jobs_;
+  uint64_t next_ = 0;
+};
+
+//! How a task hands its result to the one awaiting it
+template <typename T>
+struct TaskResult {
+  std::optional<T> value;
+
+  void return_value(T v) {
+    value.emplace(std::move(v));
+  }
+
+  T take() {
+    return std::move(*value);
+  }
+};
+
+template <>
+struct TaskResult<void> {
+  void return_void() {}
+
+  void take() {}
+};
+
+/*!
+ * A coroutine producing a T, started by the first co_await on it. When it finishes, whoever awaited
+ * it carries on in the same thread.
+ */
+template <typename T>
+class [[nodiscard]] Task {
+ public:
+  struct promise_type : TaskResult<T> {
+    // what to resume when the task is done
+    std::coroutine_handle<> continuation;
+
+    Task get_return_object() noexcept {
+      return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+    }
+
+    std::suspend_always initial_suspend() noexcept {
+      return {};
+    }
+
+    auto final_suspend() noexcept {
+      struct Resume {
+        bool await_ready() const noexcept {
+          return false;
+        }
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> handle) noexcept {
+          auto continuation = handle.promise().continuation;
+          return continuation ? continuation : std::noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+      };
+      return Resume{};
+    }
+
+    void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+
+  Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+  Task(const Task&) = delete;
+  Task& operator=(const Task&) = delete;
+
+  ~Task() {
+    if (handle_) {
+      handle_.destroy();
+    }
+  }
+
+  auto operator co_await() && noexcept {
+    struct Start {
+      std::coroutine_handle<promise_type> handle;
+
+      bool await_ready() const noexcept {
+        return handle.done();
+      }
+      std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+      }
+      T await_resume() {
+        return handle.promise().take();
+      }
+    };
+    return Start{handle_};
+  }
+
+ private:
+  explicit Task(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+
+  std::coroutine_handle<promise_type> handle_;
+};
+
+/*!
+ * Suspends the task and queues it on executor. co_await returns false if the task was cancelled,
+ * in which case it should return as soon as it can.
+ */
+class ResumeOn {
+ public:
+  ResumeOn(Executor& executor, std::shared_ptr<const TaskControl> control)
+      : executor_(executor), control_(std::move(control)) {}
+
+  bool await_ready() const noexcept {
+    return false;
+  }
+
+  void await_suspend(std::coroutine_handle<> handle) {
+    executor_.post([handle] { handle.resume(); }, control_);
+  }
+
+  bool await_resume() const noexcept {
+    return !control_ || !control_->isCancelled();
+  }
+
+ private:
+  Executor& executor_;
+  std::shared_ptr<const TaskControl> control_;
+};
+
+inline ResumeOn resumeOn(Executor& executor, std::shared_ptr<const TaskControl> control = nullptr) {
+  return ResumeOn(executor, std::move(control));
+}
+
+//! A coroutine nothing awaits, which frees itself when it's done
+struct DetachedTask {
+  struct promise_type {
+    DetachedTask get_return_object() noexcept {
+      return {};
+    }
+    std::suspend_never initial_suspend() noexcept {
+      return {};
+    }
+    std::suspend_never final_suspend() noexcept {
+      return {};
+    }
+    void return_void() noexcept {}
+    void unhandled_exception() noexcept {
+      std::terminate();
+    }
+  };
+};
+
+template <typename T, typename Done>
+DetachedTask runDetached(Task<T> task, std::shared_ptr<TaskControl> control, Done done) {
+  if constexpr (std::is_void_v<T>) {
+    co_await std::move(task);
+    done();
+  } else {
+    done(co_await std::move(task));
+  }
+  if (control) {
+    control->done_ = true;
+  }
+}
+
+/*!
+ * Starts task with nothing awaiting it. done gets the result in the thread the task finished in,
+ * which is wherever it last resumed, so a task that returns early may finish on a worker.
+ * @param control marked done afterwards, may be null
+ */
+template <typename T, typename Done>
+void spawn(Task<T> task, std::shared_ptr<TaskControl> control, Done done) {
+  runDetached(std::move(task), std::move(control), std::move(done));
+}
+
+#endif  // ANDROIDGLINVESTIGATIONS_TASK_H
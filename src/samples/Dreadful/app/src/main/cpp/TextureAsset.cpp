@@ -1,32 +1,169 @@
 #include "TextureAsset.h"
 
+#include <GLES2/gl2ext.h>
 #include <android/imagedecoder.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
 #include "AndroidOut.h"
+#include "Ktx2.h"
+#include "MipGenerator.h"
 
-std::shared_ptr<TextureAsset> TextureAsset::loadAsset(AAssetManager* assetManager, const std::string& assetPath) {
-  // Get the image from asset manager
-  auto pAndroidRobotPng = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_BUFFER);
+/*!
+ * @return the GL internal format for a KTX2 vkFormat, or GL_NONE if GL has no equivalent
+ */
+static GLenum glFormatForVkFormat(uint32_t vkFormat) {
+  switch (vkFormat) {
+    case kVkFormatR8G8B8A8Unorm:
+      return GL_RGBA8;
+    case kVkFormatR8G8B8A8Srgb:
+      return GL_SRGB8_ALPHA8;
+    case kVkFormatEtc2R8G8B8UnormBlock:
+      return GL_COMPRESSED_RGB8_ETC2;
+    case kVkFormatEtc2R8G8B8SrgbBlock:
+      return GL_COMPRESSED_SRGB8_ETC2;
+    case kVkFormatEtc2R8G8B8A1UnormBlock:
+      return GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+    case kVkFormatEtc2R8G8B8A1SrgbBlock:
+      return GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2;
+    case kVkFormatEtc2R8G8B8A8UnormBlock:
+      return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case kVkFormatEtc2R8G8B8A8SrgbBlock:
+      return GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC;
+    case kVkFormatEacR11UnormBlock:
+      return GL_COMPRESSED_R11_EAC;
+    case kVkFormatEacR11SnormBlock:
+      return GL_COMPRESSED_SIGNED_R11_EAC;
+    case kVkFormatEacR11G11UnormBlock:
+      return GL_COMPRESSED_RG11_EAC;
+    case kVkFormatEacR11G11SnormBlock:
+      return GL_COMPRESSED_SIGNED_RG11_EAC;
+    default:
+      break;
+  }
+  if (vkFormat >= kVkFormatAstc4x4UnormBlock && vkFormat <= kVkFormatAstc12x12SrgbBlock) {
+    // The 14 block sizes are in the same order in Vulkan and GL
+    uint32_t block = (vkFormat - kVkFormatAstc4x4UnormBlock) / 2;
+    bool srgb = ((vkFormat - kVkFormatAstc4x4UnormBlock) & 1) != 0;
+    return (srgb ? GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR : GL_COMPRESSED_RGBA_ASTC_4x4_KHR) + block;
+  }
+  return GL_NONE;
+}
 
-  // Make a decoder to turn it into a texture
-  AImageDecoder* pAndroidDecoder = nullptr;
-  auto result = AImageDecoder_createFromAAsset(pAndroidRobotPng, &pAndroidDecoder);
+static bool isAstcSupported() {
+  static const bool supported = [] {
+    auto extensions = reinterpret_cast<const char*>(glGetString(GL_EXTENSIONS));
+    return extensions && strstr(extensions, "GL_KHR_texture_compression_astc_ldr") != nullptr;
+  }();
+  return supported;
+}
+
+GLenum TextureAsset::getKtx2Format(uint32_t vkFormat) {
+  GLenum internalFormat = glFormatForVkFormat(vkFormat);
+  bool astc = internalFormat >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR &&
+              internalFormat <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR;
+  return astc && !isAstcSupported() ? GL_NONE : internalFormat;
+}
+
+bool TextureAsset::isKtx2Path(const std::string& assetPath) {
+  static constexpr char suffix[] = ".ktx2";
+  size_t n = sizeof(suffix) - 1;
+  return assetPath.size() >= n && assetPath.compare(assetPath.size() - n, n, suffix) == 0;
+}
+
+/*!
+ * An image decoded as tightly packed RGBA rows, with its mip chain after it, either on the heap or
+ * in a mapped pixel unpack buffer.
+ */
+struct DecodedImage {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> data;
+  // holds the chain instead of data when set, mapped until the upload
+  PixelBufferPool::Buffer pixelBuffer;
+  std::vector<MipGenerator::Level> mips;
 
+  size_t getImageSize() const {
+    return size_t(width) * height * 4;
+  }
+};
+
+/*!
+ * Decodes an image and builds its mip chain, which is premultiplied and filtered on the CPU rather
+ * than with glGenerateMipmap. Without a pool it needs no GL, so it can run on any thread.
+ *
+ * With a pool the image is decoded into pooled scratch and MipGenerator writes level 0 and the mips
+ * straight into a mapped pixel unpack buffer, so the chain is never copied; decoding into the
+ * mapping itself would have the mips read back from uncached memory.
+ * @param pixelBuffers may be null, GL thread only if set
+ * @return false if the image couldn't be decoded, which is logged
+ */
+static bool decodeImage(AImageDecoder* decoder, const std::string& assetPath, PixelBufferPool* pixelBuffers,
+                        DecodedImage& image) {
   // make sure we get 8 bits per channel out. RGBA order.
-  AImageDecoder_setAndroidBitmapFormat(pAndroidDecoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+  AImageDecoder_setAndroidBitmapFormat(decoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
 
   // Get the image header, to help set everything up
-  const AImageDecoderHeaderInfo* pAndroidHeader = nullptr;
-  pAndroidHeader = AImageDecoder_getHeaderInfo(pAndroidDecoder);
+  const AImageDecoderHeaderInfo* header = AImageDecoder_getHeaderInfo(decoder);
 
   // important metrics for sending to GL
-  auto width = AImageDecoderHeaderInfo_getWidth(pAndroidHeader);
-  auto height = AImageDecoderHeaderInfo_getHeight(pAndroidHeader);
-  auto stride = AImageDecoder_getMinimumStride(pAndroidDecoder);
+  image.width = static_cast<uint32_t>(AImageDecoderHeaderInfo_getWidth(header));
+  image.height = static_cast<uint32_t>(AImageDecoderHeaderInfo_getHeight(header));
+
+  size_t stride = size_t(image.width) * 4;
+  size_t imageSize = image.getImageSize();
+  size_t chainSize = MipGenerator::getChainSize(image.width, image.height);
+  if (pixelBuffers) {
+    image.pixelBuffer = pixelBuffers->acquire(chainSize);
+  }
+  std::vector<uint8_t> scratch;
+  uint8_t* source;
+  uint8_t* chain;
+  if (image.pixelBuffer) {
+    scratch = pixelBuffers->acquireScratch(imageSize);
+    source = scratch.data();
+    chain = image.pixelBuffer.mapped;
+  } else {
+    // Decode tightly packed rows with room after them for the mip chain
+    image.data.resize(chainSize);
+    source = chain = image.data.data();
+  }
 
-  // Get the bitmap data of the image
-  auto upAndroidImageData = std::make_unique<std::vector<uint8_t>>(height * stride);
-  auto decodeResult = AImageDecoder_decodeImage(pAndroidDecoder, upAndroidImageData->data(), stride, upAndroidImageData->size());
+  int result = AImageDecoder_decodeImage(decoder, source, stride, imageSize);
+  if (result == ANDROID_IMAGE_DECODER_SUCCESS) {
+    image.mips = MipGenerator::generate(source, image.width, image.height, chain, chain + imageSize, {});
+  }
+  if (image.pixelBuffer) {
+    pixelBuffers->releaseScratch(std::move(scratch));
+  }
+  if (result != ANDROID_IMAGE_DECODER_SUCCESS) {
+    aout << "TextureAsset: can't decode " << assetPath << ", AImageDecoder error " << result << std::endl;
+    if (image.pixelBuffer) {
+      pixelBuffers->release(image.pixelBuffer);
+    }
+    return false;
+  }
+  return true;
+}
+
+/*!
+ * Uploads a decoded image and its mips into immutable storage, from its pixel buffer if it has
+ * one, which goes back to pixelBuffers.
+ * @return the texture id, or 0 if the pixel buffer's contents were lost while mapped
+ */
+static GLuint uploadImage(DecodedImage& image, PixelBufferPool* pixelBuffers) {
+  // From a pixel buffer the levels are uploaded from offsets in it, so the driver copies on its side.
+  // Offsets aren't pointers into anything, so this is integer arithmetic either way.
+  auto uploadSource = reinterpret_cast<uintptr_t>(image.data.data());
+  if (image.pixelBuffer) {
+    if (!pixelBuffers->unmap(image.pixelBuffer)) {
+      pixelBuffers->release(image.pixelBuffer);
+      return 0;
+    }
+    uploadSource = 0;
+  }
 
   // Get an opengl texture
   GLuint textureId;
@@ -40,27 +177,242 @@ std::shared_ptr<TextureAsset> TextureAsset::loadAsset(AAssetManager* assetManage
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-  // Load the texture into VRAM
-  glTexImage2D(GL_TEXTURE_2D,              // target
-               0,                          // mip level
-               GL_RGBA,                    // internal format, often advisable to use BGR
-               width,                      // width of the texture
-               height,                     // height of the texture
-               0,                          // border (always 0)
-               GL_RGBA,                    // format
-               GL_UNSIGNED_BYTE,           // type
-               upAndroidImageData->data()  // Data to upload
-  );
-
-  // generate mip levels. Not really needed for 2D, but good to do
-  glGenerateMipmap(GL_TEXTURE_2D);
+  // Allocate every level once, immutably, then load the texture into VRAM level by level. The
+  // image is sRGB color, so sampling decodes it to linear.
+  auto levelCount = static_cast<GLsizei>(image.mips.size() + 1);
+  glTexStorage2D(GL_TEXTURE_2D, levelCount, GL_SRGB8_ALPHA8, image.width, image.height);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, image.width, image.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                  reinterpret_cast<const void*>(uploadSource));
+  for (GLint level = 1; level < levelCount; level++) {
+    const auto& mip = image.mips[level - 1];
+    // The data argument is a pointer into the image, or the offset in the bound pixel unpack buffer
+    glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE,
+                    reinterpret_cast<const void*>(uploadSource + image.getImageSize() + mip.offset));
+  }
+  if (image.pixelBuffer) {
+    pixelBuffers->release(image.pixelBuffer);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return textureId;
+}
+
+std::shared_ptr<TextureAsset> TextureAsset::loadAsset(AAssetManager* assetManager, const std::string& assetPath,
+                                                      PixelBufferPool* pixelBuffers) {
+  if (isKtx2Path(assetPath)) {
+    return loadKtx2(assetManager, assetPath);
+  }
+  auto start = std::chrono::steady_clock::now();
+
+  // Get the image from asset manager
+  auto asset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_BUFFER);
+  if (!asset) {
+    aout << "TextureAsset: can't open " << assetPath << std::endl;
+    return nullptr;
+  }
+
+  // Make a decoder to turn it into a texture
+  AImageDecoder* decoder = nullptr;
+  if (AImageDecoder_createFromAAsset(asset, &decoder) != ANDROID_IMAGE_DECODER_SUCCESS) {
+    aout << "TextureAsset: can't decode " << assetPath << std::endl;
+    AAsset_close(asset);
+    return nullptr;
+  }
+  DecodedImage image;
+  bool decoded = decodeImage(decoder, assetPath, pixelBuffers, image);
 
   // cleanup helpers
-  AImageDecoder_delete(pAndroidDecoder);
-  AAsset_close(pAndroidRobotPng);
+  AImageDecoder_delete(decoder);
+  AAsset_close(asset);
+  if (!decoded) {
+    return nullptr;
+  }
+
+  bool throughPixelBuffer = bool(image.pixelBuffer);
+  size_t byteSize = MipGenerator::getChainSize(image.width, image.height);
+  GLuint textureId = uploadImage(image, pixelBuffers);
+  if (!textureId) {
+    aout << "TextureAsset: " << assetPath << ": the pixel buffer was lost before the upload" << std::endl;
+    return nullptr;
+  }
+
+  aout << "TextureAsset: " << assetPath << " " << image.width << "x" << image.height << ", "
+       << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms"
+       << (throughPixelBuffer ? " through a pixel buffer" : "") << ", peak RSS " << getPeakRssKiB() << " KiB" << std::endl;
 
   // Create a shared pointer so it can be cleaned up easily/automatically
-  return std::shared_ptr<TextureAsset>(new TextureAsset(textureId));
+  return std::shared_ptr<TextureAsset>(new TextureAsset(textureId, byteSize));
+}
+
+Task<std::shared_ptr<TextureAsset>> TextureAsset::loadAsync(AAssetManager* assetManager, std::string assetPath,
+                                                            TaskExecutors executors,
+                                                            std::shared_ptr<const TaskControl> control) {
+  auto start = std::chrono::steady_clock::now();
+  auto msSinceStart = [&start] {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+  };
+
+  // Read the whole file, which may block on storage
+  bool running = co_await resumeOn(executors.io, control);
+  if (!running) {
+    co_return nullptr;
+  }
+  std::vector<uint8_t> bytes;
+  auto asset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_STREAMING);
+  if (asset) {
+    bytes.resize(AAsset_getLength(asset));
+    if (AAsset_read(asset, bytes.data(), bytes.size()) != int(bytes.size())) {
+      bytes.clear();
+    }
+    AAsset_close(asset);
+  }
+  if (bytes.empty()) {
+    aout << "TextureAsset: can't read " << assetPath << std::endl;
+    co_return nullptr;
+  }
+  double readMs = msSinceStart();
+
+  if (isKtx2Path(assetPath)) {
+    // Whatever mips are missing are built during the upload, KTX2 files mostly carry theirs
+    running = co_await resumeOn(executors.gl, control);
+    if (!running) {
+      co_return nullptr;
+    }
+    co_return createKtx2(assetPath, bytes.data(), bytes.size());
+  }
+
+  running = co_await resumeOn(executors.cpu, control);
+  if (!running) {
+    co_return nullptr;
+  }
+  AImageDecoder* decoder = nullptr;
+  if (AImageDecoder_createFromBuffer(bytes.data(), bytes.size(), &decoder) != ANDROID_IMAGE_DECODER_SUCCESS) {
+    aout << "TextureAsset: can't decode " << assetPath << std::endl;
+    co_return nullptr;
+  }
+  DecodedImage image;
+  bool decoded = decodeImage(decoder, assetPath, nullptr, image);
+  AImageDecoder_delete(decoder);
+  bytes = {};
+  if (!decoded) {
+    co_return nullptr;
+  }
+  double decodeMs = msSinceStart();
+
+  running = co_await resumeOn(executors.gl, control);
+  if (!running) {
+    co_return nullptr;
+  }
+  GLuint textureId = uploadImage(image, nullptr);
+  aout << "TextureAsset: " << assetPath << " " << image.width << "x" << image.height << " read by " << readMs
+       << " ms, decoded by " << decodeMs << " ms, uploaded by " << msSinceStart() << " ms" << std::endl;
+  co_return std::shared_ptr<TextureAsset>(new TextureAsset(textureId, image.data.size()));
+}
+
+std::shared_ptr<TextureAsset> TextureAsset::loadKtx2(AAssetManager* assetManager, const std::string& assetPath) {
+  auto asset = AAssetManager_open(assetManager, assetPath.c_str(), AASSET_MODE_BUFFER);
+  if (!asset) {
+    aout << "TextureAsset: can't open " << assetPath << std::endl;
+    return nullptr;
+  }
+  auto data = static_cast<const uint8_t*>(AAsset_getBuffer(asset));
+  if (!data) {
+    aout << "TextureAsset: " << assetPath << ": can't read" << std::endl;
+    AAsset_close(asset);
+    return nullptr;
+  }
+  auto texture = createKtx2(assetPath, data, AAsset_getLength(asset));
+  AAsset_close(asset);
+  return texture;
+}
+
+std::shared_ptr<TextureAsset> TextureAsset::createKtx2(const std::string& assetPath, const uint8_t* data,
+                                                       size_t size) {
+  auto start = std::chrono::steady_clock::now();
+  Ktx2Texture ktx;
+  const char* error = nullptr;
+  if (!Ktx2Texture::parse(data, size, ktx, &error)) {
+    aout << "TextureAsset: " << assetPath << ": " << error << std::endl;
+    return nullptr;
+  }
+
+  GLenum internalFormat = getKtx2Format(ktx.header.vkFormat);
+  if (internalFormat == GL_NONE) {
+    aout << "TextureAsset: " << assetPath << ": vkFormat " << ktx.header.vkFormat << " is not supported" << std::endl;
+    return nullptr;
+  }
+  bool compressed = internalFormat != GL_RGBA8 && internalFormat != GL_SRGB8_ALPHA8;
+  auto levelCount = static_cast<GLsizei>(ktx.levels.size());
+  // Uncompressed files without a mip chain get one built by MipGenerator from a copy of level 0, as
+  // the asset buffer is read only. Compressed ones and arrays make do with level 0.
+  bool generateMips = ktx.header.levelCount == 0 && !compressed && !ktx.isArray();
+  std::vector<uint8_t> generated;
+  std::vector<MipGenerator::Level> mips;
+  if (generateMips) {
+    const uint8_t* level0 = ktx.getLevelData(0);
+    generated.assign(level0, level0 + ktx.levels[0].byteLength);
+    generated.resize(generated.size() + MipGenerator::getMipsSize(ktx.header.pixelWidth, ktx.header.pixelHeight));
+    MipGenerator::Options options;
+    options.srgb = internalFormat == GL_SRGB8_ALPHA8;
+    options.premultiply = !ktx.isPremultiplied();
+    mips = MipGenerator::generate(generated.data(), ktx.header.pixelWidth, ktx.header.pixelHeight,
+                                  generated.data() + ktx.levels[0].byteLength, options);
+  } else if (ktx.hasStraightAlpha()) {
+    aout << "TextureAsset: " << assetPath << " isn't premultiplied and will blend wrongly" << std::endl;
+  }
+  GLsizei storageLevels = levelCount + static_cast<GLsizei>(mips.size());
+
+  // Arrays have every layer of a level stored together, which is one 3D upload
+  GLenum target = ktx.isArray() ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+  auto layers = static_cast<GLsizei>(ktx.getLayerCount());
+  GLuint textureId;
+  glGenTextures(1, &textureId);
+  glBindTexture(target, textureId);
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, storageLevels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  if (ktx.isArray()) {
+    glTexStorage3D(target, storageLevels, internalFormat, ktx.header.pixelWidth, ktx.header.pixelHeight, layers);
+  } else {
+    glTexStorage2D(target, storageLevels, internalFormat, ktx.header.pixelWidth, ktx.header.pixelHeight);
+  }
+
+  size_t bytes = 0;
+  for (GLint level = 0; level < levelCount; level++) {
+    auto w = static_cast<GLsizei>(ktx.getLevelWidth(level));
+    auto h = static_cast<GLsizei>(ktx.getLevelHeight(level));
+    auto size = static_cast<GLsizei>(ktx.levels[level].byteLength);
+    const uint8_t* levelData = generateMips ? generated.data() : ktx.getLevelData(level);
+    if (ktx.isArray() && compressed) {
+      glCompressedTexSubImage3D(target, level, 0, 0, 0, w, h, layers, internalFormat, size, levelData);
+    } else if (ktx.isArray()) {
+      glTexSubImage3D(target, level, 0, 0, 0, w, h, layers, GL_RGBA, GL_UNSIGNED_BYTE, levelData);
+    } else if (compressed) {
+      glCompressedTexSubImage2D(target, level, 0, 0, w, h, internalFormat, size, levelData);
+    } else {
+      glTexSubImage2D(target, level, 0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, levelData);
+    }
+    bytes += size;
+  }
+  for (size_t i = 0; i < mips.size(); i++) {
+    const auto& mip = mips[i];
+    const uint8_t* mipData = generated.data() + ktx.levels[0].byteLength + mip.offset;
+    glTexSubImage2D(target, GLint(i + 1), 0, 0, mip.width, mip.height, GL_RGBA, GL_UNSIGNED_BYTE, mipData);
+    bytes += mip.size;
+  }
+  glBindTexture(target, 0);
+
+  GLenum glError = glGetError();
+  if (glError != GL_NO_ERROR) {
+    aout << "TextureAsset: " << assetPath << ": upload failed with GL error " << glError << std::endl;
+    glDeleteTextures(1, &textureId);
+    return nullptr;
+  }
+
+  aout << "TextureAsset: " << assetPath << " " << ktx.header.pixelWidth << "x" << ktx.header.pixelHeight << ", "
+       << layers << " layers, " << storageLevels << " levels, " << bytes << " bytes, "
+       << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+  return std::shared_ptr<TextureAsset>(new TextureAsset(textureId, bytes, target, ktx.getLayerCount()));
 }
 
 TextureAsset::~TextureAsset() {
@@ -4,19 +4,48 @@
 #include <GLES3/gl3.h>
 #include <android/asset_manager.h>
 
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
 
+#include "PixelBufferPool.h"
+#include "Task.h"
+
 class TextureAsset {
  public:
   /*!
-   * Loads a texture asset from the assets/ directory
+   * Loads a texture asset from the assets/ directory. Paths ending in .ktx2 are loaded as KTX2
+   * with their stored mip chain, see loadKtx2; KTX2 arrays become GL_TEXTURE_2D_ARRAY textures.
+   * Anything else is decoded with AImageDecoder as sRGB color, premultiplied and given a mip chain
+   * by MipGenerator, and uploaded into immutable storage.
    * @param assetManager Asset manager to use
    * @param assetPath The path to the asset
-   * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up
+   * @param pixelBuffers if set, the image is decoded into pooled scratch and its mip chain is written
+   * straight into a pooled pixel unpack buffer and uploaded from it, instead of from client memory
+   * @return a shared pointer to a texture asset, resources will be reclaimed when it's cleaned up.
+   * Null if the asset is missing or can't be decoded, or a KTX2 asset can't be used on this device.
+   */
+  static std::shared_ptr<TextureAsset> loadAsset(AAssetManager* assetManager, const std::string& assetPath,
+                                                 PixelBufferPool* pixelBuffers = nullptr);
+
+  /*!
+   * Loads a texture asset like loadAsset, as a task that reads the file on executors.io, decodes it
+   * on executors.cpu and uploads it on executors.gl. KTX2 files go from the read straight to the
+   * upload. The task finishes on executors.gl unless it fails or is cancelled first.
+   * @param control checked between steps, may be null
+   * @return the texture, or null if it can't be loaded or was cancelled
+   */
+  static Task<std::shared_ptr<TextureAsset>> loadAsync(AAssetManager* assetManager, std::string assetPath,
+                                                       TaskExecutors executors,
+                                                       std::shared_ptr<const TaskControl> control);
+
+  /*!
+   * @return the GL internal format for a KTX2 vkFormat, or GL_NONE if this device can't sample it
    */
-  static std::shared_ptr<TextureAsset> loadAsset(AAssetManager* assetManager, const std::string& assetPath);
+  static GLenum getKtx2Format(uint32_t vkFormat);
+
+  static bool isKtx2Path(const std::string& assetPath);
 
   ~TextureAsset();
 
@@ -27,10 +56,71 @@ class TextureAsset {
     return textureID_;
   }
 
+  /*!
+   * @return GL_TEXTURE_2D, or GL_TEXTURE_2D_ARRAY for array textures
+   */
+  GLenum getTarget() const {
+    return target_;
+  }
+
+  /*!
+   * @return the number of array layers, 1 for plain 2D textures
+   */
+  uint32_t getLayerCount() const {
+    return layerCount_;
+  }
+
+  /*!
+   * @return roughly how much GPU memory the texture uses, including its mip chain
+   */
+  size_t getByteSize() const {
+    return byteSize_;
+  }
+
+  /*!
+   * @return true once at least one mip level can be sampled. Textures from loadAsset are resident
+   * right away, streamed ones (see TextureStreamer) start out empty and gain levels coarsest first.
+   */
+  bool isResident() const {
+    return residentLevel_ < levelCount_;
+  }
+
+  bool isFullyResident() const {
+    return levelCount_ > 0 && residentLevel_ == 0;
+  }
+
+  /*!
+   * @return the finest level that can be sampled, which is also GL_TEXTURE_BASE_LEVEL
+   */
+  uint32_t getResidentLevel() const {
+    return residentLevel_;
+  }
+
  private:
-  inline TextureAsset(GLuint textureId) : textureID_(textureId) {}
+  friend class TextureStreamer;
+
+  inline TextureAsset(GLuint textureId, size_t byteSize, GLenum target = GL_TEXTURE_2D, uint32_t layerCount = 1)
+      : textureID_(textureId), byteSize_(byteSize), target_(target), layerCount_(layerCount) {}
+
+  /*!
+   * Uploads every level of a KTX2 texture with glTexStorage2D and glCompressedTexSubImage2D, or
+   * their 3D versions for arrays. ETC2 and EAC are core in GLES 3.0; ASTC needs
+   * GL_KHR_texture_compression_astc_ldr.
+   */
+  static std::shared_ptr<TextureAsset> loadKtx2(AAssetManager* assetManager, const std::string& assetPath);
+
+  /*!
+   * Uploads a KTX2 texture from a file already in memory, see loadKtx2.
+   */
+  static std::shared_ptr<TextureAsset> createKtx2(const std::string& assetPath, const uint8_t* data, size_t size);
 
   GLuint textureID_;
+  size_t byteSize_;
+  GLenum target_;
+  uint32_t layerCount_;
+  // Levels residentLevel_ to levelCount_ - 1 hold data. Synchronous loads count as a single level.
+  uint32_t levelCount_ = 1;
+  uint32_t residentLevel_ = 0;
 };
 
 #endif  // ANDROIDGLINVESTIGATIONS_TEXTUREASSET_H
\ No newline at end of file
@@ -0,0 +1,400 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "AndroidOut.h"
+#include "Ktx2.h"
+
+using namespace std;
+
+TextureStreamer::TextureStreamer(AAssetManager* assetManager, WorkerPool& workers, PixelBufferPool* pixelBuffers,
+                                 UploadScheduler& uploads)
+    : assetManager_(assetManager),
+      workers_(workers),
+      pixelBuffers_(pixelBuffers),
+      uploadScheduler_(uploads),
+      completed_(make_shared<Completed>()) {}
+
+TextureStreamer::~TextureStreamer() {
+  if (pendingCount_) {
+    aout << "TextureStreamer: " << pendingCount_ << " textures still streaming at shutdown" << endl;
+  }
+}
+
+shared_ptr<TextureAsset> TextureStreamer::load(const string& assetPath) {
+  const AssetArchive::Entry* entry = archive_ ? archive_->find(assetPath) : nullptr;
+  AAsset* asset = nullptr;
+  if (!entry) {
+    asset = AAssetManager_open(assetManager_, assetPath.c_str(), AASSET_MODE_STREAMING);
+    if (!asset) {
+      aout << "TextureStreamer: can't open " << assetPath << endl;
+      return nullptr;
+    }
+  }
+  auto closeAsset = [asset] {
+    if (asset) {
+      AAsset_close(asset);
+    }
+  };
+
+  // Read just enough to know the texture is usable and how much room decoding it takes
+  Decoded request;
+  request.archiveEntry = entry;
+  if (TextureAsset::isKtx2Path(assetPath)) {
+    Ktx2Header header;
+    auto* headerBytes = reinterpret_cast<uint8_t*>(&header);
+    bool read = entry ? entry->size >= sizeof(header) && archive_->read(*entry, headerBytes, sizeof(header))
+                      : AAsset_read(asset, headerBytes, sizeof(header)) == sizeof(header);
+    read = read && memcmp(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier)) == 0;
+    request.internalFormat = read ? TextureAsset::getKtx2Format(header.vkFormat) : GL_NONE;
+    if (request.internalFormat == GL_NONE) {
+      aout << "TextureStreamer: " << assetPath << " is not a KTX2 file this device supports" << endl;
+      closeAsset();
+      return nullptr;
+    }
+    request.compressed = request.internalFormat != GL_RGBA8 && request.internalFormat != GL_SRGB8_ALPHA8;
+    if (header.layerCount > 0) {
+      request.target = GL_TEXTURE_2D_ARRAY;
+      request.layerCount = header.layerCount;
+    }
+    request.capacity = entry ? size_t(entry->size) : size_t(AAsset_getLength(asset));
+    if (!request.compressed && header.levelCount == 0 && header.layerCount == 0) {
+      request.capacity = (request.capacity + 3) / 4 * 4 + MipGenerator::getMipsSize(header.pixelWidth, header.pixelHeight);
+    }
+  } else {
+    vector<uint8_t> bytes;
+    AImageDecoder* decoder = createImageDecoder(archive_, entry, asset, bytes);
+    if (!decoder) {
+      aout << "TextureStreamer: can't decode " << assetPath << endl;
+      closeAsset();
+      return nullptr;
+    }
+    const AImageDecoderHeaderInfo* header = AImageDecoder_getHeaderInfo(decoder);
+    auto width = uint32_t(AImageDecoderHeaderInfo_getWidth(header));
+    auto height = uint32_t(AImageDecoderHeaderInfo_getHeight(header));
+    request.capacity = MipGenerator::getChainSize(width, height);
+    request.scratchSize = size_t(width) * height * 4;
+    AImageDecoder_delete(decoder);
+  }
+  closeAsset();
+  request.assetPath = assetPath;
+  return submit(std::move(request));
+}
+
+shared_ptr<TextureAsset> TextureStreamer::loadImage(const string& name, span<const uint8_t> bytes,
+                                                    shared_ptr<const void> owner) {
+  AImageDecoder* decoder = nullptr;
+  if (AImageDecoder_createFromBuffer(bytes.data(), bytes.size(), &decoder) != ANDROID_IMAGE_DECODER_SUCCESS) {
+    aout << "TextureStreamer: can't decode " << name << endl;
+    return nullptr;
+  }
+  const AImageDecoderHeaderInfo* header = AImageDecoder_getHeaderInfo(decoder);
+  auto width = uint32_t(AImageDecoderHeaderInfo_getWidth(header));
+  auto height = uint32_t(AImageDecoderHeaderInfo_getHeight(header));
+  Decoded request;
+  request.capacity = MipGenerator::getChainSize(width, height);
+  request.scratchSize = size_t(width) * height * 4;
+  AImageDecoder_delete(decoder);
+  request.memory = bytes;
+  request.memoryOwner = std::move(owner);
+  request.assetPath = name;
+  return submit(std::move(request));
+}
+
+shared_ptr<TextureAsset> TextureStreamer::submit(Decoded&& request) {
+  // Map the decode target now, GL can't be called from the workers
+  if (pixelBuffers_) {
+    request.pixelBuffer = pixelBuffers_->acquire(request.capacity);
+    request.data = request.pixelBuffer.mapped;
+    if (request.pixelBuffer && request.scratchSize) {
+      request.scratch = pixelBuffers_->acquireScratch(request.scratchSize);
+    }
+  }
+
+  GLuint textureId;
+  glGenTextures(1, &textureId);
+  shared_ptr<TextureAsset> texture(new TextureAsset(textureId, 0, request.target, request.layerCount));
+  texture->levelCount_ = 0;
+
+  request.texture = texture;
+  request.requested = Clock::now();
+  pendingCount_++;
+  workers_.submit([assetManager = assetManager_, archive = archive_, completed = completed_,
+                   request = std::move(request)]() mutable {
+    decode(assetManager, archive, request);
+    lock_guard<mutex> lock(completed->mutex);
+    completed->items.push_back(std::move(request));
+  });
+  return texture;
+}
+
+void TextureStreamer::decode(AAssetManager* assetManager, const AssetArchive* archive, Decoded& decoded) {
+  if (!decoded.data) {
+    decoded.heap.resize(decoded.capacity);
+    decoded.data = decoded.heap.data();
+  }
+  if (!decoded.memory.empty()) {
+    AImageDecoder* decoder = nullptr;
+    if (AImageDecoder_createFromBuffer(decoded.memory.data(), decoded.memory.size(), &decoder) ==
+        ANDROID_IMAGE_DECODER_SUCCESS) {
+      decodeImage(decoder, decoded);
+    } else {
+      aout << "TextureStreamer: can't decode " << decoded.assetPath << endl;
+    }
+    return;
+  }
+  const AssetArchive::Entry* entry = decoded.archiveEntry;
+  AAsset* asset = nullptr;
+  if (!entry) {
+    asset = AAssetManager_open(assetManager, decoded.assetPath.c_str(), AASSET_MODE_STREAMING);
+    if (!asset) {
+      return;
+    }
+  }
+
+  if (TextureAsset::isKtx2Path(decoded.assetPath)) {
+    // The file is read whole into the target and its levels uploaded from where they sit
+    auto fileSize = entry ? static_cast<size_t>(entry->size) : static_cast<size_t>(AAsset_getLength(asset));
+    bool read = fileSize <= decoded.capacity &&
+                (entry ? archive->read(*entry, decoded.data, fileSize)
+                       : AAsset_read(asset, decoded.data, fileSize) == static_cast<int>(fileSize));
+    if (read) {
+      decodeKtx2(decoded, fileSize);
+    } else {
+      aout << "TextureStreamer: can't read " << decoded.assetPath << endl;
+    }
+  } else {
+    vector<uint8_t> bytes;
+    AImageDecoder* decoder = createImageDecoder(archive, entry, asset, bytes);
+    if (decoder) {
+      decodeImage(decoder, decoded);
+    } else {
+      aout << "TextureStreamer: can't decode " << decoded.assetPath << endl;
+    }
+  }
+  if (asset) {
+    AAsset_close(asset);
+  }
+}
+
+AImageDecoder* TextureStreamer::createImageDecoder(const AssetArchive* archive, const AssetArchive::Entry* entry,
+                                                   AAsset* asset, vector<uint8_t>& bytes) {
+  AImageDecoder* decoder = nullptr;
+  int result;
+  if (entry) {
+    // stored entries decode straight from the mapping
+    auto mapped = archive->getMapped(*entry);
+    if (mapped.empty() && (!archive->read(*entry, bytes) || bytes.empty())) {
+      return nullptr;
+    }
+    const uint8_t* data = mapped.empty() ? bytes.data() : mapped.data();
+    size_t size = mapped.empty() ? bytes.size() : mapped.size();
+    result = AImageDecoder_createFromBuffer(data, size, &decoder);
+  } else {
+    result = AImageDecoder_createFromAAsset(asset, &decoder);
+  }
+  return result == ANDROID_IMAGE_DECODER_SUCCESS ? decoder : nullptr;
+}
+
+void TextureStreamer::decodeKtx2(Decoded& decoded, size_t fileSize) {
+  Ktx2Texture ktx;
+  const char* error = nullptr;
+  if (!Ktx2Texture::parse(decoded.data, fileSize, ktx, &error)) {
+    aout << "TextureStreamer: " << decoded.assetPath << ": " << error << endl;
+    return;
+  }
+  for (uint32_t level = 0; level < ktx.levels.size(); level++) {
+    const auto& l = ktx.levels[level];
+    decoded.levels.push_back({ktx.getLevelWidth(level), ktx.getLevelHeight(level), l.byteOffset, l.byteLength});
+  }
+  decoded.size = (fileSize + 3) / 4 * 4;
+
+  // An uncompressed file without mips gets them built here, compressed ones and arrays make do with
+  // level 0. That's rare enough to read back from the target even if it's a pixel buffer.
+  if (!decoded.compressed && ktx.header.levelCount == 0 && !ktx.isArray()) {
+    MipGenerator::Options options;
+    options.srgb = decoded.internalFormat == GL_SRGB8_ALPHA8;
+    options.premultiply = !ktx.isPremultiplied();
+    appendMipChain(decoded, decoded.data + decoded.levels.back().offset, options);
+  } else if (ktx.hasStraightAlpha()) {
+    aout << "TextureStreamer: " << decoded.assetPath << " isn't premultiplied and will blend wrongly" << endl;
+  }
+  decoded.ok = true;
+}
+
+void TextureStreamer::decodeImage(AImageDecoder* decoder, Decoded& decoded) {
+  AImageDecoder_setAndroidBitmapFormat(decoder, ANDROID_BITMAP_FORMAT_RGBA_8888);
+  const AImageDecoderHeaderInfo* header = AImageDecoder_getHeaderInfo(decoder);
+  auto width = static_cast<uint32_t>(AImageDecoderHeaderInfo_getWidth(header));
+  auto height = static_cast<uint32_t>(AImageDecoderHeaderInfo_getHeight(header));
+
+  // Premultiplying and filtering read level 0 back, and a mapped pixel buffer is usually
+  // write-combined memory that's very slow to read. So with one the image is decoded into scratch
+  // from the pool, and MipGenerator writes level 0 and the mips from there into the mapping.
+  uint8_t* pixels = decoded.pixelBuffer ? decoded.scratch.data() : decoded.data;
+
+  // tightly packed rows, so the mip chain can follow level 0 directly
+  size_t stride = size_t(width) * 4;
+  size_t size = stride * height;
+  int result = AImageDecoder_decodeImage(decoder, pixels, stride, size);
+  AImageDecoder_delete(decoder);
+  if (result != ANDROID_IMAGE_DECODER_SUCCESS) {
+    aout << "TextureStreamer: can't decode " << decoded.assetPath << ", error " << result << endl;
+    return;
+  }
+
+  decoded.levels.push_back({width, height, 0, size});
+  decoded.size = size;
+  appendMipChain(decoded, pixels, MipGenerator::Options());
+  decoded.ok = true;
+}
+
+void TextureStreamer::appendMipChain(Decoded& decoded, const uint8_t* source, const MipGenerator::Options& options) {
+  // The capacity was sized for this up front
+  Level last = decoded.levels.back();
+  size_t base = decoded.size;
+  auto mips = MipGenerator::generate(source, last.width, last.height, decoded.data + last.offset, decoded.data + base,
+                                     options);
+  for (auto& level : mips) {
+    level.offset += base;
+    decoded.size += level.size;
+    decoded.levels.push_back(level);
+  }
+}
+
+void TextureStreamer::update() {
+  vector<Decoded> decoded;
+  {
+    lock_guard<mutex> lock(completed_->mutex);
+    decoded.swap(completed_->items);
+  }
+  for (auto& d : decoded) {
+    beginUpload(std::move(d));
+  }
+
+  for (auto& upload : uploads_) {
+    upload.frames++;
+  }
+  for (auto it = uploads_.begin(); it != uploads_.end();) {
+    if (!it->texture->isFullyResident()) {
+      ++it;
+      continue;
+    }
+    const auto& level0 = it->decoded.levels[0];
+    aout << "TextureStreamer: " << it->decoded.assetPath << " " << level0.width << "x" << level0.height << ", "
+         << it->decoded.levels.size() << " levels, visible after "
+         << chrono::duration<double, milli>(it->visible - it->decoded.requested).count() << " ms, complete after "
+         << chrono::duration<double, milli>(Clock::now() - it->decoded.requested).count() << " ms over "
+         << it->frames << " frames" << (pixelBuffers_ ? " through a pixel buffer" : "") << ", peak RSS "
+         << getPeakRssKiB() << " KiB" << endl;
+    // everything is on the GPU and the scheduler is done with it, the staging memory can go
+    discard(it->decoded);
+    it = uploads_.erase(it);
+  }
+}
+
+void TextureStreamer::discard(Decoded& decoded) {
+  if (decoded.pixelBuffer) {
+    pixelBuffers_->release(decoded.pixelBuffer);
+  }
+  decoded.heap = {};
+  decoded.data = nullptr;
+  pendingCount_--;
+}
+
+void TextureStreamer::beginUpload(Decoded&& decoded) {
+  // An image decoded from memory is done with it, and the decode with its scratch
+  decoded.memory = {};
+  decoded.memoryOwner.reset();
+  if (pixelBuffers_) {
+    pixelBuffers_->releaseScratch(std::move(decoded.scratch));
+  }
+
+  auto texture = decoded.texture.lock();
+  // The mapping may have been lost, e.g. to a screen mode change, in which case the data is garbage
+  bool dataIntact = !decoded.pixelBuffer || pixelBuffers_->unmap(decoded.pixelBuffer);
+  if (!texture || !decoded.ok || !dataIntact) {
+    // Released while decoding, or unusable. A failed texture stays empty and is never drawn.
+    if (texture) {
+      aout << "TextureStreamer: failed to load " << decoded.assetPath << endl;
+    }
+    discard(decoded);
+    return;
+  }
+
+  auto levelCount = static_cast<uint32_t>(decoded.levels.size());
+  GLenum target = decoded.target;
+  glBindTexture(target, texture->getTextureID());
+  glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(target, GL_TEXTURE_MIN_FILTER, levelCount > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  const auto& level0 = decoded.levels[0];
+  if (target == GL_TEXTURE_2D_ARRAY) {
+    glTexStorage3D(target, levelCount, decoded.internalFormat, level0.width, level0.height, decoded.layerCount);
+  } else {
+    glTexStorage2D(target, levelCount, decoded.internalFormat, level0.width, level0.height);
+  }
+  glBindTexture(target, 0);
+
+  texture->levelCount_ = levelCount;
+  texture->residentLevel_ = levelCount;
+  texture->byteSize_ = 0;
+  for (const auto& level : decoded.levels) {
+    texture->byteSize_ += level.size;
+  }
+
+  uploads_.emplace_back();
+  Upload& upload = uploads_.back();
+  upload.decoded = std::move(decoded);
+  upload.texture = std::move(texture);
+
+  // Small levels go ahead of everything else queued, so the texture can be drawn this frame, and
+  // finer ones in pieces behind whatever is already loading. Both stay within the scheduler's
+  // budget. Jobs of a priority run in order, so each level lands after the coarser ones and base
+  // levels only ever go down.
+  uint32_t level = levelCount;
+  while (level > 0) {
+    level--;
+    auto priority = upload.decoded.levels[level].size <= kFirstVisibleBytes ? UploadScheduler::Priority::Urgent
+                                                                            : UploadScheduler::Priority::Normal;
+    uploadScheduler_.submitTexture(
+        getLevelUpload(upload, level), [&upload, level] { setResidentLevel(upload, level); }, priority);
+  }
+}
+
+UploadScheduler::TextureUpload TextureStreamer::getLevelUpload(const Upload& upload, uint32_t level) const {
+  const auto& decoded = upload.decoded;
+  const auto& l = decoded.levels[level];
+  UploadScheduler::TextureUpload result;
+  result.texture = upload.texture->getTextureID();
+  result.target = decoded.target;
+  result.level = GLint(level);
+  result.width = l.width;
+  result.height = l.height;
+  result.layerCount = decoded.layerCount;
+  result.compressedFormat = decoded.compressed ? decoded.internalFormat : GL_NONE;
+  result.size = l.size;
+  // From the pixel buffer the data is an offset into it
+  if (decoded.pixelBuffer) {
+    result.unpackBuffer = decoded.pixelBuffer.id;
+    result.data = reinterpret_cast<const uint8_t*>(l.offset);
+  } else {
+    result.data = decoded.heap.data() + l.offset;
+  }
+  return result;
+}
+
+void TextureStreamer::setResidentLevel(Upload& upload, uint32_t level) {
+  auto& texture = *upload.texture;
+  GLenum target = upload.decoded.target;
+  glBindTexture(target, texture.getTextureID());
+  glTexParameteri(target, GL_TEXTURE_BASE_LEVEL, level);
+  glBindTexture(target, 0);
+
+  if (!texture.isResident()) {
+    upload.visible = Clock::now();
+  }
+  texture.residentLevel_ = level;
+}
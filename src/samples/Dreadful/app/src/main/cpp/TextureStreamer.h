@@ -0,0 +1,205 @@
+#ifndef ANDROIDGLINVESTIGATIONS_TEXTURESTREAMER_H
+#define ANDROIDGLINVESTIGATIONS_TEXTURESTREAMER_H
+
+#include <GLES3/gl3.h>
+#include <android/asset_manager.h>
+#include <android/imagedecoder.h>
+
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "AssetArchive.h"
+#include "MipGenerator.h"
+#include "PixelBufferPool.h"
+#include "TextureAsset.h"
+#include "UploadScheduler.h"
+#include "WorkerPool.h"
+
+/*!
+ * Loads textures without stalling the GL thread. load() returns an empty texture right away and
+ * hands reading and decoding to a WorkerPool. PNGs (anything AImageDecoder reads) get their alpha
+ * premultiplied and their mip chain built there too, by MipGenerator; KTX2 files bring their own,
+ * and may be arrays. With a PixelBufferPool the workers write every level straight into a mapped
+ * pixel unpack buffer and levels are uploaded from offsets in it. Images are decoded into scratch
+ * memory from the pool first, as premultiplying and filtering read level 0 back and mapped memory
+ * is slow to read, but there is no copy of the whole chain.
+ *
+ * update() then queues decoded textures on an UploadScheduler, coarsest level first, which spreads
+ * them over frames within its time budget. Levels up to kFirstVisibleBytes are urgent jobs, so they
+ * go up ahead of finer levels of other textures, normally the frame the decode lands, and a blurry
+ * texture shows right away. GL_TEXTURE_BASE_LEVEL tracks the finest level uploaded so sampling
+ * never touches levels without data. Models whose texture isn't
+ * resident yet (TextureAsset::isResident) should be skipped.
+ *
+ * With an AssetArchive set, assets in it are read from there (decompressing on the worker) and
+ * everything else from the asset manager. Images embedded in other files, e.g. a GLB, are decoded
+ * from memory with loadImage().
+ */
+class TextureStreamer {
+ public:
+  //! Levels this small are uploaded ahead of larger ones, to make textures visible sooner
+  static constexpr size_t kFirstVisibleBytes = 64 * 64 * 4;
+
+  /*!
+   * @param pixelBuffers decode targets, or null to decode into heap memory
+   * @param uploads uploads every level. Its jobs point into the streamer, so it has to be
+   * destroyed first.
+   */
+  TextureStreamer(AAssetManager* assetManager, WorkerPool& workers, PixelBufferPool* pixelBuffers,
+                  UploadScheduler& uploads);
+  TextureStreamer(const TextureStreamer&) = delete;
+  TextureStreamer& operator=(const TextureStreamer&) = delete;
+  ~TextureStreamer();
+
+  /*!
+   * Starts streaming an asset. The asset is opened to check it exists, and for KTX2 that this device
+   * supports its format, so fallbacks can be chosen right away. Call on the GL thread.
+   * @return an empty texture that fills in over the next frames, or null if the asset can't be used
+   */
+  std::shared_ptr<TextureAsset> load(const std::string& assetPath);
+
+  /*!
+   * Starts streaming an image (anything AImageDecoder reads) that's already in memory, which owner
+   * keeps alive until it's decoded. Call on the GL thread.
+   * @param name identifies the image in logs
+   * @return an empty texture that fills in over the next frames, or null if the image can't be read
+   */
+  std::shared_ptr<TextureAsset> loadImage(const std::string& name, std::span<const uint8_t> bytes,
+                                          std::shared_ptr<const void> owner);
+
+  /*!
+   * Reads assets from archive when it has them. The archive must outlive the worker pool.
+   */
+  void setArchive(const AssetArchive* archive) {
+    archive_ = archive;
+  }
+
+  /*!
+   * Starts uploading decoded textures. Call once per frame on the GL thread, before the scheduler
+   * runs.
+   */
+  void update();
+
+  /*!
+   * @return textures still being decoded or uploaded
+   */
+  size_t getPendingCount() const {
+    return pendingCount_;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  using Level = MipGenerator::Level;
+
+  //! A texture decoded on a worker, finest level first
+  struct Decoded {
+    std::weak_ptr<TextureAsset> texture;
+    std::string assetPath;
+    // where to read from instead of the asset manager
+    const AssetArchive::Entry* archiveEntry = nullptr;
+    std::span<const uint8_t> memory;
+    std::shared_ptr<const void> memoryOwner;
+    GLenum internalFormat = GL_SRGB8_ALPHA8;
+    GLenum target = GL_TEXTURE_2D;
+    // a level's size covers all its layers
+    uint32_t layerCount = 1;
+    bool compressed = false;
+    bool ok = false;
+    // Bytes the decode may write, including generated mips. It writes to data, which points into
+    // the pixel buffer's mapping, or into heap if there's no pool.
+    size_t capacity = 0;
+    size_t size = 0;
+    uint8_t* data = nullptr;
+    PixelBufferPool::Buffer pixelBuffer;
+    std::vector<uint8_t> heap;
+    // Bytes of an image's level 0, which is decoded into scratch from the pool and premultiplied
+    // from there into the pixel buffer. 0 for KTX2 files.
+    size_t scratchSize = 0;
+    std::vector<uint8_t> scratch;
+    std::vector<Level> levels;
+    Clock::time_point requested;
+  };
+
+  struct Upload {
+    Decoded decoded;
+    std::shared_ptr<TextureAsset> texture;
+    uint32_t frames = 0;
+    Clock::time_point visible;
+  };
+
+  //! Shared with the jobs, so a job that outlives the streamer has somewhere to put its result
+  struct Completed {
+    std::mutex mutex;
+    std::vector<Decoded> items;
+  };
+
+  /*!
+   * Maps the decode target of a request that's been sized and queues its decode.
+   * @return the texture that will receive it
+   */
+  std::shared_ptr<TextureAsset> submit(Decoded&& request);
+
+  static void decode(AAssetManager* assetManager, const AssetArchive* archive, Decoded& decoded);
+
+  /*!
+   * Parses a KTX2 file already read into decoded's data.
+   */
+  static void decodeKtx2(Decoded& decoded, size_t fileSize);
+
+  /*!
+   * Decodes an image into decoded's data and deletes decoder.
+   */
+  static void decodeImage(AImageDecoder* decoder, Decoded& decoded);
+
+  /*!
+   * Creates an image decoder for an archive entry if there is one, otherwise for asset.
+   * @param bytes holds the entry if it's compressed, and must outlive the decoder
+   * @return the decoder, or null if the image can't be read
+   */
+  static AImageDecoder* createImageDecoder(const AssetArchive* archive, const AssetArchive::Entry* entry,
+                                           AAsset* asset, std::vector<uint8_t>& bytes);
+
+  /*!
+   * Builds the mips below the last level of decoded with MipGenerator, appending them to its data.
+   * @param source the last level's pixels, which may be a copy of them in cached memory
+   */
+  static void appendMipChain(Decoded& decoded, const uint8_t* source, const MipGenerator::Options& options);
+
+  /*!
+   * Drops a texture that won't be uploaded, giving back its pixel buffer.
+   */
+  void discard(Decoded& decoded);
+
+  /*!
+   * Allocates storage for a decoded texture, uploads its small levels and queues the rest.
+   */
+  void beginUpload(Decoded&& decoded);
+
+  /*!
+   * Describes a level of upload for the scheduler.
+   */
+  UploadScheduler::TextureUpload getLevelUpload(const Upload& upload, uint32_t level) const;
+
+  /*!
+   * Makes level, just uploaded, the base level of upload's texture.
+   */
+  static void setResidentLevel(Upload& upload, uint32_t level);
+
+  AAssetManager* assetManager_;
+  const AssetArchive* archive_ = nullptr;
+  WorkerPool& workers_;
+  PixelBufferPool* pixelBuffers_;
+  UploadScheduler& uploadScheduler_;
+  size_t pendingCount_ = 0;
+  std::shared_ptr<Completed> completed_;
+  // a list so queued jobs can point at their entry
+  std::list<Upload> uploads_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_TEXTURESTREAMER_H
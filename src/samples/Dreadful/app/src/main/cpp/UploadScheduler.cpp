@@ -0,0 +1,218 @@
+#include "UploadScheduler.h"
+
+#include <GLES2/gl2ext.h>
+
+#include <algorithm>
+#include <cstring>
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+//! A guess to size the first pieces with, on the low side so they can't blow the budget
+static constexpr double kInitialBytesPerMs = 256 * 1024;
+
+//! Only this much of the remaining budget is planned for, the throughput estimate is noisy
+static constexpr double kBudgetMargin = 0.8;
+
+//! Buffer pieces are at least this big, smaller ones cost more in calls than they save
+static constexpr size_t kMinBufferPieceBytes = 16 * 1024;
+
+/*!
+ * @return the pixel rows in a row of blocks of a compressed format, or 1 if it isn't one
+ */
+static uint32_t getBlockHeight(GLenum compressedFormat) {
+  // ASTC formats run 4x4, 5x4, 5x5, 6x5, 6x6, 8x5, 8x6, 8x8, 10x5, 10x6, 10x8, 10x10, 12x10, 12x12
+  static constexpr uint32_t astcHeights[] = {4, 4, 5, 5, 6, 5, 6, 8, 5, 6, 8, 10, 10, 12};
+  if (compressedFormat >= GL_COMPRESSED_RGBA_ASTC_4x4_KHR && compressedFormat <= GL_COMPRESSED_RGBA_ASTC_12x12_KHR) {
+    return astcHeights[compressedFormat - GL_COMPRESSED_RGBA_ASTC_4x4_KHR];
+  }
+  if (compressedFormat >= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR &&
+      compressedFormat <= GL_COMPRESSED_SRGB8_ALPHA8_ASTC_12x12_KHR) {
+    return astcHeights[compressedFormat - GL_COMPRESSED_SRGB8_ALPHA8_ASTC_4x4_KHR];
+  }
+  // ETC2 and EAC
+  return compressedFormat == GL_NONE ? 1 : 4;
+}
+
+//! Rows of data in one layer, counting a partial row of blocks
+static uint32_t getRowCount(const UploadScheduler::TextureUpload& upload) {
+  uint32_t blockHeight = getBlockHeight(upload.compressedFormat);
+  return (upload.height + blockHeight - 1) / blockHeight;
+}
+
+UploadScheduler::UploadScheduler(double budgetMs) : budgetMs_(budgetMs), throughput_(kInitialBytesPerMs) {}
+
+UploadScheduler::~UploadScheduler() {
+  if (pendingCount_) {
+    aout << "UploadScheduler: " << pendingCount_ << " uploads dropped at shutdown" << endl;
+  }
+}
+
+future<void> UploadScheduler::enqueue(Piece piece, size_t minBytes, Callback done, Priority priority) {
+  Job job;
+  job.piece = std::move(piece);
+  job.done = std::move(done);
+  job.minBytes = minBytes;
+  job.priority = priority;
+  auto result = job.promise.get_future();
+  pendingCount_++;
+  lock_guard<mutex> lock(mutex_);
+  submitted_.push_back(std::move(job));
+  return result;
+}
+
+future<void> UploadScheduler::submit(Step step, Callback done) {
+  return enqueue([step = std::move(step)](size_t, size_t&) { return step(); }, 0, std::move(done));
+}
+
+future<void> UploadScheduler::submitTexture(const TextureUpload& upload, Callback done, Priority priority) {
+  // The smallest piece is a row of pixels or blocks of one layer
+  size_t minBytes = max<size_t>(1, upload.size / upload.layerCount / getRowCount(upload));
+  uint32_t layer = 0;
+  uint32_t row = 0;
+  auto piece = [upload, layer, row](size_t maxBytes, size_t& uploaded) mutable {
+    uploaded = uploadRows(upload, layer, row, maxBytes);
+    return layer == upload.layerCount;
+  };
+  return enqueue(std::move(piece), minBytes, std::move(done), priority);
+}
+
+future<void> UploadScheduler::submitBuffer(GLenum target, GLuint buffer, size_t offset, const uint8_t* data,
+                                           size_t size, Callback done) {
+  size_t written = 0;
+  auto piece = [target, buffer, offset, data, size, written](size_t maxBytes, size_t& uploaded) mutable {
+    uploaded = min(max(maxBytes, kMinBufferPieceBytes), size - written);
+    glBindBuffer(target, buffer);
+    glBufferSubData(target, GLintptr(offset + written), GLsizeiptr(uploaded), data + written);
+    glBindBuffer(target, 0);
+    written += uploaded;
+    return written == size;
+  };
+  return enqueue(std::move(piece), min(size, kMinBufferPieceBytes), std::move(done));
+}
+
+size_t UploadScheduler::uploadRows(const TextureUpload& upload, uint32_t& layer, uint32_t& row, size_t maxBytes) {
+  uint32_t blockHeight = getBlockHeight(upload.compressedFormat);
+  uint32_t rowCount = getRowCount(upload);
+  size_t layerSize = upload.size / upload.layerCount;
+  size_t rowBytes = layerSize / rowCount;
+  uint32_t rows = uint32_t(clamp<size_t>(maxBytes / rowBytes, 1, rowCount - row));
+  auto y = static_cast<GLint>(row * blockHeight);
+  auto height = static_cast<GLsizei>(min(rows * blockHeight, upload.height - row * blockHeight));
+  auto size = static_cast<GLsizei>(rows * rowBytes);
+  // From a pixel buffer data is an offset, so this is integer arithmetic either way
+  auto source = reinterpret_cast<const void*>(reinterpret_cast<uintptr_t>(upload.data) + layer * layerSize +
+                                              row * rowBytes);
+
+  GLenum target = upload.target;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, upload.unpackBuffer);
+  glBindTexture(target, upload.texture);
+  if (target == GL_TEXTURE_2D_ARRAY && upload.compressedFormat != GL_NONE) {
+    glCompressedTexSubImage3D(target, upload.level, 0, y, layer, upload.width, height, 1, upload.compressedFormat, size,
+                              source);
+  } else if (target == GL_TEXTURE_2D_ARRAY) {
+    glTexSubImage3D(target, upload.level, 0, y, layer, upload.width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, source);
+  } else if (upload.compressedFormat != GL_NONE) {
+    glCompressedTexSubImage2D(target, upload.level, 0, y, upload.width, height, upload.compressedFormat, size, source);
+  } else {
+    glTexSubImage2D(target, upload.level, 0, y, upload.width, height, GL_RGBA, GL_UNSIGNED_BYTE, source);
+  }
+  glBindTexture(target, 0);
+
+  row += rows;
+  if (row == rowCount) {
+    row = 0;
+    layer++;
+  }
+  return size_t(size);
+}
+
+void UploadScheduler::run() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    for (auto& job : submitted_) {
+      // A normal job that's part way through waits behind urgent ones, its pieces don't depend on
+      // each other
+      if (job.priority == Priority::Urgent) {
+        queue_.insert(queue_.begin() + ptrdiff_t(urgentCount_++), std::move(job));
+      } else {
+        queue_.push_back(std::move(job));
+      }
+    }
+    submitted_.clear();
+  }
+  stats_.frames++;
+  stats_.lastFrameMs = 0;
+  if (queue_.empty()) {
+    return;
+  }
+
+  auto start = Clock::now();
+  auto elapsedMs = [](Clock::time_point since) {
+    return chrono::duration<double, milli>(Clock::now() - since).count();
+  };
+  bool ranPiece = false;
+  while (!queue_.empty()) {
+    auto& job = queue_.front();
+    double remainingMs = (budgetMs_ - elapsedMs(start)) * kBudgetMargin;
+    size_t maxBytes = 0;
+    // Something runs every frame however slow it looks, otherwise a big piece could wait forever
+    if (job.minBytes == 0) {
+      if (ranPiece && stepMs_ > remainingMs) {
+        break;
+      }
+    } else {
+      maxBytes = size_t(max(0., remainingMs) * throughput_);
+      if (maxBytes < job.minBytes) {
+        if (ranPiece) {
+          break;
+        }
+        maxBytes = job.minBytes;
+      }
+    }
+
+    auto pieceStart = Clock::now();
+    size_t uploaded = 0;
+    bool finished = job.piece(maxBytes, uploaded);
+    double pieceMs = elapsedMs(pieceStart);
+    ranPiece = true;
+    if (job.minBytes == 0) {
+      stepMs_ = pieceMs;
+    } else if (uploaded > 0) {
+      // a moving average, weighted so a few odd pieces don't swing it much
+      double measured = uploaded / max(pieceMs, 0.001);
+      throughput_ = throughput_ * 0.75 + measured * 0.25;
+    }
+    stats_.bytes += uploaded;
+
+    if (finished) {
+      if (job.done) {
+        job.done();
+      }
+      job.promise.set_value();
+      if (job.priority == Priority::Urgent) {
+        urgentCount_--;
+      }
+      queue_.pop_front();
+      pendingCount_--;
+      stats_.jobs++;
+    }
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  double ms = elapsedMs(start);
+  stats_.busyFrames++;
+  stats_.lastFrameMs = ms;
+  stats_.maxFrameMs = max(stats_.maxFrameMs, ms);
+  if (ms > budgetMs_) {
+    stats_.framesOverBudget++;
+  }
+}
+
+void UploadScheduler::logStats() const {
+  aout << "UploadScheduler: " << stats_.jobs << " uploads, " << stats_.bytes / 1024 << " KiB over " << stats_.busyFrames
+       << " of " << stats_.frames << " frames, at most " << stats_.maxFrameMs << " ms of a " << budgetMs_
+       << " ms budget, " << stats_.framesOverBudget << " frames over, estimated " << throughput_ / 1024
+       << " KiB/ms" << endl;
+}
@@ -0,0 +1,160 @@
+#ifndef ANDROIDGLINVESTIGATIONS_UPLOADSCHEDULER_H
+#define ANDROIDGLINVESTIGATIONS_UPLOADSCHEDULER_H
+
+#include <GLES3/gl3.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*!
+ * A queue of GL uploads that the GL thread works through a slice at a time, so no frame spends
+ * more than a fixed budget on them however much is loading. Any thread can submit; run() does the
+ * work on the GL thread once per frame.
+ *
+ * Texture and buffer uploads are split into row and byte range pieces sized from the throughput
+ * measured so far, so a piece fits in what's left of the budget. Anything else (shader linking,
+ * say) can be submitted as a step function that's called once per slice until it says it's done.
+ * Each job completes through the returned future and, on the GL thread, an optional callback.
+ * Urgent jobs, such as the levels that make a texture visible, go ahead of normal ones but still
+ * count against the budget.
+ *
+ * Only the CPU time of the GL calls is counted. A driver that defers the copy does it later, on
+ * its own time, which is the point of keeping pieces small.
+ */
+class UploadScheduler {
+ public:
+  //! Called on the GL thread, once per slice, until it returns true
+  using Step = std::function<bool()>;
+
+  //! Called on the GL thread when a job is done, before its future is ready
+  using Callback = std::function<void()>;
+
+  //! Jobs of each priority run in the order they were submitted, urgent ones before any normal ones
+  enum class Priority { Normal, Urgent };
+
+  /*!
+   * One level of a texture, or of every layer of an array texture. The data must stay valid until
+   * the job completes.
+   */
+  struct TextureUpload {
+    GLuint texture = 0;
+    GLenum target = GL_TEXTURE_2D;
+    GLint level = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    // layers of a GL_TEXTURE_2D_ARRAY, stored one after the other
+    uint32_t layerCount = 1;
+    // GL_NONE for GL_RGBA, GL_UNSIGNED_BYTE data, otherwise an ETC2, EAC or ASTC format
+    GLenum compressedFormat = GL_NONE;
+    // all layers, with tightly packed rows
+    size_t size = 0;
+    // client memory, or an offset into unpackBuffer if that's set
+    const uint8_t* data = nullptr;
+    GLuint unpackBuffer = 0;
+  };
+
+  struct Stats {
+    uint64_t frames = 0;
+    // frames that had something to upload
+    uint64_t busyFrames = 0;
+    uint64_t framesOverBudget = 0;
+    uint64_t jobs = 0;
+    size_t bytes = 0;
+    double lastFrameMs = 0;
+    double maxFrameMs = 0;
+  };
+
+  /*!
+   * @param budgetMs GL thread time run() may spend per frame
+   */
+  explicit UploadScheduler(double budgetMs);
+  UploadScheduler(const UploadScheduler&) = delete;
+  UploadScheduler& operator=(const UploadScheduler&) = delete;
+
+  /*!
+   * Drops jobs that haven't finished, without calling their callbacks. Their futures report
+   * broken promises.
+   */
+  ~UploadScheduler();
+
+  std::future<void> submit(Step step, Callback done = {});
+  std::future<void> submitTexture(const TextureUpload& upload, Callback done = {},
+                                  Priority priority = Priority::Normal);
+
+  /*!
+   * Uploads to a range of a buffer that already has storage. The data must stay valid until the
+   * job completes.
+   */
+  std::future<void> submitBuffer(GLenum target, GLuint buffer, size_t offset, const uint8_t* data, size_t size,
+                                 Callback done = {});
+
+  /*!
+   * Works on the queue, oldest job first, until it's empty or the budget is spent. Call once per
+   * frame on the GL thread.
+   */
+  void run();
+
+  /*!
+   * @return jobs submitted and not complete yet
+   */
+  size_t getPendingCount() const {
+    return pendingCount_;
+  }
+
+  double getBudgetMs() const {
+    return budgetMs_;
+  }
+
+  const Stats& getStats() const {
+    return stats_;
+  }
+
+  void logStats() const;
+
+ private:
+  using Clock = std::chrono::steady_clock;
+
+  //! How one kind of job runs a piece of itself, given the bytes it may upload
+  using Piece = std::function<bool(size_t maxBytes, size_t& uploaded)>;
+
+  struct Job {
+    Piece piece;
+    Callback done;
+    std::promise<void> promise;
+    // smallest useful piece, which runs whatever the throughput estimate says
+    size_t minBytes = 0;
+    Priority priority = Priority::Normal;
+  };
+
+  std::future<void> enqueue(Piece piece, size_t minBytes, Callback done, Priority priority = Priority::Normal);
+
+  /*!
+   * Uploads the next rows of upload, starting at layer and row.
+   */
+  static size_t uploadRows(const TextureUpload& upload, uint32_t& layer, uint32_t& row, size_t maxBytes);
+
+  double budgetMs_;
+  // bytes per millisecond, measured
+  double throughput_;
+  // last duration of a step job, which can't be split any further
+  double stepMs_ = 0;
+
+  std::mutex mutex_;
+  std::vector<Job> submitted_;
+  std::atomic<size_t> pendingCount_ = 0;
+
+  // GL thread only. Urgent jobs are the first urgentCount_.
+  std::deque<Job> queue_;
+  size_t urgentCount_ = 0;
+  Stats stats_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_UPLOADSCHEDULER_H
@@ -0,0 +1,330 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+
+//! Rounding error of 16 bit octahedral directions, measured over the sphere with some margin
+static constexpr float kOctahedralTolerance = 1e-4f;
+
+static uint32_t getComponentSize(VertexComponentType type) {
+  switch (type) {
+    case VertexComponentType::Float:
+      return 4;
+    case VertexComponentType::Unorm8:
+      return 1;
+    default:
+      return 2;
+  }
+}
+
+static uint16_t floatToHalf(float value) {
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  uint16_t sign = uint16_t(bits >> 16 & 0x8000);
+  bits &= 0x7fffffff;
+  if (bits >= 0x7f800000) {
+    // infinity, or a nan that stays one
+    return sign | (bits > 0x7f800000 ? 0x7e00 : 0x7c00);
+  }
+  if (bits >= 0x477ff000) {
+    // rounds past 65504
+    return sign | 0x7c00;
+  }
+  if (bits < 0x38800000) {
+    // below 2^-14 halves are subnormal, steps of 2^-24
+    float magnitude;
+    memcpy(&magnitude, &bits, sizeof(magnitude));
+    return sign | uint16_t(lrintf(magnitude * 16777216.f));
+  }
+  // rebias the exponent from 127 to 15 and round the dropped 13 bits to nearest even
+  uint32_t half = (bits - 0x38000000) >> 13;
+  uint32_t dropped = bits & 0x1fff;
+  if (dropped > 0x1000 || (dropped == 0x1000 && (half & 1))) {
+    half++;
+  }
+  return sign | uint16_t(half);
+}
+
+static float halfToFloat(uint16_t half) {
+  uint32_t sign = uint32_t(half & 0x8000) << 16;
+  uint32_t exponent = half >> 10 & 0x1f;
+  uint32_t mantissa = half & 0x3ff;
+  uint32_t bits;
+  if (exponent == 0) {
+    float magnitude = ldexpf(float(mantissa), -24);
+    memcpy(&bits, &magnitude, sizeof(bits));
+  } else if (exponent == 31) {
+    bits = 0x7f800000 | mantissa << 13;
+  } else {
+    bits = (exponent + 112) << 23 | mantissa << 13;
+  }
+  bits |= sign;
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void store(VertexComponentType type, float value, uint8_t* out) {
+  switch (type) {
+    case VertexComponentType::Float:
+      memcpy(out, &value, sizeof(value));
+      break;
+    case VertexComponentType::Half: {
+      uint16_t half = floatToHalf(value);
+      memcpy(out, &half, sizeof(half));
+      break;
+    }
+    case VertexComponentType::Snorm16: {
+      auto snorm = int16_t(lrintf(clamp(value, -1.f, 1.f) * 32767.f));
+      memcpy(out, &snorm, sizeof(snorm));
+      break;
+    }
+    case VertexComponentType::Unorm16: {
+      auto unorm = uint16_t(lrintf(clamp(value, 0.f, 1.f) * 65535.f));
+      memcpy(out, &unorm, sizeof(unorm));
+      break;
+    }
+    case VertexComponentType::Unorm8:
+      *out = uint8_t(lrintf(clamp(value, 0.f, 1.f) * 255.f));
+      break;
+    case VertexComponentType::None:
+      break;
+  }
+}
+
+//! The same conversions GL makes when it reads the attribute
+static float load(VertexComponentType type, const uint8_t* in) {
+  switch (type) {
+    case VertexComponentType::Float: {
+      float value;
+      memcpy(&value, in, sizeof(value));
+      return value;
+    }
+    case VertexComponentType::Half: {
+      uint16_t half;
+      memcpy(&half, in, sizeof(half));
+      return halfToFloat(half);
+    }
+    case VertexComponentType::Snorm16: {
+      int16_t snorm;
+      memcpy(&snorm, in, sizeof(snorm));
+      return max(float(snorm) / 32767.f, -1.f);
+    }
+    case VertexComponentType::Unorm16: {
+      uint16_t unorm;
+      memcpy(&unorm, in, sizeof(unorm));
+      return float(unorm) / 65535.f;
+    }
+    case VertexComponentType::Unorm8:
+      return float(*in) / 255.f;
+    case VertexComponentType::None:
+      break;
+  }
+  return 0;
+}
+
+/*!
+ * Projects a direction onto the octahedron |x| + |y| + |z| = 1 and unfolds the lower half over the
+ * corners of the upper one, giving a point in [-1, 1]^2.
+ */
+static void encodeOctahedral(const float direction[3], float out[2]) {
+  float length = fabsf(direction[0]) + fabsf(direction[1]) + fabsf(direction[2]);
+  if (length == 0) {
+    out[0] = out[1] = 0;
+    return;
+  }
+  float x = direction[0] / length;
+  float y = direction[1] / length;
+  if (direction[2] < 0) {
+    float foldedX = (1 - fabsf(y)) * (x >= 0 ? 1.f : -1.f);
+    float foldedY = (1 - fabsf(x)) * (y >= 0 ? 1.f : -1.f);
+    x = foldedX;
+    y = foldedY;
+  }
+  out[0] = x;
+  out[1] = y;
+}
+
+static void decodeOctahedral(const float encoded[2], float out[3]) {
+  float x = encoded[0];
+  float y = encoded[1];
+  float z = 1 - fabsf(x) - fabsf(y);
+  float fold = max(-z, 0.f);
+  x += x >= 0 ? -fold : fold;
+  y += y >= 0 ? -fold : fold;
+  float length = sqrtf(x * x + y * y + z * z);
+  out[0] = x / length;
+  out[1] = y / length;
+  out[2] = z / length;
+}
+
+VertexFormat VertexFormat::fromFlags(uint32_t flags) {
+  VertexFormat format;
+  if (flags & ~(kVertexPositionMask | kVertexUvMask | kVertexNormal | kVertexTangent)) {
+    return format;
+  }
+  uint32_t offset = 0;
+  auto add = [&format, &offset](VertexAttribute attribute, VertexComponentType type, uint32_t components) {
+    auto& a = format.attributes[size_t(attribute)];
+    a.type = type;
+    a.components = components;
+    a.offset = offset;
+    offset += (components * getComponentSize(type) + 3) / 4 * 4;
+  };
+
+  switch (flags & kVertexPositionMask) {
+    case kVertexPositionFloat:
+      add(VertexAttribute::Position, VertexComponentType::Float, 3);
+      break;
+    case kVertexPositionHalf:
+      add(VertexAttribute::Position, VertexComponentType::Half, 3);
+      break;
+    case kVertexPositionSnorm16:
+      add(VertexAttribute::Position, VertexComponentType::Snorm16, 3);
+      break;
+    default:
+      return VertexFormat();
+  }
+  switch (flags & kVertexUvMask) {
+    case kVertexUvFloat:
+      add(VertexAttribute::Uv, VertexComponentType::Float, 2);
+      break;
+    case kVertexUvHalf:
+      add(VertexAttribute::Uv, VertexComponentType::Half, 2);
+      break;
+    case kVertexUvUnorm16:
+      add(VertexAttribute::Uv, VertexComponentType::Unorm16, 2);
+      break;
+    default:
+      return VertexFormat();
+  }
+  if (flags & kVertexNormal) {
+    add(VertexAttribute::Normal, VertexComponentType::Snorm16, 2);
+  }
+  if (flags & kVertexTangent) {
+    add(VertexAttribute::Tangent, VertexComponentType::Snorm16, 3);
+  }
+  format.flags = flags;
+  format.stride = offset;
+  return format;
+}
+
+void VertexFormat::fit(span<const VertexAttributes> vertices) {
+  if (vertices.empty()) {
+    return;
+  }
+  // Positions go to [-1, 1] around the middle of the box, uvs to [0, 1]. A flat axis keeps a
+  // scale of 1 so nothing divides by zero.
+  if (get(VertexAttribute::Position).type != VertexComponentType::Float) {
+    for (int c = 0; c < 3; c++) {
+      auto [low, high] = minmax_element(vertices.begin(), vertices.end(),
+                                        [c](const auto& a, const auto& b) { return a.position[c] < b.position[c]; });
+      positionOffset[c] = (low->position[c] + high->position[c]) / 2;
+      float extent = (high->position[c] - low->position[c]) / 2;
+      positionScale[c] = extent > 0 ? extent : 1;
+    }
+  }
+  if (get(VertexAttribute::Uv).type != VertexComponentType::Float) {
+    for (int c = 0; c < 2; c++) {
+      auto [low, high] = minmax_element(vertices.begin(), vertices.end(),
+                                        [c](const auto& a, const auto& b) { return a.uv[c] < b.uv[c]; });
+      uvOffset[c] = low->uv[c];
+      float range = high->uv[c] - low->uv[c];
+      uvScale[c] = range > 0 ? range : 1;
+    }
+  }
+}
+
+void VertexFormat::encode(const VertexAttributes& vertex, uint8_t* out) const {
+  // zero padding keeps identical vertices byte identical
+  memset(out, 0, stride);
+  const auto& position = get(VertexAttribute::Position);
+  uint32_t size = getComponentSize(position.type);
+  for (int c = 0; c < 3; c++) {
+    store(position.type, (vertex.position[c] - positionOffset[c]) / positionScale[c], out + position.offset + c * size);
+  }
+  const auto& uv = get(VertexAttribute::Uv);
+  size = getComponentSize(uv.type);
+  for (int c = 0; c < 2; c++) {
+    store(uv.type, (vertex.uv[c] - uvOffset[c]) / uvScale[c], out + uv.offset + c * size);
+  }
+  float encoded[2];
+  if (has(VertexAttribute::Normal)) {
+    uint8_t* normal = out + get(VertexAttribute::Normal).offset;
+    encodeOctahedral(vertex.normal, encoded);
+    store(VertexComponentType::Snorm16, encoded[0], normal);
+    store(VertexComponentType::Snorm16, encoded[1], normal + 2);
+  }
+  if (has(VertexAttribute::Tangent)) {
+    uint8_t* tangent = out + get(VertexAttribute::Tangent).offset;
+    encodeOctahedral(vertex.tangent, encoded);
+    store(VertexComponentType::Snorm16, encoded[0], tangent);
+    store(VertexComponentType::Snorm16, encoded[1], tangent + 2);
+    store(VertexComponentType::Snorm16, vertex.tangent[3] < 0 ? -1.f : 1.f, tangent + 4);
+  }
+}
+
+VertexAttributes VertexFormat::decode(const uint8_t* in) const {
+  VertexAttributes vertex{};
+  const auto& position = get(VertexAttribute::Position);
+  uint32_t size = getComponentSize(position.type);
+  for (int c = 0; c < 3; c++) {
+    vertex.position[c] = load(position.type, in + position.offset + c * size) * positionScale[c] + positionOffset[c];
+  }
+  const auto& uv = get(VertexAttribute::Uv);
+  size = getComponentSize(uv.type);
+  for (int c = 0; c < 2; c++) {
+    vertex.uv[c] = load(uv.type, in + uv.offset + c * size) * uvScale[c] + uvOffset[c];
+  }
+  float encoded[2];
+  if (has(VertexAttribute::Normal)) {
+    const uint8_t* normal = in + get(VertexAttribute::Normal).offset;
+    encoded[0] = load(VertexComponentType::Snorm16, normal);
+    encoded[1] = load(VertexComponentType::Snorm16, normal + 2);
+    decodeOctahedral(encoded, vertex.normal);
+  }
+  if (has(VertexAttribute::Tangent)) {
+    const uint8_t* tangent = in + get(VertexAttribute::Tangent).offset;
+    encoded[0] = load(VertexComponentType::Snorm16, tangent);
+    encoded[1] = load(VertexComponentType::Snorm16, tangent + 2);
+    decodeOctahedral(encoded, vertex.tangent);
+    vertex.tangent[3] = load(VertexComponentType::Snorm16, tangent + 4);
+  }
+  return vertex;
+}
+
+VertexFormat::Tolerance VertexFormat::getTolerance() const {
+  // Half the step between stored values, in the normalized range. Halves in [-1, 1] are never
+  // coarser than their steps between 0.5 and 1.
+  auto step = [](VertexComponentType type) {
+    switch (type) {
+      case VertexComponentType::Half:
+        return ldexpf(1, -12);
+      case VertexComponentType::Snorm16:
+        return 0.5f / 32767.f;
+      case VertexComponentType::Unorm16:
+        return 0.5f / 65535.f;
+      case VertexComponentType::Unorm8:
+        return 0.5f / 255.f;
+      default:
+        return 0.f;
+    }
+  };
+  // plus the float rounding of the scale and offset arithmetic
+  auto slop = [](float scale, float offset) { return (fabsf(scale) + fabsf(offset)) * ldexpf(1, -21); };
+
+  Tolerance tolerance{};
+  float positionStep = step(get(VertexAttribute::Position).type);
+  for (int c = 0; c < 3; c++) {
+    tolerance.position[c] = positionStep * positionScale[c] + slop(positionScale[c], positionOffset[c]);
+  }
+  float uvStep = step(get(VertexAttribute::Uv).type);
+  for (int c = 0; c < 2; c++) {
+    tolerance.uv[c] = uvStep * uvScale[c] + slop(uvScale[c], uvOffset[c]);
+  }
+  tolerance.direction = kOctahedralTolerance;
+  return tolerance;
+}
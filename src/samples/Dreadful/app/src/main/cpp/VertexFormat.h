@@ -0,0 +1,117 @@
+#ifndef ANDROIDGLINVESTIGATIONS_VERTEXFORMAT_H
+#define ANDROIDGLINVESTIGATIONS_VERTEXFORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+/*!
+ * Vertex layouts for meshes, chosen by a combination of the flags below and stored in .dmesh files
+ * as that combination. There are no GL or Android dependencies, so src/tools/meshconv encodes
+ * with the same code the app describes its buffers with.
+ *
+ * Quantized positions and uvs are normalized to ranges fitted to each mesh, which the vertex
+ * shader undoes (see Mesh::setDequantizeUniform). Normals and tangents are unit vectors folded
+ * onto an octahedron and stored as its two coordinates. Every attribute starts on a 4 byte
+ * boundary, as GL ES wants.
+ */
+
+enum class VertexAttribute : uint32_t { Position, Uv, Normal, Tangent };
+static constexpr size_t kVertexAttributeCount = 4;
+
+// Unorm8 only comes from files laid out by other tools, e.g. glTF uvs, fromFlags never picks it
+enum class VertexComponentType : uint32_t { None, Float, Half, Snorm16, Unorm16, Unorm8 };
+
+// Position storage, in the low 4 bits. Half and Snorm16 positions are normalized to the mesh's box.
+static constexpr uint32_t kVertexPositionFloat = 0x1;
+static constexpr uint32_t kVertexPositionHalf = 0x2;
+static constexpr uint32_t kVertexPositionSnorm16 = 0x3;
+static constexpr uint32_t kVertexPositionMask = 0xf;
+
+// UV storage. Half and Unorm16 uvs are normalized to the mesh's uv range.
+static constexpr uint32_t kVertexUvFloat = 0x00;
+static constexpr uint32_t kVertexUvHalf = 0x10;
+static constexpr uint32_t kVertexUvUnorm16 = 0x20;
+static constexpr uint32_t kVertexUvMask = 0xf0;
+
+//! An octahedral encoded unit normal, 2 Snorm16
+static constexpr uint32_t kVertexNormal = 0x100;
+
+//! An octahedral encoded unit tangent, then the bitangent sign, 3 Snorm16
+static constexpr uint32_t kVertexTangent = 0x200;
+
+/*!
+ * A vertex before encoding, with everything a format can hold.
+ */
+struct VertexAttributes {
+  float position[3];
+  float uv[2];
+  float normal[3];
+  // the bitangent is cross(normal, tangent) * w
+  float tangent[4];
+};
+
+struct VertexAttributeFormat {
+  VertexComponentType type = VertexComponentType::None;
+  // as the shader reads them, any padding after them isn't counted
+  uint32_t components = 0;
+  uint32_t offset = 0;
+  // bytes between vertices if this attribute isn't interleaved with the others, 0 for the format's
+  uint32_t stride = 0;
+};
+
+struct VertexFormat {
+  uint32_t flags = 0;
+  // 0 if the flags aren't a valid combination
+  uint32_t stride = 0;
+  VertexAttributeFormat attributes[kVertexAttributeCount];
+  // position = stored * positionScale + positionOffset, and the same for uvs. Float attributes
+  // keep the identity.
+  float positionScale[3] = {1, 1, 1};
+  float positionOffset[3] = {0, 0, 0};
+  float uvScale[2] = {1, 1};
+  float uvOffset[2] = {0, 0};
+
+  /*!
+   * The largest difference encoding and decoding can make: per component for positions and uvs,
+   * and in length for normals and tangents.
+   */
+  struct Tolerance {
+    float position[3];
+    float uv[2];
+    float direction;
+  };
+
+  /*!
+   * @return the layout a combination of flags describes, with a stride of 0 if it isn't valid
+   */
+  static VertexFormat fromFlags(uint32_t flags);
+
+  const VertexAttributeFormat& get(VertexAttribute attribute) const {
+    return attributes[size_t(attribute)];
+  }
+
+  bool has(VertexAttribute attribute) const {
+    return get(attribute).type != VertexComponentType::None;
+  }
+
+  /*!
+   * Fits the ranges of quantized positions and uvs to vertices, so no precision is wasted.
+   */
+  void fit(std::span<const VertexAttributes> vertices);
+
+  /*!
+   * Writes a vertex in this format, stride bytes, padding zeroed. This and decode are for
+   * interleaved formats like the ones fromFlags describes.
+   */
+  void encode(const VertexAttributes& vertex, uint8_t* out) const;
+
+  /*!
+   * Reads a vertex back. Attributes the format doesn't have are zero.
+   */
+  VertexAttributes decode(const uint8_t* in) const;
+
+  Tolerance getTolerance() const;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_VERTEXFORMAT_H
@@ -0,0 +1,419 @@
+#include "VkRenderer.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "AndroidOut.h"
+
+using namespace std;
+
+std::unique_ptr<VkRenderer> VkRenderer::create(xrh::InstanceOb& inst, RecordMode mode, uint32_t threadCount) {
+  unique_ptr<VkRenderer> renderer(new VkRenderer(mode, threadCount));
+  if (!renderer->createDevice(inst)) {
+    return nullptr;
+  }
+  inst.set_gfx_binding(renderer->instance_, renderer->physicalDevice_, renderer->device_, renderer->queueFamily_, 0);
+
+  if (mode == RecordMode::MultiThreaded) {
+    // every Worker exists before any thread starts, so workers_ never moves under them
+    for (uint32_t w = 0; w < renderer->workers_.size(); w++) {
+      renderer->workers_[w].thread = thread(&VkRenderer::workerLoop, renderer.get(), w);
+    }
+  }
+  return renderer;
+}
+
+VkRenderer::VkRenderer(RecordMode mode, uint32_t threadCount) : mode_(mode) {
+  if (mode_ == RecordMode::MultiThreaded) {
+    workers_.resize(max(1u, threadCount));
+  }
+}
+
+VkRenderer::~VkRenderer() {
+  if (!workers_.empty()) {
+    {
+      lock_guard<mutex> lock(workMutex_);
+      stopWorkers_ = true;
+    }
+    workCv_.notify_all();
+    for (auto& worker : workers_) {
+      if (worker.thread.joinable()) {
+        worker.thread.join();
+      }
+    }
+  }
+
+  if (device_ != VK_NULL_HANDLE) {
+    vkDeviceWaitIdle(device_);
+    destroyFrames();
+    if (commandPool_ != VK_NULL_HANDLE) {
+      vkDestroyCommandPool(device_, commandPool_, nullptr);
+    }
+    vkDestroyDevice(device_, nullptr);
+  }
+  if (instance_ != VK_NULL_HANDLE) {
+    vkDestroyInstance(instance_, nullptr);
+  }
+}
+
+bool VkRenderer::createDevice(xrh::InstanceOb& inst) {
+  VkApplicationInfo appInfo{VK_STRUCTURE_TYPE_APPLICATION_INFO};
+  appInfo.pApplicationName = "dreadful";
+  appInfo.applicationVersion = 1;
+  appInfo.apiVersion = VK_API_VERSION_1_1;
+
+  VkInstanceCreateInfo instanceInfo{VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO};
+  instanceInfo.pApplicationInfo = &appInfo;
+  instance_ = inst.create_vulkan_instance(instanceInfo);
+  if (instance_ == VK_NULL_HANDLE) {
+    return false;
+  }
+
+  physicalDevice_ = inst.get_vulkan_physical_device(instance_);
+  if (physicalDevice_ == VK_NULL_HANDLE) {
+    aout << "VkRenderer: the runtime didn't provide a physical device" << endl;
+    return false;
+  }
+  VkPhysicalDeviceProperties properties;
+  vkGetPhysicalDeviceProperties(physicalDevice_, &properties);
+  aout << "Vulkan device: " << properties.deviceName << ", API " << VK_VERSION_MAJOR(properties.apiVersion) << "."
+       << VK_VERSION_MINOR(properties.apiVersion) << "." << VK_VERSION_PATCH(properties.apiVersion) << endl;
+
+  uint32_t familyCount = 0;
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &familyCount, nullptr);
+  vector<VkQueueFamilyProperties> families(familyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice_, &familyCount, families.data());
+  auto graphics = find_if(families.begin(), families.end(),
+                          [](const VkQueueFamilyProperties& f) { return (f.queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0; });
+  if (graphics == families.end()) {
+    aout << "VkRenderer: no graphics queue" << endl;
+    return false;
+  }
+  queueFamily_ = static_cast<uint32_t>(graphics - families.begin());
+
+  float priority = 1.f;
+  VkDeviceQueueCreateInfo queueInfo{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+  queueInfo.queueFamilyIndex = queueFamily_;
+  queueInfo.queueCount = 1;
+  queueInfo.pQueuePriorities = &priority;
+
+  VkDeviceCreateInfo deviceInfo{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
+  deviceInfo.queueCreateInfoCount = 1;
+  deviceInfo.pQueueCreateInfos = &queueInfo;
+  device_ = inst.create_vulkan_device(physicalDevice_, deviceInfo);
+  if (device_ == VK_NULL_HANDLE) {
+    return false;
+  }
+  vkGetDeviceQueue(device_, queueFamily_, 0, &queue_);
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = queueFamily_;
+  if (vkCreateCommandPool(device_, &poolInfo, nullptr, &commandPool_) != VK_SUCCESS) {
+    aout << "VkRenderer: vkCreateCommandPool failed" << endl;
+    return false;
+  }
+  return true;
+}
+
+bool VkRenderer::setSwapchainImages(uint32_t width, uint32_t height, VkFormat format, std::span<VkImage> images) {
+  vkDeviceWaitIdle(device_);
+  destroyFrames();
+  width_ = width;
+  height_ = height;
+
+  // The runtime hands images over in COLOR_ATTACHMENT_OPTIMAL and expects them back that way
+  VkAttachmentDescription color{};
+  color.format = format;
+  color.samples = VK_SAMPLE_COUNT_1_BIT;
+  color.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  color.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  color.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+  color.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  color.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  color.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  VkAttachmentReference colorRef{0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+  VkSubpassDescription subpass{};
+  subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  subpass.colorAttachmentCount = 1;
+  subpass.pColorAttachments = &colorRef;
+  VkRenderPassCreateInfo renderPassInfo{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+  renderPassInfo.attachmentCount = 1;
+  renderPassInfo.pAttachments = &color;
+  renderPassInfo.subpassCount = 1;
+  renderPassInfo.pSubpasses = &subpass;
+  VkResult result = vkCreateRenderPass(device_, &renderPassInfo, nullptr, &renderPass_);
+  if (result != VK_SUCCESS) {
+    aout << "VkRenderer: vkCreateRenderPass failed: " << result << endl;
+    renderPass_ = VK_NULL_HANDLE;
+    return false;
+  }
+
+  // A failure leaves the rest of the handles null, which destroyFrames() skips
+  auto failed = [this](const char* function, VkResult error) {
+    aout << "VkRenderer: " << function << " failed: " << error << endl;
+    destroyFrames();
+    return false;
+  };
+  frames_.resize(images.size());
+  for (size_t i = 0; i < images.size(); i++) {
+    auto& f = frames_[i];
+    VkImageViewCreateInfo viewInfo{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+    viewInfo.image = images[i];
+    viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewInfo.format = format;
+    viewInfo.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+    result = vkCreateImageView(device_, &viewInfo, nullptr, &f.view);
+    if (result != VK_SUCCESS) {
+      f.view = VK_NULL_HANDLE;
+      return failed("vkCreateImageView", result);
+    }
+
+    VkFramebufferCreateInfo framebufferInfo{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+    framebufferInfo.renderPass = renderPass_;
+    framebufferInfo.attachmentCount = 1;
+    framebufferInfo.pAttachments = &f.view;
+    framebufferInfo.width = width;
+    framebufferInfo.height = height;
+    framebufferInfo.layers = 1;
+    result = vkCreateFramebuffer(device_, &framebufferInfo, nullptr, &f.framebuffer);
+    if (result != VK_SUCCESS) {
+      f.framebuffer = VK_NULL_HANDLE;
+      return failed("vkCreateFramebuffer", result);
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+    allocInfo.commandPool = commandPool_;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandBufferCount = 1;
+    result = vkAllocateCommandBuffers(device_, &allocInfo, &f.primary);
+    if (result != VK_SUCCESS) {
+      f.primary = VK_NULL_HANDLE;
+      return failed("vkAllocateCommandBuffers", result);
+    }
+
+    // signaled, so the first render() of each image doesn't wait
+    VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+    result = vkCreateFence(device_, &fenceInfo, nullptr, &f.fence);
+    if (result != VK_SUCCESS) {
+      f.fence = VK_NULL_HANDLE;
+      return failed("vkCreateFence", result);
+    }
+  }
+
+  for (auto& worker : workers_) {
+    worker.pools.resize(images.size());
+    worker.secondaries.resize(images.size());
+    for (size_t i = 0; i < images.size(); i++) {
+      VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+      poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+      poolInfo.queueFamilyIndex = queueFamily_;
+      result = vkCreateCommandPool(device_, &poolInfo, nullptr, &worker.pools[i]);
+      if (result != VK_SUCCESS) {
+        worker.pools[i] = VK_NULL_HANDLE;
+        return failed("vkCreateCommandPool", result);
+      }
+
+      VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+      allocInfo.commandPool = worker.pools[i];
+      allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+      allocInfo.commandBufferCount = 1;
+      result = vkAllocateCommandBuffers(device_, &allocInfo, &worker.secondaries[i]);
+      if (result != VK_SUCCESS) {
+        return failed("vkAllocateCommandBuffers", result);
+      }
+    }
+  }
+
+  if (mode_ == RecordMode::Prerecorded) {
+    for (uint32_t i = 0; i < frames_.size(); i++) {
+      recordPrimary(i, 0.f);
+    }
+  }
+  return true;
+}
+
+void VkRenderer::destroyFrames() {
+  for (auto& worker : workers_) {
+    // destroying a pool frees its command buffers
+    for (auto pool : worker.pools) {
+      vkDestroyCommandPool(device_, pool, nullptr);
+    }
+    worker.pools.clear();
+    worker.secondaries.clear();
+  }
+  for (auto& f : frames_) {
+    vkDestroyFence(device_, f.fence, nullptr);
+    if (f.primary != VK_NULL_HANDLE) {
+      vkFreeCommandBuffers(device_, commandPool_, 1, &f.primary);
+    }
+    vkDestroyFramebuffer(device_, f.framebuffer, nullptr);
+    vkDestroyImageView(device_, f.view, nullptr);
+  }
+  frames_.clear();
+  if (renderPass_ != VK_NULL_HANDLE) {
+    vkDestroyRenderPass(device_, renderPass_, nullptr);
+    renderPass_ = VK_NULL_HANDLE;
+  }
+}
+
+void VkRenderer::render(uint32_t imageIndex) {
+  if (imageIndex >= frames_.size()) {
+    aout << "Invalid image index: " << imageIndex << ", numImages: " << frames_.size() << endl;
+    return;
+  }
+  auto& f = frames_[imageIndex];
+
+  // The image's last submission has to finish before its command buffers are submitted or reset
+  vkWaitForFences(device_, 1, &f.fence, VK_TRUE, UINT64_MAX);
+  vkResetFences(device_, 1, &f.fence);
+
+  auto start = chrono::steady_clock::now();
+  frameCount_++;
+  if (mode_ == RecordMode::MultiThreaded) {
+    recordMultiThreaded(imageIndex, frameCount_ / 60.f);
+  }
+
+  VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+  submitInfo.commandBufferCount = 1;
+  submitInfo.pCommandBuffers = &f.primary;
+  VkResult result = vkQueueSubmit(queue_, 1, &submitInfo, f.fence);
+  if (result != VK_SUCCESS) {
+    aout << "VkRenderer: vkQueueSubmit failed: " << result << endl;
+  }
+
+  statSubmitMs_ += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  if (++statFrames_ >= kReportFrames) {
+    aout << "VkRenderer: "
+         << (mode_ == RecordMode::Prerecorded ? string("pre-recorded") : to_string(workers_.size()) + " recording threads")
+         << ", " << statSubmitMs_ / statFrames_ << " ms average CPU record and submit" << endl;
+    statFrames_ = 0;
+    statSubmitMs_ = 0;
+  }
+}
+
+void VkRenderer::beginRenderPass(VkCommandBuffer cmd, uint32_t imageIndex, VkSubpassContents contents) const {
+  VkClearValue clear{};
+  clear.color.float32[0] = 0.1f;
+  clear.color.float32[1] = 0.1f;
+  clear.color.float32[2] = 0.1f;
+  clear.color.float32[3] = 1.f;
+  VkRenderPassBeginInfo beginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+  beginInfo.renderPass = renderPass_;
+  beginInfo.framebuffer = frames_[imageIndex].framebuffer;
+  beginInfo.renderArea = {{0, 0}, {width_, height_}};
+  beginInfo.clearValueCount = 1;
+  beginInfo.pClearValues = &clear;
+  vkCmdBeginRenderPass(cmd, &beginInfo, contents);
+}
+
+void VkRenderer::recordTiles(VkCommandBuffer cmd, uint32_t first, uint32_t stride, float t) const {
+  uint32_t tileWidth = width_ / kTiles;
+  uint32_t tileHeight = height_ / kTiles;
+  if (tileWidth < 3 || tileHeight < 3) {
+    return;
+  }
+  for (uint32_t i = first; i < kTiles * kTiles; i += stride) {
+    float phase = t + 0.37f * i;
+    VkClearAttachment clear{};
+    clear.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    clear.colorAttachment = 0;
+    clear.clearValue.color.float32[0] = sin(1.7f * phase) * 0.5f + 0.5f;
+    clear.clearValue.color.float32[1] = sin(0.6f * phase + 2.1f) * 0.5f + 0.5f;
+    clear.clearValue.color.float32[2] = sin(0.8f * phase + 0.2f) * 0.5f + 0.5f;
+    clear.clearValue.color.float32[3] = 1.f;
+
+    // a one pixel gap between tiles
+    VkClearRect rect{};
+    rect.rect.offset = {static_cast<int32_t>((i % kTiles) * tileWidth + 1),
+                        static_cast<int32_t>((i / kTiles) * tileHeight + 1)};
+    rect.rect.extent = {tileWidth - 2, tileHeight - 2};
+    rect.baseArrayLayer = 0;
+    rect.layerCount = 1;
+    vkCmdClearAttachments(cmd, 1, &clear, 1, &rect);
+  }
+}
+
+void VkRenderer::recordPrimary(uint32_t imageIndex, float t) {
+  auto cmd = frames_[imageIndex].primary;
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  vkBeginCommandBuffer(cmd, &beginInfo);
+  beginRenderPass(cmd, imageIndex, VK_SUBPASS_CONTENTS_INLINE);
+  recordTiles(cmd, 0, 1, t);
+  vkCmdEndRenderPass(cmd);
+  vkEndCommandBuffer(cmd);
+}
+
+void VkRenderer::recordMultiThreaded(uint32_t imageIndex, float t) {
+  {
+    lock_guard<mutex> lock(workMutex_);
+    workImage_ = imageIndex;
+    workTime_ = t;
+    workPending_ = static_cast<uint32_t>(workers_.size());
+    workGeneration_++;
+  }
+  workCv_.notify_all();
+
+  // The primary only stitches the workers' secondaries together, so start it while they record
+  auto cmd = frames_[imageIndex].primary;
+  VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  vkBeginCommandBuffer(cmd, &beginInfo);
+  beginRenderPass(cmd, imageIndex, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+  {
+    unique_lock<mutex> lock(workMutex_);
+    doneCv_.wait(lock, [this] { return workPending_ == 0; });
+  }
+
+  vector<VkCommandBuffer> secondaries;
+  secondaries.reserve(workers_.size());
+  for (const auto& worker : workers_) {
+    secondaries.push_back(worker.secondaries[imageIndex]);
+  }
+  vkCmdExecuteCommands(cmd, static_cast<uint32_t>(secondaries.size()), secondaries.data());
+  vkCmdEndRenderPass(cmd);
+  vkEndCommandBuffer(cmd);
+}
+
+void VkRenderer::workerLoop(uint32_t workerIndex) {
+  uint64_t generation = 0;
+  for (;;) {
+    uint32_t imageIndex;
+    float t;
+    {
+      unique_lock<mutex> lock(workMutex_);
+      workCv_.wait(lock, [this, generation] { return stopWorkers_ || workGeneration_ != generation; });
+      if (stopWorkers_) {
+        return;
+      }
+      generation = workGeneration_;
+      imageIndex = workImage_;
+      t = workTime_;
+    }
+
+    // render() waited on this image's fence, so nothing from this pool is still executing
+    auto& worker = workers_[workerIndex];
+    vkResetCommandPool(device_, worker.pools[imageIndex], 0);
+    auto cmd = worker.secondaries[imageIndex];
+
+    VkCommandBufferInheritanceInfo inheritance{VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance.renderPass = renderPass_;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = frames_[imageIndex].framebuffer;
+    VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+    vkBeginCommandBuffer(cmd, &beginInfo);
+    recordTiles(cmd, workerIndex, static_cast<uint32_t>(workers_.size()), t);
+    vkEndCommandBuffer(cmd);
+
+    {
+      lock_guard<mutex> lock(workMutex_);
+      workPending_--;
+    }
+    doneCv_.notify_one();
+  }
+}
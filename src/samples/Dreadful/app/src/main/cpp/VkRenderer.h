@@ -0,0 +1,120 @@
+#ifndef ANDROIDGLINVESTIGATIONS_VKRENDERER_H
+#define ANDROIDGLINVESTIGATIONS_VKRENDERER_H
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "xrh.h"
+
+/*!
+ * A minimal Vulkan renderer for the XR_KHR_vulkan_enable2 path. The VkInstance and VkDevice are
+ * created through the OpenXR runtime and handed to the session as its graphics binding.
+ *
+ * It draws a grid of tiles with vkCmdClearAttachments, so it needs no pipelines or shaders, in one
+ * of two ways:
+ *  - pre-recorded: one primary command buffer per swapchain image, recorded once and resubmitted
+ *    every frame. The tiles are static.
+ *  - multi-threaded: every frame each worker thread records a secondary command buffer for its
+ *    share of the tiles from its own command pool, and the primary executes them. The tiles animate.
+ *
+ * The CPU cost of recording and submitting is measured and logged, for comparison with the GLES
+ * Renderer.
+ */
+class VkRenderer {
+ public:
+  enum class RecordMode { Prerecorded, MultiThreaded };
+
+  /*!
+   * Creates the Vulkan instance and device through the runtime and sets them as inst's graphics
+   * binding. inst must have been created with XR_KHR_vulkan_enable2 enabled.
+   * @return a renderer, or null on failure
+   */
+  static std::unique_ptr<VkRenderer> create(xrh::InstanceOb& inst, RecordMode mode, uint32_t threadCount);
+
+  ~VkRenderer();
+
+  /*!
+   * Sets the swap chain images for the renderer. They're in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL
+   * whenever the application owns them, and rendering leaves them that way.
+   * @return false if the views, framebuffers or command buffers for them can't be created, in
+   *         which case the renderer has no images to render to
+   */
+  bool setSwapchainImages(uint32_t width, uint32_t height, VkFormat format, std::span<VkImage> images);
+
+  /*!
+   * Records, if needed, and submits a frame for the specified image.
+   */
+  void render(uint32_t imageIndex);
+
+ private:
+  // How many tiles along each side of the image
+  static constexpr uint32_t kTiles = 8;
+  // How often the CPU cost is logged, in frames
+  static constexpr uint32_t kReportFrames = 300;
+
+  struct Frame {
+    VkImageView view = VK_NULL_HANDLE;
+    VkFramebuffer framebuffer = VK_NULL_HANDLE;
+    VkCommandBuffer primary = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+  };
+
+  struct Worker {
+    std::thread thread;
+    // one pool per swapchain image, so a pool is only reset once the GPU is done with its image
+    std::vector<VkCommandPool> pools;
+    std::vector<VkCommandBuffer> secondaries;
+  };
+
+  VkRenderer(RecordMode mode, uint32_t threadCount);
+
+  bool createDevice(xrh::InstanceOb& inst);
+  void destroyFrames();
+
+  void beginRenderPass(VkCommandBuffer cmd, uint32_t imageIndex, VkSubpassContents contents) const;
+
+  /*!
+   * Clears the tiles with index % stride == first, inside the render pass.
+   */
+  void recordTiles(VkCommandBuffer cmd, uint32_t first, uint32_t stride, float t) const;
+
+  void recordPrimary(uint32_t imageIndex, float t);
+  void recordMultiThreaded(uint32_t imageIndex, float t);
+  void workerLoop(uint32_t workerIndex);
+
+  RecordMode mode_;
+  VkInstance instance_ = VK_NULL_HANDLE;
+  VkPhysicalDevice physicalDevice_ = VK_NULL_HANDLE;
+  VkDevice device_ = VK_NULL_HANDLE;
+  uint32_t queueFamily_ = 0;
+  VkQueue queue_ = VK_NULL_HANDLE;
+  VkCommandPool commandPool_ = VK_NULL_HANDLE;
+  VkRenderPass renderPass_ = VK_NULL_HANDLE;
+  uint32_t width_ = 0;
+  uint32_t height_ = 0;
+  std::vector<Frame> frames_;
+
+  // Worker threads are woken for each frame with the image and time to record for
+  std::vector<Worker> workers_;
+  std::mutex workMutex_;
+  std::condition_variable workCv_;
+  std::condition_variable doneCv_;
+  uint64_t workGeneration_ = 0;
+  uint32_t workPending_ = 0;
+  uint32_t workImage_ = 0;
+  float workTime_ = 0;
+  bool stopWorkers_ = false;
+
+  uint64_t frameCount_ = 0;
+  uint32_t statFrames_ = 0;
+  double statSubmitMs_ = 0;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_VKRENDERER_H
@@ -0,0 +1,52 @@
+#include "WorkerPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+WorkerPool::WorkerPool(uint32_t threadCount) {
+  threadCount = max(1u, threadCount);
+  threads_.reserve(threadCount);
+  for (uint32_t i = 0; i < threadCount; i++) {
+    threads_.emplace_back(&WorkerPool::workerLoop, this);
+  }
+}
+
+WorkerPool::~WorkerPool() {
+  {
+    lock_guard<mutex> lock(mutex_);
+    stopping_ = true;
+    jobs_.clear();
+  }
+  wake_.notify_all();
+  for (auto& t : threads_) {
+    t.join();
+  }
+}
+
+void WorkerPool::submit(function<void()> job) {
+  post(std::move(job), nullptr);
+}
+
+void WorkerPool::post(function<void()> job, shared_ptr<const TaskControl> control) {
+  {
+    lock_guard<mutex> lock(mutex_);
+    jobs_.push(std::move(job), std::move(control));
+  }
+  wake_.notify_one();
+}
+
+void WorkerPool::workerLoop() {
+  for (;;) {
+    function<void()> job;
+    {
+      unique_lock<mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+      if (stopping_) {
+        return;
+      }
+      job = jobs_.pop();
+    }
+    job();
+  }
+}
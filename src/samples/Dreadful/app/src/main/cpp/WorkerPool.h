@@ -0,0 +1,51 @@
+#ifndef ANDROIDGLINVESTIGATIONS_WORKERPOOL_H
+#define ANDROIDGLINVESTIGATIONS_WORKERPOOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Task.h"
+
+/*!
+ * A fixed set of threads running jobs, for work that must stay off the GL thread such as decoding
+ * assets. Jobs can't touch GL. Queued jobs run in the order of a TaskQueue: steps of cancelled
+ * tasks first, then the highest priority, then the oldest. Plain jobs have priority 0, so they run
+ * in submission order among themselves, behind any task steps of higher priority.
+ */
+class WorkerPool : public Executor {
+ public:
+  /*!
+   * @param threadCount number of threads, at least 1
+   */
+  explicit WorkerPool(uint32_t threadCount);
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  /*!
+   * Drops jobs that haven't started and waits for the running ones.
+   */
+  ~WorkerPool();
+
+  void submit(std::function<void()> job);
+
+  void post(std::function<void()> job, std::shared_ptr<const TaskControl> control) override;
+
+  uint32_t getThreadCount() const {
+    return static_cast<uint32_t>(threads_.size());
+  }
+
+ private:
+  void workerLoop();
+
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  TaskQueue jobs_;
+  bool stopping_ = false;
+  std::vector<std::thread> threads_;
+};
+
+#endif  // ANDROIDGLINVESTIGATIONS_WORKERPOOL_H
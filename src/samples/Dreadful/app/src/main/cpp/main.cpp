@@ -6,43 +6,63 @@
 #include <span>
 
 #include "AndroidOut.h"
-#include "Renderer.h"
 #include "xrh.h"
 #include "xrhlinear.h"
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+#include "VkRenderer.h"
+#else
+#include "Renderer.h"
+#endif
 
 using namespace std;
 using namespace xrh;
 
 namespace {
-struct Xr {
-  using RendererPtr = std::shared_ptr<Renderer>;
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+// Pre-recorded command buffers are resubmitted as is. MultiThreaded records secondaries on
+// kVulkanRecordThreads threads every frame.
+constexpr VkRenderer::RecordMode kVulkanRecordMode = VkRenderer::RecordMode::MultiThreaded;
+constexpr uint32_t kVulkanRecordThreads = 2;
+#endif
 
-#if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
-  Xr(android_app* pApp)
+struct Xr {
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  using RendererPtr = std::shared_ptr<VkRenderer>;
 #else
-  Xr()
+  using RendererPtr = std::shared_ptr<Renderer>;
 #endif
-  {
-#if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
-    renderer = make_shared<Renderer>(pApp);
-    auto dpy = renderer->getDisplay();
-    auto cfg = renderer->getConfig();
-    auto ctx = renderer->getContext();
+
+  Xr(android_app* pApp) {
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
     // instance
     inst = make_instance();
-    inst->add_required_extension(XR_KHR_OPENGL_ES_ENABLE_EXTENSION_NAME);
+    inst->add_required_extension(XR_KHR_VULKAN_ENABLE2_EXTENSION_NAME);
     if (!inst->create()) {
       aout << "OpenXR instance creation failed, exiting." << endl;
+      inst.reset();
+      return;
+    }
+    // The Vulkan instance and device come from the runtime, so the renderer follows the instance
+    renderer = VkRenderer::create(*inst, kVulkanRecordMode, kVulkanRecordThreads);
+    if (!renderer) {
+      aout << "Vulkan renderer creation failed, exiting." << endl;
+      inst.reset();
       return;
     }
-    inst->set_gfx_binding(dpy, cfg, ctx);
 #else
+    renderer = make_shared<Renderer>(pApp);
+    auto dpy = renderer->getDisplay();
+    auto cfg = renderer->getConfig();
+    auto ctx = renderer->getContext();
     // instance
     inst = make_instance();
     inst->add_required_extension(XR_KHR_OPENGL_ES_ENABLE_EXTENSION_NAME);
     if (!inst->create()) {
       aout << "OpenXR instance creation failed, exiting." << endl;
+      inst.reset();
+      return;
     }
+    inst->set_gfx_binding(dpy, cfg, ctx);
 #endif
     // session
     ssn = inst->create_session();
@@ -55,7 +75,19 @@ struct Xr {
     auto scci = Swapchain::element_type::make_create_info(vcv.recommendedImageRectWidth, vcv.recommendedImageRectHeight);
     sc = ssn->create_swapchain(scci);
 
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+    if (!renderer->setSwapchainImages(sc->get_width(), sc->get_height(), static_cast<VkFormat>(sc->get_format()),
+                                      sc->enumerate_images())) {
+      aout << "Vulkan swapchain setup failed, exiting." << endl;
+      sc.reset();
+      local.reset();
+      ssn.reset();
+      inst.reset();
+      return;
+    }
+#else
     renderer->setSwapchainImages(sc->get_width(), sc->get_height(), sc->enumerate_images());
+#endif
   }
 
   ~Xr() {
@@ -94,11 +126,12 @@ struct Xr {
   }
 
  private:
+  // Declared first so it's destroyed last, after the session that renders with it
+  RendererPtr renderer;
   Instance inst;
   Session ssn;
   Space local;
   Swapchain sc;
-  RendererPtr renderer;
 };
 
 }  // namespace
@@ -119,7 +152,17 @@ void handle_cmd(android_app* pApp, int32_t cmd) {
       // if you change the class here as a reinterpret_cast is dangerous this in the
       // android_main function and the APP_CMD_TERM_WINDOW handler case.
       aout << "APP_CMD_INIT_WINDOW" << endl;
-      pApp->userData = new Xr(pApp);
+      {
+        auto* pxr = new Xr(pApp);
+        if (!pxr->is_initialized()) {
+          // The reason is logged. With no session or renderer there's nothing to run, so close
+          // the activity rather than let the frame loop use them.
+          delete pxr;
+          GameActivity_finish(pApp->activity);
+          break;
+        }
+        pApp->userData = pxr;
+      }
       break;
     case APP_CMD_TERM_WINDOW:
       // The window is being destroyed. Use this to clean up your userData to avoid leaking
@@ -189,8 +232,10 @@ void android_main(struct android_app* pApp) {
     // user data remember to change it here
     auto& xr = *reinterpret_cast<Xr*>(pApp->userData);
 
+#if !defined(XR_USE_GRAPHICS_API_VULKAN)
     // Process game input
     xr.get_renderer()->handleInput();
+#endif
 
     if (!xr.begin_frame()) {
       // We can't begin a frame until the session is in a valid state.
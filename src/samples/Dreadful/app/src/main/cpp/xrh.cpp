@@ -1,5 +1,7 @@
 #include "xrh.h"
 
+#include <cstring>
+
 #include "AndroidOut.h"
 
 using namespace std;
@@ -25,6 +27,12 @@ namespace {
 #if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
 DECL_PFN(xrGetOpenGLESGraphicsRequirementsKHR);
 #endif
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+DECL_PFN(xrGetVulkanGraphicsRequirements2KHR);
+DECL_PFN(xrCreateVulkanInstanceKHR);
+DECL_PFN(xrGetVulkanGraphicsDevice2KHR);
+DECL_PFN(xrCreateVulkanDeviceKHR);
+#endif
 
 // generated by copilot
 std::string ToString(XrSessionState sessionState) {
@@ -119,6 +127,7 @@ bool ext_supported(span<const XrExtensionProperties> ext_span, const XrExtension
 }  // namespace
 
 namespace xrh {
+#if defined(ANDROID)
 bool init_loader(JavaVM* vm, jobject ctx) {
   DECL_INIT_PFN(XR_NULL_HANDLE, xrInitializeLoaderKHR);
   if (xrInitializeLoaderKHR == nullptr) {
@@ -132,6 +141,7 @@ bool init_loader(JavaVM* vm, jobject ctx) {
   }
   return true;
 }
+#endif
 
 Instance make_instance() {
   return make_shared<Instance::element_type>();
@@ -204,6 +214,15 @@ bool InstanceOb::create() {
   XRH(xrGetOpenGLESGraphicsRequirementsKHR(inst, sysid, &gfxreqs));
 #endif
 
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  INIT_PFN(inst, xrGetVulkanGraphicsRequirements2KHR);
+  INIT_PFN(inst, xrCreateVulkanInstanceKHR);
+  INIT_PFN(inst, xrGetVulkanGraphicsDevice2KHR);
+  INIT_PFN(inst, xrCreateVulkanDeviceKHR);
+  gfxreqs = {XR_TYPE_GRAPHICS_REQUIREMENTS_VULKAN2_KHR};
+  XRH(xrGetVulkanGraphicsRequirements2KHR(inst, sysid, &gfxreqs));
+#endif
+
   // Get view config info
   uint32_t viewConfigTypeCount = 0;
   XRH(xrEnumerateViewConfigurations(inst, sysid, 0, &viewConfigTypeCount, nullptr));
@@ -265,6 +284,58 @@ void InstanceOb::set_gfx_binding(EGLDisplay dpy, EGLConfig cfg, EGLContext ctx)
 }
 #endif
 
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+VkInstance InstanceOb::create_vulkan_instance(const VkInstanceCreateInfo& vkci) {
+  XrVulkanInstanceCreateInfoKHR ci{XR_TYPE_VULKAN_INSTANCE_CREATE_INFO_KHR};
+  ci.systemId = sysid;
+  ci.pfnGetInstanceProcAddr = &vkGetInstanceProcAddr;
+  ci.vulkanCreateInfo = &vkci;
+  VkInstance vkinst = VK_NULL_HANDLE;
+  VkResult vkres = VK_SUCCESS;
+  XRH(xrCreateVulkanInstanceKHR(inst, &ci, &vkinst, &vkres));
+  if (vkres != VK_SUCCESS) {
+    aout << "vkCreateInstance failed: " << vkres << endl;
+    return VK_NULL_HANDLE;
+  }
+  return vkinst;
+}
+
+VkPhysicalDevice InstanceOb::get_vulkan_physical_device(VkInstance vkinst) {
+  XrVulkanGraphicsDeviceGetInfoKHR gi{XR_TYPE_VULKAN_GRAPHICS_DEVICE_GET_INFO_KHR};
+  gi.systemId = sysid;
+  gi.vulkanInstance = vkinst;
+  VkPhysicalDevice phys = VK_NULL_HANDLE;
+  XRH(xrGetVulkanGraphicsDevice2KHR(inst, &gi, &phys));
+  return phys;
+}
+
+VkDevice InstanceOb::create_vulkan_device(VkPhysicalDevice phys, const VkDeviceCreateInfo& vkci) {
+  XrVulkanDeviceCreateInfoKHR ci{XR_TYPE_VULKAN_DEVICE_CREATE_INFO_KHR};
+  ci.systemId = sysid;
+  ci.pfnGetInstanceProcAddr = &vkGetInstanceProcAddr;
+  ci.vulkanPhysicalDevice = phys;
+  ci.vulkanCreateInfo = &vkci;
+  VkDevice dev = VK_NULL_HANDLE;
+  VkResult vkres = VK_SUCCESS;
+  XRH(xrCreateVulkanDeviceKHR(inst, &ci, &dev, &vkres));
+  if (vkres != VK_SUCCESS) {
+    aout << "vkCreateDevice failed: " << vkres << endl;
+    return VK_NULL_HANDLE;
+  }
+  return dev;
+}
+
+void InstanceOb::set_gfx_binding(VkInstance vkinst, VkPhysicalDevice phys, VkDevice dev, uint32_t queueFamilyIndex,
+                                 uint32_t queueIndex) {
+  gfxbinding = {XR_TYPE_GRAPHICS_BINDING_VULKAN2_KHR};
+  gfxbinding.instance = vkinst;
+  gfxbinding.physicalDevice = phys;
+  gfxbinding.device = dev;
+  gfxbinding.queueFamilyIndex = queueFamilyIndex;
+  gfxbinding.queueIndex = queueIndex;
+}
+#endif
+
 Session InstanceOb::create_session() {
   XrSessionCreateInfo ci = {XR_TYPE_SESSION_CREATE_INFO};
   ci.next = &gfxbinding;
@@ -421,6 +492,18 @@ SwapchainOb::SwapchainOb(Session ssn_, XrSwapchain swapchain_, const XrSwapchain
   }
   chainlength = imageCount;
 #endif
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  uint32_t imageCount = 0;
+  XRH(xrEnumerateSwapchainImages(swapchain, 0, &imageCount, nullptr));
+  images.resize(imageCount);
+  vector<XrSwapchainImageVulkan2KHR> imagesKHR(imageCount, {XR_TYPE_SWAPCHAIN_IMAGE_VULKAN2_KHR});
+  XRH(xrEnumerateSwapchainImages(swapchain, imageCount, &imageCount,
+                                 reinterpret_cast<XrSwapchainImageBaseHeader*>(imagesKHR.data())));
+  for (uint32_t i = 0; i < imageCount; ++i) {
+    images[i] = imagesKHR[i].image;
+  }
+  chainlength = imageCount;
+#endif
 }
 
 SwapchainOb::~SwapchainOb() {
@@ -4,18 +4,29 @@
 #pragma once
 
 #if defined(ANDROID)
+#include <jni.h>
+#define XR_USE_PLATFORM_ANDROID 1
+// GLES unless the build asks for Vulkan
+#if !defined(XR_USE_GRAPHICS_API_VULKAN) && !defined(XR_USE_GRAPHICS_API_OPENGL_ES)
+#define XR_USE_GRAPHICS_API_OPENGL_ES 1
+#endif
+#endif
+
+#if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
 #include <EGL/egl.h>
 #include <EGL/eglext.h>
 #include <GLES3/gl3.h>
 #include <GLES3/gl3ext.h>
-#include <jni.h>
-#define XR_USE_GRAPHICS_API_OPENGL_ES 1
-#define XR_USE_PLATFORM_ANDROID 1
+#endif
+
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+#include <vulkan/vulkan.h>
 #endif
 
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
+#include <algorithm>
 #include <array>
 #include <memory>
 #include <set>
@@ -133,6 +144,20 @@ class InstanceOb : public std::enable_shared_from_this<InstanceOb> {
   void set_gfx_binding(EGLDisplay dpy, EGLConfig cfg, EGLContext ctx);
 #endif
 
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  // XR_KHR_vulkan_enable2: the runtime creates the VkInstance and VkDevice so it can add what it
+  // needs, and picks the physical device attached to the headset.
+  VkInstance create_vulkan_instance(const VkInstanceCreateInfo& vkci);
+  VkPhysicalDevice get_vulkan_physical_device(VkInstance vkinst);
+  VkDevice create_vulkan_device(VkPhysicalDevice phys, const VkDeviceCreateInfo& vkci);
+  void set_gfx_binding(VkInstance vkinst, VkPhysicalDevice phys, VkDevice dev, uint32_t queueFamilyIndex,
+                       uint32_t queueIndex);
+
+  const XrGraphicsRequirementsVulkan2KHR& get_vulkan_requirements() const {
+    return gfxreqs;
+  }
+#endif
+
   Session create_session();
 
   const XrViewConfigurationView& get_xr_view_config_view(int eye) const {
@@ -155,6 +180,10 @@ class InstanceOb : public std::enable_shared_from_this<InstanceOb> {
 #if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
   XrGraphicsRequirementsOpenGLESKHR gfxreqs;
   XrGraphicsBindingOpenGLESAndroidKHR gfxbinding;
+#endif
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  XrGraphicsRequirementsVulkan2KHR gfxreqs;
+  XrGraphicsBindingVulkan2KHR gfxbinding;
 #endif
   bool fov_mutable = false;
   std::array<XrViewConfigurationView, 2> view_config_views;
@@ -255,7 +284,11 @@ class SwapchainOb {
  public:
   using CreateInfo = XrSwapchainCreateInfo;
   static constexpr XrStructureType CIST = XR_TYPE_SWAPCHAIN_CREATE_INFO;
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  static constexpr int64_t SRGB_A = VK_FORMAT_R8G8B8A8_SRGB;
+#else
   static constexpr int64_t SRGB_A = GL_SRGB8_ALPHA8;
+#endif
   static constexpr uint64_t UsageSampled = XR_SWAPCHAIN_USAGE_SAMPLED_BIT;
   static constexpr uint64_t UsageColorAttachment = XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT;
   SwapchainOb(Session ssn_, XrSwapchain sc_, const CreateInfo& ci_);
@@ -281,12 +314,22 @@ class SwapchainOb {
     return {static_cast<int>(ci.width), static_cast<int>(ci.height)};
   }
 
+  int64_t get_format() const {
+    return ci.format;
+  }
+
 #if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
   const std::span<GLuint> enumerate_images() {
     return images;
   }
 #endif
 
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  const std::span<VkImage> enumerate_images() {
+    return images;
+  }
+#endif
+
   uint32_t acquire_image() {
     XrSwapchainImageAcquireInfo acquireInfo{XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO};
     uint32_t imageIndex = 0;
@@ -319,6 +362,9 @@ class SwapchainOb {
 #if defined(XR_USE_GRAPHICS_API_OPENGL_ES)
   std::vector<GLuint> images;
 #endif
+#if defined(XR_USE_GRAPHICS_API_VULKAN)
+  std::vector<VkImage> images;
+#endif
 };
 
 }  // namespace xrh
@@ -0,0 +1,177 @@
+// Packs a directory of assets into a .dpak archive for AssetArchive, compressing entries with LZ4
+// where that saves enough. Build and run on the host:
+//
+//   g++ -std=c++20 -O2 -I../../samples/Dreadful/app/src/main/cpp assetpack.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/Lz4.cpp -o assetpack
+//   ./assetpack ../../samples/Dreadful/app/src/main/assets
+//               ../../samples/Dreadful/app/src/main/assets/assets.dpak
+//
+// Entry names are paths relative to the input directory with / separators, the same paths the
+// sample passes to AAssetManager_open.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "AssetPack.h"
+#include "Lz4.h"
+
+using namespace std;
+namespace fs = std::filesystem;
+
+struct Options {
+  bool compress = true;
+  // percent of an entry LZ4 has to save for it to be stored compressed, since the stored form
+  // can be used in place without decompressing at all
+  int minSaving = 10;
+  string input;
+  string output;
+};
+
+struct Input {
+  string name;
+  vector<uint8_t> data;
+  vector<uint8_t> stored;
+  uint32_t compression = kAssetPackStored;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: assetpack [--no-compress] [--min-saving percent] input_dir output.dpak\n"
+          "  --no-compress     store every entry as is\n"
+          "  --min-saving N    compress entries only if LZ4 makes them at least N%% smaller (default 10)\n");
+}
+
+static bool readFile(const fs::path& path, vector<uint8_t>& data) {
+  ifstream file(path, ios::binary);
+  if (!file) {
+    return false;
+  }
+  data.assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+  return !file.bad();
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  vector<string> paths;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--no-compress")) {
+      options.compress = false;
+    } else if (!strcmp(argv[i], "--min-saving") && i + 1 < argc) {
+      options.minSaving = atoi(argv[++i]);
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != 2) {
+    usage();
+    return 1;
+  }
+  options.input = paths[0];
+  options.output = paths[1];
+
+  // Every regular file under the input, except a previous pack being replaced
+  vector<Input> inputs;
+  error_code error;
+  fs::path output = fs::weakly_canonical(options.output, error);
+  for (fs::recursive_directory_iterator it(options.input, error), end; !error && it != end; it.increment(error)) {
+    if (!it->is_regular_file() || fs::weakly_canonical(it->path(), error) == output) {
+      continue;
+    }
+    Input input;
+    input.name = it->path().lexically_relative(options.input).generic_string();
+    if (!readFile(it->path(), input.data)) {
+      fprintf(stderr, "assetpack: can't read %s\n", it->path().c_str());
+      return 1;
+    }
+    inputs.push_back(std::move(input));
+  }
+  if (error) {
+    fprintf(stderr, "assetpack: %s: %s\n", options.input.c_str(), error.message().c_str());
+    return 1;
+  }
+  // AssetArchive binary searches the index
+  sort(inputs.begin(), inputs.end(), [](const Input& a, const Input& b) { return a.name < b.name; });
+
+  size_t totalSize = 0;
+  for (auto& input : inputs) {
+    totalSize += input.data.size();
+    if (options.compress && !input.data.empty()) {
+      vector<uint8_t> compressed(lz4CompressBound(input.data.size()));
+      size_t size = lz4Compress(input.data.data(), input.data.size(), compressed.data(), compressed.size());
+      if (size && size * 100 <= input.data.size() * (100 - options.minSaving)) {
+        compressed.resize(size);
+        input.stored = std::move(compressed);
+        input.compression = kAssetPackLz4;
+      }
+    }
+  }
+
+  AssetPackHeader header{};
+  memcpy(header.magic, kAssetPackMagic, sizeof(kAssetPackMagic));
+  header.version = kAssetPackVersion;
+  header.entryCount = uint32_t(inputs.size());
+  string names;
+  vector<AssetPackEntry> index(inputs.size());
+  for (size_t i = 0; i < inputs.size(); i++) {
+    index[i].nameOffset = uint32_t(names.size());
+    index[i].nameLength = uint32_t(inputs[i].name.size());
+    names += inputs[i].name;
+  }
+  header.namesSize = uint32_t(names.size());
+
+  // Payloads follow the names, each aligned
+  size_t offset = sizeof(header) + index.size() * sizeof(AssetPackEntry) + names.size();
+  for (size_t i = 0; i < inputs.size(); i++) {
+    const auto& stored = inputs[i].compression == kAssetPackLz4 ? inputs[i].stored : inputs[i].data;
+    offset = (offset + kAssetPackAlignment - 1) / kAssetPackAlignment * kAssetPackAlignment;
+    index[i].offset = offset;
+    index[i].storedSize = stored.size();
+    index[i].size = inputs[i].data.size();
+    index[i].compression = inputs[i].compression;
+    offset += stored.size();
+  }
+
+  FILE* f = fopen(options.output.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "assetpack: can't write %s\n", options.output.c_str());
+    return 1;
+  }
+  size_t written = 0;
+  auto write = [f, &written](const void* data, size_t size) {
+    fwrite(data, 1, size, f);
+    written += size;
+  };
+  write(&header, sizeof(header));
+  write(index.data(), index.size() * sizeof(AssetPackEntry));
+  write(names.data(), names.size());
+  static const uint8_t padding[kAssetPackAlignment] = {};
+  size_t compressedCount = 0;
+  for (size_t i = 0; i < inputs.size(); i++) {
+    const auto& stored = inputs[i].compression == kAssetPackLz4 ? inputs[i].stored : inputs[i].data;
+    write(padding, index[i].offset - written);
+    write(stored.data(), stored.size());
+    printf("  %s: %zu bytes%s\n", inputs[i].name.c_str(), inputs[i].data.size(),
+           inputs[i].compression == kAssetPackLz4 ? (", LZ4 " + to_string(stored.size())).c_str() : "");
+    compressedCount += inputs[i].compression == kAssetPackLz4;
+  }
+  bool ok = !ferror(f);
+  fclose(f);
+  if (!ok) {
+    fprintf(stderr, "assetpack: can't write %s\n", options.output.c_str());
+    return 1;
+  }
+
+  printf("%s: %zu entries, %zu compressed, %zu bytes (%zu unpacked)\n", options.output.c_str(), inputs.size(),
+         compressedCount, written, totalSize);
+  return 0;
+}
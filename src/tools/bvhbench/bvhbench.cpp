@@ -0,0 +1,247 @@
+// Measures Bvh on the host. Build and run:
+//
+//   g++ -std=c++20 -O2 -pthread -I../../samples/Dreadful/app/src/main/cpp bvhbench.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/Bvh.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/WorkerPool.cpp -o bvhbench
+//   ./bvhbench
+//
+// For 10000 random boxes scattered through a cube, then ten times as many up to --objects, it times
+// and prints:
+//   build     building the tree
+//   refit     refitting after 1% of the boxes moved, and after all of them did
+//   frustum   culling an axis aligned slab a third of the cube across, against testing every box
+//   rays      castRays on --queries random rays
+//   spheres   overlapSpheres on --queries random spheres
+//   rebuild   the cost after the boxes drift until needsRebuild(), and after rebuildAsync() on a
+//             worker brings it back down
+// The frustum cull is checked against testing every box, before and after the rebuild, and the
+// first --checked rays and spheres against every box too.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Bvh.h"
+
+using namespace std;
+
+struct Options {
+  uint32_t objects = 1000000;
+  uint32_t queries = 10000;
+  uint32_t checked = 100;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: bvhbench [--objects N] [--queries N] [--checked N]\n"
+          "  --objects N   largest box count to try (default 1000000)\n"
+          "  --queries N   rays and spheres to time (default 10000)\n"
+          "  --checked N   rays and spheres to check against every box (default 100)\n");
+}
+
+static double elapsedMs(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+//! @return true if visible holds each box inside planes once, and nothing else
+static bool isCullCorrect(span<const BoundingBox> boxes, span<const r3::Planef> planes, const vector<uint32_t>& visible) {
+  vector<uint8_t> seen(boxes.size());
+  for (auto object : visible) {
+    if (object >= boxes.size() || seen[object]++) {
+      return false;
+    }
+  }
+  for (size_t i = 0; i < boxes.size(); i++) {
+    if (bool(seen[i]) != intersects(planes, boxes[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//! @return the distance along ray to the nearest box it enters within maxDistance, or maxDistance
+static float findNearestHit(span<const BoundingBox> boxes, const r3::Linef& ray, float maxDistance) {
+  auto origin = ray.GetPosition();
+  auto direction = ray.GetDirection();
+  float nearest = maxDistance;
+  for (const auto& box : boxes) {
+    float enter = 0;
+    float exit = nearest;
+    for (int axis = 0; axis < 3; axis++) {
+      float t0 = (box.min[axis] - origin[axis]) / direction[axis];
+      float t1 = (box.max[axis] - origin[axis]) / direction[axis];
+      enter = max(enter, min(t0, t1));
+      exit = min(exit, max(t0, t1));
+    }
+    if (enter <= exit && enter < nearest) {
+      nearest = enter;
+    }
+  }
+  return nearest;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    auto number = [&](uint32_t& value) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+        return false;
+      }
+      value = uint32_t(atoi(argv[++i]));
+      return true;
+    };
+    bool ok = false;
+    if (!strcmp(argv[i], "--objects")) {
+      ok = number(options.objects);
+    } else if (!strcmp(argv[i], "--queries")) {
+      ok = number(options.queries);
+    } else if (!strcmp(argv[i], "--checked")) {
+      ok = number(options.checked);
+    }
+    if (!ok) {
+      usage();
+      return 1;
+    }
+  }
+
+  mt19937 random(1);
+  uniform_real_distribution<float> unit(0.f, 1.f);
+  WorkerPool workers(1);
+  bool allCorrect = true;
+  for (uint32_t count = min(10000u, options.objects);; count *= 10) {
+    // About one box per 64 cubic units, boxes 1 to 3 units across
+    float side = cbrtf(float(count)) * 4.f;
+    auto randomBox = [&](const r3::Vec3f& center) {
+      r3::Vec3f half(0.5f + unit(random), 0.5f + unit(random), 0.5f + unit(random));
+      return BoundingBox{center - half, center + half};
+    };
+    vector<BoundingBox> boxes(count);
+    for (auto& box : boxes) {
+      box = randomBox(r3::Vec3f(unit(random), unit(random), unit(random)) * side);
+    }
+
+    Bvh bvh;
+    auto start = chrono::steady_clock::now();
+    bvh.build(boxes);
+    double buildMs = elapsedMs(start);
+    size_t builtNodes = bvh.getNodeCount();
+    float builtCost = bvh.getCost();
+
+    vector<uint32_t> moved(count / 100);
+    for (auto& object : moved) {
+      object = random() % count;
+      boxes[object] = randomBox(boxes[object].getCenter() + r3::Vec3f(unit(random), unit(random), unit(random)));
+    }
+    start = chrono::steady_clock::now();
+    bvh.refit(boxes, moved);
+    double refitMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    bvh.refit(boxes);
+    double fullRefitMs = elapsedMs(start);
+
+    // An axis aligned slab a third of the cube across, so about a ninth of the boxes are visible
+    float low = side / 3.f;
+    float high = side * 2.f / 3.f;
+    vector<r3::Planef> planes = {
+        r3::Planef(r3::Vec3f(1, 0, 0), r3::Vec3f(low, 0, 0)), r3::Planef(r3::Vec3f(-1, 0, 0), r3::Vec3f(high, 0, 0)),
+        r3::Planef(r3::Vec3f(0, 1, 0), r3::Vec3f(0, low, 0)), r3::Planef(r3::Vec3f(0, -1, 0), r3::Vec3f(0, high, 0)),
+    };
+    vector<uint32_t> visible;
+    visible.reserve(count);
+    start = chrono::steady_clock::now();
+    bvh.cullFrustum(planes, visible);
+    double cullMs = elapsedMs(start);
+    start = chrono::steady_clock::now();
+    size_t bruteVisible = 0;
+    for (const auto& box : boxes) {
+      bruteVisible += intersects(planes, box);
+    }
+    double bruteMs = elapsedMs(start);
+    bool cullCorrect = isCullCorrect(boxes, planes, visible);
+    size_t builtVisible = visible.size();
+
+    vector<r3::Linef> rays(options.queries);
+    for (auto& ray : rays) {
+      r3::Vec3f origin(unit(random) * side, unit(random) * side, unit(random) * side);
+      r3::Vec3f direction(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f);
+      ray = r3::Linef(origin, origin + direction.Normalized());
+    }
+    vector<Bvh::RayHit> hits(rays.size());
+    start = chrono::steady_clock::now();
+    bvh.castRays(rays, side, hits);
+    double raysMs = elapsedMs(start);
+    uint32_t wrongRays = 0;
+    for (uint32_t r = 0; r < min(options.checked, options.queries); r++) {
+      float nearest = findNearestHit(boxes, rays[r], side);
+      bool hit = nearest < side;
+      if (hit != (hits[r].object != Bvh::kNoObject) || (hit && fabsf(nearest - hits[r].distance) > 1e-3f * side)) {
+        wrongRays++;
+      }
+    }
+
+    vector<BoundingSphere> spheres(options.queries);
+    for (auto& sphere : spheres) {
+      sphere = {r3::Vec3f(unit(random), unit(random), unit(random)) * side, 4.f};
+    }
+    vector<uint32_t> overlaps;
+    vector<uint32_t> offsets;
+    start = chrono::steady_clock::now();
+    bvh.overlapSpheres(spheres, overlaps, offsets);
+    double spheresMs = elapsedMs(start);
+    uint32_t wrongSpheres = 0;
+    for (uint32_t s = 0; s < min(options.checked, options.queries); s++) {
+      vector<uint32_t> found(overlaps.begin() + offsets[s], overlaps.begin() + offsets[s + 1]);
+      sort(found.begin(), found.end());
+      vector<uint32_t> expected;
+      for (uint32_t i = 0; i < count; i++) {
+        auto offset = r3::Min(r3::Max(spheres[s].center, boxes[i].min), boxes[i].max) - spheres[s].center;
+        if (offset.Dot(offset) <= spheres[s].radius * spheres[s].radius) {
+          expected.push_back(i);
+        }
+      }
+      wrongSpheres += found != expected;
+    }
+
+    // Drift every box until the tree's shape is stale, then rebuild it in the background
+    float step = side / 50.f;
+    uint32_t drifts = 0;
+    while (!bvh.needsRebuild() && drifts < 100) {
+      for (auto& box : boxes) {
+        box = randomBox(box.getCenter() + r3::Vec3f(unit(random) - 0.5f, unit(random) - 0.5f, unit(random) - 0.5f) * step);
+      }
+      bvh.refit(boxes);
+      drifts++;
+    }
+    float staleCost = bvh.getCost();
+    start = chrono::steady_clock::now();
+    bvh.rebuildAsync(boxes, workers);
+    while (!bvh.finishRebuild(boxes)) {
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
+    double rebuildMs = elapsedMs(start);
+    visible.clear();
+    bvh.cullFrustum(planes, visible);
+    bool rebuiltCorrect = isCullCorrect(boxes, planes, visible);
+
+    printf("%u boxes, %zu nodes\n", count, builtNodes);
+    printf("  build    %.2f ms\n", buildMs);
+    printf("  refit    %zu moved %.3f ms, all %.3f ms\n", moved.size(), refitMs, fullRefitMs);
+    printf("  frustum  %zu visible %.3f ms, every box %zu in %.3f ms%s\n", builtVisible, cullMs, bruteVisible,
+           bruteMs, cullCorrect ? "" : "  WRONG RESULTS");
+    printf("  rays     %.2f M/s%s\n", rays.size() / raysMs / 1000, wrongRays ? "  WRONG RESULTS" : "");
+    printf("  spheres  %.2f M/s%s\n", spheres.size() / spheresMs / 1000, wrongSpheres ? "  WRONG RESULTS" : "");
+    printf("  rebuild  cost %.1f built, %.1f after %u drifts, %.1f after %.1f ms on a worker%s\n", builtCost,
+           staleCost, drifts, bvh.getCost(), rebuildMs, rebuiltCorrect ? "" : "  WRONG RESULTS");
+    allCorrect = allCorrect && cullCorrect && !wrongRays && !wrongSpheres && rebuiltCorrect;
+    if (count > options.objects / 10) {
+      break;
+    }
+  }
+  return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,302 @@
+// Lists what GlbAsset would load from a binary glTF file, and checks the parsers it uses. Build and
+// run on the host:
+//
+//   g++ -std=c++20 -O2 -I../../samples/Dreadful/app/src/main/cpp glbinfo.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/GlbFile.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/Json.cpp -o glbinfo
+//   ./glbinfo model.glb
+//
+// For a file it prints the meshes, their primitives with vertex and index counts, the images and
+// how long GlbFile::parse took, and fails if the file can't be parsed. --test parses documents
+// built in memory instead: JSON values, escapes and lookups, a small GLB whose tables are
+// compared field by field, and broken JSON and GLB files that have to be refused.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include "GlbFile.h"
+#include "Json.h"
+
+using namespace std;
+
+static void usage() {
+  fprintf(stderr,
+          "usage: glbinfo file.glb\n"
+          "       glbinfo --test\n");
+}
+
+static const char* getComponentName(uint32_t componentType) {
+  switch (componentType) {
+    case kGltfByte:
+      return "byte";
+    case kGltfUnsignedByte:
+      return "ubyte";
+    case kGltfShort:
+      return "short";
+    case kGltfUnsignedShort:
+      return "ushort";
+    case kGltfUnsignedInt:
+      return "uint";
+    case kGltfFloat:
+      return "float";
+    default:
+      return "?";
+  }
+}
+
+static int printFile(const char* path) {
+  ifstream file(path, ios::binary);
+  vector<uint8_t> data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+  if (!file && !file.eof()) {
+    fprintf(stderr, "glbinfo: can't read %s\n", path);
+    return 1;
+  }
+  GlbFile glb;
+  const char* error = nullptr;
+  auto start = chrono::steady_clock::now();
+  bool parsed = GlbFile::parse(data.data(), data.size(), glb, &error);
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  if (!parsed) {
+    fprintf(stderr, "glbinfo: %s: %s\n", path, error);
+    return 1;
+  }
+
+  printf("%s: %zu bytes, %zu byte BIN chunk, %zu buffer views, %zu accessors, parsed in %.3f ms\n", path,
+         data.size(), glb.binSize, glb.bufferViews.size(), glb.accessors.size(), ms);
+  auto accessor = [&glb](uint32_t index) -> const GlbAccessor* {
+    return index != kGltfNone && glb.accessors[index].bufferView != kGltfNone ? &glb.accessors[index] : nullptr;
+  };
+  for (size_t m = 0; m < glb.meshes.size(); m++) {
+    const auto& mesh = glb.meshes[m];
+    printf("mesh %zu \"%s\"\n", m, mesh.name.c_str());
+    for (size_t p = 0; p < mesh.primitives.size(); p++) {
+      const auto& primitive = mesh.primitives[p];
+      auto position = accessor(primitive.position);
+      auto uv = accessor(primitive.uv);
+      auto indices = accessor(primitive.indices);
+      printf("  primitive %zu: ", p);
+      if (position) {
+        printf("%u vertices, positions %u x %s", position->count, position->components,
+               getComponentName(position->componentType));
+      } else {
+        printf("no positions");
+      }
+      if (uv) {
+        printf(", uvs %u x %s%s", uv->components, getComponentName(uv->componentType),
+               uv->normalized ? " normalized" : "");
+      }
+      if (indices) {
+        printf(", %u %s indices", indices->count, getComponentName(indices->componentType));
+      } else {
+        printf(", not indexed");
+      }
+      if (primitive.mode != kGltfTriangles) {
+        printf(", mode %u", primitive.mode);
+      }
+      if (primitive.material != kGltfNone) {
+        printf(", material %u", primitive.material);
+      }
+      // What GlbAsset can draw, the rest it skips
+      bool loaded = primitive.mode == kGltfTriangles && position && position->componentType == kGltfFloat &&
+                    position->components == 3 && position->hasBounds && indices && indices->components == 1 &&
+                    (indices->componentType == kGltfUnsignedByte || indices->componentType == kGltfUnsignedShort ||
+                     indices->componentType == kGltfUnsignedInt);
+      printf("%s\n", loaded ? "" : ", skipped");
+    }
+  }
+  for (size_t i = 0; i < glb.images.size(); i++) {
+    const auto& image = glb.images[i];
+    printf("image %zu \"%s\": ", i, image.name.c_str());
+    if (image.bufferView != kGltfNone) {
+      printf("%s, %zu bytes embedded\n", image.mimeType.c_str(), glb.getBufferView(image.bufferView).size());
+    } else {
+      printf("not embedded, skipped\n");
+    }
+  }
+  return 0;
+}
+
+/*!
+ * @return a GLB of json and bin, each padded to 4 bytes as the format asks
+ */
+static vector<uint8_t> makeGlb(string json, const vector<uint8_t>& bin) {
+  json.resize((json.size() + 3) / 4 * 4, ' ');
+  size_t binSize = (bin.size() + 3) / 4 * 4;
+  vector<uint8_t> out;
+  auto put32 = [&out](uint32_t value) {
+    out.insert(out.end(), reinterpret_cast<uint8_t*>(&value), reinterpret_cast<uint8_t*>(&value) + 4);
+  };
+  put32(kGlbMagic);
+  put32(kGlbVersion);
+  put32(uint32_t(12 + 8 + json.size() + (bin.empty() ? 0 : 8 + binSize)));
+  put32(uint32_t(json.size()));
+  put32(kGlbChunkJson);
+  out.insert(out.end(), json.begin(), json.end());
+  if (!bin.empty()) {
+    put32(uint32_t(binSize));
+    put32(kGlbChunkBin);
+    out.insert(out.end(), bin.begin(), bin.end());
+    out.resize(out.size() + binSize - bin.size());
+  }
+  return out;
+}
+
+/*!
+ * The JSON of a textured quad: positions, uvs and indices in views 0 to 2 and an image in view 3,
+ * with the given accessor for the indices so tests can break it.
+ */
+static string makeQuadJson(const string& indexAccessor) {
+  return R"({"asset": {"version": "2.0"},
+    "buffers": [{"byteLength": 96}],
+    "bufferViews": [
+      {"buffer": 0, "byteOffset": 0, "byteLength": 48},
+      {"buffer": 0, "byteOffset": 48, "byteLength": 32, "byteStride": 8},
+      {"buffer": 0, "byteOffset": 80, "byteLength": 12},
+      {"buffer": 0, "byteOffset": 92, "byteLength": 4}],
+    "accessors": [
+      {"bufferView": 0, "componentType": 5126, "count": 4, "type": "VEC3", "min": [-1, -1, 0], "max": [1, 1, 0]},
+      {"bufferView": 1, "componentType": 5126, "count": 4, "type": "VEC2"},
+      )" + indexAccessor + R"(],
+    "images": [{"bufferView": 3, "mimeType": "image/png", "name": "quad\u00e9"}],
+    "textures": [{"source": 0}],
+    "materials": [{"pbrMetallicRoughness": {"baseColorTexture": {"index": 0}}}],
+    "meshes": [{"name": "quad", "primitives": [{"attributes": {"POSITION": 0, "TEXCOORD_0": 1}, "indices": 2,
+      "material": 0}]}]})";
+}
+
+static vector<uint8_t> makeQuadBin() {
+  vector<uint8_t> bin(96);
+  float positions[12] = {-1, -1, 0, 1, -1, 0, 1, 1, 0, -1, 1, 0};
+  float uvs[8] = {0, 1, 1, 1, 1, 0, 0, 0};
+  uint16_t indices[6] = {0, 1, 2, 0, 2, 3};
+  memcpy(bin.data(), positions, sizeof(positions));
+  memcpy(bin.data() + 48, uvs, sizeof(uvs));
+  memcpy(bin.data() + 80, indices, sizeof(indices));
+  memcpy(bin.data() + 92, "\x89PNG", 4);
+  return bin;
+}
+
+static bool runTests() {
+  bool passed = true;
+  auto check = [&passed](bool ok, const char* what) {
+    printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+    passed = passed && ok;
+  };
+
+  // JSON values and lookups
+  JsonValue json;
+  bool parsed = JsonValue::parse(
+      R"( {"numbers": [1, 2.5, -3e2, 0.25E+1], "flags": [true, false, null], "text": "a\"\\\/\n\u00e9\ud83d\ude00",
+           "empty": {}, "nested": {"list": [[], {"x": 7}]}} )",
+      json);
+  check(parsed && json.getType() == JsonValue::Type::Object && json.size() == 5, "JSON document parses");
+  const auto& numbers = json["numbers"];
+  check(numbers.size() == 4 && numbers[0].getUint() == 1 && numbers[1].getNumber() == 2.5 &&
+            numbers[2].getNumber() == -300 && numbers[3].getNumber() == 2.5,
+        "JSON numbers");
+  check(numbers[1].getUint(9) == 9 && numbers[2].getUint(9) == 9 && json["text"].getUint(9) == 9,
+        "getUint falls back for fractions, negatives and other types");
+  check(json["flags"][0].getBool() && !json["flags"][1].getBool(true) && json["flags"][2].isNull(), "JSON literals");
+  check(json["text"].getString() == "a\"\\/\n\xc3\xa9\xf0\x9f\x98\x80", "JSON escapes and surrogate pairs");
+  check(json["nested"]["list"][1]["x"].getUint() == 7 && json["nested"]["list"][0].size() == 0 &&
+            json["empty"].getType() == JsonValue::Type::Object,
+        "nested JSON lookups");
+  check(json["missing"][3]["x"].getUint(5) == 5 && json["numbers"]["x"].isNull() && json["text"][0].isNull(),
+        "missing JSON members read as null");
+  string deep(100, '[');
+  deep += string(100, ']');
+  for (const char* bad : {"", "[1,]", "{\"a\" 1}", "[1] 2", "\"open", "[01x]", "{\"a\": tru}", "[1.]", "\"\\q\"",
+                          "\"\\ud83d\\u0041\"", "-", deep.c_str()}) {
+    const char* error = nullptr;
+    bool refused = !JsonValue::parse(bad, json, &error) && error && json.isNull();
+    if (!refused) {
+      printf("  accepted %s\n", bad);
+    }
+    check(refused, "broken JSON is refused");
+  }
+
+  // A well formed GLB
+  auto bin = makeQuadBin();
+  string indices = R"({"bufferView": 2, "componentType": 5123, "count": 6, "type": "SCALAR"})";
+  auto data = makeGlb(makeQuadJson(indices), bin);
+  GlbFile glb;
+  const char* error = nullptr;
+  parsed = GlbFile::parse(data.data(), data.size(), glb, &error);
+  check(parsed, "GLB parses");
+  if (parsed) {
+    check(glb.binSize == 96 && glb.bufferViews.size() == 4 && glb.bufferViews[1].byteStride == 8,
+          "GLB buffer views");
+    const auto& position = glb.accessors[0];
+    check(glb.accessors.size() == 3 && position.bufferView == 0 && position.count == 4 && position.components == 3 &&
+              position.getElementSize() == 12 && position.hasBounds && position.min[0] == -1 && position.max[1] == 1,
+          "GLB accessors");
+    check(glb.accessors[2].componentType == kGltfUnsignedShort && glb.accessors[2].getElementSize() == 2,
+          "GLB index accessor");
+    check(glb.meshes.size() == 1 && glb.meshes[0].name == "quad" && glb.meshes[0].primitives.size() == 1,
+          "GLB meshes");
+    const auto& primitive = glb.meshes[0].primitives[0];
+    check(primitive.position == 0 && primitive.uv == 1 && primitive.indices == 2 && primitive.material == 0 &&
+              primitive.mode == kGltfTriangles,
+          "GLB primitive");
+    auto view = glb.getBufferView(2);
+    check(view.size() == 12 && !memcmp(view.data(), bin.data() + 80, 12), "GLB buffer views point into BIN");
+    check(glb.materials.size() == 1 && glb.materials[0].baseColorImage == 0 && glb.images.size() == 1 &&
+              glb.images[0].bufferView == 3 && glb.images[0].mimeType == "image/png" &&
+              glb.images[0].name == "quad\xc3\xa9",
+          "GLB materials and images");
+  }
+
+  // Broken ones
+  auto refuse = [&](vector<uint8_t> file, const char* what) {
+    GlbFile out;
+    const char* error = nullptr;
+    bool refused = !GlbFile::parse(file.data(), file.size(), out, &error) && error;
+    check(refused, what);
+  };
+  auto badMagic = data;
+  badMagic[0] = 'x';
+  refuse(badMagic, "GLB with a bad magic is refused");
+  auto badVersion = data;
+  badVersion[4] = 1;
+  refuse(badVersion, "GLB of glTF 1 is refused");
+  auto truncated = data;
+  truncated.resize(data.size() - 8);
+  // the header's length is clamped to the data, so the BIN chunk runs past the end
+  refuse(truncated, "truncated GLB is refused");
+  refuse(vector<uint8_t>(data.begin(), data.begin() + 12), "GLB without chunks is refused");
+  string viewPastBin = makeQuadJson(indices);
+  viewPastBin.replace(viewPastBin.find("\"byteOffset\": 92"), 16, "\"byteOffset\": 93");
+  refuse(makeGlb(viewPastBin, bin), "buffer view past the BIN chunk is refused");
+  refuse(makeGlb(makeQuadJson(R"({"bufferView": 2, "componentType": 5123, "count": 7, "type": "SCALAR"})"), bin),
+         "accessor past its view is refused");
+  refuse(makeGlb(makeQuadJson(
+                     R"({"bufferView": 2, "byteOffset": 1, "componentType": 5123, "count": 5, "type": "SCALAR"})"),
+                 bin),
+         "misaligned accessor is refused");
+  string missingAccessor = makeQuadJson(indices);
+  missingAccessor.replace(missingAccessor.find("\"indices\": 2"), 12, "\"indices\": 9");
+  refuse(makeGlb(missingAccessor, bin), "primitive using a missing accessor is refused");
+  refuse(makeGlb("{\"asset\": ", bin), "GLB with broken JSON is refused");
+  return passed;
+}
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    usage();
+    return 1;
+  }
+  if (!strcmp(argv[1], "--test")) {
+    return runTests() ? 0 : 1;
+  }
+  if (argv[1][0] == '-') {
+    usage();
+    return 1;
+  }
+  return printFile(argv[1]);
+}
@@ -0,0 +1,209 @@
+// Measures how JobSystem scales from one thread to many, on the host. Build and run:
+//
+//   g++ -std=c++20 -O2 -pthread -I../../samples/Dreadful/app/src/main/cpp jobbench.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/FrustumCuller.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/JobSystem.cpp -o jobbench
+//   ./jobbench
+//
+// For each thread count from 1 to --threads (the hardware's by default) it times three loads,
+// --frames times each, and prints the average:
+//   empty     --jobs jobs that do nothing, submitted from one thread: the cost of a job
+//   cull      FrustumCuller on --objects spheres against two eyes, with parallelFor
+//   graph     a frame's worth of dependent stages: move the spheres, cull them, count the visible
+//             ones, each stage a parallelFor started by a job waiting for the stage before
+// and checks the parallel results against a single threaded run.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "FrustumCuller.h"
+#include "JobSystem.h"
+
+using namespace std;
+
+struct Options {
+  uint32_t threads = max(1u, thread::hardware_concurrency());
+  uint32_t objects = 1000000;
+  uint32_t jobs = 100000;
+  uint32_t frames = 20;
+  uint32_t grain = 4096;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: jobbench [--threads N] [--objects N] [--jobs N] [--frames N] [--grain N]\n"
+          "  --threads N   largest thread count to try (default: the hardware's)\n"
+          "  --objects N   spheres to cull (default 1000000)\n"
+          "  --jobs N      empty jobs per frame (default 100000)\n"
+          "  --frames N    runs of each load to average (default 20)\n"
+          "  --grain N     spheres per parallelFor piece (default 4096)\n");
+}
+
+//! The spheres of a frame, and where they're moved to
+struct Scene {
+  vector<r3::Vec3f> centers;
+  vector<float> radii;
+  FrustumCuller::Spheres spheres;
+  vector<uint8_t> masks;
+  r3::Posef pose;
+};
+
+static double elapsedMs(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+static void moveSpheres(Scene& scene, uint32_t first, uint32_t last) {
+  for (uint32_t i = first; i < last; i++) {
+    scene.spheres.set(i, {scene.pose.Transform(scene.centers[i]), scene.radii[i]});
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    auto number = [&](uint32_t& value) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+        return false;
+      }
+      value = uint32_t(atoi(argv[++i]));
+      return true;
+    };
+    bool ok = false;
+    if (!strcmp(argv[i], "--threads")) {
+      ok = number(options.threads);
+    } else if (!strcmp(argv[i], "--objects")) {
+      ok = number(options.objects);
+    } else if (!strcmp(argv[i], "--jobs")) {
+      ok = number(options.jobs);
+    } else if (!strcmp(argv[i], "--frames")) {
+      ok = number(options.frames);
+    } else if (!strcmp(argv[i], "--grain")) {
+      ok = number(options.grain);
+    }
+    if (!ok) {
+      usage();
+      return 1;
+    }
+  }
+
+  // Spheres up to 30 m away around a pair of eyes, as in cullbench
+  mt19937 random(1);
+  uniform_real_distribution<float> unit(-1.f, 1.f);
+  Scene scene;
+  scene.centers.resize(options.objects);
+  scene.radii.resize(options.objects);
+  for (uint32_t i = 0; i < options.objects; i++) {
+    scene.centers[i] = r3::Vec3f(unit(random), unit(random), unit(random)) * 30.f;
+    scene.radii[i] = 0.5f + unit(random) * 0.4f;
+  }
+  scene.spheres.resize(options.objects);
+  scene.masks.resize(options.objects);
+  r3::Posef eyes[2] = {r3::Posef(r3::Quaternionf(), r3::Vec3f(-0.032f, 0, 0)),
+                       r3::Posef(r3::Quaternionf(), r3::Vec3f(0.032f, 0, 0))};
+  FrustumCuller::Fov fovs[2] = {{-0.94f, 0.80f, 0.84f, -0.96f}, {-0.80f, 0.94f, 0.84f, -0.96f}};
+  FrustumCuller culler;
+  culler.setEyes(eyes, fovs, 0.05f, 50.f);
+
+  // What one thread gets, to check the others against
+  vector<uint8_t> expectedMasks(options.objects);
+  vector<size_t> expectedVisible(options.frames);
+  for (uint32_t frame = 0; frame < options.frames; frame++) {
+    scene.pose = r3::Posef(r3::Quaternionf(r3::Vec3f(0, 1, 0), frame * 0.1f), r3::Vec3f(0, 0, 0));
+    moveSpheres(scene, 0, options.objects);
+    culler.cull(scene.spheres, expectedMasks);
+    expectedVisible[frame] = options.objects - count(expectedMasks.begin(), expectedMasks.end(), 0);
+  }
+  culler.cull(scene.spheres, expectedMasks);
+
+  printf("%u spheres, %u empty jobs, grain %u, %u frames, %s\n", options.objects, options.jobs, options.grain,
+         options.frames, FrustumCuller::getSimdName());
+  printf("threads  empty jobs/us  cull ms  speedup  graph ms  speedup\n");
+  double cullMs1 = 0;
+  double graphMs1 = 0;
+  bool allCorrect = true;
+  for (uint32_t threads = 1; threads <= options.threads; threads++) {
+    JobSystem jobs(threads, options.jobs + options.objects / options.grain * 8 + 64);
+
+    // Empty jobs
+    double emptyMs = 0;
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+      jobs.beginFrame();
+      auto start = chrono::steady_clock::now();
+      JobSystem::Counter done;
+      for (uint32_t j = 0; j < options.jobs; j++) {
+        jobs.run(done, [] {});
+      }
+      jobs.wait(done);
+      emptyMs += elapsedMs(start);
+    }
+
+    // Culling alone, the spheres as the last frame left them
+    double cullMs = 0;
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+      jobs.beginFrame();
+      fill(scene.masks.begin(), scene.masks.end(), 0xff);
+      auto start = chrono::steady_clock::now();
+      JobSystem::Counter done;
+      jobs.parallelFor(done, 0, options.objects, options.grain, [&scene, &culler](uint32_t first, uint32_t last) {
+        culler.cull(scene.spheres, first, last, scene.masks);
+      });
+      jobs.wait(done);
+      cullMs += elapsedMs(start);
+    }
+    bool correct = scene.masks == expectedMasks;
+
+    // Stages of a frame, each waiting for the one before
+    double graphMs = 0;
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+      jobs.beginFrame();
+      scene.pose = r3::Posef(r3::Quaternionf(r3::Vec3f(0, 1, 0), frame * 0.1f), r3::Vec3f(0, 0, 0));
+      atomic<size_t> visible = 0;
+      auto start = chrono::steady_clock::now();
+      JobSystem::Counter moved;
+      JobSystem::Counter culled;
+      JobSystem::Counter counted;
+      uint32_t objects = options.objects;
+      uint32_t grain = options.grain;
+      jobs.parallelFor(moved, 0, objects, grain, [&scene](uint32_t first, uint32_t last) {
+        moveSpheres(scene, first, last);
+      });
+      jobs.runAfter(moved, culled, [&jobs, &culled, &scene, &culler, objects, grain] {
+        jobs.parallelFor(culled, 0, objects, grain, [&scene, &culler](uint32_t first, uint32_t last) {
+          culler.cull(scene.spheres, first, last, scene.masks);
+        });
+      });
+      jobs.runAfter(culled, counted, [&jobs, &counted, &scene, &visible, objects, grain] {
+        jobs.parallelFor(counted, 0, objects, grain, [&scene, &visible](uint32_t first, uint32_t last) {
+          size_t seen = 0;
+          for (uint32_t i = first; i < last; i++) {
+            seen += scene.masks[i] != 0;
+          }
+          visible += seen;
+        });
+      });
+      jobs.wait(counted);
+      graphMs += elapsedMs(start);
+      correct = correct && visible == expectedVisible[frame];
+    }
+
+    emptyMs /= options.frames;
+    cullMs /= options.frames;
+    graphMs /= options.frames;
+    if (threads == 1) {
+      cullMs1 = cullMs;
+      graphMs1 = graphMs;
+    }
+    printf("%7u  %13.2f  %7.3f  %6.2fx  %8.3f  %6.2fx%s\n", threads, options.jobs / (emptyMs * 1000), cullMs,
+           cullMs1 / cullMs, graphMs, graphMs1 / graphMs, correct ? "" : "  WRONG RESULTS");
+    allCorrect = allCorrect && correct;
+  }
+  return allCorrect ? 0 : 1;
+}
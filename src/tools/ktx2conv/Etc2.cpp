@@ -0,0 +1,227 @@
+#include "Etc2.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+
+// ETC1 intensity modifiers, {small, large} per table
+static constexpr int kColorModifiers[8][2] = {{2, 8}, {5, 17}, {9, 29}, {13, 42}, {18, 60}, {24, 80}, {33, 106}, {47, 183}};
+
+// EAC modifiers, scaled by the block's multiplier
+static constexpr int kAlphaModifiers[16][8] = {
+    {-3, -6, -9, -15, 2, 5, 8, 14}, {-3, -7, -10, -13, 2, 6, 9, 12}, {-2, -5, -8, -13, 1, 4, 7, 12},
+    {-2, -4, -6, -13, 1, 3, 5, 12}, {-3, -6, -8, -12, 2, 5, 7, 11},  {-3, -7, -9, -11, 2, 6, 8, 10},
+    {-4, -7, -8, -11, 3, 6, 7, 10}, {-3, -5, -8, -11, 2, 4, 7, 10},  {-2, -6, -8, -10, 1, 5, 7, 9},
+    {-2, -5, -8, -10, 1, 4, 7, 9},  {-2, -4, -8, -10, 1, 3, 7, 9},   {-2, -5, -7, -10, 1, 4, 6, 9},
+    {-3, -4, -7, -10, 2, 3, 6, 9},  {-1, -2, -3, -10, 0, 1, 2, 9},   {-4, -6, -8, -9, 3, 5, 7, 8},
+    {-3, -5, -7, -9, 2, 4, 6, 8}};
+
+static int clamp255(int v) {
+  return v < 0 ? 0 : (v > 255 ? 255 : v);
+}
+
+static void writeBigEndian64(uint64_t v, uint8_t out[8]) {
+  for (int i = 0; i < 8; i++) {
+    out[i] = uint8_t(v >> (56 - 8 * i));
+  }
+}
+
+namespace {
+
+struct SubblockFit {
+  int table = 0;
+  // 2 bit pixel codes in ETC order: +small, +large, -small, -large
+  int codes[8] = {};
+  int error = INT_MAX;
+};
+
+/*!
+ * Picks the modifier table and per pixel modifiers for one half of a block given its base color.
+ */
+SubblockFit fitSubblock(const int base[3], const uint8_t* pixels[8]) {
+  SubblockFit best;
+  for (int t = 0; t < 8; t++) {
+    const int modifiers[4] = {kColorModifiers[t][0], kColorModifiers[t][1], -kColorModifiers[t][0],
+                              -kColorModifiers[t][1]};
+    SubblockFit fit;
+    fit.table = t;
+    fit.error = 0;
+    for (int p = 0; p < 8 && fit.error < best.error; p++) {
+      int bestPixelError = INT_MAX;
+      for (int c = 0; c < 4; c++) {
+        int error = 0;
+        for (int ch = 0; ch < 3; ch++) {
+          int d = clamp255(base[ch] + modifiers[c]) - pixels[p][ch];
+          error += d * d;
+        }
+        if (error < bestPixelError) {
+          bestPixelError = error;
+          fit.codes[p] = c;
+        }
+      }
+      fit.error += bestPixelError;
+    }
+    if (fit.error < best.error) {
+      best = fit;
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+void encodeEtc2ColorBlock(const uint8_t rgba[16 * 4], uint8_t out[8]) {
+  uint64_t bestBlock = 0;
+  int bestError = INT_MAX;
+
+  for (int flip = 0; flip < 2; flip++) {
+    // ETC numbers pixels down columns: pixel i is at x = i / 4, y = i % 4
+    const uint8_t* halves[2][8];
+    int pixelIndex[2][8];
+    int count[2] = {0, 0};
+    for (int i = 0; i < 16; i++) {
+      int x = i / 4;
+      int y = i % 4;
+      int half = flip ? (y >= 2) : (x >= 2);
+      halves[half][count[half]] = &rgba[(y * 4 + x) * 4];
+      pixelIndex[half][count[half]] = i;
+      count[half]++;
+    }
+
+    float average[2][3];
+    for (int h = 0; h < 2; h++) {
+      for (int ch = 0; ch < 3; ch++) {
+        int sum = 0;
+        for (int p = 0; p < 8; p++) {
+          sum += halves[h][p][ch];
+        }
+        average[h][ch] = sum / 8.f;
+      }
+    }
+
+    // Differential mode: 5 bit colors, the second stored as a 3 bit delta from the first
+    int q5[2][3];
+    bool differential = true;
+    for (int ch = 0; ch < 3; ch++) {
+      q5[0][ch] = int(lround(average[0][ch] * 31.f / 255.f));
+      q5[1][ch] = int(lround(average[1][ch] * 31.f / 255.f));
+      int delta = q5[1][ch] - q5[0][ch];
+      differential = differential && delta >= -4 && delta <= 3;
+    }
+    // Individual mode: 4 bit colors
+    int q4[2][3];
+    for (int h = 0; h < 2; h++) {
+      for (int ch = 0; ch < 3; ch++) {
+        q4[h][ch] = int(lround(average[h][ch] * 15.f / 255.f));
+      }
+    }
+
+    for (int mode = 0; mode < 2; mode++) {
+      bool diffMode = mode == 1;
+      if (diffMode && !differential) {
+        continue;
+      }
+      SubblockFit fits[2];
+      int error = 0;
+      for (int h = 0; h < 2; h++) {
+        int base[3];
+        for (int ch = 0; ch < 3; ch++) {
+          base[ch] = diffMode ? (q5[h][ch] << 3) | (q5[h][ch] >> 2) : q4[h][ch] * 17;
+        }
+        fits[h] = fitSubblock(base, halves[h]);
+        error += fits[h].error;
+      }
+      if (error >= bestError) {
+        continue;
+      }
+
+      uint64_t block = 0;
+      if (diffMode) {
+        for (int ch = 0; ch < 3; ch++) {
+          int shift = 59 - ch * 8;
+          block |= uint64_t(q5[0][ch]) << shift;
+          block |= uint64_t((q5[1][ch] - q5[0][ch]) & 7) << (shift - 3);
+        }
+        block |= uint64_t(1) << 33;
+      } else {
+        for (int ch = 0; ch < 3; ch++) {
+          int shift = 60 - ch * 8;
+          block |= uint64_t(q4[0][ch]) << shift;
+          block |= uint64_t(q4[1][ch]) << (shift - 4);
+        }
+      }
+      block |= uint64_t(fits[0].table) << 37;
+      block |= uint64_t(fits[1].table) << 34;
+      block |= uint64_t(flip) << 32;
+      for (int h = 0; h < 2; h++) {
+        for (int p = 0; p < 8; p++) {
+          int i = pixelIndex[h][p];
+          int code = fits[h].codes[p];
+          block |= uint64_t(code >> 1) << (16 + i);
+          block |= uint64_t(code & 1) << i;
+        }
+      }
+      bestBlock = block;
+      bestError = error;
+    }
+  }
+  writeBigEndian64(bestBlock, out);
+}
+
+void encodeEacAlphaBlock(const uint8_t rgba[16 * 4], uint8_t out[8]) {
+  int alpha[16];
+  int minAlpha = 255;
+  int maxAlpha = 0;
+  for (int i = 0; i < 16; i++) {
+    // in pixel order, down the columns
+    alpha[i] = rgba[((i % 4) * 4 + i / 4) * 4 + 3];
+    minAlpha = min(minAlpha, alpha[i]);
+    maxAlpha = max(maxAlpha, alpha[i]);
+  }
+
+  uint64_t bestBlock = 0;
+  if (minAlpha == maxAlpha) {
+    // table 13 has a zero modifier at index 4
+    bestBlock = (uint64_t(minAlpha) << 56) | (uint64_t(1) << 52) | (uint64_t(13) << 48);
+    for (int i = 0; i < 16; i++) {
+      bestBlock |= uint64_t(4) << (45 - 3 * i);
+    }
+    writeBigEndian64(bestBlock, out);
+    return;
+  }
+
+  int bestError = INT_MAX;
+  for (int t = 0; t < 16 && bestError > 0; t++) {
+    const int* modifiers = kAlphaModifiers[t];
+    int span = modifiers[7] - modifiers[3];
+    // the smallest multipliers whose range covers the block, and one more
+    int firstMultiplier = clamp((maxAlpha - minAlpha + span - 1) / span, 1, 15);
+    for (int m = firstMultiplier; m <= min(firstMultiplier + 1, 15); m++) {
+      int centered = (minAlpha + maxAlpha) / 2 - (modifiers[7] + modifiers[3]) * m / 2;
+      for (int base = max(0, centered - 2); base <= min(255, centered + 2); base++) {
+        uint64_t block = (uint64_t(base) << 56) | (uint64_t(m) << 52) | (uint64_t(t) << 48);
+        int error = 0;
+        for (int i = 0; i < 16 && error < bestError; i++) {
+          int bestPixelError = INT_MAX;
+          int bestIndex = 0;
+          for (int k = 0; k < 8; k++) {
+            int d = clamp255(base + modifiers[k] * m) - alpha[i];
+            if (d * d < bestPixelError) {
+              bestPixelError = d * d;
+              bestIndex = k;
+            }
+          }
+          error += bestPixelError;
+          block |= uint64_t(bestIndex) << (45 - 3 * i);
+        }
+        if (error < bestError) {
+          bestError = error;
+          bestBlock = block;
+        }
+      }
+    }
+  }
+  writeBigEndian64(bestBlock, out);
+}
@@ -0,0 +1,19 @@
+#ifndef KTX2CONV_ETC2_H
+#define KTX2CONV_ETC2_H
+
+#include <cstdint>
+
+/*!
+ * Encodes a 4x4 block of RGBA8 pixels, rows top to bottom, as an ETC2 RGB block. Only the
+ * individual and differential modes shared with ETC1 are used, which is fast and good enough for
+ * our assets; the T, H and planar modes are never emitted.
+ */
+void encodeEtc2ColorBlock(const uint8_t rgba[16 * 4], uint8_t out[8]);
+
+/*!
+ * Encodes the alpha of a 4x4 block of RGBA8 pixels as an EAC block. Together with a color block
+ * this makes an ETC2 RGBA8 block, alpha first.
+ */
+void encodeEacAlphaBlock(const uint8_t rgba[16 * 4], uint8_t out[8]);
+
+#endif  // KTX2CONV_ETC2_H
@@ -0,0 +1,205 @@
+#include "Png.h"
+
+#include <zlib.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static uint32_t readBigEndian32(const uint8_t* p) {
+  return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+}
+
+static uint8_t paeth(int a, int b, int c) {
+  int p = a + b - c;
+  int pa = abs(p - a);
+  int pb = abs(p - b);
+  int pc = abs(p - c);
+  if (pa <= pb && pa <= pc) {
+    return uint8_t(a);
+  }
+  return uint8_t(pb <= pc ? b : c);
+}
+
+bool Image::hasAlpha() const {
+  for (size_t i = 3; i < pixels.size(); i += 4) {
+    if (pixels[i] != 255) {
+      return true;
+    }
+  }
+  return false;
+}
+
+bool loadPng(const std::string& path, Image& out, std::string& error) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) {
+    error = "can't open " + path;
+    return false;
+  }
+  vector<uint8_t> file;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    file.insert(file.end(), buffer, buffer + n);
+  }
+  fclose(f);
+
+  static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (file.size() < 8 || memcmp(file.data(), signature, 8) != 0) {
+    error = "not a PNG file";
+    return false;
+  }
+
+  uint32_t width = 0;
+  uint32_t height = 0;
+  uint8_t bitDepth = 0;
+  uint8_t colorType = 0;
+  vector<uint8_t> palette;  // RGBA
+  vector<uint8_t> compressed;
+  for (size_t pos = 8; pos + 12 <= file.size();) {
+    uint32_t length = readBigEndian32(&file[pos]);
+    const uint8_t* type = &file[pos + 4];
+    const uint8_t* data = &file[pos + 8];
+    if (length > file.size() - pos - 12) {
+      error = "truncated chunk";
+      return false;
+    }
+    if (!memcmp(type, "IHDR", 4)) {
+      width = readBigEndian32(data);
+      height = readBigEndian32(data + 4);
+      bitDepth = data[8];
+      colorType = data[9];
+      if (data[12] != 0) {
+        error = "interlaced PNGs are not supported";
+        return false;
+      }
+    } else if (!memcmp(type, "PLTE", 4)) {
+      palette.assign((length / 3) * 4, 255);
+      for (uint32_t i = 0; i < length / 3; i++) {
+        memcpy(&palette[i * 4], data + i * 3, 3);
+      }
+    } else if (!memcmp(type, "tRNS", 4) && colorType == 3) {
+      for (uint32_t i = 0; i < length && i * 4 + 3 < palette.size(); i++) {
+        palette[i * 4 + 3] = data[i];
+      }
+    } else if (!memcmp(type, "IDAT", 4)) {
+      compressed.insert(compressed.end(), data, data + length);
+    } else if (!memcmp(type, "IEND", 4)) {
+      break;
+    }
+    pos += length + 12;
+  }
+
+  uint32_t channels = 0;
+  switch (colorType) {
+    case 0:
+      channels = 1;
+      break;
+    case 2:
+      channels = 3;
+      break;
+    case 3:
+      channels = 1;
+      break;
+    case 4:
+      channels = 2;
+      break;
+    case 6:
+      channels = 4;
+      break;
+    default:
+      error = "unknown color type";
+      return false;
+  }
+  if (width == 0 || height == 0 || (bitDepth != 8 && !(bitDepth == 16 && colorType != 3))) {
+    error = "unsupported size or bit depth";
+    return false;
+  }
+
+  uint32_t bytesPerPixel = channels * bitDepth / 8;
+  size_t rowBytes = size_t(width) * bytesPerPixel;
+  vector<uint8_t> raw((rowBytes + 1) * height);
+  uLongf rawSize = raw.size();
+  if (uncompress(raw.data(), &rawSize, compressed.data(), compressed.size()) != Z_OK || rawSize != raw.size()) {
+    error = "corrupt image data";
+    return false;
+  }
+
+  // undo the per-row filters in place
+  vector<uint8_t> zeroRow(rowBytes, 0);
+  for (uint32_t y = 0; y < height; y++) {
+    uint8_t filter = raw[y * (rowBytes + 1)];
+    uint8_t* row = &raw[y * (rowBytes + 1) + 1];
+    const uint8_t* prior = y ? &raw[(y - 1) * (rowBytes + 1) + 1] : zeroRow.data();
+    for (size_t i = 0; i < rowBytes; i++) {
+      int a = i >= bytesPerPixel ? row[i - bytesPerPixel] : 0;
+      int b = prior[i];
+      int c = i >= bytesPerPixel ? prior[i - bytesPerPixel] : 0;
+      switch (filter) {
+        case 0:
+          break;
+        case 1:
+          row[i] += a;
+          break;
+        case 2:
+          row[i] += b;
+          break;
+        case 3:
+          row[i] += (a + b) / 2;
+          break;
+        case 4:
+          row[i] += paeth(a, b, c);
+          break;
+        default:
+          error = "unknown row filter";
+          return false;
+      }
+    }
+  }
+
+  out.width = width;
+  out.height = height;
+  out.pixels.resize(size_t(width) * height * 4);
+  uint32_t sampleBytes = bitDepth / 8;
+  for (uint32_t y = 0; y < height; y++) {
+    const uint8_t* row = &raw[y * (rowBytes + 1) + 1];
+    for (uint32_t x = 0; x < width; x++) {
+      const uint8_t* p = row + x * bytesPerPixel;
+      // 16 bit samples are big endian, keep the high byte
+      auto sample = [p, sampleBytes](uint32_t c) { return p[c * sampleBytes]; };
+      uint8_t* dst = out.at(x, y);
+      switch (colorType) {
+        case 0:
+          dst[0] = dst[1] = dst[2] = sample(0);
+          dst[3] = 255;
+          break;
+        case 2:
+          dst[0] = sample(0);
+          dst[1] = sample(1);
+          dst[2] = sample(2);
+          dst[3] = 255;
+          break;
+        case 3:
+          if (size_t(p[0]) * 4 + 3 >= palette.size()) {
+            error = "palette index out of range";
+            return false;
+          }
+          memcpy(dst, &palette[p[0] * 4], 4);
+          break;
+        case 4:
+          dst[0] = dst[1] = dst[2] = sample(0);
+          dst[3] = sample(1);
+          break;
+        case 6:
+          dst[0] = sample(0);
+          dst[1] = sample(1);
+          dst[2] = sample(2);
+          dst[3] = sample(3);
+          break;
+      }
+    }
+  }
+  return true;
+}
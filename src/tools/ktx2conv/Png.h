@@ -0,0 +1,34 @@
+#ifndef KTX2CONV_PNG_H
+#define KTX2CONV_PNG_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+ * An 8 bit per channel RGBA image, rows top to bottom.
+ */
+struct Image {
+  uint32_t width = 0;
+  uint32_t height = 0;
+  std::vector<uint8_t> pixels;
+
+  uint8_t* at(uint32_t x, uint32_t y) {
+    return &pixels[(size_t(y) * width + x) * 4];
+  }
+
+  const uint8_t* at(uint32_t x, uint32_t y) const {
+    return &pixels[(size_t(y) * width + x) * 4];
+  }
+
+  bool hasAlpha() const;
+};
+
+/*!
+ * Reads a non-interlaced PNG of any color type at 8 or 16 bits per channel (palette and grayscale
+ * at 8) and expands it to RGBA8.
+ * @param error receives a description of the problem on failure
+ */
+bool loadPng(const std::string& path, Image& out, std::string& error);
+
+#endif  // KTX2CONV_PNG_H
@@ -0,0 +1,415 @@
+// Converts PNG images to ETC2 compressed KTX2 textures with a full mip chain, for
+// TextureAsset::loadAsset. Build and run on the host:
+//
+//   g++ -std=c++20 -O2 -I../../samples/Dreadful/app/src/main/cpp ktx2conv.cpp Png.cpp Etc2.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/Ktx2.cpp -lz -o ktx2conv
+//   ./ktx2conv ../../samples/Dreadful/app/src/main/assets/android_robot.png
+//              ../../samples/Dreadful/app/src/main/assets/android_robot.ktx2
+//
+// With --array, several images of the same size become the layers of one array texture, which
+// ModelBatch draws from with a layer per instance:
+//
+//   ./ktx2conv --array ../../samples/Dreadful/art/ui_icons/*.png
+//              ../../samples/Dreadful/app/src/main/assets/ui_icons.ktx2
+//
+// --self-test converts a small image and runs Ktx2Texture::parse on the result and on copies with
+// the header or level index changed so the levels no longer hold what it asks for. Each is printed
+// with what parse made of it; any that came out other than expected is marked WRONG RESULTS.
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "Etc2.h"
+#include "Ktx2.h"
+#include "Png.h"
+
+using namespace std;
+
+struct Options {
+  // color data is sRGB encoded, filter mips in linear light
+  bool srgb = true;
+  bool mips = true;
+  // color is multiplied by alpha, as the sample blends with GL_ONE, GL_ONE_MINUS_SRC_ALPHA
+  bool premultiply = true;
+  bool array = false;
+  vector<string> inputs;
+  string output;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: ktx2conv [--linear] [--no-mips] [--straight-alpha] input.png output.ktx2\n"
+          "       ktx2conv [--linear] [--no-mips] [--straight-alpha] --array layer0.png layer1.png ... output.ktx2\n"
+          "       ktx2conv --self-test\n"
+          "  --linear          the image holds linear data (e.g. normals), not sRGB color\n"
+          "  --no-mips         store only the base level\n"
+          "  --straight-alpha  don't premultiply color by alpha\n"
+          "  --array           pack same sized images into the layers of a 2D array texture\n"
+          "  --self-test       check that the texture loader refuses malformed files, and takes ours\n"
+          "Images with any alpha below 255 become ETC2 RGBA8, opaque ones ETC2 RGB8.\n");
+}
+
+static float srgbToLinear(uint8_t v) {
+  float c = v / 255.f;
+  return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+static uint8_t linearToSrgb(float c) {
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.f / 2.4f) - 0.055f;
+  return uint8_t(lroundf(fminf(fmaxf(c, 0.f), 1.f) * 255.f));
+}
+
+/*!
+ * Multiplies color by alpha, in linear light for sRGB images.
+ */
+static void premultiply(Image& image, bool srgb) {
+  for (size_t i = 0; i < image.pixels.size(); i += 4) {
+    uint8_t* p = &image.pixels[i];
+    float alpha = p[3] / 255.f;
+    for (int c = 0; c < 3; c++) {
+      p[c] = srgb ? linearToSrgb(srgbToLinear(p[c]) * alpha) : uint8_t(lroundf(p[c] * alpha));
+    }
+  }
+}
+
+/*!
+ * Halves an image with a box filter. Odd edges repeat their last row or column.
+ */
+static Image downsample(const Image& src, bool srgb) {
+  static float toLinear[256];
+  static bool tableReady = false;
+  if (!tableReady) {
+    for (int i = 0; i < 256; i++) {
+      toLinear[i] = srgbToLinear(uint8_t(i));
+    }
+    tableReady = true;
+  }
+
+  Image dst;
+  dst.width = max(1u, src.width / 2);
+  dst.height = max(1u, src.height / 2);
+  dst.pixels.resize(size_t(dst.width) * dst.height * 4);
+  for (uint32_t y = 0; y < dst.height; y++) {
+    for (uint32_t x = 0; x < dst.width; x++) {
+      uint32_t x0 = min(x * 2, src.width - 1);
+      uint32_t x1 = min(x * 2 + 1, src.width - 1);
+      uint32_t y0 = min(y * 2, src.height - 1);
+      uint32_t y1 = min(y * 2 + 1, src.height - 1);
+      const uint8_t* p[4] = {src.at(x0, y0), src.at(x1, y0), src.at(x0, y1), src.at(x1, y1)};
+      uint8_t* out = dst.at(x, y);
+      for (int c = 0; c < 4; c++) {
+        if (srgb && c < 3) {
+          float sum = toLinear[p[0][c]] + toLinear[p[1][c]] + toLinear[p[2][c]] + toLinear[p[3][c]];
+          out[c] = linearToSrgb(sum / 4.f);
+        } else {
+          out[c] = uint8_t((p[0][c] + p[1][c] + p[2][c] + p[3][c] + 2) / 4);
+        }
+      }
+    }
+  }
+  return dst;
+}
+
+/*!
+ * Compresses one level. Blocks hanging over the edge repeat the last row and column.
+ */
+static vector<uint8_t> compress(const Image& image, bool alpha) {
+  uint32_t blocksX = (image.width + 3) / 4;
+  uint32_t blocksY = (image.height + 3) / 4;
+  size_t blockBytes = alpha ? 16 : 8;
+  vector<uint8_t> out(blocksX * blocksY * blockBytes);
+  uint8_t pixels[16 * 4];
+  for (uint32_t by = 0; by < blocksY; by++) {
+    for (uint32_t bx = 0; bx < blocksX; bx++) {
+      for (uint32_t y = 0; y < 4; y++) {
+        for (uint32_t x = 0; x < 4; x++) {
+          uint32_t sx = min(bx * 4 + x, image.width - 1);
+          uint32_t sy = min(by * 4 + y, image.height - 1);
+          memcpy(&pixels[(y * 4 + x) * 4], image.at(sx, sy), 4);
+        }
+      }
+      uint8_t* block = &out[(by * blocksX + bx) * blockBytes];
+      if (alpha) {
+        encodeEacAlphaBlock(pixels, block);
+        block += 8;
+      }
+      encodeEtc2ColorBlock(pixels, block);
+    }
+  }
+  return out;
+}
+
+static void append32(vector<uint8_t>& v, uint32_t value) {
+  for (int i = 0; i < 4; i++) {
+    v.push_back(uint8_t(value >> (8 * i)));
+  }
+}
+
+/*!
+ * A basic data format descriptor for ETC2 with one sample per 64 bit half of the block.
+ */
+static vector<uint8_t> makeDfd(bool alpha, bool srgb, bool premultiplied) {
+  uint32_t sampleCount = alpha ? 2 : 1;
+  uint32_t blockSize = 24 + 16 * sampleCount;
+  vector<uint8_t> dfd;
+  append32(dfd, 4 + blockSize);
+  append32(dfd, 0);                 // vendor Khronos, basic descriptor
+  append32(dfd, 2 | blockSize << 16);  // version 2
+  uint32_t flags = premultiplied ? kKhrDfFlagAlphaPremultiplied : 0;
+  append32(dfd, kKhrDfModelEtc2 | kKhrDfPrimariesBt709 << 8 | (srgb ? kKhrDfTransferSrgb : kKhrDfTransferLinear) << 16 |
+                    flags << 24);
+  append32(dfd, 3 | 3 << 8);        // 4x4 texel blocks
+  append32(dfd, alpha ? 16 : 8);    // bytes per block
+  append32(dfd, 0);
+  for (uint32_t s = 0; s < sampleCount; s++) {
+    bool alphaSample = alpha && s == 0;
+    uint32_t bitOffset = s * 64;
+    append32(dfd, bitOffset | 63 << 16 | (alphaSample ? kKhrDfChannelEtc2Alpha : kKhrDfChannelEtc2Color) << 24);
+    append32(dfd, 0);
+    append32(dfd, 0);
+    append32(dfd, 0xFFFFFFFF);
+  }
+  return dfd;
+}
+
+//! A converted texture and what went into it
+struct Ktx2File {
+  vector<uint8_t> bytes;
+  bool alpha = false;
+  bool premultiplied = false;
+  size_t levelCount = 0;
+  size_t uncompressedBytes = 0;
+};
+
+/*!
+ * Compresses images, all the same size, into the layers of a KTX2 file, with a full mip chain unless
+ * options.mips is false.
+ */
+static Ktx2File convert(vector<Image> images, const Options& options) {
+  Ktx2File file;
+  for (const auto& layer : images) {
+    // one format for every layer, so any translucent layer makes them all RGBA8
+    file.alpha = file.alpha || layer.hasAlpha();
+  }
+  bool alpha = file.alpha;
+  uint32_t width = images[0].width;
+  uint32_t height = images[0].height;
+  // opaque images are the same either way, and only get the flag if they have alpha
+  file.premultiplied = alpha && options.premultiply;
+  if (file.premultiplied) {
+    for (auto& layer : images) {
+      premultiply(layer, options.srgb);
+    }
+  }
+
+  // Each level holds that level of every layer, one after the other
+  vector<vector<uint8_t>> levels;
+  for (;;) {
+    levels.emplace_back();
+    for (const auto& layer : images) {
+      auto data = compress(layer, alpha);
+      levels.back().insert(levels.back().end(), data.begin(), data.end());
+      file.uncompressedBytes += size_t(layer.width) * layer.height * 4;
+    }
+    if (!options.mips || (images[0].width == 1 && images[0].height == 1)) {
+      break;
+    }
+    for (auto& layer : images) {
+      layer = downsample(layer, options.srgb);
+    }
+  }
+  file.levelCount = levels.size();
+
+  uint32_t vkFormat = alpha ? (options.srgb ? kVkFormatEtc2R8G8B8A8SrgbBlock : kVkFormatEtc2R8G8B8A8UnormBlock)
+                            : (options.srgb ? kVkFormatEtc2R8G8B8SrgbBlock : kVkFormatEtc2R8G8B8UnormBlock);
+  vector<uint8_t> dfd = makeDfd(alpha, options.srgb, file.premultiplied);
+
+  // key/value data: just the writer, padded to 4 bytes
+  static const char writerKey[] = "KTXwriter";
+  static const char writerValue[] = "ktx2conv";
+  vector<uint8_t> kvd;
+  append32(kvd, sizeof(writerKey) + sizeof(writerValue));
+  kvd.insert(kvd.end(), writerKey, writerKey + sizeof(writerKey));
+  kvd.insert(kvd.end(), writerValue, writerValue + sizeof(writerValue));
+  while (kvd.size() % 4) {
+    kvd.push_back(0);
+  }
+
+  Ktx2Header header{};
+  memcpy(header.identifier, kKtx2Identifier, sizeof(kKtx2Identifier));
+  header.vkFormat = vkFormat;
+  header.typeSize = 1;
+  header.pixelWidth = width;
+  header.pixelHeight = height;
+  header.layerCount = options.array ? uint32_t(images.size()) : 0;
+  header.faceCount = 1;
+  header.levelCount = uint32_t(levels.size());
+  header.supercompressionScheme = kKtx2SupercompressionNone;
+
+  size_t offset = sizeof(Ktx2Header) + levels.size() * sizeof(Ktx2Level);
+  header.dfdByteOffset = uint32_t(offset);
+  header.dfdByteLength = uint32_t(dfd.size());
+  offset += dfd.size();
+  header.kvdByteOffset = uint32_t(offset);
+  header.kvdByteLength = uint32_t(kvd.size());
+  offset += kvd.size();
+
+  // Level data is stored smallest first, each aligned to the block size
+  size_t alignment = alpha ? 16 : 8;
+  vector<Ktx2Level> index(levels.size());
+  for (size_t l = levels.size(); l-- > 0;) {
+    offset = (offset + alignment - 1) / alignment * alignment;
+    index[l] = {offset, levels[l].size(), levels[l].size()};
+    offset += levels[l].size();
+  }
+
+  auto& bytes = file.bytes;
+  auto write = [&bytes](const void* data, size_t size) {
+    bytes.insert(bytes.end(), static_cast<const uint8_t*>(data), static_cast<const uint8_t*>(data) + size);
+  };
+  write(&header, sizeof(header));
+  write(index.data(), index.size() * sizeof(Ktx2Level));
+  write(dfd.data(), dfd.size());
+  write(kvd.data(), kvd.size());
+  for (size_t l = levels.size(); l-- > 0;) {
+    bytes.resize(index[l].byteOffset);
+    write(levels[l].data(), levels[l].size());
+  }
+  return file;
+}
+
+/*!
+ * Checks that Ktx2Texture::parse takes what convert writes and refuses files whose levels hold
+ * more or less data than their header asks for, which the loaders would read past.
+ * @return true if every case came out as expected
+ */
+static bool selfTest() {
+  // 13x7, so the levels end in partial blocks and 1 pixel rows, with an opaque and a translucent
+  // layer
+  Image layers[2];
+  for (int l = 0; l < 2; l++) {
+    layers[l].width = 13;
+    layers[l].height = 7;
+    layers[l].pixels.resize(13 * 7 * 4);
+    for (size_t i = 0; i < layers[l].pixels.size(); i++) {
+      layers[l].pixels[i] = i % 4 == 3 ? uint8_t(l ? i * 3 : 255) : uint8_t(i * 7);
+    }
+  }
+  Options single;
+  Ktx2File opaque = convert({layers[0]}, single);
+  Options array;
+  array.array = true;
+  Ktx2File translucent = convert({layers[0], layers[1]}, array);
+
+  static const char* kWrongSize = "level size doesn't match the format and dimensions";
+  struct Case {
+    const char* name;
+    const Ktx2File& file;
+    // changes the copy of the file before it's parsed
+    function<void(Ktx2Header&, Ktx2Level*)> corrupt;
+    // nullptr if parse should succeed
+    const char* error;
+  };
+  const Case cases[] = {
+      {"RGB8 with mips", opaque, [](Ktx2Header&, Ktx2Level*) {}, nullptr},
+      {"RGBA8 array with mips", translucent, [](Ktx2Header&, Ktx2Level*) {}, nullptr},
+      {"level 0 a block short", opaque, [](Ktx2Header&, Ktx2Level* levels) { levels[0].byteLength -= 8; }, kWrongSize},
+      {"last level a block long", translucent,
+       [](Ktx2Header& header, Ktx2Level* levels) { levels[header.levelCount - 1].byteLength += 16; }, kWrongSize},
+      {"width doubled", opaque, [](Ktx2Header& header, Ktx2Level*) { header.pixelWidth *= 2; }, kWrongSize},
+      {"a layer more", translucent, [](Ktx2Header& header, Ktx2Level*) { header.layerCount++; }, kWrongSize},
+      {"RGB8 labelled RGBA8", opaque,
+       [](Ktx2Header& header, Ktx2Level*) { header.vkFormat = kVkFormatEtc2R8G8B8A8SrgbBlock; }, kWrongSize},
+      {"ETC2 labelled RGBA8 to mip", opaque,
+       [](Ktx2Header& header, Ktx2Level*) {
+         header.vkFormat = kVkFormatR8G8B8A8Srgb;
+         header.levelCount = 0;
+       },
+       kWrongSize},
+      {"RGB8 labelled ASTC 12x12", opaque,
+       [](Ktx2Header& header, Ktx2Level*) { header.vkFormat = kVkFormatAstc12x12SrgbBlock; }, kWrongSize},
+      {"unknown vkFormat", opaque, [](Ktx2Header& header, Ktx2Level*) { header.vkFormat = 1; }, "unsupported vkFormat"},
+  };
+
+  printf("case                        result\n");
+  bool allCorrect = true;
+  for (const auto& c : cases) {
+    vector<uint8_t> bytes = c.file.bytes;
+    auto* header = reinterpret_cast<Ktx2Header*>(bytes.data());
+    c.corrupt(*header, reinterpret_cast<Ktx2Level*>(bytes.data() + sizeof(Ktx2Header)));
+    Ktx2Texture texture;
+    const char* error = nullptr;
+    bool parsed = Ktx2Texture::parse(bytes.data(), bytes.size(), texture, &error);
+    bool correct = c.error ? !parsed && !strcmp(error, c.error) : parsed;
+    printf("%-26s  %s%s\n", c.name, parsed ? "parsed" : error, correct ? "" : "  WRONG RESULTS");
+    allCorrect = allCorrect && correct;
+  }
+  return allCorrect;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--linear")) {
+      options.srgb = false;
+    } else if (!strcmp(argv[i], "--no-mips")) {
+      options.mips = false;
+    } else if (!strcmp(argv[i], "--straight-alpha")) {
+      options.premultiply = false;
+    } else if (!strcmp(argv[i], "--array")) {
+      options.array = true;
+    } else if (!strcmp(argv[i], "--self-test") && argc == 2) {
+      return selfTest() ? 0 : 1;
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    } else {
+      options.inputs.push_back(argv[i]);
+    }
+  }
+  // the last name is the output
+  if (options.inputs.size() >= 2) {
+    options.output = options.inputs.back();
+    options.inputs.pop_back();
+  }
+  if (options.output.empty() || (!options.array && options.inputs.size() != 1)) {
+    usage();
+    return 1;
+  }
+
+  vector<Image> images(options.inputs.size());
+  for (size_t i = 0; i < images.size(); i++) {
+    string error;
+    if (!loadPng(options.inputs[i], images[i], error)) {
+      fprintf(stderr, "ktx2conv: %s: %s\n", options.inputs[i].c_str(), error.c_str());
+      return 1;
+    }
+    if (images[i].width != images[0].width || images[i].height != images[0].height) {
+      fprintf(stderr, "ktx2conv: %s is %ux%u, array layers must all be %ux%u\n", options.inputs[i].c_str(),
+              images[i].width, images[i].height, images[0].width, images[0].height);
+      return 1;
+    }
+  }
+  uint32_t width = images[0].width;
+  uint32_t height = images[0].height;
+  size_t layerCount = images.size();
+  Ktx2File file = convert(move(images), options);
+
+  FILE* f = fopen(options.output.c_str(), "wb");
+  if (!f) {
+    fprintf(stderr, "ktx2conv: can't write %s\n", options.output.c_str());
+    return 1;
+  }
+  fwrite(file.bytes.data(), 1, file.bytes.size(), f);
+  fclose(f);
+
+  printf("%s: %ux%u, %zu layers, %zu levels, %s %s%s, %zu bytes (%zu as RGBA8, %.1fx smaller)\n", options.output.c_str(),
+         width, height, layerCount, file.levelCount, file.alpha ? "ETC2 RGBA8" : "ETC2 RGB8",
+         options.srgb ? "sRGB" : "linear", file.premultiplied ? " premultiplied" : "", file.bytes.size(),
+         file.uncompressedBytes, double(file.uncompressedBytes) / file.bytes.size());
+  return 0;
+}
@@ -0,0 +1,988 @@
+// Converts Wavefront OBJ meshes to .dmesh files for Mesh::loadAsset, with vertices and indices
+// already in the layout the GL buffers take. Build and run on the host:
+//
+//   g++ -std=c++20 -O2 -I../../samples/Dreadful/app/src/main/cpp meshconv.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/MeshFile.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/MeshOptimizer.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/VertexFormat.cpp -o meshconv
+//   ./meshconv ../../samples/Dreadful/art/meshes/square.obj
+//              ../../samples/Dreadful/app/src/main/assets/square.dmesh
+//
+// --grid N writes a generated terrain of 2 * N * N triangles instead, for load benchmarks:
+//
+//   ./meshconv --grid 1024 ../../samples/Dreadful/app/src/main/assets/benchmark.dmesh
+//
+// Triangles and vertices are reordered for the GPU's caches unless --no-optimize is given, and the
+// cache efficiency before and after is printed. --test-optimizer times every MeshOptimizer pass on
+// a shuffled grid, checks what each does and writes nothing.
+//
+// Vertices are quantized by default: --position float|half|snorm16 and --uv float|half|unorm16
+// pick the storage (snorm16 and unorm16 unless given). Normals are kept, octahedral encoded, when
+// the source has them and --no-normals isn't given; --tangents adds tangents generated from the
+// uvs. Every vertex is decoded again and checked against the format's error bounds.
+// --test-formats runs the same check over random vertices in every format and writes nothing.
+//
+// --lods N adds up to N coarser levels of detail to every submesh, each with --lod-ratio (0.5) of
+// the triangles of the one before, see MeshOptimizer::simplify. Levels stop early once the
+// simplifier can't take off another tenth of the triangles without tearing the outline.
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MeshFile.h"
+#include "MeshOptimizer.h"
+
+using namespace std;
+
+//! Vertices are built as floats and encoded in the output's format when written
+using Vertex = VertexAttributes;
+
+struct Material {
+  string name;
+  string texture;
+  float baseColor[4] = {1, 1, 1, 1};
+};
+
+//! A triangle corner, as indices into the position, uv and normal lists
+struct Corner {
+  uint32_t position;
+  uint32_t uv;
+  // ~0u if the face has no normals
+  uint32_t normal;
+
+  bool operator==(const Corner&) const = default;
+};
+
+struct CornerHash {
+  size_t operator()(const Corner& c) const {
+    return hash<uint64_t>()(uint64_t(c.position) << 32 | c.uv) ^ hash<uint32_t>()(c.normal) * 31;
+  }
+};
+
+//! What's read from the source, triangles grouped by material
+struct Source {
+  vector<array<float, 3>> positions;
+  vector<array<float, 2>> uvs;
+  vector<array<float, 3>> normals;
+  vector<Material> materials;
+  // per material, plus a last group for faces without one
+  vector<vector<Corner>> groups;
+};
+
+struct Output {
+  vector<Vertex> vertices;
+  vector<uint16_t> indices;
+  vector<MeshFileSubmesh> submeshes;
+  // every submesh's levels of detail, in submesh order
+  vector<MeshFileLod> lods;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: meshconv [options] input.obj output.dmesh\n"
+          "       meshconv [options] --grid N output.dmesh\n"
+          "options: --no-optimize, --position float|half|snorm16, --uv float|half|unorm16,\n"
+          "         --no-normals, --tangents, --lods N, --lod-ratio R\n"
+          "       meshconv --test-formats\n"
+          "       meshconv --test-optimizer\n");
+}
+
+static bool readMtl(const filesystem::path& path, Source& source, string& error) {
+  ifstream file(path);
+  if (!file) {
+    error = "can't read " + path.string();
+    return false;
+  }
+  string line;
+  while (getline(file, line)) {
+    istringstream in(line);
+    string keyword;
+    in >> keyword;
+    if (keyword == "newmtl") {
+      source.materials.emplace_back();
+      in >> source.materials.back().name;
+    } else if (source.materials.empty()) {
+      continue;
+    } else if (keyword == "map_Kd") {
+      // options come first, the path last
+      string word;
+      while (in >> word) {
+        source.materials.back().texture = word;
+      }
+    } else if (keyword == "Kd") {
+      auto& color = source.materials.back().baseColor;
+      in >> color[0] >> color[1] >> color[2];
+    } else if (keyword == "d") {
+      in >> source.materials.back().baseColor[3];
+    }
+  }
+  return true;
+}
+
+static bool readObj(const filesystem::path& path, Source& source, string& error) {
+  ifstream file(path);
+  if (!file) {
+    error = "can't read " + path.string();
+    return false;
+  }
+  // Groups are keyed by material name, which can be used before the library defining it is read
+  vector<string> groupNames = {""};
+  source.groups.resize(1);
+  size_t group = 0;
+
+  string line;
+  for (size_t lineNumber = 1; getline(file, line); lineNumber++) {
+    istringstream in(line);
+    string keyword;
+    in >> keyword;
+    if (keyword == "v") {
+      array<float, 3> p{};
+      in >> p[0] >> p[1] >> p[2];
+      source.positions.push_back(p);
+    } else if (keyword == "vt") {
+      array<float, 2> t{};
+      in >> t[0] >> t[1];
+      // OBJ puts v = 0 at the bottom of the image, GL at the first row uploaded, which is the top
+      t[1] = 1 - t[1];
+      source.uvs.push_back(t);
+    } else if (keyword == "vn") {
+      array<float, 3> n{};
+      in >> n[0] >> n[1] >> n[2];
+      float length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+      for (auto& c : n) {
+        c = length > 0 ? c / length : 0;
+      }
+      source.normals.push_back(n);
+    } else if (keyword == "usemtl") {
+      string name;
+      in >> name;
+      auto it = find(groupNames.begin(), groupNames.end(), name);
+      group = size_t(it - groupNames.begin());
+      if (it == groupNames.end()) {
+        groupNames.push_back(name);
+        source.groups.emplace_back();
+      }
+    } else if (keyword == "mtllib") {
+      string name;
+      in >> name;
+      if (!readMtl(path.parent_path() / name, source, error)) {
+        return false;
+      }
+    } else if (keyword == "f") {
+      // v, v/vt, v//vn or v/vt/vn, 1 based or negative from the end; polygons become fans
+      vector<Corner> polygon;
+      string word;
+      while (in >> word) {
+        long p = strtol(word.c_str(), nullptr, 10);
+        size_t slash = word.find('/');
+        long t = slash == string::npos ? 0 : strtol(word.c_str() + slash + 1, nullptr, 10);
+        size_t secondSlash = slash == string::npos ? string::npos : word.find('/', slash + 1);
+        long n = secondSlash == string::npos ? 0 : strtol(word.c_str() + secondSlash + 1, nullptr, 10);
+        p = p < 0 ? long(source.positions.size()) + p : p - 1;
+        t = t < 0 ? long(source.uvs.size()) + t : t - 1;
+        n = n < 0 ? long(source.normals.size()) + n : n - 1;
+        if (p < 0 || p >= long(source.positions.size()) || t >= long(source.uvs.size()) ||
+            n >= long(source.normals.size())) {
+          error = "bad face on line " + to_string(lineNumber);
+          return false;
+        }
+        // no uv reads as uv 0, added on demand below
+        polygon.push_back({uint32_t(p), t < 0 ? ~0u : uint32_t(t), n < 0 ? ~0u : uint32_t(n)});
+      }
+      for (size_t i = 2; i < polygon.size(); i++) {
+        source.groups[group].insert(source.groups[group].end(), {polygon[0], polygon[i - 1], polygon[i]});
+      }
+    }
+  }
+
+  uint32_t zeroUv = uint32_t(source.uvs.size());
+  for (auto& corners : source.groups) {
+    for (auto& corner : corners) {
+      if (corner.uv == ~0u) {
+        corner.uv = zeroUv;
+      }
+    }
+  }
+  source.uvs.push_back({0, 0});
+
+  // Put the groups in material order, the unnamed one last
+  vector<vector<Corner>> groups(source.materials.size() + 1);
+  for (size_t g = 0; g < groupNames.size(); g++) {
+    auto it = find_if(source.materials.begin(), source.materials.end(),
+                      [&](const Material& m) { return m.name == groupNames[g]; });
+    if (it == source.materials.end() && !groupNames[g].empty()) {
+      fprintf(stderr, "meshconv: material %s isn't defined, its faces get none\n", groupNames[g].c_str());
+    }
+    auto& target = groups[size_t(it - source.materials.begin())];
+    target.insert(target.end(), source.groups[g].begin(), source.groups[g].end());
+  }
+  source.groups = std::move(groups);
+  return true;
+}
+
+static void makeGrid(uint32_t n, Source& source) {
+  for (uint32_t y = 0; y <= n; y++) {
+    for (uint32_t x = 0; x <= n; x++) {
+      float u = float(x) / n;
+      float v = float(y) / n;
+      float height = 0.1f * sinf(u * 12.f) * cosf(v * 9.f);
+      source.positions.push_back({u * 2 - 1, v * 2 - 1, height});
+      source.uvs.push_back({u, 1 - v});
+    }
+  }
+  Material material;
+  material.name = "grid";
+  material.texture = "android_robot.ktx2";
+  source.materials.push_back(material);
+  source.groups.resize(2);
+  auto& corners = source.groups[0];
+  corners.reserve(size_t(n) * n * 6);
+  for (uint32_t y = 0; y < n; y++) {
+    for (uint32_t x = 0; x < n; x++) {
+      uint32_t i = y * (n + 1) + x;
+      uint32_t j = i + n + 1;
+      for (uint32_t k : {i, i + 1, j + 1, i, j + 1, j}) {
+        corners.push_back({k, k, ~0u});
+      }
+    }
+  }
+}
+
+/*!
+ * Sets the bounds of a submesh from its vertices, the sphere centered on the box.
+ */
+static void setBounds(const Vertex* vertices, size_t count, float center[3], float& radius, float boundsMin[3],
+                      float boundsMax[3]) {
+  for (int c = 0; c < 3; c++) {
+    boundsMin[c] = count ? vertices[0].position[c] : 0;
+    boundsMax[c] = boundsMin[c];
+  }
+  for (size_t i = 0; i < count; i++) {
+    for (int c = 0; c < 3; c++) {
+      boundsMin[c] = min(boundsMin[c], vertices[i].position[c]);
+      boundsMax[c] = max(boundsMax[c], vertices[i].position[c]);
+    }
+  }
+  for (int c = 0; c < 3; c++) {
+    center[c] = (boundsMin[c] + boundsMax[c]) / 2;
+  }
+  float radiusSquared = 0;
+  for (size_t i = 0; i < count; i++) {
+    float d[3];
+    for (int c = 0; c < 3; c++) {
+      d[c] = vertices[i].position[c] - center[c];
+    }
+    radiusSquared = max(radiusSquared, d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+  }
+  radius = sqrt(radiusSquared);
+}
+
+/*!
+ * Sets each vertex's tangent from the uv gradients of its triangles, made perpendicular to its
+ * normal, and the sign that gives the bitangent's direction.
+ */
+static void generateTangents(vector<Vertex>& vertices, const vector<uint32_t>& indices) {
+  vector<array<float, 3>> tangents(vertices.size(), array<float, 3>{});
+  vector<array<float, 3>> bitangents(vertices.size(), array<float, 3>{});
+  for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+    const Vertex* v[3] = {&vertices[indices[i]], &vertices[indices[i + 1]], &vertices[indices[i + 2]]};
+    float e1[3], e2[3];
+    for (int c = 0; c < 3; c++) {
+      e1[c] = v[1]->position[c] - v[0]->position[c];
+      e2[c] = v[2]->position[c] - v[0]->position[c];
+    }
+    float du1 = v[1]->uv[0] - v[0]->uv[0];
+    float dv1 = v[1]->uv[1] - v[0]->uv[1];
+    float du2 = v[2]->uv[0] - v[0]->uv[0];
+    float dv2 = v[2]->uv[1] - v[0]->uv[1];
+    float determinant = du1 * dv2 - du2 * dv1;
+    if (fabsf(determinant) < 1e-20f) {
+      continue;
+    }
+    for (int k = 0; k < 3; k++) {
+      for (int c = 0; c < 3; c++) {
+        tangents[indices[i + k]][c] += (e1[c] * dv2 - e2[c] * dv1) / determinant;
+        bitangents[indices[i + k]][c] += (e2[c] * du1 - e1[c] * du2) / determinant;
+      }
+    }
+  }
+  for (size_t i = 0; i < vertices.size(); i++) {
+    auto& vertex = vertices[i];
+    const float* n = vertex.normal;
+    auto& t = tangents[i];
+    float d = n[0] * t[0] + n[1] * t[1] + n[2] * t[2];
+    for (int c = 0; c < 3; c++) {
+      t[c] -= n[c] * d;
+    }
+    float length = sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+    if (length < 1e-12f) {
+      // no usable uvs here, any perpendicular will do
+      t = fabsf(n[0]) < 0.9f ? array<float, 3>{0, -n[2], n[1]} : array<float, 3>{n[2], 0, -n[0]};
+      length = sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+    }
+    float cross[3] = {n[1] * t[2] - n[2] * t[1], n[2] * t[0] - n[0] * t[2], n[0] * t[1] - n[1] * t[0]};
+    const auto& b = bitangents[i];
+    for (int c = 0; c < 3; c++) {
+      vertex.tangent[c] = length > 0 ? t[c] / length : 0;
+    }
+    vertex.tangent[3] = cross[0] * b[0] + cross[1] * b[1] + cross[2] * b[2] < 0 ? -1.f : 1.f;
+  }
+}
+
+//! Cache efficiency of the triangles before and after optimizing, and what optimizing cost
+struct Report {
+  size_t triangles = 0;
+  size_t vertices = 0;
+  size_t missesBefore = 0;
+  size_t missesAfter = 0;
+  double optimizeMs = 0;
+  // per level of detail, from the first coarser one
+  vector<size_t> lodTriangles;
+  vector<float> lodErrors;
+  double simplifyMs = 0;
+};
+
+/*!
+ * Deduplicates corners into vertices, optimizes each group's triangle order (see MeshOptimizer.h)
+ * and splits it into submeshes of at most 65536 vertices, so they can use 16 bit indices. Vertices
+ * are numbered in the order triangles first use them, so splitting keeps the fetch order too.
+ */
+static void build(const Source& source, bool optimize, bool tangents, Output& output, Report& report) {
+  for (size_t g = 0; g < source.groups.size(); g++) {
+    const auto& corners = source.groups[g];
+    if (corners.empty()) {
+      continue;
+    }
+    vector<Vertex> vertices;
+    vector<uint32_t> indices;
+    indices.reserve(corners.size());
+    unordered_map<Corner, uint32_t, CornerHash> unique;
+    for (const auto& corner : corners) {
+      auto [it, added] = unique.try_emplace(corner, uint32_t(vertices.size()));
+      if (added) {
+        const auto& p = source.positions[corner.position];
+        const auto& t = source.uvs[corner.uv];
+        Vertex vertex{{p[0], p[1], p[2]}, {t[0], t[1]}, {}, {}};
+        if (corner.normal != ~0u) {
+          const auto& n = source.normals[corner.normal];
+          copy(n.begin(), n.end(), vertex.normal);
+        }
+        vertices.push_back(vertex);
+      }
+      indices.push_back(it->second);
+    }
+    if (tangents) {
+      generateTangents(vertices, indices);
+    }
+
+    auto before = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+    report.triangles += indices.size() / 3;
+    report.missesBefore += size_t(lround(before.acmr * double(indices.size() / 3)));
+    if (optimize) {
+      auto start = chrono::steady_clock::now();
+      MeshOptimizer::optimize(vertices, indices, MeshOptimizer::Options());
+      report.optimizeMs += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+    auto after = MeshOptimizer::analyzeVertexCache(indices, vertices.size());
+    report.missesAfter += size_t(lround(after.acmr * double(indices.size() / 3)));
+
+    vector<uint32_t> local(vertices.size(), ~0u);
+    size_t next = 0;
+    while (next < indices.size()) {
+      MeshFileSubmesh submesh{};
+      submesh.firstIndex = uint32_t(output.indices.size());
+      submesh.baseVertex = uint32_t(output.vertices.size());
+      submesh.material = g < source.materials.size() ? uint32_t(g) : kMeshFileNoMaterial;
+      for (; next < indices.size(); next += 3) {
+        // a triangle adds up to three vertices, which have to fit
+        if (output.vertices.size() - submesh.baseVertex + 3 > 65536) {
+          break;
+        }
+        for (size_t k = 0; k < 3; k++) {
+          uint32_t v = indices[next + k];
+          if (local[v] == ~0u || local[v] < submesh.baseVertex) {
+            local[v] = uint32_t(output.vertices.size());
+            output.vertices.push_back(vertices[v]);
+          }
+          output.indices.push_back(uint16_t(local[v] - submesh.baseVertex));
+        }
+      }
+      submesh.indexCount = uint32_t(output.indices.size()) - submesh.firstIndex;
+      submesh.vertexCount = uint32_t(output.vertices.size()) - submesh.baseVertex;
+      setBounds(output.vertices.data() + submesh.baseVertex, submesh.vertexCount, submesh.center, submesh.radius,
+                submesh.boundsMin, submesh.boundsMax);
+      output.submeshes.push_back(submesh);
+    }
+    report.vertices += vertices.size();
+  }
+}
+
+static double msSince(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/*!
+ * Appends up to lodCount levels of detail to each submesh, their indices after all the others. Each
+ * level reuses the submesh's vertices and is ordered for the vertex cache.
+ */
+static void buildLods(Output& output, uint32_t lodCount, float ratio, Report& report) {
+  auto start = chrono::steady_clock::now();
+  for (auto& submesh : output.submeshes) {
+    const auto* first = output.indices.data() + submesh.firstIndex;
+    vector<uint32_t> previous(first, first + submesh.indexCount);
+    for (uint32_t level = 0; level < lodCount; level++) {
+      size_t target = size_t(double(previous.size() / 3) * ratio) * 3;
+      float error = 0;
+      auto indices = MeshOptimizer::simplify(previous, reinterpret_cast<const uint8_t*>(&output.vertices[submesh.baseVertex]),
+                                             submesh.vertexCount, sizeof(Vertex), target, FLT_MAX, &error);
+      if (indices.empty() || indices.size() > previous.size() / 10 * 9) {
+        break;
+      }
+      MeshOptimizer::optimizeVertexCache(indices, submesh.vertexCount);
+      MeshFileLod lod{};
+      lod.firstIndex = uint32_t(output.indices.size());
+      lod.indexCount = uint32_t(indices.size());
+      // simplifying a level rather than the full submesh adds its error to the last one's
+      lod.error = error + (submesh.lodCount ? output.lods.back().error : 0);
+      output.indices.insert(output.indices.end(), indices.begin(), indices.end());
+      output.lods.push_back(lod);
+      submesh.lodCount++;
+      if (report.lodTriangles.size() <= level) {
+        report.lodTriangles.push_back(0);
+        report.lodErrors.push_back(0);
+      }
+      report.lodTriangles[level] += indices.size() / 3;
+      report.lodErrors[level] = max(report.lodErrors[level], lod.error);
+      previous = std::move(indices);
+    }
+  }
+  report.simplifyMs = msSince(start);
+}
+
+/*!
+ * Encodes vertices in format, then decodes every one again and checks it's within the format's
+ * tolerance of the original, so a quantization bug can't ship quietly.
+ * @param worst receives the largest error found as a fraction of its tolerance
+ */
+static bool encode(const vector<Vertex>& vertices, const VertexFormat& format, vector<uint8_t>& out, float& worst,
+                   string& error) {
+  auto tolerance = format.getTolerance();
+  out.resize(vertices.size() * format.stride);
+  worst = 0;
+  auto check = [&worst](float error, float tolerance) {
+    float fraction = tolerance > 0 ? error / tolerance : (error > 0 ? INFINITY : 0);
+    worst = max(worst, fraction);
+    return fraction <= 1;
+  };
+  for (size_t i = 0; i < vertices.size(); i++) {
+    const auto& vertex = vertices[i];
+    uint8_t* encoded = out.data() + i * format.stride;
+    format.encode(vertex, encoded);
+    auto decoded = format.decode(encoded);
+    bool ok = true;
+    for (int c = 0; c < 3; c++) {
+      ok &= check(fabsf(decoded.position[c] - vertex.position[c]), tolerance.position[c]);
+    }
+    for (int c = 0; c < 2; c++) {
+      ok &= check(fabsf(decoded.uv[c] - vertex.uv[c]), tolerance.uv[c]);
+    }
+    // directions the source left zero decode to some unit vector, there's nothing to compare
+    auto checkDirection = [&](const float* original, const float* result) {
+      float length = sqrt(original[0] * original[0] + original[1] * original[1] + original[2] * original[2]);
+      if (length == 0) {
+        return true;
+      }
+      float d[3];
+      for (int c = 0; c < 3; c++) {
+        d[c] = result[c] - original[c] / length;
+      }
+      return check(sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]), tolerance.direction);
+    };
+    if (format.has(VertexAttribute::Normal)) {
+      ok &= checkDirection(vertex.normal, decoded.normal);
+    }
+    if (format.has(VertexAttribute::Tangent)) {
+      ok &= checkDirection(vertex.tangent, decoded.tangent) && (decoded.tangent[3] < 0) == (vertex.tangent[3] < 0);
+    }
+    if (!ok) {
+      error = "vertex " + to_string(i) + " is out of tolerance after encoding";
+      return false;
+    }
+  }
+  return true;
+}
+
+/*!
+ * Grows bounds by the position tolerance, so they hold the vertices the GPU will see.
+ */
+static void padBounds(const VertexFormat::Tolerance& tolerance, float& radius, float boundsMin[3],
+                      float boundsMax[3]) {
+  const float* t = tolerance.position;
+  radius += sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+  for (int c = 0; c < 3; c++) {
+    boundsMin[c] -= t[c];
+    boundsMax[c] += t[c];
+  }
+}
+
+/*!
+ * Encodes random vertices, spread over ranges from tiny to large and with directions over the whole
+ * sphere, in every combination of storage flags.
+ * @return whether every one decoded within tolerance
+ */
+static bool testFormats() {
+  mt19937 random(1);
+  uniform_real_distribution<float> unit(-1, 1);
+  bool passed = true;
+  for (float range : {1e-3f, 1.f, 1e3f}) {
+    vector<Vertex> vertices(100000);
+    for (auto& v : vertices) {
+      for (int c = 0; c < 3; c++) {
+        v.position[c] = unit(random) * range + range / 2;
+        v.normal[c] = unit(random);
+        v.tangent[c] = unit(random);
+      }
+      v.uv[0] = unit(random) * range;
+      v.uv[1] = unit(random) * range;
+      v.tangent[3] = unit(random);
+    }
+    for (uint32_t position : {kVertexPositionFloat, kVertexPositionHalf, kVertexPositionSnorm16}) {
+      for (uint32_t uv : {kVertexUvFloat, kVertexUvHalf, kVertexUvUnorm16}) {
+        auto format = VertexFormat::fromFlags(position | uv | kVertexNormal | kVertexTangent);
+        format.fit(vertices);
+        vector<uint8_t> encoded;
+        float worst = 0;
+        string error;
+        bool ok = encode(vertices, format, encoded, worst, error);
+        printf("format 0x%03x, range %g: %u bytes per vertex, largest error %.0f%% of tolerance%s%s\n",
+               format.flags, range, format.stride, worst * 100, ok ? "" : ", FAILED: ", error.c_str());
+        passed &= ok;
+      }
+    }
+  }
+  return passed;
+}
+
+/*!
+ * Grid vertices of the kind makeGrid builds, (n + 1) squared of them, with a bumpy height unless
+ * flat is set.
+ */
+static vector<Vertex> makeGridVertices(uint32_t n, bool flat) {
+  vector<Vertex> vertices;
+  for (uint32_t y = 0; y <= n; y++) {
+    for (uint32_t x = 0; x <= n; x++) {
+      Vertex v{};
+      float u = float(x) / n;
+      float w = float(y) / n;
+      v.position[0] = u * 2 - 1;
+      v.position[1] = w * 2 - 1;
+      v.position[2] = flat ? 0 : 0.1f * sinf(u * 12.f) * cosf(w * 9.f);
+      v.uv[0] = u;
+      v.uv[1] = 1 - w;
+      vertices.push_back(v);
+    }
+  }
+  return vertices;
+}
+
+static vector<uint32_t> makeGridIndices(uint32_t n) {
+  vector<uint32_t> indices;
+  for (uint32_t y = 0; y < n; y++) {
+    for (uint32_t x = 0; x < n; x++) {
+      uint32_t i = y * (n + 1) + x;
+      uint32_t j = i + n + 1;
+      indices.insert(indices.end(), {i, i + 1, j + 1, i, j + 1, j});
+    }
+  }
+  return indices;
+}
+
+/*!
+ * @return the triangles as sorted vertex contents, each starting at its smallest corner so winding
+ * counts but numbering doesn't
+ */
+static vector<array<float, 15>> getTriangleSet(const vector<Vertex>& vertices, const vector<uint32_t>& indices) {
+  vector<array<float, 15>> triangles;
+  for (size_t t = 0; t < indices.size(); t += 3) {
+    array<array<float, 5>, 3> corners;
+    for (int k = 0; k < 3; k++) {
+      const auto& v = vertices[indices[t + k]];
+      corners[k] = {v.position[0], v.position[1], v.position[2], v.uv[0], v.uv[1]};
+    }
+    rotate(corners.begin(), min_element(corners.begin(), corners.end()), corners.end());
+    array<float, 15> triangle;
+    for (int k = 0; k < 3; k++) {
+      copy(corners[k].begin(), corners[k].end(), triangle.begin() + k * 5);
+    }
+    triangles.push_back(triangle);
+  }
+  sort(triangles.begin(), triangles.end());
+  return triangles;
+}
+
+/*!
+ * Times every MeshOptimizer pass on a shuffled, unindexed grid, the way a naive exporter writes
+ * one, and checks that each keeps the triangles and does what it's for: deduplicate merges the
+ * copies, the vertex cache order lowers ACMR, overdraw sorting gives little of that back and vertex
+ * fetch numbers vertices in first use order. Then checks simplify: valid triangles within the
+ * target, errors that grow as the target shrinks and stay under maxError, the outline kept and a
+ * flat grid collapsed for free.
+ * @return whether every check passed
+ */
+static bool testOptimizer() {
+  bool passed = true;
+  auto check = [&passed](bool ok, const char* what) {
+    if (!ok) {
+      printf("  FAILED: %s\n", what);
+      passed = false;
+    }
+  };
+
+  constexpr uint32_t n = 256;
+  auto grid = makeGridVertices(n, false);
+  auto gridIndices = makeGridIndices(n);
+  vector<array<uint32_t, 3>> shuffled;
+  for (size_t t = 0; t < gridIndices.size(); t += 3) {
+    shuffled.push_back({gridIndices[t], gridIndices[t + 1], gridIndices[t + 2]});
+  }
+  shuffle(shuffled.begin(), shuffled.end(), mt19937(1));
+  vector<Vertex> vertices;
+  vector<uint32_t> indices;
+  for (const auto& triangle : shuffled) {
+    for (uint32_t k : triangle) {
+      indices.push_back(uint32_t(vertices.size()));
+      vertices.push_back(grid[k]);
+    }
+  }
+  auto expected = getTriangleSet(vertices, indices);
+
+  auto bytes = reinterpret_cast<uint8_t*>(vertices.data());
+  size_t vertexCount = vertices.size();
+  double triangles = double(indices.size() / 3);
+  auto time = [triangles](const char* pass, auto&& run) {
+    auto start = chrono::steady_clock::now();
+    run();
+    double ms = msSince(start);
+    printf("%s: %.1f ms, %.2f Mtriangles/s\n", pass, ms, triangles / ms / 1000);
+  };
+  auto sameTriangles = [&] {
+    vector<Vertex> used(vertices.begin(), vertices.begin() + vertexCount);
+    return getTriangleSet(used, indices) == expected;
+  };
+
+  auto before = MeshOptimizer::analyzeVertexCache(indices, vertexCount);
+  time("deduplicate", [&] { vertexCount = MeshOptimizer::deduplicate(bytes, vertexCount, sizeof(Vertex), indices); });
+  check(vertexCount == size_t(n + 1) * (n + 1), "deduplicate left copies");
+  check(sameTriangles(), "deduplicate changed the triangles");
+  auto deduplicated = MeshOptimizer::analyzeVertexCache(indices, vertexCount);
+
+  time("vertex cache", [&] { MeshOptimizer::optimizeVertexCache(indices, vertexCount); });
+  check(sameTriangles(), "the vertex cache order changed the triangles");
+  auto tipsified = MeshOptimizer::analyzeVertexCache(indices, vertexCount);
+  check(tipsified.acmr < deduplicated.acmr * 0.5, "the vertex cache order didn't halve ACMR");
+
+  time("overdraw", [&] { MeshOptimizer::optimizeOverdraw(indices, bytes, vertexCount, sizeof(Vertex)); });
+  check(sameTriangles(), "overdraw sorting changed the triangles");
+  auto sorted = MeshOptimizer::analyzeVertexCache(indices, vertexCount);
+  check(sorted.acmr <= tipsified.acmr * 1.1, "overdraw sorting gave back more than a tenth of the ACMR gained");
+
+  time("vertex fetch", [&] {
+    vertexCount = MeshOptimizer::optimizeVertexFetch(bytes, vertexCount, sizeof(Vertex), indices);
+  });
+  check(sameTriangles(), "vertex fetch ordering changed the triangles");
+  uint32_t next = 0;
+  bool firstUseOrder = true;
+  for (uint32_t index : indices) {
+    firstUseOrder &= index <= next;
+    next += index == next;
+  }
+  check(firstUseOrder && next == vertexCount, "vertex fetch ordering isn't in first use order");
+  auto after = MeshOptimizer::analyzeVertexCache(indices, vertexCount);
+  printf("%.0f triangles, %zu -> %zu vertices, ACMR %.3f -> %.3f deduplicated -> %.3f -> %.3f overdraw sorted, "
+         "ATVR %.3f -> %.3f\n",
+         triangles, vertices.size(), vertexCount, before.acmr, deduplicated.acmr, tipsified.acmr, sorted.acmr,
+         deduplicated.atvr, after.atvr);
+
+  // Simplify the bumpy grid to ever smaller targets
+  grid = makeGridVertices(128, false);
+  gridIndices = makeGridIndices(128);
+  auto gridBytes = reinterpret_cast<const uint8_t*>(grid.data());
+  auto validTriangles = [&grid](const vector<uint32_t>& lod) {
+    for (size_t t = 0; t < lod.size(); t += 3) {
+      uint32_t a = lod[t];
+      uint32_t b = lod[t + 1];
+      uint32_t c = lod[t + 2];
+      if (a >= grid.size() || b >= grid.size() || c >= grid.size() || a == b || b == c || a == c) {
+        return false;
+      }
+    }
+    return lod.size() % 3 == 0;
+  };
+  auto keepsOutline = [](const vector<uint32_t>& lod, uint32_t size) {
+    vector<bool> used((size + 1) * (size + 1));
+    for (uint32_t index : lod) {
+      used[index] = true;
+    }
+    for (uint32_t i = 0; i <= size; i++) {
+      if (!used[i] || !used[size * (size + 1) + i] || !used[i * (size + 1)] || !used[i * (size + 1) + size]) {
+        return false;
+      }
+    }
+    return true;
+  };
+  float lastError = 0;
+  for (size_t divisor : {2, 4, 16}) {
+    size_t target = gridIndices.size() / 3 / divisor * 3;
+    float error = 0;
+    auto start = chrono::steady_clock::now();
+    auto lod = MeshOptimizer::simplify(gridIndices, gridBytes, grid.size(), sizeof(Vertex), target, FLT_MAX, &error);
+    printf("simplify to 1/%zu: %zu -> %zu triangles, error %.4f, %.1f ms\n", divisor, gridIndices.size() / 3,
+           lod.size() / 3, error, msSince(start));
+    check(!lod.empty() && lod.size() <= target, "simplify missed its target");
+    check(validTriangles(lod), "simplify made invalid triangles");
+    check(keepsOutline(lod, 128), "simplify moved the outline");
+    check(error >= lastError, "simplify's error shrank with its target");
+    lastError = error;
+  }
+  float error = 0;
+  auto lod = MeshOptimizer::simplify(gridIndices, gridBytes, grid.size(), sizeof(Vertex), 0, 0.05f, &error);
+  printf("simplify to an error of 0.05: %zu triangles, error %.4f\n", lod.size() / 3, error);
+  check(error <= 0.05f && lod.size() < gridIndices.size(), "simplify didn't stop at maxError");
+  check(validTriangles(lod), "simplify made invalid triangles");
+
+  // A flat grid loses everything but its outline at no cost
+  grid = makeGridVertices(128, true);
+  gridBytes = reinterpret_cast<const uint8_t*>(grid.data());
+  lod = MeshOptimizer::simplify(gridIndices, gridBytes, grid.size(), sizeof(Vertex), 0, 1e-4f, &error);
+  printf("simplify a flat grid: %zu triangles, error %.6f\n", lod.size() / 3, error);
+  check(lod.size() <= gridIndices.size() / 10 && error <= 1e-4f, "simplify didn't collapse a flat grid");
+  check(validTriangles(lod), "simplify made invalid triangles");
+  check(keepsOutline(lod, 128), "simplify moved the outline");
+  return passed;
+}
+
+int main(int argc, char** argv) {
+  vector<string> paths;
+  uint32_t grid = 0;
+  bool optimize = true;
+  bool normals = true;
+  bool tangents = false;
+  uint32_t lods = 0;
+  float lodRatio = 0.5f;
+  uint32_t positionFormat = kVertexPositionSnorm16;
+  uint32_t uvFormat = kVertexUvUnorm16;
+  // name=flags pairs for the storage options
+  auto choose = [](const char* name, initializer_list<pair<const char*, uint32_t>> choices, uint32_t& out) {
+    for (const auto& [choice, flags] : choices) {
+      if (!strcmp(name, choice)) {
+        out = flags;
+        return true;
+      }
+    }
+    return false;
+  };
+  if (argc == 2 && !strcmp(argv[1], "--test-formats")) {
+    return testFormats() ? 0 : 1;
+  }
+  if (argc == 2 && !strcmp(argv[1], "--test-optimizer")) {
+    return testOptimizer() ? 0 : 1;
+  }
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--grid") && i + 1 < argc) {
+      grid = uint32_t(atoi(argv[++i]));
+      if (grid == 0) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--no-optimize")) {
+      optimize = false;
+    } else if (!strcmp(argv[i], "--position") && i + 1 < argc) {
+      if (!choose(argv[++i],
+                  {{"float", kVertexPositionFloat}, {"half", kVertexPositionHalf}, {"snorm16", kVertexPositionSnorm16}},
+                  positionFormat)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--uv") && i + 1 < argc) {
+      if (!choose(argv[++i], {{"float", kVertexUvFloat}, {"half", kVertexUvHalf}, {"unorm16", kVertexUvUnorm16}},
+                  uvFormat)) {
+        usage();
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "--no-normals")) {
+      normals = false;
+    } else if (!strcmp(argv[i], "--tangents")) {
+      tangents = true;
+    } else if (!strcmp(argv[i], "--lods") && i + 1 < argc) {
+      lods = uint32_t(atoi(argv[++i]));
+    } else if (!strcmp(argv[i], "--lod-ratio") && i + 1 < argc) {
+      lodRatio = float(atof(argv[++i]));
+      if (!(lodRatio > 0 && lodRatio < 1)) {
+        usage();
+        return 1;
+      }
+    } else if (argv[i][0] == '-') {
+      usage();
+      return 1;
+    } else {
+      paths.push_back(argv[i]);
+    }
+  }
+  if (paths.size() != (grid ? 1 : 2)) {
+    usage();
+    return 1;
+  }
+  string output = paths.back();
+
+  auto start = chrono::steady_clock::now();
+  Source source;
+  if (grid) {
+    makeGrid(grid, source);
+  } else {
+    string error;
+    if (!readObj(paths[0], source, error)) {
+      fprintf(stderr, "meshconv: %s: %s\n", paths[0].c_str(), error.c_str());
+      return 1;
+    }
+  }
+  normals = normals && !source.normals.empty();
+  if (tangents && !normals) {
+    fprintf(stderr, "meshconv: --tangents needs normals in the source\n");
+    return 1;
+  }
+  Output mesh;
+  Report report;
+  build(source, optimize, tangents, mesh, report);
+  buildLods(mesh, lods, lodRatio, report);
+  double convertMs = msSince(start);
+  if (mesh.indices.empty()) {
+    fprintf(stderr, "meshconv: %s has no faces\n", paths[0].c_str());
+    return 1;
+  }
+
+  string strings;
+  vector<MeshFileMaterial> materials;
+  for (const auto& m : source.materials) {
+    MeshFileMaterial material{};
+    material.nameOffset = uint32_t(strings.size());
+    material.nameLength = uint32_t(m.name.size());
+    strings += m.name;
+    material.textureOffset = uint32_t(strings.size());
+    material.textureLength = uint32_t(m.texture.size());
+    strings += m.texture;
+    memcpy(material.baseColor, m.baseColor, sizeof(material.baseColor));
+    materials.push_back(material);
+  }
+
+  auto format = VertexFormat::fromFlags(positionFormat | uvFormat | (normals ? kVertexNormal : 0) |
+                                       (tangents ? kVertexTangent : 0));
+  format.fit(mesh.vertices);
+  vector<uint8_t> vertexData;
+  float worstError = 0;
+  string encodeError;
+  if (!encode(mesh.vertices, format, vertexData, worstError, encodeError)) {
+    fprintf(stderr, "meshconv: %s\n", encodeError.c_str());
+    return 1;
+  }
+  auto tolerance = format.getTolerance();
+  for (auto& submesh : mesh.submeshes) {
+    padBounds(tolerance, submesh.radius, submesh.boundsMin, submesh.boundsMax);
+  }
+
+  auto align = [](size_t offset) { return (offset + kMeshFileAlignment - 1) / kMeshFileAlignment * kMeshFileAlignment; };
+  MeshFileHeader header{};
+  memcpy(header.magic, kMeshFileMagic, sizeof(kMeshFileMagic));
+  header.version = kMeshFileVersion;
+  header.vertexFormat = format.flags;
+  header.vertexStride = format.stride;
+  header.indexSize = sizeof(uint16_t);
+  header.submeshCount = uint32_t(mesh.submeshes.size());
+  header.materialCount = uint32_t(materials.size());
+  header.stringsSize = uint32_t(strings.size());
+  header.vertexCount = mesh.vertices.size();
+  header.indexCount = mesh.indices.size();
+  header.vertexOffset = align(sizeof(header) + mesh.submeshes.size() * sizeof(MeshFileSubmesh) +
+                              mesh.lods.size() * sizeof(MeshFileLod) + materials.size() * sizeof(MeshFileMaterial) +
+                              strings.size());
+  header.indexOffset = align(header.vertexOffset + vertexData.size());
+  setBounds(mesh.vertices.data(), mesh.vertices.size(), header.center, header.radius, header.boundsMin,
+            header.boundsMax);
+  padBounds(tolerance, header.radius, header.boundsMin, header.boundsMax);
+  memcpy(header.positionScale, format.positionScale, sizeof(header.positionScale));
+  memcpy(header.positionOffset, format.positionOffset, sizeof(header.positionOffset));
+  memcpy(header.uvScale, format.uvScale, sizeof(header.uvScale));
+  memcpy(header.uvOffset, format.uvOffset, sizeof(header.uvOffset));
+
+  vector<uint8_t> file(header.indexOffset + mesh.indices.size() * sizeof(uint16_t));
+  uint8_t* p = file.data();
+  auto put = [&p](const void* data, size_t size) {
+    memcpy(p, data, size);
+    p += size;
+  };
+  put(&header, sizeof(header));
+  put(mesh.submeshes.data(), mesh.submeshes.size() * sizeof(MeshFileSubmesh));
+  put(mesh.lods.data(), mesh.lods.size() * sizeof(MeshFileLod));
+  put(materials.data(), materials.size() * sizeof(MeshFileMaterial));
+  put(strings.data(), strings.size());
+  memcpy(file.data() + header.vertexOffset, vertexData.data(), vertexData.size());
+  memcpy(file.data() + header.indexOffset, mesh.indices.data(), mesh.indices.size() * sizeof(uint16_t));
+
+  // What loading costs on device before the upload: a parse of the tables
+  start = chrono::steady_clock::now();
+  MeshFile parsed;
+  const char* error = nullptr;
+  if (!MeshFile::parse(file.data(), file.size(), parsed, &error)) {
+    fprintf(stderr, "meshconv: wrote an invalid file: %s\n", error);
+    return 1;
+  }
+  double parseMs = msSince(start);
+
+  FILE* f = fopen(output.c_str(), "wb");
+  if (!f || fwrite(file.data(), 1, file.size(), f) != file.size()) {
+    fprintf(stderr, "meshconv: can't write %s\n", output.c_str());
+    if (f) {
+      fclose(f);
+    }
+    return 1;
+  }
+  fclose(f);
+
+  printf("%s: %zu vertices, %zu triangles, %zu submeshes, %zu materials, %zu bytes; converted in %.1f ms, parses in "
+         "%.3f ms\n",
+         output.c_str(), mesh.vertices.size(), report.triangles, mesh.submeshes.size(), materials.size(),
+         file.size(), convertMs, parseMs);
+  printf("  %u bytes per vertex (%zu as floats), largest error %.0f%% of the format's tolerance\n", format.stride,
+         sizeof(float) * (5 + (normals ? 3 : 0) + (tangents ? 4 : 0)), worstError * 100);
+  // With a 16 entry FIFO post-transform cache, which is what the optimizer assumes
+  double triangles = double(report.triangles);
+  double vertices = double(report.vertices);
+  printf("  ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", double(report.missesBefore) / triangles,
+         double(report.missesAfter) / triangles, double(report.missesBefore) / vertices,
+         double(report.missesAfter) / vertices);
+  if (optimize) {
+    printf(", optimized in %.1f ms (%.2f Mtriangles/s)\n", report.optimizeMs, triangles / report.optimizeMs / 1000);
+  } else {
+    printf(", not optimized\n");
+  }
+  if (!report.lodTriangles.empty()) {
+    printf("  levels of detail:");
+    for (size_t l = 0; l < report.lodTriangles.size(); l++) {
+      printf("%s %zu triangles (error %.3g)", l ? "," : "", report.lodTriangles[l], report.lodErrors[l]);
+    }
+    printf(", simplified in %.1f ms\n", report.simplifyMs);
+  }
+  return 0;
+}
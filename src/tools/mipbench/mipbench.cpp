@@ -0,0 +1,124 @@
+// Measures MipGenerator and the two ways TextureAsset can feed a pixel unpack buffer, on the host.
+// Build and run:
+//
+//   g++ -std=c++20 -O2 -I../../samples/Dreadful/app/src/main/cpp mipbench.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/MipGenerator.cpp -o mipbench
+//   ./mipbench
+//
+// On a noisy --size square image it times, --runs times each, and prints the average of:
+//   generate  generate in place
+//   copy      decode into a heap chain, generate in place, copy the chain into the upload buffer
+//   direct    decode into level 0 sized scratch, generate from it straight into the upload buffer
+// with the heap memory each holds besides the upload buffer. "Decoding" is a copy of the source
+// image, standing in for AImageDecoder writing its output. The upload buffer is ordinary memory
+// here; on a device it's a write combined mapping, which makes the extra copy dearer still. Results
+// are checked: both upload paths have to produce the same bytes as generating in place.
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "MipGenerator.h"
+
+using namespace std;
+
+struct Options {
+  uint32_t size = 2048;
+  uint32_t runs = 5;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: mipbench [--size N] [--runs N]\n"
+          "  --size N   width and height of the image (default 2048)\n"
+          "  --runs N   runs of each path to average (default 5)\n");
+}
+
+static double elapsedMs(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    auto number = [&](uint32_t& value) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+        return false;
+      }
+      value = uint32_t(atoi(argv[++i]));
+      return true;
+    };
+    bool ok = false;
+    if (!strcmp(argv[i], "--size")) {
+      ok = number(options.size);
+    } else if (!strcmp(argv[i], "--runs")) {
+      ok = number(options.runs);
+    }
+    if (!ok) {
+      usage();
+      return 1;
+    }
+  }
+
+  // A noisy gradient, so nothing is uniform enough to be cheap
+  uint32_t size = options.size;
+  size_t imageSize = size_t(size) * size * 4;
+  size_t chainSize = MipGenerator::getChainSize(size, size);
+  vector<uint8_t> source(imageSize);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < imageSize; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    source[i] = uint8_t((i / 4 % size) * 255 / size / 2 + (seed >> 25));
+  }
+  double megapixels = double(size) * size / 1e6;
+  printf("%ux%u image, %zu byte chain, %u runs\n", size, size, chainSize, options.runs);
+  printf("path               ms  Mpixel/s  heap bytes\n");
+  auto report = [&](const char* path, double ms, size_t heapBytes) {
+    ms /= options.runs;
+    printf("%-15s %5.2f  %8.1f  %10zu\n", path, ms, megapixels / (ms / 1000), heapBytes);
+  };
+  bool allCorrect = true;
+
+  // Generation alone, the reference the upload paths are checked against
+  vector<uint8_t> chain(chainSize);
+  double ms = 0;
+  for (uint32_t run = 0; run < options.runs; run++) {
+    memcpy(chain.data(), source.data(), imageSize);
+    auto start = chrono::steady_clock::now();
+    MipGenerator::generate(chain.data(), size, size, chain.data() + imageSize, {});
+    ms += elapsedMs(start);
+  }
+  report("generate", ms, chainSize);
+
+  // What loadAsset did before decoding into scratch: the chain is built on the heap, then copied
+  vector<uint8_t> copied(chainSize);
+  ms = 0;
+  for (uint32_t run = 0; run < options.runs; run++) {
+    auto start = chrono::steady_clock::now();
+    vector<uint8_t> heapChain(chainSize);
+    memcpy(heapChain.data(), source.data(), imageSize);
+    MipGenerator::generate(heapChain.data(), size, size, heapChain.data() + imageSize, {});
+    memcpy(copied.data(), heapChain.data(), chainSize);
+    ms += elapsedMs(start);
+  }
+  report("copy", ms, chainSize);
+
+  // What it does now, with scratch reused from the pool as PixelBufferPool::acquireScratch does
+  vector<uint8_t> direct(chainSize);
+  vector<uint8_t> scratch(imageSize);
+  ms = 0;
+  for (uint32_t run = 0; run < options.runs; run++) {
+    auto start = chrono::steady_clock::now();
+    memcpy(scratch.data(), source.data(), imageSize);
+    MipGenerator::generate(scratch.data(), size, size, direct.data(), direct.data() + imageSize, {});
+    ms += elapsedMs(start);
+  }
+  report("direct", ms, imageSize);
+  if (copied != chain || direct != chain) {
+    printf("  WRONG RESULTS: the upload paths differ from generating in place\n");
+    allCorrect = false;
+  }
+  return allCorrect ? 0 : 1;
+}
@@ -0,0 +1,139 @@
+// Measures SceneGraph updates on the host. Build and run:
+//
+//   g++ -std=c++20 -O2 -I../../samples/Dreadful/app/src/main/cpp scenebench.cpp
+//       ../../samples/Dreadful/app/src/main/cpp/SceneGraph.cpp -o scenebench
+//   ./scenebench
+//
+// It builds a tree of --nodes nodes with --fanout children each, then every frame gives --changed
+// nodes picked at random new local poses and times, --frames times each, and prints the average of:
+//   incremental   update() recomputing the changed nodes and everything under them
+//   full          invalidate() then update(), recomputing every node
+// with how many nodes each recomputed. After each, every world pose is checked against its parent's
+// world pose and its own local one.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "SceneGraph.h"
+
+using namespace std;
+
+struct Options {
+  uint32_t nodes = 100000;
+  uint32_t fanout = 4;
+  uint32_t changed = 1000;
+  uint32_t frames = 100;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: scenebench [--nodes N] [--fanout N] [--changed N] [--frames N]\n"
+          "  --nodes N     nodes in the tree (default 100000)\n"
+          "  --fanout N    children of each node (default 4)\n"
+          "  --changed N   local poses changed per frame (default 1000)\n"
+          "  --frames N    updates of each kind to average (default 100)\n");
+}
+
+static double elapsedMs(chrono::steady_clock::time_point start) {
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+//! @return how many nodes' world poses aren't their parent's composed with their local pose
+static size_t countWrongWorlds(const SceneGraph& scene, const vector<SceneGraph::Node>& nodes) {
+  size_t wrong = 0;
+  for (auto node : nodes) {
+    auto parent = scene.getParent(node);
+    const auto& local = scene.getLocal(node);
+    r3::Posef expected = local;
+    if (parent != SceneGraph::kNoNode) {
+      const auto& parentWorld = scene.getWorld(parent);
+      expected = r3::Posef(parentWorld.r * local.r, parentWorld.Transform(local.t));
+    }
+    const auto& world = scene.getWorld(node);
+    float error = (world.t - expected.t).Length() + fabsf(world.r.x - expected.r.x) + fabsf(world.r.y - expected.r.y) +
+                  fabsf(world.r.z - expected.r.z) + fabsf(world.r.w - expected.r.w);
+    wrong += !(error <= 1e-4f);
+  }
+  return wrong;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    auto number = [&](uint32_t& value) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+        return false;
+      }
+      value = uint32_t(atoi(argv[++i]));
+      return true;
+    };
+    bool ok = false;
+    if (!strcmp(argv[i], "--nodes")) {
+      ok = number(options.nodes);
+    } else if (!strcmp(argv[i], "--fanout")) {
+      ok = number(options.fanout);
+    } else if (!strcmp(argv[i], "--changed")) {
+      ok = number(options.changed);
+    } else if (!strcmp(argv[i], "--frames")) {
+      ok = number(options.frames);
+    }
+    if (!ok) {
+      usage();
+      return 1;
+    }
+  }
+
+  mt19937 random(1);
+  uniform_real_distribution<float> unit(-1.f, 1.f);
+  auto randomPose = [&] {
+    r3::Vec3f axis(unit(random), unit(random), unit(random) + 2.f);
+    return r3::Posef(r3::Quaternionf(axis.Normalized(), unit(random)),
+                     r3::Vec3f(unit(random), unit(random), unit(random)));
+  };
+
+  SceneGraph scene;
+  vector<SceneGraph::Node> nodes;
+  nodes.reserve(options.nodes);
+  auto start = chrono::steady_clock::now();
+  for (uint32_t i = 0; i < options.nodes; i++) {
+    nodes.push_back(scene.add(randomPose(), i == 0 ? SceneGraph::kNoNode : nodes[(i - 1) / options.fanout]));
+  }
+  scene.update();
+  double buildMs = elapsedMs(start);
+  printf("%u nodes, fanout %u, built in %.2f ms, %u changed per frame, %u frames\n", options.nodes, options.fanout,
+         buildMs, options.changed, options.frames);
+  printf("update         ms  nodes recomputed\n");
+  bool allCorrect = true;
+
+  // Only the updates are timed, not setting the poses
+  for (bool incremental : {true, false}) {
+    double ms = 0;
+    size_t updated = 0;
+    for (uint32_t frame = 0; frame < options.frames; frame++) {
+      for (uint32_t i = 0; i < options.changed; i++) {
+        scene.setLocal(nodes[random() % nodes.size()], randomPose());
+      }
+      if (!incremental) {
+        scene.invalidate();
+      }
+      start = chrono::steady_clock::now();
+      scene.update();
+      ms += elapsedMs(start);
+      updated += scene.getUpdated().size();
+    }
+    size_t wrong = countWrongWorlds(scene, nodes);
+    bool correct = wrong == 0 && (incremental || updated == size_t(options.nodes) * options.frames);
+    printf("%-11s %5.3f  %16zu%s\n", incremental ? "incremental" : "full", ms / options.frames,
+           updated / options.frames, correct ? "" : "  WRONG RESULTS");
+    if (wrong) {
+      printf("  %zu nodes have stale world poses\n", wrong);
+    }
+    allCorrect = allCorrect && correct;
+  }
+  return allCorrect ? 0 : 1;
+}
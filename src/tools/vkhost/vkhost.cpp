@@ -0,0 +1,168 @@
+// Runs the Vulkan backend, xrh and VkRenderer, on a desktop against the stand-in OpenXR runtime of
+// xrstandin.cpp and whatever Vulkan driver the loader finds. It needs the Vulkan SDK headers and
+// loader (libvulkan-dev) and a driver; Mesa's lavapipe renders on the CPU. Build and run:
+//
+//   cmake -S . -B build && cmake --build build
+//   VK_ICD_FILENAMES=/usr/share/vulkan/icd.d/lvp_icd.x86_64.json ./build/vkhost
+//
+// In each record mode it sets up the session the way main.cpp does, then renders --frames frames
+// into a quad layer with --threads recording threads. The runtime reads every frame back and each
+// is checked against the tiles VkRenderer::recordTiles clears: the background in the gaps, and the
+// color for the frame's time inside every tile. It prints the CPU time per frame, which includes
+// the read back, and how many frames were right. The renderer's log goes to stderr.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "VkRenderer.h"
+#include "xrstandin.h"
+
+using namespace std;
+using namespace xrh;
+
+struct Options {
+  uint32_t frames = 300;
+  uint32_t threads = 2;
+};
+
+static void usage() {
+  fprintf(stderr,
+          "usage: vkhost [--frames N] [--threads N]\n"
+          "  --frames N    frames to render in each record mode (default 300)\n"
+          "  --threads N   recording threads of the multi-threaded mode (default 2)\n");
+}
+
+//! @return the 8 bit sRGB encoding of a linear color component
+static int encodeSrgb(float c) {
+  float encoded = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1 / 2.4f) - 0.055f;
+  return int(lroundf(encoded * 255));
+}
+
+/*!
+ * @return true if pixels hold the 8x8 tiles VkRenderer records for time t, one pixel apart on the
+ *         background, in an sRGB image
+ */
+static bool isFrameCorrect(const uint8_t* pixels, uint32_t width, uint32_t height, float t) {
+  // As in VkRenderer::beginRenderPass and recordTiles
+  constexpr uint32_t kTiles = 8;
+  uint32_t tileWidth = width / kTiles;
+  uint32_t tileHeight = height / kTiles;
+  auto matches = [&](uint32_t x, uint32_t y, const int rgb[3]) {
+    const uint8_t* p = pixels + (size_t(y) * width + x) * 4;
+    return abs(p[0] - rgb[0]) <= 2 && abs(p[1] - rgb[1]) <= 2 && abs(p[2] - rgb[2]) <= 2 && p[3] == 255;
+  };
+  int background[3] = {encodeSrgb(0.1f), encodeSrgb(0.1f), encodeSrgb(0.1f)};
+  for (uint32_t i = 0; i < kTiles * kTiles; i++) {
+    float phase = t + 0.37f * i;
+    int color[3] = {encodeSrgb(sin(1.7f * phase) * 0.5f + 0.5f), encodeSrgb(sin(0.6f * phase + 2.1f) * 0.5f + 0.5f),
+                    encodeSrgb(sin(0.8f * phase + 0.2f) * 0.5f + 0.5f)};
+    uint32_t x0 = (i % kTiles) * tileWidth;
+    uint32_t y0 = (i / kTiles) * tileHeight;
+    uint32_t x1 = x0 + tileWidth - 1;
+    uint32_t y1 = y0 + tileHeight - 1;
+    if (!matches(x0, y0, background) || !matches(x1, y1, background) || !matches(x0 + 1, y0 + 1, color) ||
+        !matches(x1 - 1, y1 - 1, color) || !matches((x0 + x1) / 2, (y0 + y1) / 2, color)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+//! @return true if every frame rendered in mode was right
+static bool run(VkRenderer::RecordMode mode, const Options& options) {
+  const char* name = mode == VkRenderer::RecordMode::Prerecorded ? "pre-recorded" : "multi-threaded";
+  // Declared first so it's destroyed last, after the session that renders with it
+  shared_ptr<VkRenderer> renderer;
+  auto inst = make_instance();
+  inst->add_required_extension(XR_KHR_VULKAN_ENABLE2_EXTENSION_NAME);
+  if (!inst->create()) {
+    printf("%s: OpenXR instance creation failed\n", name);
+    return false;
+  }
+  renderer = VkRenderer::create(*inst, mode, options.threads);
+  if (!renderer) {
+    printf("%s: Vulkan renderer creation failed\n", name);
+    return false;
+  }
+  auto ssn = inst->create_session();
+  if (!ssn) {
+    printf("%s: OpenXR session creation failed\n", name);
+    return false;
+  }
+  auto local = ssn->create_refspace(RefSpace::element_type::make_create_info());
+  auto vcv = inst->get_xr_view_config_view(0);
+  auto sc = ssn->create_swapchain(
+      Swapchain::element_type::make_create_info(vcv.recommendedImageRectWidth, vcv.recommendedImageRectHeight));
+  if (!renderer->setSwapchainImages(sc->get_width(), sc->get_height(), static_cast<VkFormat>(sc->get_format()),
+                                    sc->enumerate_images())) {
+    printf("%s: swapchain setup failed\n", name);
+    return false;
+  }
+
+  // The renderer animates by its frame count, the pre-recorded tiles stay at time 0
+  uint32_t frame = 0;
+  uint32_t correct = 0;
+  xrstandin::setFrameCheck([&](const uint8_t* pixels, uint32_t width, uint32_t height) {
+    float t = mode == VkRenderer::RecordMode::Prerecorded ? 0.f : frame / 60.f;
+    correct += isFrameCorrect(pixels, width, height, t);
+  });
+  auto start = chrono::steady_clock::now();
+  while (frame < options.frames) {
+    if (!ssn->begin_frame()) {
+      printf("%s: the session didn't start\n", name);
+      break;
+    }
+    uint32_t imageIndex = sc->acquire_and_wait_image();
+    frame++;
+    renderer->render(imageIndex);
+    sc->release_image();
+
+    QuadLayer quad;
+    quad.set_size(1.0f, 1.0f);
+    quad.set_swapchain(sc);
+    quad.set_space(local);
+    ssn->add_layer(quad);
+    ssn->end_frame();
+  }
+  double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+  xrstandin::setFrameCheck(nullptr);
+
+  bool allCorrect = correct == options.frames;
+  printf("%-14s  %8.3f  %7u of %u%s\n", name, frame ? ms / frame : 0., correct, options.frames,
+         allCorrect ? "" : "  WRONG RESULTS");
+  return allCorrect;
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    auto number = [&](uint32_t& value) {
+      if (i + 1 >= argc || atoi(argv[i + 1]) <= 0) {
+        return false;
+      }
+      value = uint32_t(atoi(argv[++i]));
+      return true;
+    };
+    bool ok = false;
+    if (!strcmp(argv[i], "--frames")) {
+      ok = number(options.frames);
+    } else if (!strcmp(argv[i], "--threads")) {
+      ok = number(options.threads);
+    }
+    if (!ok) {
+      usage();
+      return 1;
+    }
+  }
+
+  printf("%u frames each, %u recording threads\n", options.frames, options.threads);
+  printf("mode            ms/frame  frames right\n");
+  bool allCorrect = true;
+  for (auto mode : {VkRenderer::RecordMode::Prerecorded, VkRenderer::RecordMode::MultiThreaded}) {
+    allCorrect = run(mode, options) && allCorrect;
+  }
+  return allCorrect ? 0 : 1;
+}
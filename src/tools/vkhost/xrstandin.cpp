@@ -0,0 +1,611 @@
+// A stand-in OpenXR runtime for running xrh and VkRenderer on a desktop, see xrstandin.h. It's
+// linked in place of the OpenXR loader, so the app's calls land here directly; only the extension
+// functions go through xrGetInstanceProcAddr. Handles point to the structs below, so it needs a
+// 64 bit build, where XR_DEFINE_HANDLE makes them pointers.
+
+#include <vulkan/vulkan.h>
+
+#include <openxr/openxr.h>
+#include <openxr/openxr_platform.h>
+
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <span>
+#include <vector>
+
+#include "xrstandin.h"
+
+using namespace std;
+
+static_assert(XR_PTR_SIZE == 8, "the stand-in runtime's handles are pointers");
+
+namespace {
+
+constexpr XrSystemId kSystemId = 1;
+constexpr uint32_t kViewSize = 512;
+constexpr uint32_t kMaxImageSize = 4096;
+constexpr uint32_t kSwapchainLength = 3;
+// 72 Hz
+constexpr XrDuration kFramePeriod = 13888889;
+
+xrstandin::FrameCheck frameCheck;
+
+//! The two call idiom: reports how many values there are, and copies them if there's room
+template <typename T>
+XrResult enumerate(span<const T> values, uint32_t capacity, uint32_t* count, T* out) {
+  *count = static_cast<uint32_t>(values.size());
+  if (capacity == 0) {
+    return XR_SUCCESS;
+  }
+  if (capacity < values.size()) {
+    return XR_ERROR_SIZE_INSUFFICIENT;
+  }
+  copy(values.begin(), values.end(), out);
+  return XR_SUCCESS;
+}
+
+//! @return the index of a memory type allowed by typeBits with all of flags, or UINT32_MAX
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeBits, VkMemoryPropertyFlags flags) {
+  VkPhysicalDeviceMemoryProperties properties;
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+  for (uint32_t i = 0; i < properties.memoryTypeCount; i++) {
+    if ((typeBits & (1u << i)) && (properties.memoryTypes[i].propertyFlags & flags) == flags) {
+      return i;
+    }
+  }
+  return UINT32_MAX;
+}
+
+}  // namespace
+
+struct XrInstance_T {
+  VkInstance vulkanInstance = VK_NULL_HANDLE;
+  deque<XrEventDataBuffer> events;
+};
+
+struct XrSession_T {
+  XrInstance instance;
+  XrSessionState state = XR_SESSION_STATE_UNKNOWN;
+  XrTime displayTime = 0;
+  VkPhysicalDevice physicalDevice;
+  VkDevice device;
+  VkQueue queue = VK_NULL_HANDLE;
+  VkCommandPool pool = VK_NULL_HANDLE;
+  VkCommandBuffer cmd = VK_NULL_HANDLE;
+  VkFence fence = VK_NULL_HANDLE;
+
+  void setState(XrSessionState newState) {
+    state = newState;
+    XrEventDataSessionStateChanged changed{XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED};
+    changed.session = this;
+    changed.state = newState;
+    changed.time = displayTime;
+    XrEventDataBuffer event{};
+    memcpy(&event, &changed, sizeof(changed));
+    instance->events.push_back(event);
+  }
+
+  //! Records cmd with record, submits it and waits for it, so it's ready to record again
+  template <typename Record>
+  VkResult submitAndWait(Record record) {
+    vkResetCommandBuffer(cmd, 0);
+    VkCommandBufferBeginInfo beginInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO};
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(cmd, &beginInfo);
+    record(cmd);
+    vkEndCommandBuffer(cmd);
+    VkSubmitInfo submitInfo{VK_STRUCTURE_TYPE_SUBMIT_INFO};
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &cmd;
+    VkResult result = vkQueueSubmit(queue, 1, &submitInfo, fence);
+    if (result == VK_SUCCESS) {
+      result = vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+    }
+    vkResetFences(device, 1, &fence);
+    return result;
+  }
+};
+
+struct XrSpace_T {
+  XrSession session;
+};
+
+struct XrSwapchain_T {
+  XrSession session;
+  uint32_t width;
+  uint32_t height;
+  vector<VkImage> images;
+  vector<VkDeviceMemory> memories;
+  uint32_t nextImage = 0;
+  uint32_t acquired = 0;
+  bool waited = false;
+  uint32_t lastReleased = UINT32_MAX;
+  // host visible, for reading images back
+  VkBuffer readback = VK_NULL_HANDLE;
+  VkDeviceMemory readbackMemory = VK_NULL_HANDLE;
+  void* readbackPixels = nullptr;
+
+  ~XrSwapchain_T() {
+    VkDevice device = session->device;
+    vkDeviceWaitIdle(device);
+    for (auto image : images) {
+      vkDestroyImage(device, image, nullptr);
+    }
+    for (auto memory : memories) {
+      vkFreeMemory(device, memory, nullptr);
+    }
+    vkDestroyBuffer(device, readback, nullptr);
+    vkFreeMemory(device, readbackMemory, nullptr);
+  }
+
+  //! Copies the last released image into readbackPixels
+  VkResult readBack() {
+    VkImage image = images[lastReleased];
+    return session->submitAndWait([&](VkCommandBuffer cmd) {
+      // The application's rendering was submitted to the same queue before the image was released
+      VkImageMemoryBarrier toTransfer{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+      toTransfer.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      toTransfer.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      toTransfer.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      toTransfer.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      toTransfer.image = image;
+      toTransfer.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0,
+                           nullptr, 0, nullptr, 1, &toTransfer);
+
+      VkBufferImageCopy region{};
+      region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+      region.imageExtent = {width, height, 1};
+      vkCmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback, 1, &region);
+
+      VkBufferMemoryBarrier toHost{VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER};
+      toHost.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      toHost.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+      toHost.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      toHost.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      toHost.buffer = readback;
+      toHost.size = VK_WHOLE_SIZE;
+      VkImageMemoryBarrier toColor = toTransfer;
+      toColor.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+      toColor.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      toColor.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+      toColor.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                           VK_PIPELINE_STAGE_HOST_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 1,
+                           &toHost, 1, &toColor);
+    });
+  }
+};
+
+namespace {
+
+XrResult getVulkanGraphicsRequirements2(XrInstance instance, XrSystemId systemId,
+                                        XrGraphicsRequirementsVulkanKHR* graphicsRequirements) {
+  if (systemId != kSystemId) {
+    return XR_ERROR_SYSTEM_INVALID;
+  }
+  graphicsRequirements->minApiVersionSupported = XR_MAKE_VERSION(1, 0, 0);
+  graphicsRequirements->maxApiVersionSupported = XR_MAKE_VERSION(1, 3, 0);
+  return XR_SUCCESS;
+}
+
+XrResult createVulkanInstance(XrInstance instance, const XrVulkanInstanceCreateInfoKHR* createInfo,
+                              VkInstance* vulkanInstance, VkResult* vulkanResult) {
+  auto create = reinterpret_cast<PFN_vkCreateInstance>(
+      createInfo->pfnGetInstanceProcAddr(VK_NULL_HANDLE, "vkCreateInstance"));
+  *vulkanResult = create(createInfo->vulkanCreateInfo, createInfo->vulkanAllocator, vulkanInstance);
+  if (*vulkanResult == VK_SUCCESS) {
+    instance->vulkanInstance = *vulkanInstance;
+  }
+  return XR_SUCCESS;
+}
+
+XrResult getVulkanGraphicsDevice2(XrInstance instance, const XrVulkanGraphicsDeviceGetInfoKHR* getInfo,
+                                  VkPhysicalDevice* vulkanPhysicalDevice) {
+  // The first device stands in for the one driving the headset
+  uint32_t count = 1;
+  VkResult result = vkEnumeratePhysicalDevices(getInfo->vulkanInstance, &count, vulkanPhysicalDevice);
+  if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || count == 0) {
+    fprintf(stderr, "xrstandin: no Vulkan physical device (%d)\n", result);
+    return XR_ERROR_RUNTIME_FAILURE;
+  }
+  return XR_SUCCESS;
+}
+
+XrResult createVulkanDevice(XrInstance instance, const XrVulkanDeviceCreateInfoKHR* createInfo, VkDevice* vulkanDevice,
+                            VkResult* vulkanResult) {
+  auto create = reinterpret_cast<PFN_vkCreateDevice>(
+      createInfo->pfnGetInstanceProcAddr(instance->vulkanInstance, "vkCreateDevice"));
+  *vulkanResult = create(createInfo->vulkanPhysicalDevice, createInfo->vulkanCreateInfo, createInfo->vulkanAllocator,
+                         vulkanDevice);
+  return XR_SUCCESS;
+}
+
+}  // namespace
+
+namespace xrstandin {
+
+void setFrameCheck(FrameCheck check) {
+  frameCheck = std::move(check);
+}
+
+}  // namespace xrstandin
+
+XrResult xrResultToString(XrInstance instance, XrResult value, char buffer[XR_MAX_RESULT_STRING_SIZE]) {
+  snprintf(buffer, XR_MAX_RESULT_STRING_SIZE, "%s_%d", value < 0 ? "XR_UNKNOWN_FAILURE" : "XR_UNKNOWN_SUCCESS",
+           value);
+  return XR_SUCCESS;
+}
+
+XrResult xrGetInstanceProcAddr(XrInstance instance, const char* name, PFN_xrVoidFunction* function) {
+  struct Entry {
+    const char* name;
+    PFN_xrVoidFunction function;
+  };
+  static const Entry entries[] = {
+      {"xrGetVulkanGraphicsRequirements2KHR", reinterpret_cast<PFN_xrVoidFunction>(&getVulkanGraphicsRequirements2)},
+      {"xrCreateVulkanInstanceKHR", reinterpret_cast<PFN_xrVoidFunction>(&createVulkanInstance)},
+      {"xrGetVulkanGraphicsDevice2KHR", reinterpret_cast<PFN_xrVoidFunction>(&getVulkanGraphicsDevice2)},
+      {"xrCreateVulkanDeviceKHR", reinterpret_cast<PFN_xrVoidFunction>(&createVulkanDevice)},
+  };
+  *function = nullptr;
+  if (instance == XR_NULL_HANDLE) {
+    return XR_ERROR_HANDLE_INVALID;
+  }
+  for (const auto& entry : entries) {
+    if (!strcmp(name, entry.name)) {
+      *function = entry.function;
+      return XR_SUCCESS;
+    }
+  }
+  return XR_ERROR_FUNCTION_UNSUPPORTED;
+}
+
+XrResult xrEnumerateInstanceExtensionProperties(const char* layerName, uint32_t propertyCapacityInput,
+                                                uint32_t* propertyCountOutput, XrExtensionProperties* properties) {
+  XrExtensionProperties vulkan{XR_TYPE_EXTENSION_PROPERTIES};
+  strcpy(vulkan.extensionName, XR_KHR_VULKAN_ENABLE2_EXTENSION_NAME);
+  vulkan.extensionVersion = XR_KHR_vulkan_enable2_SPEC_VERSION;
+  const XrExtensionProperties extensions[] = {vulkan};
+  return enumerate<XrExtensionProperties>(extensions, propertyCapacityInput, propertyCountOutput, properties);
+}
+
+XrResult xrCreateInstance(const XrInstanceCreateInfo* createInfo, XrInstance* instance) {
+  for (uint32_t i = 0; i < createInfo->enabledExtensionCount; i++) {
+    if (strcmp(createInfo->enabledExtensionNames[i], XR_KHR_VULKAN_ENABLE2_EXTENSION_NAME)) {
+      return XR_ERROR_EXTENSION_NOT_PRESENT;
+    }
+  }
+  *instance = new XrInstance_T;
+  return XR_SUCCESS;
+}
+
+XrResult xrDestroyInstance(XrInstance instance) {
+  delete instance;
+  return XR_SUCCESS;
+}
+
+XrResult xrGetInstanceProperties(XrInstance instance, XrInstanceProperties* instanceProperties) {
+  instanceProperties->runtimeVersion = XR_MAKE_VERSION(1, 0, 0);
+  strcpy(instanceProperties->runtimeName, "xrstandin");
+  return XR_SUCCESS;
+}
+
+XrResult xrGetSystem(XrInstance instance, const XrSystemGetInfo* getInfo, XrSystemId* systemId) {
+  if (getInfo->formFactor != XR_FORM_FACTOR_HEAD_MOUNTED_DISPLAY) {
+    return XR_ERROR_FORM_FACTOR_UNSUPPORTED;
+  }
+  *systemId = kSystemId;
+  return XR_SUCCESS;
+}
+
+XrResult xrGetSystemProperties(XrInstance instance, XrSystemId systemId, XrSystemProperties* properties) {
+  if (systemId != kSystemId) {
+    return XR_ERROR_SYSTEM_INVALID;
+  }
+  properties->systemId = systemId;
+  properties->vendorId = 0;
+  strcpy(properties->systemName, "xrstandin headset");
+  properties->graphicsProperties = {kMaxImageSize, kMaxImageSize, 16};
+  properties->trackingProperties = {XR_TRUE, XR_TRUE};
+  return XR_SUCCESS;
+}
+
+XrResult xrEnumerateViewConfigurations(XrInstance instance, XrSystemId systemId,
+                                       uint32_t viewConfigurationTypeCapacityInput,
+                                       uint32_t* viewConfigurationTypeCountOutput,
+                                       XrViewConfigurationType* viewConfigurationTypes) {
+  const XrViewConfigurationType types[] = {XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO};
+  return enumerate<XrViewConfigurationType>(types, viewConfigurationTypeCapacityInput,
+                                            viewConfigurationTypeCountOutput, viewConfigurationTypes);
+}
+
+XrResult xrEnumerateViewConfigurationViews(XrInstance instance, XrSystemId systemId,
+                                           XrViewConfigurationType viewConfigurationType, uint32_t viewCapacityInput,
+                                           uint32_t* viewCountOutput, XrViewConfigurationView* views) {
+  if (viewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO) {
+    return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+  }
+  XrViewConfigurationView view{XR_TYPE_VIEW_CONFIGURATION_VIEW};
+  view.recommendedImageRectWidth = kViewSize;
+  view.maxImageRectWidth = kMaxImageSize;
+  view.recommendedImageRectHeight = kViewSize;
+  view.maxImageRectHeight = kMaxImageSize;
+  view.recommendedSwapchainSampleCount = 1;
+  view.maxSwapchainSampleCount = 1;
+  const XrViewConfigurationView eyes[] = {view, view};
+  return enumerate<XrViewConfigurationView>(eyes, viewCapacityInput, viewCountOutput, views);
+}
+
+XrResult xrGetViewConfigurationProperties(XrInstance instance, XrSystemId systemId,
+                                          XrViewConfigurationType viewConfigurationType,
+                                          XrViewConfigurationProperties* configurationProperties) {
+  configurationProperties->viewConfigurationType = viewConfigurationType;
+  configurationProperties->fovMutable = XR_FALSE;
+  return XR_SUCCESS;
+}
+
+XrResult xrCreateSession(XrInstance instance, const XrSessionCreateInfo* createInfo, XrSession* session) {
+  auto binding = static_cast<const XrGraphicsBindingVulkan2KHR*>(createInfo->next);
+  if (binding == nullptr || binding->type != XR_TYPE_GRAPHICS_BINDING_VULKAN2_KHR || binding->device == VK_NULL_HANDLE) {
+    return XR_ERROR_GRAPHICS_DEVICE_INVALID;
+  }
+  auto s = new XrSession_T{instance};
+  s->physicalDevice = binding->physicalDevice;
+  s->device = binding->device;
+  vkGetDeviceQueue(s->device, binding->queueFamilyIndex, binding->queueIndex, &s->queue);
+
+  VkCommandPoolCreateInfo poolInfo{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+  poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  poolInfo.queueFamilyIndex = binding->queueFamilyIndex;
+  if (vkCreateCommandPool(s->device, &poolInfo, nullptr, &s->pool) != VK_SUCCESS) {
+    xrDestroySession(s);
+    return XR_ERROR_RUNTIME_FAILURE;
+  }
+  VkCommandBufferAllocateInfo allocInfo{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+  allocInfo.commandPool = s->pool;
+  allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  allocInfo.commandBufferCount = 1;
+  VkFenceCreateInfo fenceInfo{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
+  if (vkAllocateCommandBuffers(s->device, &allocInfo, &s->cmd) != VK_SUCCESS ||
+      vkCreateFence(s->device, &fenceInfo, nullptr, &s->fence) != VK_SUCCESS) {
+    xrDestroySession(s);
+    return XR_ERROR_RUNTIME_FAILURE;
+  }
+
+  // Nothing to wait for, the headset is always on
+  s->setState(XR_SESSION_STATE_IDLE);
+  s->setState(XR_SESSION_STATE_READY);
+  *session = s;
+  return XR_SUCCESS;
+}
+
+XrResult xrDestroySession(XrSession session) {
+  vkDestroyFence(session->device, session->fence, nullptr);
+  vkDestroyCommandPool(session->device, session->pool, nullptr);
+  delete session;
+  return XR_SUCCESS;
+}
+
+XrResult xrEnumerateReferenceSpaces(XrSession session, uint32_t spaceCapacityInput, uint32_t* spaceCountOutput,
+                                    XrReferenceSpaceType* spaces) {
+  const XrReferenceSpaceType types[] = {XR_REFERENCE_SPACE_TYPE_VIEW, XR_REFERENCE_SPACE_TYPE_LOCAL};
+  return enumerate<XrReferenceSpaceType>(types, spaceCapacityInput, spaceCountOutput, spaces);
+}
+
+XrResult xrCreateReferenceSpace(XrSession session, const XrReferenceSpaceCreateInfo* createInfo, XrSpace* space) {
+  *space = new XrSpace_T{session};
+  return XR_SUCCESS;
+}
+
+XrResult xrDestroySpace(XrSpace space) {
+  delete space;
+  return XR_SUCCESS;
+}
+
+XrResult xrCreateSwapchain(XrSession session, const XrSwapchainCreateInfo* createInfo, XrSwapchain* swapchain) {
+  auto format = static_cast<VkFormat>(createInfo->format);
+  if (format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM) {
+    return XR_ERROR_SWAPCHAIN_FORMAT_UNSUPPORTED;
+  }
+  if (createInfo->width == 0 || createInfo->height == 0 || createInfo->width > kMaxImageSize ||
+      createInfo->height > kMaxImageSize || createInfo->sampleCount != 1 || createInfo->arraySize != 1 ||
+      createInfo->mipCount != 1 || createInfo->faceCount != 1) {
+    return XR_ERROR_VALIDATION_FAILURE;
+  }
+
+  VkDevice device = session->device;
+  auto sc = new XrSwapchain_T{session, createInfo->width, createInfo->height};
+  auto fail = [sc] {
+    delete sc;
+    return XR_ERROR_RUNTIME_FAILURE;
+  };
+  VkImageCreateInfo imageInfo{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+  imageInfo.imageType = VK_IMAGE_TYPE_2D;
+  imageInfo.format = format;
+  imageInfo.extent = {sc->width, sc->height, 1};
+  imageInfo.mipLevels = 1;
+  imageInfo.arrayLayers = 1;
+  imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+  imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+  // Reading images back needs TRANSFER_SRC whatever the application asked for
+  imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+  if (createInfo->usageFlags & XR_SWAPCHAIN_USAGE_COLOR_ATTACHMENT_BIT) {
+    imageInfo.usage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+  }
+  if (createInfo->usageFlags & XR_SWAPCHAIN_USAGE_SAMPLED_BIT) {
+    imageInfo.usage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+  }
+  imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+  for (uint32_t i = 0; i < kSwapchainLength; i++) {
+    VkImage image;
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
+      return fail();
+    }
+    sc->images.push_back(image);
+    VkMemoryRequirements requirements;
+    vkGetImageMemoryRequirements(device, image, &requirements);
+    VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+    allocInfo.allocationSize = requirements.size;
+    allocInfo.memoryTypeIndex =
+        findMemoryType(session->physicalDevice, requirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    VkDeviceMemory memory;
+    if (allocInfo.memoryTypeIndex == UINT32_MAX || vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+      return fail();
+    }
+    sc->memories.push_back(memory);
+    if (vkBindImageMemory(device, image, memory, 0) != VK_SUCCESS) {
+      return fail();
+    }
+  }
+
+  VkBufferCreateInfo bufferInfo{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+  bufferInfo.size = VkDeviceSize(sc->width) * sc->height * 4;
+  bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+  bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+  if (vkCreateBuffer(device, &bufferInfo, nullptr, &sc->readback) != VK_SUCCESS) {
+    return fail();
+  }
+  VkMemoryRequirements requirements;
+  vkGetBufferMemoryRequirements(device, sc->readback, &requirements);
+  VkMemoryAllocateInfo allocInfo{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+  allocInfo.allocationSize = requirements.size;
+  allocInfo.memoryTypeIndex =
+      findMemoryType(session->physicalDevice, requirements.memoryTypeBits,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+  if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+      vkAllocateMemory(device, &allocInfo, nullptr, &sc->readbackMemory) != VK_SUCCESS ||
+      vkBindBufferMemory(device, sc->readback, sc->readbackMemory, 0) != VK_SUCCESS ||
+      vkMapMemory(device, sc->readbackMemory, 0, VK_WHOLE_SIZE, 0, &sc->readbackPixels) != VK_SUCCESS) {
+    return fail();
+  }
+
+  // Images are the application's to render to in COLOR_ATTACHMENT_OPTIMAL
+  VkResult result = session->submitAndWait([sc](VkCommandBuffer cmd) {
+    for (auto image : sc->images) {
+      VkImageMemoryBarrier barrier{VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER};
+      barrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+      barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+      barrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+      barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      barrier.image = image;
+      barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+      vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0,
+                           nullptr, 0, nullptr, 1, &barrier);
+    }
+  });
+  if (result != VK_SUCCESS) {
+    return fail();
+  }
+  *swapchain = sc;
+  return XR_SUCCESS;
+}
+
+XrResult xrDestroySwapchain(XrSwapchain swapchain) {
+  delete swapchain;
+  return XR_SUCCESS;
+}
+
+XrResult xrEnumerateSwapchainImages(XrSwapchain swapchain, uint32_t imageCapacityInput, uint32_t* imageCountOutput,
+                                    XrSwapchainImageBaseHeader* images) {
+  vector<XrSwapchainImageVulkan2KHR> vulkanImages;
+  for (auto image : swapchain->images) {
+    vulkanImages.push_back({XR_TYPE_SWAPCHAIN_IMAGE_VULKAN2_KHR, nullptr, image});
+  }
+  return enumerate<XrSwapchainImageVulkan2KHR>(vulkanImages, imageCapacityInput, imageCountOutput,
+                                               reinterpret_cast<XrSwapchainImageVulkan2KHR*>(images));
+}
+
+XrResult xrAcquireSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageAcquireInfo* acquireInfo,
+                                 uint32_t* index) {
+  if (swapchain->acquired == swapchain->images.size()) {
+    return XR_ERROR_CALL_ORDER_INVALID;
+  }
+  *index = swapchain->nextImage;
+  swapchain->nextImage = (swapchain->nextImage + 1) % swapchain->images.size();
+  swapchain->acquired++;
+  return XR_SUCCESS;
+}
+
+XrResult xrWaitSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageWaitInfo* waitInfo) {
+  // Images are read back before xrEndFrame returns, so an acquired one is always free
+  if (swapchain->acquired == 0 || swapchain->waited) {
+    return XR_ERROR_CALL_ORDER_INVALID;
+  }
+  swapchain->waited = true;
+  return XR_SUCCESS;
+}
+
+XrResult xrReleaseSwapchainImage(XrSwapchain swapchain, const XrSwapchainImageReleaseInfo* releaseInfo) {
+  if (!swapchain->waited) {
+    return XR_ERROR_CALL_ORDER_INVALID;
+  }
+  uint32_t count = static_cast<uint32_t>(swapchain->images.size());
+  swapchain->lastReleased = (swapchain->nextImage + count - swapchain->acquired) % count;
+  swapchain->acquired--;
+  swapchain->waited = false;
+  return XR_SUCCESS;
+}
+
+XrResult xrPollEvent(XrInstance instance, XrEventDataBuffer* eventData) {
+  if (instance->events.empty()) {
+    return XR_EVENT_UNAVAILABLE;
+  }
+  *eventData = instance->events.front();
+  instance->events.pop_front();
+  return XR_SUCCESS;
+}
+
+XrResult xrBeginSession(XrSession session, const XrSessionBeginInfo* beginInfo) {
+  if (session->state != XR_SESSION_STATE_READY) {
+    return XR_ERROR_SESSION_NOT_READY;
+  }
+  if (beginInfo->primaryViewConfigurationType != XR_VIEW_CONFIGURATION_TYPE_PRIMARY_STEREO) {
+    return XR_ERROR_VIEW_CONFIGURATION_TYPE_UNSUPPORTED;
+  }
+  session->setState(XR_SESSION_STATE_SYNCHRONIZED);
+  session->setState(XR_SESSION_STATE_VISIBLE);
+  session->setState(XR_SESSION_STATE_FOCUSED);
+  return XR_SUCCESS;
+}
+
+XrResult xrEndSession(XrSession session) {
+  session->setState(XR_SESSION_STATE_IDLE);
+  return XR_SUCCESS;
+}
+
+XrResult xrWaitFrame(XrSession session, const XrFrameWaitInfo* frameWaitInfo, XrFrameState* frameState) {
+  session->displayTime += kFramePeriod;
+  frameState->predictedDisplayTime = session->displayTime;
+  frameState->predictedDisplayPeriod = kFramePeriod;
+  frameState->shouldRender = XR_TRUE;
+  return XR_SUCCESS;
+}
+
+XrResult xrBeginFrame(XrSession session, const XrFrameBeginInfo* frameBeginInfo) {
+  return XR_SUCCESS;
+}
+
+XrResult xrEndFrame(XrSession session, const XrFrameEndInfo* frameEndInfo) {
+  for (uint32_t i = 0; i < frameEndInfo->layerCount; i++) {
+    if (frameEndInfo->layers[i]->type != XR_TYPE_COMPOSITION_LAYER_QUAD) {
+      continue;
+    }
+    auto quad = reinterpret_cast<const XrCompositionLayerQuad*>(frameEndInfo->layers[i]);
+    XrSwapchain swapchain = quad->subImage.swapchain;
+    if (swapchain == XR_NULL_HANDLE || swapchain->lastReleased == UINT32_MAX) {
+      return XR_ERROR_LAYER_INVALID;
+    }
+    if (swapchain->readBack() != VK_SUCCESS) {
+      return XR_ERROR_RUNTIME_FAILURE;
+    }
+    if (frameCheck) {
+      frameCheck(static_cast<const uint8_t*>(swapchain->readbackPixels), swapchain->width, swapchain->height);
+    }
+  }
+  return XR_SUCCESS;
+}
@@ -0,0 +1,26 @@
+#ifndef VKHOST_XRSTANDIN_H
+#define VKHOST_XRSTANDIN_H
+
+#include <cstdint>
+#include <functional>
+
+/*!
+ * The stand-in OpenXR runtime of xrstandin.cpp implements the core functions xrh calls, and
+ * XR_KHR_vulkan_enable2 on top of whatever Vulkan driver the loader finds. It has one head mounted
+ * system with two 512x512 views. A session goes straight from READY to FOCUSED once it's begun,
+ * and frames never wait for a display.
+ *
+ * Swap chains hold three images of R8G8B8A8 formats, handed to the application in
+ * VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL. xrEndFrame reads the last released image of every quad
+ * layer back, on the session's queue, and gives it to the FrameCheck, if one is set.
+ */
+namespace xrstandin {
+
+//! Gets width * height tightly packed RGBA8 pixels, rows top to bottom
+using FrameCheck = std::function<void(const uint8_t* pixels, uint32_t width, uint32_t height)>;
+
+void setFrameCheck(FrameCheck check);
+
+}  // namespace xrstandin
+
+#endif  // VKHOST_XRSTANDIN_H